@@ -0,0 +1,44 @@
+//===- ExecutionCounts.h - Estimated block execution counts -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Estimates of how many times the blocks of a function execute, shared by the
+// passes that weigh the cost of a transformation by how often it runs, and the
+// helpers their reports use.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_EXECUTIONCOUNTS_H
+#define LLVM_ANALYSIS_EXECUTIONCOUNTS_H
+
+#include <vector>
+
+namespace llvm {
+
+class Function;
+class raw_ostream;
+
+/// Estimate how many times each block of \p F executes, in function order.
+/// The block frequencies are scaled so that the entry block executes as often
+/// as the profile says the function was called, or once without a profile.
+/// Without \p UseBlockFrequencies the dominator tree, loop and block frequency
+/// analyses are skipped and every block counts as executed once per call.
+std::vector<double>
+estimateBlockExecutionCounts(Function &F, bool UseBlockFrequencies = true);
+
+/// \p Part as a percentage of \p Whole, or 0 if \p Whole is 0.
+inline double percentOf(double Part, double Whole) {
+  return Whole > 0 ? 100 * Part / Whole : 0.0;
+}
+
+/// Print the report line saying where the execution counts came from.
+void printExecutionCountSource(raw_ostream &OS, bool HaveProfile);
+
+} // end namespace llvm
+
+#endif
@@ -21,6 +21,7 @@
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/DwarfStringPoolEntry.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/TrapInfo.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/RandomNumberGenerator.h"
@@ -145,6 +146,11 @@ private:
   /// If the target supports dwarf debug info, this pointer is non-null.
   DwarfDebug *DD;
 
+  /// Uniqued trap information referenced by lowered MCInsts. MCInsts may be
+  /// re-encoded during relaxation after their MachineFunction is gone, so the
+  /// entries live as long as the printer.
+  DenseMap<TrapInfo, std::unique_ptr<TrapInfo>> UniquedTrapInfo;
+
 protected:
   explicit AsmPrinter(TargetMachine &TM, std::unique_ptr<MCStreamer> Streamer);
 
@@ -166,6 +172,10 @@ public:
   MCSymbol *getFunctionEnd() const { return CurrentFnEnd; }
   MCSymbol *getCurExceptionSym();
 
+  /// Return a pointer to a copy of TI that stays valid until the printer is
+  /// destroyed, or null if TI is unknown. Used to attach trap info to MCInsts.
+  const TrapInfo *getUniquedTrapInfo(const TrapInfo &TI);
+
   /// Return information about object file lowering.
   const TargetLoweringObjectFile &getObjFileLowering() const;
 
@@ -575,6 +585,9 @@ private:
   std::unique_ptr<RandomNumberGenerator> RNG;
 
   void EmitCallTrampolines();
+
+  /// Emit the diversity manifest of the module into its ELF section.
+  void EmitDiversityManifest(const Module &M);
 };
 }
 
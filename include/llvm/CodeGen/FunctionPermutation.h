@@ -0,0 +1,47 @@
+//===- CodeGen/FunctionPermutation.h - Load-time permutation ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// With -load-time-function-permutation, the permutable functions of a module
+// are emitted back to back into one .text.fperm section, each starting on a
+// slot boundary, and the multicompiler_fperm section describes the slots and
+// every pc-relative reference the module's code makes. The FunctionPermutation
+// runtime uses it to permute the slots of each module before main runs.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_FUNCTIONPERMUTATION_H
+#define LLVM_CODEGEN_FUNCTIONPERMUTATION_H
+
+namespace llvm {
+class Function;
+class TargetMachine;
+
+/// Version of the multicompiler_fperm section layout.
+static const unsigned FunctionPermutationVersion = 1;
+
+/// Return true if -load-time-function-permutation is given and supported for
+/// code generated by \p TM: position-independent x86-64 ELF code without code
+/// pointer protection trampolines or read-only jump tables.
+bool isLoadTimePermutationEnabled(const TargetMachine &TM);
+
+/// Return true if \p F is emitted into the .text.fperm section of its module.
+/// Only functions with local linkage are permuted, since the runtime cannot
+/// find references to them from code compiled without the option. Functions
+/// with inline assembly or thread-local accesses, which the linker may rewrite,
+/// stay in place.
+bool isLoadTimePermutable(const Function &F, const TargetMachine &TM);
+
+/// Log2 of the alignment of every function in .text.fperm. It is the size
+/// granule of the slots, so permuting them keeps every alignment the code
+/// relies on.
+unsigned getPermutableFunctionAlignment();
+
+} // end namespace llvm
+
+#endif
@@ -22,6 +22,8 @@
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/IR/TrapInfo.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/ArrayRecycler.h"
 #include "llvm/Support/Recycler.h"
@@ -133,6 +135,14 @@ class MachineFunction {
   typedef ilist<MachineBasicBlock> BasicBlockListType;
   BasicBlockListType BasicBlocks;
 
+  // Trap information for the few instructions that carry any. Kept on the
+  // side so that MachineInstr doesn't pay for it.
+  DenseMap<const MachineInstr *, TrapInfo> InstrTrapInfo;
+
+  // Per-function multicompiler option values, parsed from the function's
+  // attributes on first use.
+  mutable DenseMap<const cl::Option *, int64_t> FunctionOptions;
+
   /// FunctionNumber - This provides a unique ID for each function emitted in
   /// this translation unit.
   ///
@@ -436,6 +446,37 @@ public:
   ///
   void DeleteMachineInstr(MachineInstr *MI);
 
+  /// getTrapInfo - Return the trap information attached to MI, or an unknown
+  /// TrapInfo if there is none.
+  TrapInfo getTrapInfo(const MachineInstr *MI) const {
+    return InstrTrapInfo.lookup(MI);
+  }
+
+  /// setTrapInfo - Attach trap information to MI, which must have been
+  /// allocated by this function. An unknown TrapInfo clears the entry.
+  void setTrapInfo(const MachineInstr *MI, const TrapInfo &TI) {
+    if (TI.isUnknown())
+      InstrTrapInfo.erase(MI);
+    else
+      InstrTrapInfo[MI] = TI;
+  }
+
+  /// getFunctionOption - Return this function's value of the multicompiler
+  /// option O. The value is parsed from the function's attributes once and
+  /// cached.
+  template <class DataType, bool ExternalStorage, class ParserClass>
+  DataType
+  getFunctionOption(cl::opt<DataType, ExternalStorage, ParserClass> &O) const {
+    static_assert(std::is_integral<DataType>::value,
+                  "per-function options are integers or booleans");
+    auto I = FunctionOptions.find(&O);
+    if (I != FunctionOptions.end())
+      return static_cast<DataType>(I->second);
+    DataType Val = multicompiler::getFunctionOption(O, *Fn);
+    FunctionOptions[&O] = Val;
+    return Val;
+  }
+
   /// CreateMachineBasicBlock - Allocate a new MachineBasicBlock. Use this
   /// instead of `new MachineBasicBlock'.
   ///
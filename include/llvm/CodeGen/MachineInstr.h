@@ -103,7 +103,6 @@ private:
   mmo_iterator MemRefs;
 
   DebugLoc debugLoc;                    // Source line information.
-  TrapInfo trapInfo;
 
   MachineInstr(const MachineInstr&) = delete;
   void operator=(const MachineInstr&) = delete;
@@ -249,7 +248,10 @@ public:
   /// Returns the debug location id of this MachineInstr.
   const DebugLoc &getDebugLoc() const { return debugLoc; }
 
-  TrapInfo getTrapInfo() const { return trapInfo; }
+  /// Returns the trap information attached to this MachineInstr. The
+  /// information lives in the parent MachineFunction, so this returns an
+  /// unknown TrapInfo for instructions not inserted into a function yet.
+  TrapInfo getTrapInfo() const;
 
   /// Return the debug variable referenced by
   /// this DBG_VALUE instruction.
@@ -1179,10 +1181,10 @@ public:
     assert(debugLoc.hasTrivialDestructor() && "Expected trivial destructor");
   }
 
-  void setTrapInfo(const TrapInfo ti) {
-    trapInfo = ti;
-    assert(trapInfo.hasTrivialDestructor() && "Expected trivial destructor");
-  }
+  /// Attach trap information to this instruction, which must already be
+  /// inserted into a function. Use MachineInstrBuilder::setTrapInfo() for
+  /// instructions that are still being built.
+  void setTrapInfo(const TrapInfo &TI);
 
   /// Erase an operand  from an instruction, leaving it with one
   /// fewer operand than it started with.
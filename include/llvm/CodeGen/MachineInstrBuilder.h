@@ -199,6 +199,11 @@ public:
     return *this;
   }
 
+  const MachineInstrBuilder &setTrapInfo(const TrapInfo &TI) const {
+    MF->setTrapInfo(MI, TI);
+    return *this;
+  }
+
   const MachineInstrBuilder &setMIFlags(unsigned Flags) const {
     MI->setFlags(Flags);
     return *this;
@@ -42,6 +42,7 @@
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/MCSymbol.h"
 #include "llvm/MC/MachineLocation.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/Dwarf.h"
@@ -206,6 +207,9 @@ class MachineModuleInfo : public ImmutablePass {
   /// addresses.
   std::vector<CallTrampolineInfo> CallTrampolines;
 
+  /// Manifest - Decisions of the diversifying transformations for the module.
+  multicompiler::DiversityManifest Manifest;
+
 public:
   static char ID; // Pass identification, replacement for typeid
 
@@ -457,6 +461,13 @@ public:
     return CallTrampolines;
   }
 
+  /// getDiversityManifest - Return the manifest the diversifying
+  /// transformations record their decisions in, or null if
+  /// -diversity-manifest is off.
+  multicompiler::DiversityManifest *getDiversityManifest() {
+    return multicompiler::DiversityManifestEnabled ? &Manifest : nullptr;
+  }
+
 }; // End class MachineModuleInfo
 
 } // End llvm namespace
@@ -191,6 +191,11 @@ public:
   /// Return true if shrink wrapping is enabled.
   bool getEnableShrinkWrap() const;
 
+  /// Return true if the diversifying transformations should take their fast
+  /// path: single-pass transforms sharing one random stream per module, and
+  /// planning without block frequencies. The default at -O0.
+  bool useCheapDiversity() const;
+
   /// Return true if the default global register allocator is in use and
   /// has not be overriden on the command line with '-regalloc=...'
   bool usingDefaultRegAlloc() const;
@@ -671,6 +676,22 @@ namespace llvm {
   /// global variables and adds random padding between globals.
   ModulePass *createGlobalRandomizationPass();
 
+  /// createFunctionOptionsPass - This pass attaches the settings of the
+  /// per-function options file to functions as attributes.
+  ModulePass *createFunctionOptionsPass();
+
+  /// createDiversityPlannerPass - This pass chooses per-function settings for
+  /// the diversifying transformations that fit an overhead budget. A Cheap
+  /// planner counts every block as executed once per call instead of
+  /// computing block frequencies.
+  ModulePass *createDiversityPlannerPass(const TargetMachine *TM,
+                                         bool Cheap = false);
+
+  /// createIndirectCallPromotionPass - This pass promotes profiled hot
+  /// indirect call targets to guarded direct calls ahead of pointer
+  /// protection.
+  ModulePass *createIndirectCallPromotionPass();
+
   /// createPointerProtection - This pass creates pointer protection tables.
   ModulePass *createPointerProtectionPass(bool HMACForwardPointers);
 
@@ -67,6 +67,10 @@ class RegisterClassInfo {
   // RNG instance for this pass
   std::unique_ptr<RandomNumberGenerator> RNG;
 
+  // Index of the diversity manifest record of MF, or -1 before the first
+  // randomization.
+  mutable int ManifestRecord;
+
   // Compute all information about RC.
   void compute(const TargetRegisterClass *RC) const;
 
@@ -45,6 +45,12 @@ struct CSDataRando : public ModulePass {
     // The map of node to mask argument value
     DenseMap<const DSNode*, Value*> ArgMaskMap;
 
+    // If the clone takes its masks in a table, the table argument and the
+    // index in the table of the mask of each arg node. The masks are then
+    // loaded on first use, so they are not in ArgMaskMap.
+    Argument *MaskTable = nullptr;
+    DenseMap<const DSNode*, unsigned> MaskTableIndex;
+
     // Map values in the new function to the values in the original function
     ValueMap<const Value*, const Value*> NewToOldMap;
 
@@ -55,6 +61,10 @@ struct CSDataRando : public ModulePass {
     DenseMap<const DSNode*, const DSNode*> ToGlobalNodeMap;
 
     bool CanReplaceAddress = true;
+
+    bool isArgNode(const DSNode *N) const {
+      return ArgMaskMap.count(N) || MaskTableIndex.count(N);
+    }
   };
 
   static char ID;
@@ -89,27 +99,25 @@ private:
 
   Value *getCloneCalledValue(CallSite CS, FuncInfo &CalleeInfo);
 
+  bool usesMaskTable(const FuncInfo &FI) const;
+
+  Constant *getConstantMaskTable(Module &M, ArrayRef<Constant*> Masks);
+
+  Value *createMaskTable(Instruction *Call, ArrayRef<Value*> Masks);
+
   bool replaceOriginalsWithClones();
 
+  void shareCloneBodies();
+
   BUMarkDoNotEncrypt *DSA;
   MapVector<Function*, Function*> OldToNewFuncMap;
   std::map<const Function*, FuncInfo> FunctionInfo;
+  DenseMap<Constant*, GlobalVariable*> ConstantMaskTables;
   DenseSet<const DSNode*> GlobalNodes;
   Type *MaskTy;
 };
 
 class FunctionWrappers : public ModulePass {
-public:
-  struct WrapperInfo {
-    WrapperInfo(const char *N, const Type *T)
-        : Name(N), Ty(T) {}
-
-    const char *Name;
-    const Type *Ty;
-  };
-
-private:
-  StringMap<const WrapperInfo> Wrappers;
   DenseSet<const Type*> CantEncryptTypes;
   DenseSet<StringRef> MemManagement;
   DenseSet<StringRef> JmpFunctions;
@@ -127,16 +135,14 @@ public:
     AU.addRequiredTransitive<FormatFunctions>();
   }
 
-  void constructMap(LLVMContext &C);
+  // The wrappers are described in include/llvm/DataRando/Runtime/Wrappers.td.
+  bool hasWrapperFunction(const Function *F) const;
 
-  const StringMap<const WrapperInfo> *getWrappers() const {
-    return &Wrappers;
-  }
+  // Name of the runtime wrapper for F, which must have one.
+  StringRef getWrapperName(const Function *F) const;
 
-  bool hasWrapperFunction(const Function *F) const {
-    const StringRef Name = Function::getRealLinkageName(F->getName());
-    return Wrappers.count(Name);
-  }
+  // The type the runtime declares the wrapper for F with.
+  FunctionType *getDeclaredWrapperType(const Function *F) const;
 
   bool typeCanBeEncrypted(const Type* T) const {
     if (CantEncryptTypes.count(T)) {
@@ -162,9 +168,8 @@ public:
     return MemManagement.count(Name);
   }
 
-  bool isFormatFunction(const Value *V) const {
-    return FormatFuncs->isFormatFunction(V);
-  }
+  // Whether V is a function that takes a mask for each variadic argument.
+  bool isFormatFunction(const Value *V) const;
 
   // For setjmp/longjmp, we can handle these even though they don't have wrapper
   // functions.
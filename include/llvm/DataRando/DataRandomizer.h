@@ -4,6 +4,8 @@
 #define LLVM_DATARANDO_DATARANDOMIZER_H
 
 #include "llvm/DataRando/Runtime/DataRandoTypes.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/TypeBuilder.h"
@@ -15,6 +17,9 @@ class Value;
 class DataLayout;
 class PointerEquivalenceAnalysis;
 class FunctionWrappers;
+class Instruction;
+class LoadInst;
+class Loop;
 
 class DataRandomizer {
 public:
@@ -37,6 +42,16 @@ public:
 
   Value *createXor(IRBuilder<> &builder, Value *V, Value *Address, Value *Mask, unsigned Alignment = 1);
 
+  // Like createXor, but for a vector V accessed through the vector of pointers
+  // Addresses, as in gathers and scatters. Each lane is masked with the
+  // corresponding entry of LaneMasks.
+  Value *createLaneXor(IRBuilder<> &builder, Value *V, Value *Addresses, ArrayRef<Value *> LaneMasks, unsigned Alignment);
+
+  // Clean up the code emitted by createXor in F: forward stored values to
+  // loads of the same address, fold encrypt/decrypt pairs and hoist loop
+  // invariant mask computations out of loops.
+  bool optimizeInstrumentation(Function &F);
+
 private:
   // Get the equivalent width integer type
   Type *getIntType(Type *T);
@@ -45,12 +60,32 @@ private:
 
   Value *createAddressAlignment(IRBuilder<> &builder, Value *Address, uint64_t MaskSize, uint64_t Alignment);
 
+  Value *getAlignmentAddress(IRBuilder<> &builder, Value *Address, uint64_t MaskSize);
+
   Value *getEffectiveMask(IRBuilder<> &builder, Value *Address, Value *Mask, unsigned Alignment);
 
   Value *getMaskAsType(IRBuilder<> &builder, Type *Ty, Value *Mask);
 
+  void recordEmitted(BasicBlock *BB, Instruction *Prev, BasicBlock::iterator InsertPt);
+
+  bool forwardStoredValues(Function &F);
+
+  bool foldXorPairs(Function &F);
+
+  bool hoistMaskComputations(Loop *L);
+
+  bool isEquivalentMask(const Value *A, const Value *B, unsigned Depth = 0) const;
+
+  void eraseIfDead(Instruction *I);
+
   const DataLayout &DL;
   Type *MaskTy;
+
+  // Instructions emitted by createXor, the xors applying the masks and the
+  // loads whose result is decrypted by them.
+  SmallPtrSet<Instruction *, 64> Emitted;
+  SmallPtrSet<Instruction *, 16> Xors;
+  SmallVector<LoadInst *, 16> DecryptedLoads;
 };
 
 
@@ -9,6 +9,7 @@
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/DataRando/Runtime/DataRandoTypes.h"
 #include "llvm/Support/RandomNumberGenerator.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "dsa/DataStructure.h"
 #include "dsa/DSGraph.h"
@@ -79,6 +80,18 @@ public:
   virtual NodeHandle getNode(const Value *V) = 0;
   virtual Value *getMaskForNode(const NodeHandle &NH) = 0;
 
+  // Record the alignment of the memory accesses in F so that classes which are
+  // only accessed at addresses aligned to less than the effective mask size
+  // are assigned narrower, repeated masks. Must be called before masks are
+  // assigned.
+  void recordAccessAlignments(const Function &F, const DataLayout &DL);
+
+  // The smallest power of 2 number of bytes after which the mask value repeats.
+  // Mask rotation is only needed for accesses that are not aligned to this.
+  // Masks not known at compile time are assumed to use the full effective mask
+  // size.
+  static unsigned getMaskPeriod(const Value *Mask);
+
   static bool shouldIgnoreGlobal(const GlobalVariable &GV) {
     // This is the same condition that the local DSA pass uses to determine if a
     // global should be ignored.
@@ -89,21 +102,29 @@ public:
 
 protected:
   Constant *nextMask() {
+    return nextMask(EffectiveMaskSize);
+  }
+
+  Constant *nextMask(unsigned MaskSize) {
     assert(RNG && "RNG not initialized, call init first.");
     mask_t M;
     do {
       M = RNG->Random();
-      mask_t BitsNeededMask = ((uint64_t)-1) >> ((sizeof(mask_t) - EffectiveMaskSize) * 8);
+      mask_t BitsNeededMask = ((uint64_t)-1) >> ((sizeof(mask_t) - MaskSize) * 8);
       // Get the bits we need
       M &= BitsNeededMask;
       // Fill the rest of the mask with the repeated value;
-      for (unsigned i = EffectiveMaskSize; i < sizeof(mask_t); i *= 2) {
+      for (unsigned i = MaskSize; i < sizeof(mask_t); i *= 2) {
         M |= M << (8 * i);
       }
     } while (M == 0);
     return ConstantInt::get(getMaskTy(), M);
   }
 
+  // Get a new random mask for the class N, sized for the accesses recorded by
+  // recordAccessAlignments.
+  Constant *nextMaskForNode(const DSNode *N);
+
   Constant *nullMask() {
     return Constant::getNullValue(getMaskTy());
   }
@@ -116,10 +137,28 @@ protected:
   // Initialize the random number generator and mask type.
   void init(RandomNumberGenerator &R, LLVMContext &C);
 
+  // The largest power of 2 number of bytes, up to the effective mask size, that
+  // an access of AccessTy with the given alignment is aligned to.
+  static unsigned getAlignedSize(Type *AccessTy, unsigned Alignment, const DataLayout &DL);
+
+  // The mask size that nextMaskForNode will use for N.
+  unsigned getMaskSize(const DSNode *N) const {
+    auto I = MaskSizes.find(N);
+    return I == MaskSizes.end() ? (unsigned)EffectiveMaskSize : I->second;
+  }
+
+  void setMaskSize(const DSNode *N, unsigned Size) {
+    MaskSizes[N] = Size;
+  }
+
 private:
   RandomNumberGenerator *RNG;
   IntegerType *MaskTy;
 
+  // Mask size of each class, narrower than the effective mask size only if
+  // every recorded access to the class has that alignment.
+  DenseMap<const DSNode*, unsigned> MaskSizes;
+
   void appendMasksForReachable(Type *T, const NodeHandle &N, const DataLayout &DL, const FunctionWrappers &FW, SmallVectorImpl<Value *> &SV, DenseSet<StructType*> &Visited);
 };
 
@@ -134,7 +173,8 @@ public:
 
   void getAnalysisUsage(AnalysisUsage &AU) const override;
 
-  // Print all equivalence classes to FileName. This may take a lot of time if
+  // Print all equivalence classes to FileName, as JSON lines unless
+  // -print-eq-classes-text is given. The text format may take a lot of time if
   // the program is large. Also if Values are RAUWed after outputing the values
   // actually in the equivalence class will change.
   bool printEquivalenceClasses(StringRef FileName, const Module &M);
@@ -181,6 +221,20 @@ private:
 
   void safetyAnalysis();
 
+  // Rank the classes still to be assigned masks by their estimated dynamic
+  // access counts and leave the most frequently accessed ones unencrypted, or
+  // narrow their masks, to keep the estimated overhead within
+  // -data-rando-overhead-budget. Optionally writes a report of the result.
+  void applyOverheadBudget(Module &M);
+
+  void visitClassValues(const Module &M, function_ref<void(const Value *, StringRef, const Function *, int)> Visit);
+
+  unsigned getClassID(const DSNode *N);
+
+  void numberClasses(const Module &M);
+
+  bool dumpEquivalenceClasses(StringRef FileName, const Module &M);
+
   void warnUnknown(const DSNode *Node);
 
   ValueMap<const Value*, NodeHandle> NodeMap;
@@ -191,6 +245,9 @@ private:
   const FunctionWrappers *FW;
   DenseSet<const DSNode*> UsedUnknownNodes;
   DenseMap<const DSNode*, StringSet<>> MaskReason;
+  // Stable class numbers shared by the budget report and the class dump.
+  DenseMap<const DSNode*, unsigned> ClassIDs;
+  std::vector<const DSNode*> Classes;
 };
 }
 
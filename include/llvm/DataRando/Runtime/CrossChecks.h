@@ -0,0 +1,52 @@
+#ifndef LLVM_DATARANDO_RUNTIME_CROSSCHECKS_H
+#define LLVM_DATARANDO_RUNTIME_CROSSCHECKS_H
+
+/* Interface between instrumented code and the cross-checking runtime. This
+   header is shared by the compiler passes in lib/DataRando and the runtimes,
+   so it must stay plain C. */
+
+#include <stdint.h>
+
+/* Multiplier for the heap check hash. With -hash-heap-checks and
+   -inline-heap-check-hash the HeapChecks pass folds each checked object into
+   the thread-local accumulator __crosscheck_hash_state inline, using exactly
+   the update below. Only flush points (calls to external functions) call
+   __crosscheckHash(), which cross-checks and resets the accumulator. Runtimes
+   that support this define __crosscheck_hash_state. */
+#define CROSSCHECK_HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+#define CROSSCHECK_HASH_SHIFT 32
+
+static inline uint64_t __crosscheck_hash_update(uint64_t acc, uint64_t value) {
+  acc = (acc ^ value) * CROSSCHECK_HASH_MULTIPLIER;
+  return acc ^ (acc >> CROSSCHECK_HASH_SHIFT);
+}
+
+/* Buffered data cross-checks. With -xcheck-buffer the DataChecks pass
+   appends each checked value to the thread-local __crosscheck_buffer and
+   calls __crosscheckFlush() once CROSSCHECK_INTERVAL values are pending, as
+   well as before every call to an external function (the points where the
+   program can reach a system call). The flush verifies the whole batch. */
+#define CROSSCHECK_BUFFER_SIZE 4096
+#define CROSSCHECK_INTERVAL 1024
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __cplusplus
+extern __thread uint64_t __crosscheck_hash_state;
+extern __thread uint64_t __crosscheck_buffer[CROSSCHECK_BUFFER_SIZE];
+extern __thread uint64_t __crosscheck_buffer_pos;
+#endif
+
+void __crosscheck(uintptr_t value);
+void __crosscheckFlush(void);
+void __crosscheckObject(void *object);
+void __crosscheckHashObject(void *object);
+void __crosscheckHash(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LLVM_DATARANDO_RUNTIME_CROSSCHECKS_H */
@@ -41,12 +41,18 @@ class Instruction : public User,
 
   BasicBlock *Parent;
   DebugLoc DbgLoc;                         // 'dbg' Metadata cache.
-  TrapInfo trapInfo;                       // 'textrap' Metadata cache.
 
   enum {
     /// HasMetadataBit - This is a bit stored in the SubClassData field which
     /// indicates whether this instruction has metadata attached to it or not.
-    HasMetadataBit = 1 << 15
+    HasMetadataBit = 1 << 15,
+
+    /// HasTrapInfoBit - This is a bit stored in the SubClassData field which
+    /// indicates whether this instruction has an entry in the on-the-side
+    /// TrapInfo table.
+    HasTrapInfoBit = 1 << 14,
+
+    ReservedBits = HasMetadataBit | HasTrapInfoBit
   };
 public:
   // Out of line virtual method, so the vtable, etc has a home.
@@ -232,11 +238,22 @@ public:
   /// getDebugLoc - Return the debug location for this node as a DebugLoc.
   const DebugLoc &getDebugLoc() const { return DbgLoc; }
 
-  /// setTrapInfo - Set the trap information for this instruction.
-  void setTrapInfo(const TrapInfo &Info) { trapInfo = Info; }
+  /// setTrapInfo - Set the trap information for this instruction.  Only a
+  /// handful of instructions carry trap information, so it is kept in a side
+  /// table rather than in every instruction.
+  void setTrapInfo(const TrapInfo &Info);
 
   /// getTrapInfo - Return the trap information for this node.
-  const TrapInfo &getTrapInfo() const { return trapInfo; }
+  TrapInfo getTrapInfo() const {
+    if (!hasTrapInfo())
+      return TrapInfo();
+    return getTrapInfoImpl();
+  }
+
+  /// hasTrapInfo - Return true if this instruction has trap information.
+  bool hasTrapInfo() const {
+    return (getSubclassDataFromValue() & HasTrapInfoBit) != 0;
+  }
 
   /// Set or clear the unsafe-algebra flag on this instruction, which must be an
   /// operator which supports this flag. See LangRef.html for the meaning of
@@ -311,6 +328,9 @@ private:
   void getAllMetadataOtherThanDebugLocImpl(
       SmallVectorImpl<std::pair<unsigned, MDNode *>> &) const;
   void clearMetadataHashEntries();
+
+  // Implemented in Instruction.cpp.
+  TrapInfo getTrapInfoImpl() const;
 public:
   //===--------------------------------------------------------------------===//
   // Predicates and helper methods.
@@ -518,20 +538,25 @@ private:
                          (V ? HasMetadataBit : 0));
   }
 
+  void setHasTrapInfo(bool V) {
+    setValueSubclassData((getSubclassDataFromValue() & ~HasTrapInfoBit) |
+                         (V ? HasTrapInfoBit : 0));
+  }
+
   friend class SymbolTableListTraits<Instruction>;
   void setParent(BasicBlock *P);
 protected:
-  // Instruction subclasses can stick up to 15 bits of stuff into the
+  // Instruction subclasses can stick up to 14 bits of stuff into the
   // SubclassData field of instruction with these members.
 
-  // Verify that only the low 15 bits are used.
+  // Verify that only the low 14 bits are used.
   void setInstructionSubclassData(unsigned short D) {
-    assert((D & HasMetadataBit) == 0 && "Out of range value put into field");
-    setValueSubclassData((getSubclassDataFromValue() & HasMetadataBit) | D);
+    assert((D & ReservedBits) == 0 && "Out of range value put into field");
+    setValueSubclassData((getSubclassDataFromValue() & ReservedBits) | D);
   }
 
   unsigned getSubclassDataFromInstruction() const {
-    return getSubclassDataFromValue() & ~HasMetadataBit;
+    return getSubclassDataFromValue() & ~ReservedBits;
   }
 
   Instruction(Type *Ty, unsigned iType, Use *Ops, unsigned NumOps,
@@ -152,10 +152,12 @@ class MCInst {
   unsigned Opcode;
   SMLoc Loc;
   SmallVector<MCOperand, 8> Operands;
-  TrapInfo trapInfo;
+  // Non-owning; points at trap info uniqued by the producer of this MCInst so
+  // that copying an MCInst never goes through metadata tracking.
+  const TrapInfo *TI;
 
 public:
-  MCInst() : Opcode(0) {}
+  MCInst() : Opcode(0), TI(nullptr) {}
 
   void setOpcode(unsigned Op) { Opcode = Op; }
   unsigned getOpcode() const { return Opcode; }
@@ -163,8 +165,8 @@ public:
   void setLoc(SMLoc loc) { Loc = loc; }
   SMLoc getLoc() const { return Loc; }
 
-  void setTrapInfo(TrapInfo TI) { trapInfo = TI; }
-  TrapInfo getTrapInfo() const { return trapInfo; }
+  void setTrapInfo(const TrapInfo *Info) { TI = Info; }
+  TrapInfo getTrapInfo() const { return TI ? *TI : TrapInfo(); }
 
   const MCOperand &getOperand(unsigned i) const { return Operands[i]; }
   MCOperand &getOperand(unsigned i) { return Operands[i]; }
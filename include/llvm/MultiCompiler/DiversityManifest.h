@@ -0,0 +1,121 @@
+//===- DiversityManifest.h - Record of diversification decisions -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the diversity manifest: the decisions the multicompiler
+// transformations made for a module, keyed by function, so that two variants
+// can be compared without disassembling them. With -diversity-manifest the
+// AsmPrinter writes the manifest of every module into the
+// .multicompiler_manifest section. The linker concatenates the manifests of
+// all the modules of a program.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_MULTICOMPILER_DIVERSITYMANIFEST_H
+#define LLVM_MULTICOMPILER_DIVERSITYMANIFEST_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace multicompiler {
+
+using namespace llvm;
+
+extern cl::opt<bool> DiversityManifestEnabled;
+
+static const char DiversityManifestSection[] = ".multicompiler_manifest";
+
+// The decisions a record holds. The values of each kind are:
+//
+//   NOPInsertion      instruction index and NOP kind, for every inserted NOP
+//   MOVToLEA          instruction index, for every substituted MOV
+//   EquivSubst        instruction index and new opcode, for every substitution
+//   RegisterOrder     register class and a hash of its shuffled allocation
+//                     order, every time the allocation order is shuffled
+//   StackLayout       frame object indices in layout order, then the frame
+//                     size
+//   GlobalLayout      name hash of every global variable in layout order, or
+//                     the size of a padding variable
+//   FunctionLayout    name hash of every function in emission order
+//   Trampolines       original index of every call trampoline in layout order
+//
+// Instruction indices count the instructions of the function before the
+// transformation, in layout order. The ordering kinds describe layout, so
+// the same value at the same position means the same placement.
+enum DecisionKind : uint8_t {
+  DK_NOPInsertion,
+  DK_MOVToLEA,
+  DK_EquivSubst,
+  DK_RegisterOrder,
+  DK_StackLayout,
+  DK_GlobalLayout,
+  DK_FunctionLayout,
+  DK_Trampolines,
+  DK_NumKinds
+};
+
+StringRef getDecisionKindName(DecisionKind Kind);
+
+// Return true if Kind records a layout (a sequence of placements) rather
+// than a set of independent choices.
+inline bool isLayoutDecision(DecisionKind Kind) {
+  return Kind >= DK_RegisterOrder;
+}
+
+// Return a name hash that is the same on every host.
+uint64_t getManifestNameHash(StringRef Name);
+
+struct DecisionRecord {
+  DecisionKind Kind;
+  // The function the decisions are for, empty for module-wide decisions.
+  std::string Function;
+  std::vector<uint64_t> Values;
+
+  DecisionRecord(DecisionKind Kind, StringRef Function)
+      : Kind(Kind), Function(Function) {}
+};
+
+// The decisions made for one module.
+class DiversityManifest {
+public:
+  uint64_t Seed;
+  std::string ModuleID;
+  std::vector<DecisionRecord> Records;
+
+  DiversityManifest() : Seed(0) {}
+
+  // Start a new record. The reference is valid until the next call.
+  DecisionRecord &addRecord(DecisionKind Kind, StringRef Function);
+
+  // Append the encoding of the manifest to OS:
+  //
+  //   "MCDM", version and the size of the rest as 32-bit little-endian words
+  //   seed, module ID and number of records
+  //   for each record: kind, function and values
+  //
+  // Every number after the size is ULEB128 and every string is its length
+  // followed by its bytes.
+  void write(raw_ostream &OS) const;
+
+  // Parse the concatenated manifests in Data into Manifests. Returns false
+  // and sets Error if Data is malformed.
+  static bool read(StringRef Data, std::vector<DiversityManifest> &Manifests,
+                   std::string &Error);
+};
+
+}
+
+#endif
@@ -38,6 +38,8 @@ extern cl::opt<unsigned int> EarlyNOPMaxCount;
 extern cl::opt<unsigned int> MOVToLEAPercentage;
 extern cl::opt<unsigned int> EquivSubstPercentage;
 extern cl::opt<bool> RandomizeFunctionList;
+extern cl::opt<bool> ShuffleFunctionSections;
+extern cl::opt<bool> LoadTimeFunctionPermutation;
 extern cl::opt<unsigned int> FunctionAlignment;
 extern cl::opt<bool> RandomizePhysRegs;
 extern cl::opt<unsigned int> ISchedRandPercentage;
@@ -52,27 +54,36 @@ extern cl::opt<unsigned int> GlobalPaddingMaxSize;
 extern cl::opt<unsigned int> GlobalMinCount;
 extern cl::opt<bool> ShuffleGlobals;
 extern cl::opt<bool> ReverseGlobals;
+extern cl::opt<bool> InternalCommonPadding;
 
 static const int NOPInsertionUnknown = -1;
 
-bool findFunctionOption(const Function &Fn, StringRef OptName, StringRef &Val);
+// Per-function settings are attached to a function as string attributes
+// named by this prefix followed by the option name, e.g.
+// "multicompiler-nop-insertion-percentage"="25".
+static const char FunctionOptionAttrPrefix[] = "multicompiler-";
 
-void readFunctionOptions();
+std::string getFunctionOptionAttrName(StringRef OptName);
 
+// Attach the settings that -function-options-file gives for the functions of
+// M as option attributes. The file is only read once per process. Settings a
+// function already has are kept.
+void applyFunctionOptions(Module &M);
+
+// Return the value of O for Fn: the option attribute if Fn has one, the
+// global value otherwise. Machine passes should use
+// MachineFunction::getFunctionOption, which caches the parsed value.
 template<class DataType, bool ExternalStorage, class ParserClass>
 DataType getFunctionOption(cl::opt<DataType, ExternalStorage, ParserClass> &O, const llvm::Function &Fn) {
-  if (!UseFunctionOptions)
+  Attribute A = Fn.getFnAttribute(getFunctionOptionAttrName(O.ArgStr));
+  if (!A.isStringAttribute())
     return O;
 
-  StringRef ValStr;
   DataType Val;
-  if (findFunctionOption(Fn, O.ArgStr, ValStr)) {
-    if (!O.getParser().parse(O, O.ArgStr, ValStr, Val))
-      return Val;
-    else
-      llvm::errs() << "Error: couldn't parse option for " << Fn.getName()
-                   << "::" << O.ArgStr << ", reverting to global value\n";
-  }
+  if (!O.getParser().parse(O, O.ArgStr, A.getValueAsString(), Val))
+    return Val;
+  llvm::errs() << "Error: couldn't parse option for " << Fn.getName()
+               << "::" << O.ArgStr << ", reverting to global value\n";
   return O;
 }
 
@@ -34,6 +34,7 @@ namespace llvm {
 
 class Function;
 class GlobalVariable;
+class Instruction;
 class Module;
 
 /// Return the name of data section containing profile counter variables.
@@ -513,6 +514,27 @@ void InstrProfRecord::reserveSites(uint32_t ValueKind, uint32_t NumValueSites) {
   ValueSites.reserve(NumValueSites);
 }
 
+/// Attach the value profile of site \p SiteIdx of kind \p ValueKind in
+/// \p InstrProfR to \p Inst as !prof metadata of the form
+/// !{!"VP", i32 ValueKind, i64 TotalCount, i64 Value, i64 Count, ...}, keeping
+/// at most \p MaxMDCount of the hottest values. The metadata stays attached to
+/// the instruction through later transformations, unlike the position of the
+/// site among the instrumented sites of its function.
+void annotateValueSite(Module &M, Instruction &Inst,
+                       const InstrProfRecord &InstrProfR,
+                       InstrProfValueKind ValueKind, uint32_t SiteIdx,
+                       uint32_t MaxMDCount = 3);
+
+/// Extract the value profile data of kind \p ValueKind attached to \p Inst by
+/// annotateValueSite. At most \p MaxNumValueData values are stored in
+/// \p ValueData, their number in \p ActualNumValueData and the total count of
+/// the site in \p TotalC. Return false if \p Inst has no such metadata.
+bool getValueProfDataFromInst(const Instruction &Inst,
+                              InstrProfValueKind ValueKind,
+                              uint32_t MaxNumValueData,
+                              InstrProfValueData ValueData[],
+                              uint32_t &ActualNumValueData, uint64_t &TotalC);
+
 inline support::endianness getHostEndianness() {
   return sys::IsLittleEndianHost ? support::little : support::big;
 }
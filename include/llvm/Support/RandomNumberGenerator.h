@@ -70,6 +70,10 @@ public:
 
   ~RandomNumberGenerator();
 
+  /// Returns the seed given by -random-seed, which generators created without
+  /// an explicit seed use.
+  static uint64_t getCommandLineSeed();
+
   /**
    * Shuffles an *array* of type T.
    *
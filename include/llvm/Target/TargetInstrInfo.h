@@ -980,6 +980,14 @@ public:
     return false;
   }
 
+  /// If MI refers to a symbol through a 32-bit displacement relative to the
+  /// end of the instruction, return the number of bytes from the start of the
+  /// displacement to the end of MI. Return 0 otherwise. Load-time function
+  /// permutation rewrites these displacements when functions move.
+  virtual unsigned getPCRelDisplacementTail(const MachineInstr *MI) const {
+    return 0;
+  }
+
   virtual bool enableClusterLoads() const { return false; }
 
   virtual bool shouldClusterLoads(MachineInstr *FirstLdSt,
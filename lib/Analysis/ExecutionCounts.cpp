@@ -0,0 +1,49 @@
+//===- ExecutionCounts.cpp - Estimated block execution counts -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/ExecutionCounts.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BlockFrequencyInfoImpl.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+std::vector<double>
+llvm::estimateBlockExecutionCounts(Function &F, bool UseBlockFrequencies) {
+  Optional<uint64_t> EntryCount = F.getEntryCount();
+  double Calls = EntryCount ? *EntryCount : 1;
+  std::vector<double> Counts(F.size(), Calls);
+  if (!UseBlockFrequencies)
+    return Counts;
+
+  // Scale the block frequencies so that the entry block executes as often as
+  // the profile says the function was called.
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  BranchProbabilityInfo BPI;
+  BPI.calculate(F, LI);
+  BlockFrequencyInfo BFI;
+  BFI.calculate(F, BPI, LI);
+  double Scale = Calls / (double)BFI.getEntryFreq();
+  unsigned BI = 0;
+  for (BasicBlock &BB : F)
+    Counts[BI++] = BFI.getBlockFreq(&BB).getFrequency() * Scale;
+  return Counts;
+}
+
+void llvm::printExecutionCountSource(raw_ostream &OS, bool HaveProfile) {
+  OS << "# Execution counts from "
+     << (HaveProfile ? "profile data" : "static block frequency estimates")
+     << '\n';
+}
@@ -602,7 +602,7 @@ lltok::Kind LLLexer::LexIdentifier() {
 
   KEYWORD(attributes);
 
-  KEYWORD(nocrosscheck);
+  KEYWORD(crosscheck);
   KEYWORD(alwaysinline);
   KEYWORD(argmemonly);
   KEYWORD(builtin);
@@ -14,6 +14,7 @@
 #include "llvm/CodeGen/AsmPrinter.h"
 #include "DwarfDebug.h"
 #include "DwarfException.h"
+#include "FunctionPermutationHandler.h"
 #include "WinException.h"
 #include "VTableMarkingHandler.h"
 #include "WinCodeViewLineTables.h"
@@ -21,6 +22,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/CodeGen/Analysis.h"
+#include "llvm/CodeGen/FunctionPermutation.h"
 #include "llvm/CodeGen/GCMetadataPrinter.h"
 #include "llvm/CodeGen/MachineConstantPool.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
@@ -39,9 +41,13 @@
 #include "llvm/MC/MCExpr.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCSection.h"
+#include "llvm/MC/MCSectionELF.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSymbolELF.h"
 #include "llvm/MC/MCValue.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
+#include "llvm/Support/ELF.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/MathExtras.h"
@@ -294,6 +300,16 @@ bool AsmPrinter::doInitialization(Module &M) {
                                       DbgTimerName,
                                       DivMarkingGroupName));
   }
+
+  if (multicompiler::LoadTimeFunctionPermutation) {
+    if (!isLoadTimePermutationEnabled(TM))
+      report_fatal_error("-load-time-function-permutation requires x86-64 ELF "
+                         "position-independent code without pointer "
+                         "protection or read-only jump tables");
+    DivHandlers.push_back(HandlerInfo(new FunctionPermutationHandler(this),
+                                      DbgTimerName,
+                                      DivMarkingGroupName));
+  }
   return false;
 }
 
@@ -629,8 +645,12 @@ void AsmPrinter::EmitFunctionHeader() {
   EmitVisibility(CurrentFnSym, F->getVisibility());
 
   EmitLinkage(F, CurrentFnSym);
+  unsigned Alignment = MF->getAlignment();
+  // Permutable functions start on slot boundaries.
+  if (isLoadTimePermutable(*F, TM))
+    Alignment = std::max(Alignment, getPermutableFunctionAlignment());
   if (MAI->hasFunctionAlignment())
-    EmitAlignment(MF->getAlignment(), F);
+    EmitAlignment(Alignment, F);
 
   if (MAI->hasDotTypeDotSizeDirective())
     OutStreamer->EmitSymbolAttribute(CurrentFnSym, MCSA_ELF_TypeFunction);
@@ -1235,6 +1255,9 @@ bool AsmPrinter::doFinalization(Module &M) {
   DivHandlers.clear();
   DD = nullptr;
 
+  if (MMI->getDiversityManifest())
+    EmitDiversityManifest(M);
+
   // If the target wants to know about weak references, print them all.
   if (MAI->getWeakRefDirective()) {
     // FIXME: This is not lazy, it would be nice to only print weak references
@@ -1343,6 +1366,15 @@ MCSymbol *AsmPrinter::getCurExceptionSym() {
   return CurExceptionSym;
 }
 
+const TrapInfo *AsmPrinter::getUniquedTrapInfo(const TrapInfo &TI) {
+  if (TI.isUnknown())
+    return nullptr;
+  std::unique_ptr<TrapInfo> &Entry = UniquedTrapInfo[TI];
+  if (!Entry)
+    Entry = llvm::make_unique<TrapInfo>(TI);
+  return Entry.get();
+}
+
 void AsmPrinter::SetupMachineFunction(MachineFunction &MF) {
   this->MF = &MF;
   // Get the function symbol.
@@ -1469,8 +1501,9 @@ void AsmPrinter::EmitJumpTableInfo() {
   // the appropriate section.
   const Function *F = MF->getFunction();
   const TargetLoweringObjectFile &TLOF = getObjFileLowering();
+  // The jump tables of permutable functions move with them.
   bool JTInDiffSection = TM.Options.JumpTablesROData ||
-      (!TM.Options.ExecJumpTables &&
+      (!TM.Options.ExecJumpTables && !isLoadTimePermutable(*F, TM) &&
        !TLOF.shouldPutJumpTableInFunctionSection(
           MJTI->getEntryKind() == MachineJumpTableInfo::EK_LabelDifference32,
           *F));
@@ -2775,8 +2808,22 @@ void AsmPrinter::EmitCallTrampolines() {
   if (Trampolines.empty())
     return;
 
+  // Remember the original order for the diversity manifest.
+  multicompiler::DiversityManifest *Manifest = MMI->getDiversityManifest();
+  DenseMap<const MachineInstr *, unsigned> OrigIndex;
+  if (Manifest)
+    for (unsigned i = 0, e = Trampolines.size(); i != e; ++i)
+      OrigIndex[Trampolines[i].OrigCall] = i;
+
   RNG->shuffle(Trampolines);
 
+  if (Manifest) {
+    multicompiler::DecisionRecord &R =
+        Manifest->addRecord(multicompiler::DK_Trampolines, MF->getName());
+    for (const CallTrampolineInfo &Trampoline : Trampolines)
+      R.Values.push_back(OrigIndex[Trampoline.OrigCall]);
+  }
+
   // Sort the landing pads in order of their type ids.  This is used to fold
   // duplicate actions.
   const std::vector<LandingPadInfo> &PadInfos = MMI->getLandingPads();
@@ -2894,3 +2941,24 @@ void AsmPrinter::EmitCallTrampolines() {
 AsmPrinterHandler::~AsmPrinterHandler() {}
 
 void AsmPrinterHandler::markFunctionEnd() {}
+
+void AsmPrinter::EmitDiversityManifest(const Module &M) {
+  // Only ELF has a section the manifest of every module is appended to.
+  if (!TM.getTargetTriple().isOSBinFormatELF())
+    return;
+
+  multicompiler::DiversityManifest &Manifest = *MMI->getDiversityManifest();
+  multicompiler::DecisionRecord &Layout =
+      Manifest.addRecord(multicompiler::DK_FunctionLayout, "");
+  for (const Function &F : M)
+    if (!F.isDeclaration())
+      Layout.Values.push_back(multicompiler::getManifestNameHash(F.getName()));
+
+  SmallString<256> Data;
+  raw_svector_ostream OS(Data);
+  Manifest.write(OS);
+
+  OutStreamer->SwitchSection(OutContext.getELFSection(
+      multicompiler::DiversityManifestSection, ELF::SHT_PROGBITS, 0));
+  OutStreamer->EmitBytes(Data);
+}
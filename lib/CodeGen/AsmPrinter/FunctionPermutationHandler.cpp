@@ -0,0 +1,119 @@
+//===-- llvm/lib/CodeGen/AsmPrinter/FunctionPermutationHandler.cpp -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains support for writing the metadata used to permute
+// functions at load time. Every module with permutable functions gets one
+// record in the multicompiler_fperm section, made of 32-bit words:
+//
+//   version
+//   log2 of the slot alignment
+//   __multicompiler_fperm_runtime - .
+//   start of .text.fperm - .
+//   size of .text.fperm
+//   number of slots
+//   number of fixups
+//   for each slot: offset of its function from the start of .text.fperm
+//   for each fixup: end of the instruction - ., and the number of bytes from
+//                   the start of its pc-relative displacement to its end
+//
+// Each slot extends to the start of the next one. The fixups cover every
+// instruction of the module that refers to a symbol relative to its own
+// address, whether or not it is in a slot.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionPermutationHandler.h"
+#include "llvm/CodeGen/AsmPrinter.h"
+#include "llvm/CodeGen/FunctionPermutation.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCExpr.h"
+#include "llvm/MC/MCSectionELF.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSymbol.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/Target/TargetSubtargetInfo.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "function-permutation"
+
+static void EmitPCRelReference(MCStreamer &Streamer, const MCSymbol *Sym) {
+  MCContext &Context = Streamer.getContext();
+  MCSymbol *Here = Context.createTempSymbol();
+  Streamer.EmitLabel(Here);
+  Streamer.EmitValue(
+      MCBinaryExpr::createSub(MCSymbolRefExpr::create(Sym, Context),
+                              MCSymbolRefExpr::create(Here, Context), Context),
+      4);
+}
+
+void FunctionPermutationHandler::endModule() {
+  if (Functions.empty())
+    return;
+
+  MCStreamer &OS = *Asm->OutStreamer;
+  MCContext &Context = Asm->OutContext;
+  unsigned SlotAlign = getPermutableFunctionAlignment();
+
+  // Pad the last slot like the others.
+  OS.SwitchSection(TextSection);
+  Asm->EmitAlignment(SlotAlign);
+  MCSymbol *End = Context.createTempSymbol("fperm_end");
+  OS.EmitLabel(End);
+
+  DEBUG(dbgs() << "Emitting " << Functions.size() << " slots and "
+               << Fixups.size() << " fixups\n");
+
+  OS.SwitchSection(Context.getELFSection("multicompiler_fperm",
+                                         ELF::SHT_PROGBITS, ELF::SHF_ALLOC));
+  Asm->EmitAlignment(2);
+
+  const MCSymbol *Begin = Functions.front();
+  OS.EmitIntValue(FunctionPermutationVersion, 4);
+  OS.EmitIntValue(SlotAlign, 4);
+  // The reference pulls the runtime into the link.
+  EmitPCRelReference(OS,
+                     Context.getOrCreateSymbol("__multicompiler_fperm_runtime"));
+  EmitPCRelReference(OS, Begin);
+  Asm->EmitLabelDifference(End, Begin, 4);
+  OS.EmitIntValue(Functions.size(), 4);
+  OS.EmitIntValue(Fixups.size(), 4);
+  for (const MCSymbol *Fn : Functions)
+    Asm->EmitLabelDifference(Fn, Begin, 4);
+  for (const auto &Fixup : Fixups) {
+    EmitPCRelReference(OS, Fixup.first);
+    OS.EmitIntValue(Fixup.second, 4);
+  }
+}
+
+void FunctionPermutationHandler::beginFunction(const MachineFunction *MF) {
+  TII = MF->getSubtarget().getInstrInfo();
+  if (!isLoadTimePermutable(*MF->getFunction(), Asm->TM))
+    return;
+
+  DEBUG(dbgs() << "Permutable function " << MF->getName() << '\n');
+  TextSection = Asm->OutStreamer->getCurrentSection().first;
+  Functions.push_back(Asm->CurrentFnSym);
+}
+
+void FunctionPermutationHandler::beginInstruction(const MachineInstr *MI) {
+  PendingTail = TII->getPCRelDisplacementTail(MI);
+}
+
+void FunctionPermutationHandler::endInstruction() {
+  if (!PendingTail)
+    return;
+
+  MCSymbol *Label = Asm->OutContext.createTempSymbol();
+  Asm->OutStreamer->EmitLabel(Label);
+  Fixups.push_back(std::make_pair(Label, PendingTail));
+  PendingTail = 0;
+}
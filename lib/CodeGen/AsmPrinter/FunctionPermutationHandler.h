@@ -0,0 +1,70 @@
+//===-- llvm/lib/CodeGen/AsmPrinter/FunctionPermutationHandler.h -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains support for writing the metadata used to permute
+// functions at load time.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_CODEGEN_ASMPRINTER_FUNCTIONPERMUTATIONHANDLER_H
+#define LLVM_LIB_CODEGEN_ASMPRINTER_FUNCTIONPERMUTATIONHANDLER_H
+
+#include "AsmPrinterHandler.h"
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class AsmPrinter;
+class MCSection;
+class TargetInstrInfo;
+
+/// \brief Collects the slots of the permutable functions of a module and the
+/// pc-relative references of its code, and emits them into the
+/// multicompiler_fperm section.
+class FunctionPermutationHandler : public AsmPrinterHandler {
+  AsmPrinter *Asm;
+
+  /// The section holding the permutable functions.
+  MCSection *TextSection;
+
+  /// Entry labels of the permutable functions, in layout order.
+  std::vector<const MCSymbol *> Functions;
+
+  /// Labels at the end of instructions with a pc-relative displacement, and
+  /// the number of bytes from the start of the displacement to the label.
+  std::vector<std::pair<const MCSymbol *, unsigned>> Fixups;
+
+  const TargetInstrInfo *TII;
+
+  /// Displacement tail of the instruction being emitted, or 0.
+  unsigned PendingTail;
+
+public:
+  FunctionPermutationHandler(AsmPrinter *AP)
+    : Asm(AP), TextSection(nullptr), TII(nullptr), PendingTail(0) {}
+
+  void setSymbolSize(const MCSymbol *, uint64_t) override {}
+
+  /// \brief Emit the multicompiler_fperm section.
+  void endModule() override;
+
+  /// \brief Record the slot of a permutable function.
+  void beginFunction(const MachineFunction *MF) override;
+
+  void endFunction(const MachineFunction *MF) override {}
+
+  /// \brief Check whether the instruction has a pc-relative displacement.
+  void beginInstruction(const MachineInstr *MI) override;
+
+  /// \brief Label the end of an instruction with a pc-relative displacement.
+  void endInstruction() override;
+};
+} // End of namespace llvm
+
+#endif
@@ -0,0 +1,346 @@
+//===-- DiversityPlanner.cpp: Overhead-budgeted diversity settings --------===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Choose per-function multicompiler settings under an overhead budget.
+///
+/// The diversifying transformations are normally configured globally, so hot
+/// code pays for them just as much as cold code. Given
+/// -diversity-overhead-budget=P, this pass estimates how often every function
+/// executes each transformation site and picks per-function settings, never
+/// above the global value, that transform as many static sites as possible
+/// while keeping the estimated added instructions within P% of the executed
+/// instructions.
+///
+/// Each transformation has a cost model: the number of instructions it adds
+/// every time a transformed site executes. A function at setting S% for a
+/// transformation with C static sites executed N times in total diversifies
+/// S% of C sites at an estimated cost of S% * N * Cost. This is a fractional
+/// knapsack problem, so picking the (function, transformation) pairs with the
+/// most static sites per added instruction first gives the optimal plan.
+/// Functions that never execute are diversified fully for free.
+///
+/// The settings are attached as "multicompiler-<option>" function attributes,
+/// which multicompiler::getFunctionOption prefers over the global value.
+/// Settings already attached to a function are kept and their cost is counted
+/// against the budget.
+///
+/// Execution counts come from the profile's function entry counts scaled by
+/// the block frequencies. Without a profile every function is counted as
+/// called once. The cheap planner used by the -cheap-diversity pipeline skips
+/// the dominator tree, loop and block frequency analyses and counts every
+/// block as executed once per call.
+///
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/ExecutionCounts.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <tuple>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "diversity-planner"
+
+static cl::opt<double>
+OverheadBudget("diversity-overhead-budget", cl::init(0),
+               cl::desc("Estimated run time overhead, as a percentage of "
+                        "executed instructions, that the diversifying "
+                        "transformations may add. Chooses per-function "
+                        "settings. 0 disables planning"));
+
+static cl::list<std::string>
+CostModel("diversity-cost", cl::CommaSeparated,
+          cl::value_desc("option=instructions"),
+          cl::desc("Override the number of instructions a transformation adds "
+                   "each time a transformed site executes, e.g. "
+                   "nop-insertion-percentage=0.5"));
+
+static cl::opt<std::string>
+PlanReport("diversity-plan-report", cl::value_desc("filename"),
+           cl::desc("Output the estimated execution counts, settings and "
+                    "expected overhead of each function to the specified "
+                    "file"));
+
+STATISTIC(NumPlanned, "Number of per-function settings chosen");
+STATISTIC(NumReduced, "Number of settings reduced below the global value");
+
+namespace {
+// What a transformation counts as one site.
+enum SiteKind {
+  InstructionSites, // every instruction
+  AllocaSites       // every static alloca and byval argument
+};
+
+struct Transform {
+  cl::opt<unsigned int> *Option;
+  SiteKind Sites;
+  // Instructions added each time a transformed site executes.
+  double Cost;
+  // The largest setting the plan may choose, 0 if the transformation is off.
+  unsigned int Max;
+};
+
+struct FunctionUsage {
+  Function *F;
+  Optional<uint64_t> EntryCount;
+  double Instructions;
+  // Static and dynamic site counts for each SiteKind.
+  size_t StaticSites[2];
+  double DynamicSites[2];
+};
+
+struct Choice {
+  unsigned Func;
+  unsigned Trans;
+  double Benefit; // static sites per percent
+  double Cost;    // added instructions per percent
+  unsigned Setting;
+  bool Fixed;
+};
+
+class DiversityPlanner : public ModulePass {
+  const TargetMachine *TM;
+  bool Cheap;
+
+public:
+  static char ID;
+
+  DiversityPlanner(const TargetMachine *TM, bool Cheap = false)
+      : ModulePass(ID), TM(TM), Cheap(Cheap) {
+    initializeDiversityPlannerPass(*PassRegistry::getPassRegistry());
+  }
+
+  DiversityPlanner() : DiversityPlanner(nullptr) {}
+
+  bool runOnModule(Module &M) override;
+  const char *getPassName() const override { return "Diversity Planner"; }
+
+private:
+  void initTransforms();
+  FunctionUsage measure(Function &F);
+  void printReport(const std::vector<FunctionUsage> &Usage,
+                   const std::vector<Choice> &Plan, double Total,
+                   double Used, bool HaveProfile);
+
+  std::vector<Transform> Transforms;
+};
+} // end anonymous namespace
+
+char DiversityPlanner::ID = 0;
+INITIALIZE_TM_PASS(DiversityPlanner, "diversity-planner",
+                   "Overhead-budgeted diversity planner", false, false)
+
+ModulePass *llvm::createDiversityPlannerPass(const TargetMachine *TM,
+                                             bool Cheap) {
+  return new DiversityPlanner(TM, Cheap);
+}
+
+void DiversityPlanner::initTransforms() {
+  using namespace multicompiler;
+  bool NOPs = TM && TM->Options.NOPInsertion;
+  Transforms = {
+      {&NOPInsertionPercentage, InstructionSites,
+       (double)MaxNOPsPerInstruction, NOPs ? (unsigned)NOPInsertionPercentage : 0u},
+      // LEA is slightly slower than MOV and only register MOVs qualify.
+      {&MOVToLEAPercentage, InstructionSites, 0.05, MOVToLEAPercentage},
+      {&EquivSubstPercentage, InstructionSites, 0.1, EquivSubstPercentage},
+      // A malloc() and free() call per promoted alloca.
+      {&StackToHeapPercentage, AllocaSites, 100,
+       StackToHeapPromotion ? (unsigned)StackToHeapPercentage : 0u},
+  };
+
+  for (StringRef Entry : CostModel) {
+    StringRef Name, Value;
+    std::tie(Name, Value) = Entry.split('=');
+    std::string ValueStr = Value;
+    char *End;
+    double Cost = strtod(ValueStr.c_str(), &End);
+    auto I = std::find_if(Transforms.begin(), Transforms.end(),
+                          [&](const Transform &T) {
+                            return T.Option->ArgStr == Name;
+                          });
+    if (I == Transforms.end() || Value.empty() || *End || Cost < 0) {
+      errs() << "Error: invalid -diversity-cost entry '" << Entry << "'\n";
+      continue;
+    }
+    I->Cost = Cost;
+  }
+}
+
+FunctionUsage DiversityPlanner::measure(Function &F) {
+  FunctionUsage U = {&F, F.getEntryCount(), 0, {0, 0}, {0, 0}};
+  double Calls = U.EntryCount ? *U.EntryCount : 1;
+  std::vector<double> Counts = estimateBlockExecutionCounts(F, !Cheap);
+
+  unsigned BI = 0;
+  for (BasicBlock &BB : F) {
+    double Count = Counts[BI++];
+    U.Instructions += Count * BB.size();
+    U.StaticSites[InstructionSites] += BB.size();
+    U.DynamicSites[InstructionSites] += Count * BB.size();
+    for (Instruction &I : BB) {
+      AllocaInst *AI = dyn_cast<AllocaInst>(&I);
+      if (AI && AI->isStaticAlloca()) {
+        U.StaticSites[AllocaSites]++;
+        U.DynamicSites[AllocaSites] += Count;
+      }
+    }
+  }
+  for (Argument &Arg : F.args()) {
+    if (Arg.hasByValAttr()) {
+      U.StaticSites[AllocaSites]++;
+      U.DynamicSites[AllocaSites] += Calls;
+    }
+  }
+  return U;
+}
+
+bool DiversityPlanner::runOnModule(Module &M) {
+  if (OverheadBudget <= 0)
+    return false;
+
+  initTransforms();
+
+  std::vector<FunctionUsage> Usage;
+  double Total = 0;
+  bool HaveProfile = false;
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    Usage.push_back(measure(F));
+    Total += Usage.back().Instructions;
+    HaveProfile |= Usage.back().EntryCount.hasValue();
+  }
+
+  std::vector<Choice> Plan;
+  double Used = 0;
+  for (unsigned FI = 0, FE = Usage.size(); FI != FE; ++FI) {
+    const FunctionUsage &U = Usage[FI];
+    for (unsigned TI = 0, TE = Transforms.size(); TI != TE; ++TI) {
+      const Transform &T = Transforms[TI];
+      Choice C = {FI, TI, U.StaticSites[T.Sites] / 100.0,
+                  U.DynamicSites[T.Sites] * T.Cost / 100.0, 0, false};
+      // Keep settings the function already has.
+      Attribute A = U.F->getFnAttribute(
+          multicompiler::getFunctionOptionAttrName(T.Option->ArgStr));
+      if (A.isStringAttribute()) {
+        C.Fixed = true;
+        if (!A.getValueAsString().getAsInteger(10, C.Setting))
+          Used += C.Setting * C.Cost;
+      }
+      if (C.Fixed || T.Max > 0)
+        Plan.push_back(C);
+    }
+  }
+
+  // Most static sites per added instruction first. Sites that never execute
+  // cost nothing.
+  std::vector<Choice *> Ranked;
+  for (Choice &C : Plan)
+    if (!C.Fixed)
+      Ranked.push_back(&C);
+  auto Ratio = [](const Choice *C) {
+    return C->Cost > 0 ? C->Benefit / C->Cost
+                       : std::numeric_limits<double>::infinity();
+  };
+  std::stable_sort(Ranked.begin(), Ranked.end(),
+                   [&](const Choice *A, const Choice *B) {
+                     return Ratio(A) > Ratio(B);
+                   });
+
+  double Budget = OverheadBudget / 100 * Total;
+  for (Choice *C : Ranked) {
+    unsigned Max = Transforms[C->Trans].Max;
+    if (C->Cost == 0) {
+      C->Setting = Max;
+    } else {
+      double Left = std::max(Budget - Used, 0.0);
+      C->Setting = std::min<double>(Max, Left / C->Cost);
+    }
+    Used += C->Setting * C->Cost;
+
+    Function *F = Usage[C->Func].F;
+    StringRef OptName = Transforms[C->Trans].Option->ArgStr;
+    DEBUG(dbgs() << "Diversity planner: " << F->getName() << " " << OptName
+                 << "=" << C->Setting << "\n");
+    F->addFnAttr(multicompiler::getFunctionOptionAttrName(OptName),
+                 utostr(C->Setting));
+    ++NumPlanned;
+    if (C->Setting < Max)
+      ++NumReduced;
+  }
+
+  if (!PlanReport.empty())
+    printReport(Usage, Plan, Total, Used, HaveProfile);
+
+  return !Ranked.empty();
+}
+
+void DiversityPlanner::printReport(const std::vector<FunctionUsage> &Usage,
+                                   const std::vector<Choice> &Plan,
+                                   double Total, double Used,
+                                   bool HaveProfile) {
+  std::error_code EC;
+  raw_fd_ostream S(PlanReport, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Error opening " << PlanReport << ": " << EC.message() << '\n';
+    return;
+  }
+
+  S << "Function,Entry count,Executed instructions";
+  for (const Transform &T : Transforms)
+    S << ',' << T.Option->ArgStr;
+  S << ",Estimated overhead %\n";
+
+  // The plan holds the choices of each function contiguously, in the order
+  // of Transforms.
+  auto C = Plan.begin();
+  double Diversified = 0, Possible = 0;
+  for (unsigned FI = 0, FE = Usage.size(); FI != FE; ++FI) {
+    const FunctionUsage &U = Usage[FI];
+    S << U.F->getName() << ',';
+    if (U.EntryCount)
+      S << *U.EntryCount;
+    S << ',' << format("%.0f", U.Instructions);
+    double Overhead = 0;
+    for (unsigned TI = 0, TE = Transforms.size(); TI != TE; ++TI) {
+      S << ',';
+      if (C == Plan.end() || C->Func != FI || C->Trans != TI)
+        continue;
+      S << C->Setting;
+      Overhead += C->Setting * C->Cost;
+      Diversified += C->Setting * C->Benefit;
+      Possible += Transforms[TI].Max * C->Benefit;
+      ++C;
+    }
+    S << ',' << format("%.4f", percentOf(Overhead, Total)) << '\n';
+  }
+
+  printExecutionCountSource(S, HaveProfile);
+  S << "# Diversified sites: "
+    << format("%.2f", percentOf(Diversified, Possible))
+    << "% of the global settings\n";
+  S << "# Estimated overhead: " << format("%.4f", percentOf(Used, Total))
+    << "% of executed instructions (budget "
+    << format("%.4f", (double)OverheadBudget) << "%)\n";
+}
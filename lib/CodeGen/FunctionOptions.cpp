@@ -0,0 +1,56 @@
+//===-- FunctionOptions.cpp: Attach per-function multicompiler options ----===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Attach the settings from -function-options-file to functions.
+///
+/// With -use-function-options, the per-function settings of the options file
+/// are attached to the matching functions as "multicompiler-<option>"
+/// attributes before any diversifying transformation runs. The
+/// transformations then only look at the function's attributes.
+///
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
+
+using namespace llvm;
+
+namespace {
+class FunctionOptions : public ModulePass {
+public:
+  static char ID;
+
+  FunctionOptions() : ModulePass(ID) {
+    initializeFunctionOptionsPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override {
+    if (!multicompiler::UseFunctionOptions)
+      return false;
+    multicompiler::applyFunctionOptions(M);
+    return true;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  const char *getPassName() const override {
+    return "Attach Per-Function Options";
+  }
+};
+} // end anonymous namespace
+
+char FunctionOptions::ID = 0;
+INITIALIZE_PASS(FunctionOptions, "function-options",
+                "Attach per-function multicompiler options", false, false)
+
+ModulePass *llvm::createFunctionOptionsPass() {
+  return new FunctionOptions();
+}
@@ -0,0 +1,67 @@
+//===-- FunctionPermutation.cpp - Load-time function permutation ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Decide which functions are laid out for load-time permutation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/FunctionPermutation.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
+#include "llvm/Target/TargetMachine.h"
+#include <algorithm>
+
+using namespace llvm;
+
+bool llvm::isLoadTimePermutationEnabled(const TargetMachine &TM) {
+  if (!multicompiler::LoadTimeFunctionPermutation)
+    return false;
+  const Triple &TT = TM.getTargetTriple();
+  return TT.getArch() == Triple::x86_64 && TT.isOSBinFormatELF() &&
+         TM.getRelocationModel() == Reloc::PIC_ &&
+         !TM.Options.PointerProtection && !TM.Options.CallPointerProtection &&
+         !TM.Options.JumpTablesROData;
+}
+
+static bool referencesThreadLocal(const Value *V) {
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(V))
+    return GV->isThreadLocal();
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(V))
+    for (const Value *Op : CE->operands())
+      if (referencesThreadLocal(Op))
+        return true;
+  return false;
+}
+
+bool llvm::isLoadTimePermutable(const Function &F, const TargetMachine &TM) {
+  if (!isLoadTimePermutationEnabled(TM))
+    return false;
+  if (F.isDeclaration() || !F.hasLocalLinkage() || F.hasComdat() ||
+      F.hasSection() || F.hasPrefixData() ||
+      F.getAlignment() > (1u << getPermutableFunctionAlignment()))
+    return false;
+
+  for (const Instruction &I : instructions(F)) {
+    ImmutableCallSite CS(&I);
+    if (CS && CS.isInlineAsm())
+      return false;
+    for (const Value *Op : I.operands())
+      if (referencesThreadLocal(Op))
+        return false;
+  }
+  return true;
+}
+
+unsigned llvm::getPermutableFunctionAlignment() {
+  return std::max(4u, (unsigned)multicompiler::FunctionAlignment);
+}
@@ -13,6 +13,7 @@
 
 #define DEBUG_TYPE "multicompiler"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Module.h"
@@ -170,12 +171,19 @@ bool GlobalRandomization::runOnModule(Module &M) {
       WorkList.push_back(&G);
   }
 
+  // Common padding is allocated by the linker along with the common globals.
+  // When the gold plugin has defined the common globals of the module, leave
+  // the padding with the other globals instead.
+  GlobalVariable::LinkageTypes CommonPaddingLinkage =
+      multicompiler::InternalCommonPadding ? GlobalVariable::InternalLinkage
+                                           : GlobalVariable::CommonLinkage;
+
   unsigned long NormalGlobalCount = 0;
   unsigned long CommonGlobalCount = 0;
   for (GlobalVariable *G : WorkList) {
     GlobalVariable::LinkageTypes linkage = GlobalVariable::InternalLinkage;
     if (G->hasCommonLinkage()) {
-      linkage = GlobalVariable::CommonLinkage;
+      linkage = CommonPaddingLinkage;
       CommonGlobalCount++;
     } else {
       NormalGlobalCount++;
@@ -199,7 +207,7 @@ bool GlobalRandomization::runOnModule(Module &M) {
 
   if (CommonGlobalCount > 0)
     for (; CommonGlobalCount < multicompiler::GlobalMinCount; ++CommonGlobalCount)
-      UsedGlobals.insert(CreatePadding(GlobalVariable::CommonLinkage));
+      UsedGlobals.insert(CreatePadding(CommonPaddingLinkage));
 
   setUsedInitializer(UsedV, M, UsedGlobals);
 
@@ -215,6 +223,21 @@ bool GlobalRandomization::runOnModule(Module &M) {
     DEBUG(dbgs() << "reversed order of " << Globals.size() <<" global variables\n");
   }
 
+  MachineModuleInfo *MMI = getAnalysisIfAvailable<MachineModuleInfo>();
+  if (multicompiler::DiversityManifest *Manifest =
+          MMI ? MMI->getDiversityManifest() : nullptr) {
+    multicompiler::DecisionRecord &R =
+        Manifest->addRecord(multicompiler::DK_GlobalLayout, "");
+    for (GlobalVariable &G : Globals) {
+      if (G.isDeclaration())
+        continue;
+      if (G.getName().startswith("[padding]"))
+        R.Values.push_back(G.getValueType()->getArrayNumElements());
+      else
+        R.Values.push_back(multicompiler::getManifestNameHash(G.getName()));
+    }
+  }
+
   //Dump globals after randomization and reversal. Note: linker may affect this order.
   DEBUG(dbgs() << "start list of randomized global variables\n");
   for (GlobalVariable &G : Globals) {
@@ -0,0 +1,216 @@
+//===-- IndirectCallPromotion.cpp: Profile-guided indirect call promotion -===//
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Promote hot indirect call targets to guarded direct calls.
+///
+/// With code-pointer protection every indirect call goes through a jump
+/// trampoline. This pass reads the indirect call target value profile
+/// (IPVK_IndirectCallTarget) attached to each call site and rewrites
+///
+///   call %fp(...)
+///
+/// into
+///
+///   if (%fp == @hot) call @hot(...) else call %fp(...)
+///
+/// for the hottest targets of each site. It must run before
+/// PointerProtection: the comparison operand @hot is an address-taken use of
+/// the function, so PointerProtection rewrites it to the trampoline address of
+/// @hot. The guard therefore compares trampoline addresses against trampoline
+/// addresses and never materializes the real code address, while the direct
+/// call itself is left untouched.
+///
+/// The profile of a site is the !prof !{!"VP", ...} metadata that the
+/// frontend attaches to the call with annotateValueSite when it reads the
+/// instrprof file. It identifies the site by the call itself rather than by
+/// its position among the indirect calls of the function, which inlining and
+/// dead code elimination change between instrumentation and code generation.
+///
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "icp"
+
+static cl::opt<unsigned>
+ICPMaxTargets("icp-max-targets", cl::init(2),
+              cl::desc("Maximum number of targets promoted per indirect "
+                       "call site"));
+
+static cl::opt<unsigned>
+ICPMinCount("icp-min-count", cl::init(1000),
+            cl::desc("Minimum profile count of a target to be promoted"));
+
+static cl::opt<unsigned>
+ICPMinPercent("icp-min-percent", cl::init(30),
+              cl::desc("Minimum percentage of the calls at a site that a "
+                       "target must account for to be promoted"));
+
+STATISTIC(NumPromotedTargets, "Number of indirect call targets promoted");
+STATISTIC(NumPromotedSites, "Number of indirect call sites promoted");
+
+namespace {
+class IndirectCallPromotion : public ModulePass {
+public:
+  static char ID;
+
+  IndirectCallPromotion() : ModulePass(ID) {
+    initializeIndirectCallPromotionPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+  const char *getPassName() const override {
+    return "Indirect Call Promotion";
+  }
+
+private:
+  bool promoteSite(CallInst *CI);
+  Instruction *promoteTarget(CallInst *CI, Function *Target, uint64_t Count,
+                             uint64_t TotalCount);
+
+  // Map from PGO name hash to the function with that name.
+  DenseMap<uint64_t, Function *> TargetMap;
+};
+} // end anonymous namespace
+
+char IndirectCallPromotion::ID = 0;
+INITIALIZE_PASS(IndirectCallPromotion, "indirect-call-promotion",
+                "Indirect Call Promotion", false, false)
+
+ModulePass *llvm::createIndirectCallPromotionPass() {
+  return new IndirectCallPromotion();
+}
+
+static bool isIndirectCallSite(Instruction &I) {
+  CallSite CS(&I);
+  if (!CS || CS.getCalledFunction() || CS.isInlineAsm())
+    return false;
+  return !isa<Constant>(CS.getCalledValue()->stripPointerCasts());
+}
+
+/// Split the block around CI and call Target directly if the called value is
+/// Target. Returns the direct call.
+Instruction *IndirectCallPromotion::promoteTarget(CallInst *CI,
+                                                  Function *Target,
+                                                  uint64_t Count,
+                                                  uint64_t TotalCount) {
+  LLVMContext &C = CI->getContext();
+  IRBuilder<> Builder(CI);
+
+  Value *Callee = CI->getCalledValue();
+  Value *IsTarget = Builder.CreateICmpEQ(
+      Builder.CreateBitCast(Callee, Type::getInt8PtrTy(C)),
+      ConstantExpr::getBitCast(Target, Type::getInt8PtrTy(C)), "icp.cmp");
+
+  // Branch weights are 32-bit, so scale large counts down.
+  uint64_t Scale = TotalCount / UINT32_MAX + 1;
+  MDNode *Weights = MDBuilder(C).createBranchWeights(
+      Count / Scale, (TotalCount - Count) / Scale);
+
+  TerminatorInst *ThenTerm, *ElseTerm;
+  SplitBlockAndInsertIfThenElse(IsTarget, CI, &ThenTerm, &ElseTerm, Weights);
+
+  CallInst *DirectCall = cast<CallInst>(CI->clone());
+  DirectCall->setCalledFunction(Target);
+  DirectCall->insertBefore(ThenTerm);
+  DirectCall->setDebugLoc(CI->getDebugLoc());
+
+  BasicBlock *MergeBlock = CI->getParent();
+  CI->moveBefore(ElseTerm);
+
+  if (!CI->getType()->isVoidTy()) {
+    PHINode *PN = PHINode::Create(CI->getType(), 2, "icp.ret",
+                                  &MergeBlock->front());
+    CI->replaceAllUsesWith(PN);
+    PN->addIncoming(DirectCall, DirectCall->getParent());
+    PN->addIncoming(CI, CI->getParent());
+  }
+
+  return DirectCall;
+}
+
+bool IndirectCallPromotion::promoteSite(CallInst *CI) {
+  InstrProfValueData Values[INSTR_PROF_MAX_NUM_VAL_PER_SITE];
+  uint32_t NumValues;
+  uint64_t TotalCount;
+  if (!getValueProfDataFromInst(*CI, IPVK_IndirectCallTarget,
+                                INSTR_PROF_MAX_NUM_VAL_PER_SITE, Values,
+                                NumValues, TotalCount))
+    return false;
+
+  // The profile only describes the original indirect call.
+  CI->setMetadata(LLVMContext::MD_prof, nullptr);
+
+  // The values are sorted by descending count.
+  Function &F = *CI->getParent()->getParent();
+  unsigned NumPromoted = 0;
+  for (uint32_t I = 0; I != NumValues && NumPromoted < ICPMaxTargets; ++I) {
+    uint64_t Count = Values[I].Count;
+    if (Count < ICPMinCount || Count * 100 < TotalCount * ICPMinPercent)
+      break;
+
+    Function *Target = TargetMap.lookup(Values[I].Value);
+    if (!Target || Target->getFunctionType() != CI->getFunctionType()) {
+      DEBUG(dbgs() << "ICP: no compatible target for a site in "
+                   << F.getName() << "\n");
+      continue;
+    }
+
+    DEBUG(dbgs() << "ICP: promoting " << Target->getName() << " in "
+                 << F.getName() << " (" << Count << "/" << TotalCount
+                 << ")\n");
+    promoteTarget(CI, Target, Count, TotalCount);
+    TotalCount -= Count;
+    ++NumPromoted;
+    ++NumPromotedTargets;
+  }
+
+  if (!NumPromoted)
+    return false;
+  ++NumPromotedSites;
+  return true;
+}
+
+bool IndirectCallPromotion::runOnModule(Module &M) {
+  // Only plain calls are promoted; invokes keep going through the trampoline.
+  SmallVector<CallInst *, 8> Sites;
+  for (Function &F : M)
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB)
+        if (isIndirectCallSite(I) && I.getMetadata(LLVMContext::MD_prof))
+          if (CallInst *CI = dyn_cast<CallInst>(&I))
+            if (!CI->isMustTailCall())
+              Sites.push_back(CI);
+  if (Sites.empty())
+    return false;
+
+  TargetMap.clear();
+  for (Function &F : M)
+    if (!F.isIntrinsic())
+      TargetMap[IndexedInstrProf::ComputeHash(getPGOFuncName(F))] = &F;
+
+  bool Changed = false;
+  for (CallInst *CI : Sites)
+    Changed |= promoteSite(CI);
+  return Changed;
+}
@@ -221,8 +221,12 @@ MachineFunction::CreateMachineInstr(const MCInstrDesc &MCID,
 /// identical in all ways except the instruction has no parent, prev, or next.
 MachineInstr *
 MachineFunction::CloneMachineInstr(const MachineInstr *Orig) {
-  return new (InstructionRecycler.Allocate<MachineInstr>(Allocator))
+  MachineInstr *MI = new (InstructionRecycler.Allocate<MachineInstr>(Allocator))
              MachineInstr(*this, *Orig);
+  TrapInfo TI = getTrapInfo(Orig);
+  if (!TI.isUnknown())
+    InstrTrapInfo[MI] = TI;
+  return MI;
 }
 
 /// Delete the given MachineInstr.
@@ -235,6 +239,7 @@ MachineFunction::DeleteMachineInstr(MachineInstr *MI) {
   // independently recyclable.
   if (MI->Operands)
     deallocateOperandArray(MI->CapOperands, MI->Operands);
+  InstrTrapInfo.erase(MI);
   // Don't call ~MachineInstr() which must be trivial anyway because
   // ~MachineFunction drops whole lists of MachineInstrs wihout calling their
   // destructors.
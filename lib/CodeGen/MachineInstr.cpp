@@ -674,7 +674,7 @@ MachineInstr::MachineInstr(MachineFunction &MF, const MachineInstr &MI)
   : MCID(&MI.getDesc()), Parent(nullptr), Operands(nullptr), NumOperands(0),
     Flags(0), AsmPrinterFlags(0),
     NumMemRefs(MI.NumMemRefs), MemRefs(MI.MemRefs),
-    debugLoc(MI.getDebugLoc()), trapInfo(MI.getTrapInfo()) {
+    debugLoc(MI.getDebugLoc()) {
   assert(debugLoc.hasTrivialDestructor() && "Expected trivial destructor");
 
   CapOperands = OperandCapacity::get(MI.getNumOperands());
@@ -697,6 +697,19 @@ MachineRegisterInfo *MachineInstr::getRegInfo() {
   return nullptr;
 }
 
+TrapInfo MachineInstr::getTrapInfo() const {
+  if (const MachineBasicBlock *MBB = getParent())
+    if (const MachineFunction *MF = MBB->getParent())
+      return MF->getTrapInfo(this);
+  return TrapInfo();
+}
+
+void MachineInstr::setTrapInfo(const TrapInfo &TI) {
+  assert(getParent() && getParent()->getParent() &&
+         "Instruction must be inserted into a function to carry trap info");
+  getParent()->getParent()->setTrapInfo(this, TI);
+}
+
 /// RemoveRegOperandsFromUseLists - Unlink all of the register operands in
 /// this instruction from their respective use lists.  This requires that the
 /// operands already be on their use lists.
@@ -1869,7 +1882,7 @@ void MachineInstr::print(raw_ostream &OS, ModuleSlotTracker &MST,
     debugLoc.print(OS);
   }
 
-  if (!trapInfo.isUnknown())
+  if (MF && !MF->getTrapInfo(this).isUnknown())
     OS << " TRAPINFO";
 
   OS << '\n';
@@ -23,6 +23,7 @@
 #include "llvm/MC/MCSymbol.h"
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/RandomNumberGenerator.h"
 using namespace llvm;
 using namespace llvm::dwarf;
 
@@ -214,6 +215,9 @@ bool MachineModuleInfo::doInitialization(Module &M) {
   PersonalityTypeCache = EHPersonality::Unknown;
   AddrLabelSymbols = nullptr;
   TheModule = nullptr;
+  Manifest = multicompiler::DiversityManifest();
+  Manifest.Seed = RandomNumberGenerator::getCommandLineSeed();
+  Manifest.ModuleID = M.getModuleIdentifier();
 
   return false;
 }
@@ -108,6 +108,14 @@ cl::opt<bool> MISchedPostRA("misched-postra", cl::Hidden,
 static cl::opt<bool> EarlyLiveIntervals("early-live-intervals", cl::Hidden,
     cl::desc("Run live interval analysis earlier in the pipeline"));
 
+// Select the cheap diversity pipeline. Defaults to on at -O0 only, so that a
+// seed gives the same code at -O1 as before the cheap pipeline existed.
+static cl::opt<cl::boolOrDefault> CheapDiversity(
+    "cheap-diversity", cl::Hidden,
+    cl::desc("Run the diversifying transformations as single-pass "
+             "transforms sharing one random stream per module, without "
+             "block frequency analysis"));
+
 static cl::opt<bool> UseCFLAA("use-cfl-aa-in-codegen",
   cl::init(false), cl::Hidden,
   cl::desc("Enable the new, experimental CFL alias analysis in CodeGen"));
@@ -478,6 +486,12 @@ void TargetPassConfig::addCodeGenPrepare() {
 void TargetPassConfig::addISelPrepare() {
   addPreISel();
 
+  // Attach the per-function options file settings and choose the remaining
+  // per-function diversity settings before any of the diversifying
+  // transformations query them.
+  addPass(createFunctionOptionsPass());
+  addPass(createDiversityPlannerPass(TM, useCheapDiversity()));
+
   // Randomize globals
   addPass(createGlobalRandomizationPass());
 
@@ -488,6 +502,13 @@ void TargetPassConfig::addISelPrepare() {
   addPass(createStackToHeapPromotionPass(TM));
   addPass(createStackElementPaddingPass(TM));
 
+  // Promote hot indirect call targets before pointer protection rewrites
+  // address-taken functions, so only the cold fallback uses a trampoline.
+  // Without pointer protection indirect calls are cheap enough as they are.
+  if (getOptLevel() != CodeGenOpt::None &&
+      (TM->Options.PointerProtection || TM->Options.CallPointerProtection))
+    addPass(createIndirectCallPromotionPass());
+
   if (TM->Options.PointerProtection) {
     addPass(createPointerProtectionPass(TM->Options.PointerProtectionHMAC));
   }
@@ -675,6 +696,15 @@ bool TargetPassConfig::getOptimizeRegAlloc() const {
   llvm_unreachable("Invalid optimize-regalloc state");
 }
 
+bool TargetPassConfig::useCheapDiversity() const {
+  switch (CheapDiversity) {
+  case cl::BOU_UNSET: return getOptLevel() == CodeGenOpt::None;
+  case cl::BOU_TRUE:  return true;
+  case cl::BOU_FALSE: return false;
+  }
+  llvm_unreachable("Invalid cheap-diversity state");
+}
+
 /// RegisterRegAlloc's global Registry tracks allocator registration.
 MachinePassRegistry RegisterRegAlloc::Registry;
 
@@ -724,8 +724,7 @@ void PEI::calculateFrameObjectOffsets(MachineFunction &Fn) {
       llvm_unreachable("Unexpected SSPLayoutKind.");
     }
 
-    if(multicompiler::getFunctionOption(multicompiler::ShuffleStackFrames,
-                                        *Fn.getFunction())) {
+    if(Fn.getFunctionOption(multicompiler::ShuffleStackFrames)) {
 //      dbgs() << ".....large objects " << LargeArrayObjs.size() << "\n";
 //      dbgs() << ".....small objects " << SmallArrayObjs.size() << "\n";
 //      dbgs() << "...addr of objects " << AddrOfObjs.size()     << "\n";
@@ -741,8 +740,7 @@ void PEI::calculateFrameObjectOffsets(MachineFunction &Fn) {
       RNG->shuffle<int, 8>(AllObjs);
       DEBUG(dbgs() << "shuffled protected objects in " << Fn.getName() << "\n");
 
-      if(multicompiler::getFunctionOption(multicompiler::ReverseStackFrames,
-                                          *Fn.getFunction())){
+      if(Fn.getFunctionOption(multicompiler::ReverseStackFrames)){
         std::reverse(AllObjs.begin(), AllObjs.end());
         DEBUG(dbgs() << "reversed protected objects in " << Fn.getName() << "\n");
       }
@@ -773,16 +771,14 @@ void PEI::calculateFrameObjectOffsets(MachineFunction &Fn) {
   SmallVector<unsigned, 10> array;
   for(int i = 0; i < MFI->getObjectIndexEnd(); i++) array.push_back(i);
 
-  if(multicompiler::getFunctionOption(multicompiler::ShuffleStackFrames,
-                                      *Fn.getFunction())){
+  if(Fn.getFunctionOption(multicompiler::ShuffleStackFrames)){
     RNG->shuffle<unsigned, 10>(array);
     DEBUG(dbgs() << "shuffled stack frame for " << Fn.getName() << "\n");
     for(size_t i = 0; i < array.size(); i++) DEBUG(dbgs() << array[i] << " ");
     DEBUG(dbgs() << "\n");
   }
 
-  if(multicompiler::getFunctionOption(multicompiler::ReverseStackFrames,
-                                      *Fn.getFunction())){
+  if(Fn.getFunctionOption(multicompiler::ReverseStackFrames)){
     std::reverse(array.begin(), array.end());
     DEBUG(dbgs() << "reversed stack frame for " << Fn.getName() << "\n");
     for(size_t i = 0; i < array.size(); i++) DEBUG(dbgs() << array[i] << " ");
@@ -792,8 +788,8 @@ void PEI::calculateFrameObjectOffsets(MachineFunction &Fn) {
   // Stack frame padding
   // If we haven't applied a pad yet, do so now.
   if (!PaddingApplied) {
-    unsigned int maxStackPadding = multicompiler::getFunctionOption(
-      multicompiler::MaxStackFramePadding, *Fn.getFunction());
+    unsigned int maxStackPadding =
+      Fn.getFunctionOption(multicompiler::MaxStackFramePadding);
     if (maxStackPadding > 0) {
       uint32_t pad = RNG->Random(maxStackPadding);
       Offset += pad;
@@ -871,6 +867,24 @@ void PEI::calculateFrameObjectOffsets(MachineFunction &Fn) {
   int64_t StackSize = Offset - LocalAreaOffset;
   MFI->setStackSize(StackSize);
   NumBytesStackSpace += StackSize;
+
+  multicompiler::DiversityManifest *Manifest =
+      Fn.getMMI().getDiversityManifest();
+  if (Manifest && (Fn.getFunctionOption(multicompiler::ShuffleStackFrames) ||
+                   Fn.getFunctionOption(multicompiler::ReverseStackFrames) ||
+                   Fn.getFunctionOption(multicompiler::MaxStackFramePadding))) {
+    SmallVector<int, 16> Order;
+    for (int i = 0, e = MFI->getObjectIndexEnd(); i != e; ++i)
+      if (!MFI->isDeadObjectIndex(i))
+        Order.push_back(i);
+    std::stable_sort(Order.begin(), Order.end(), [&](int A, int B) {
+      return MFI->getObjectOffset(A) < MFI->getObjectOffset(B);
+    });
+    multicompiler::DecisionRecord &R =
+        Manifest->addRecord(multicompiler::DK_StackLayout, Fn.getName());
+    R.Values.assign(Order.begin(), Order.end());
+    R.Values.push_back(StackSize);
+  }
 }
 
 /// insertPrologEpilogCode - Scan the function for modified callee saved
@@ -16,6 +16,7 @@
 
 #include "llvm/CodeGen/RegisterClassInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
@@ -31,11 +32,13 @@ StressRA("stress-regalloc", cl::Hidden, cl::init(0), cl::value_desc("N"),
          cl::desc("Limit all regclasses to N registers"));
 
 RegisterClassInfo::RegisterClassInfo()
-  : Tag(0), MF(nullptr), TRI(nullptr), CalleeSaved(nullptr) {}
+  : Tag(0), MF(nullptr), TRI(nullptr), CalleeSaved(nullptr),
+    ManifestRecord(-1) {}
 
 void RegisterClassInfo::runOnMachineFunction(const MachineFunction &mf) {
   bool Update = false;
   MF = &mf;
+  ManifestRecord = -1;
 
   if (!RNG)
     RNG.reset(MF->getFunction()->getParent()->createRNG());
@@ -189,6 +192,20 @@ void RegisterClassInfo::randomize(const TargetRegisterClass *RC) const {
 
   // TODO: randomize CSRs seperately from scratch regs
   RNG->shuffle(RCI.Order.get(), RCI.NumRegs);
+  // The allocation order is shuffled on every query, so record a hash of
+  // each order rather than the order itself.
+  if (multicompiler::DiversityManifest *Manifest =
+          MF->getMMI().getDiversityManifest()) {
+    if (ManifestRecord < 0) {
+      ManifestRecord = Manifest->Records.size();
+      Manifest->addRecord(multicompiler::DK_RegisterOrder, MF->getName());
+    }
+    std::vector<uint64_t> &Values = Manifest->Records[ManifestRecord].Values;
+    Values.push_back(RC->getID());
+    Values.push_back(multicompiler::getManifestNameHash(
+        StringRef(reinterpret_cast<const char *>(RCI.Order.get()),
+                  RCI.NumRegs * sizeof(MCPhysReg))));
+  }
   DEBUG({
     dbgs() << "AllocationOrderAfterRandomizing(" << TRI->getRegClassName(RC) << ") = [";
     for (unsigned I = 0; I != RCI.NumRegs; ++I)
@@ -385,7 +385,7 @@ void InstrEmitter::AddOperand(MachineInstrBuilder &MIB,
     MIB.addImm(C->getSExtValue());
     if (const ConstantVTIndex *VTI =
         dyn_cast<ConstantVTIndex>(C->getConstantIntValue()))
-      MIB->setTrapInfo(VTI->getTrapInfo());
+      MIB.setTrapInfo(VTI->getTrapInfo());
   } else if (ConstantFPSDNode *F = dyn_cast<ConstantFPSDNode>(Op)) {
     MIB.addFPImm(F->getConstantFPValue());
   } else if (RegisterSDNode *R = dyn_cast<RegisterSDNode>(Op)) {
@@ -400,7 +400,7 @@ void InstrEmitter::AddOperand(MachineInstrBuilder &MIB,
     MIB.addGlobalAddress(TGA->getGlobal(), TGA->getOffset(),
                          TGA->getTargetFlags());
     if (!TGA->getTrapInfo().isUnknown())
-      MIB->setTrapInfo(TGA->getTrapInfo());
+      MIB.setTrapInfo(TGA->getTrapInfo());
   } else if (BasicBlockSDNode *BBNode = dyn_cast<BasicBlockSDNode>(Op)) {
     MIB.addMBB(BBNode->getBasicBlock());
   } else if (FrameIndexSDNode *FI = dyn_cast<FrameIndexSDNode>(Op)) {
@@ -570,7 +570,7 @@ void InstrEmitter::EmitSubregNode(SDNode *Node,
       MIB.addImm(SD->getZExtValue());
       if (const ConstantVTIndex *VTI =
           dyn_cast<ConstantVTIndex>(SD->getConstantIntValue()))
-        MIB->setTrapInfo(VTI->getTrapInfo());
+        MIB.setTrapInfo(VTI->getTrapInfo());
     } else
       AddOperand(MIB, N0, 0, nullptr, VRBaseMap, /*IsDebug=*/false,
                  IsClone, IsCloned);
@@ -820,7 +820,7 @@ EmitMachineNode(SDNode *Node, bool IsClone, bool IsCloned,
 
   TrapInfo TI = Node->getTrapInfo();
   if (!TI.isUnknown())
-    MIB->setTrapInfo(TI);
+    MIB.setTrapInfo(TI);
 
   // Insert the instruction into position in the block. This needs to
   // happen before any custom inserter hook is called so that the
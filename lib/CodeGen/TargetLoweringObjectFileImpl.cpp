@@ -16,6 +16,7 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/CodeGen/FunctionPermutation.h"
 #include "llvm/CodeGen/MachineModuleInfoImpls.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
@@ -33,6 +34,7 @@
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSymbolELF.h"
 #include "llvm/MC/MCValue.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
 #include "llvm/Support/COFF.h"
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/ELF.h"
@@ -247,6 +249,13 @@ static StringRef getSectionPrefixForGlobal(SectionKind Kind) {
   return ".data.rel.ro";
 }
 
+/// Return true if code of this kind is emitted into uniqued .text.shuffle
+/// sections, which the gold plugin permutes across all objects of the link.
+static bool isShuffledText(SectionKind Kind) {
+  return multicompiler::ShuffleFunctionSections && Kind.isText() &&
+         !Kind.isTexTramp();
+}
+
 static MCSectionELF *
 selectELFSectionForGlobal(MCContext &Ctx, const GlobalValue *GV,
                           SectionKind Kind, Mangler &Mang,
@@ -293,6 +302,8 @@ selectELFSectionForGlobal(MCContext &Ctx, const GlobalValue *GV,
   } else if (Kind.isMergeableConst()) {
     Name = ".rodata.cst";
     Name += utostr(EntrySize);
+  } else if (isShuffledText(Kind)) {
+    Name = ".text.shuffle";
   } else {
     Name = getSectionPrefixForGlobal(Kind);
   }
@@ -317,12 +328,20 @@ MCSection *TargetLoweringObjectFileELF::SelectSectionForGlobal(
     const TargetMachine &TM) const {
   unsigned Flags = getELFSectionFlags(Kind);
 
+  // Permutable functions are kept together in one section, whose layout the
+  // FunctionPermutation runtime rearranges at startup.
+  if (Kind.isText() && !Kind.isTexTramp())
+    if (const Function *F = dyn_cast<Function>(GV))
+      if (isLoadTimePermutable(*F, TM))
+        return getContext().getELFSection(".text.fperm", ELF::SHT_PROGBITS,
+                                          Flags);
+
   // If we have -ffunction-section or -fdata-section then we should emit the
   // global value to a uniqued section specifically for it.
   bool EmitUniqueSection = false;
   if (!(Flags & ELF::SHF_MERGE) && !Kind.isCommon()) {
     if (Kind.isText() || Kind.isTexTrapText())
-      EmitUniqueSection = TM.getFunctionSections();
+      EmitUniqueSection = TM.getFunctionSections() || isShuffledText(Kind);
     else // specifically excluding SectionKind::TexTramp, since they need to be
          // uniqued as data
       EmitUniqueSection = TM.getDataSections();
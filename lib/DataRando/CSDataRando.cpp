@@ -10,6 +10,8 @@
 #include "llvm/IR/InstVisitor.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/RandomNumberGenerator.h"
 #include "llvm/Support/ToolOutputFile.h"
@@ -31,6 +33,26 @@ STATISTIC(NumGlobalECs, "Number of equivalence classes containing global variabl
 STATISTIC(MaxSizeGlobalEC, "Maximum number of globals contained in a single equivalence class");
 STATISTIC(NumIndirectCalls, "Number of indirect calls examined");
 STATISTIC(NumIndirectCantEncrypt, "Number of indirect calls that could not be encrypted");
+STATISTIC(NumMaskArgs, "Number of masks passed as call arguments");
+STATISTIC(NumMaskTableStores, "Number of masks stored to mask tables at call sites");
+STATISTIC(NumConstantMaskTables, "Number of constant mask tables");
+STATISTIC(NumMaskTableLoads, "Number of masks loaded from mask tables");
+STATISTIC(NumSharedClones, "Number of original functions sharing the body of their clone");
+STATISTIC(NumRemovedOriginals, "Number of unused original functions removed");
+STATISTIC(NumSharedInsts, "Number of instructions removed by sharing clone bodies");
+
+static cl::opt<unsigned>
+MaskTableThreshold("cs-data-rando-mask-table-threshold",
+                   cl::desc("Pass the masks of functions needing more than "
+                            "this many masks in a table instead of as "
+                            "separate arguments (0 to disable)"),
+                   cl::init(0));
+
+static cl::opt<bool>
+ShareCloneBodies("cs-data-rando-share-clones",
+                 cl::desc("Replace the body of cloned functions with a call "
+                          "to their clone with null masks"),
+                 cl::init(true));
 
 namespace {
 
@@ -77,7 +99,7 @@ struct ContextSensitivePEA : public PointerEquivalenceAnalysis {
       auto gbl = Info.ToGlobalNodeMap.find(N);
       if (gbl != Info.ToGlobalNodeMap.end()) {
         // TODO: if we remove global nodes from possible arg nodes we can remove this check.
-        if (! Info.ArgMaskMap.count(N)) {
+        if (! Info.isArgNode(N)) {
           assert(GlobalPEA && "Node found which maps to global nodes, but no global variable PEA available");
           return GlobalPEA->getMaskForNode(gbl->second);
         }
@@ -100,7 +122,7 @@ struct ContextSensitivePEA : public PointerEquivalenceAnalysis {
         if (TrackStatistics) {
           NumMasks++;
         }
-        Mask = nextMask();
+        Mask = nextMaskForNode(N);
       }
       if (N->isHeapNode() && TrackStatistics) {
         NumHeap++;
@@ -173,7 +195,7 @@ struct FunctionPEA : public ContextSensitivePEA {
     }
 
     for (auto I : ValueLists) {
-      if (Info.ArgMaskMap.count(I.first)) {
+      if (Info.isArgNode(I.first)) {
         StringSet<> Reasons;
         Reasons.insert("Argument node of original function");
         printClass(S, I.first, MaskMap[I.first], Reasons, I.second);
@@ -199,6 +221,26 @@ struct CloneFunctionPEA : public ContextSensitivePEA {
     return NodeHandle();
   }
 
+  virtual Value *getMaskForNode(const NodeHandle &NH) override {
+    const DSNode *N = NH.getNode();
+    if (N && !MaskMap.count(N)) {
+      auto I = Info.MaskTableIndex.find(N);
+      if (I != Info.MaskTableIndex.end()) {
+        // Load the mask from the table on first use. The entry block dominates
+        // every later use of the mask.
+        BasicBlock &Entry = Info.MaskTable->getParent()->getEntryBlock();
+        IRBuilder<> Builder(&Entry, Entry.getFirstInsertionPt());
+        Value *Addr = Builder.CreateConstInBoundsGEP1_32(
+            Info.MaskTable->getType()->getPointerElementType(), Info.MaskTable, I->second);
+        Value *Mask = Builder.CreateLoad(Addr, "arg_mask");
+        MaskMap[N] = Mask;
+        NumMaskTableLoads++;
+        return Mask;
+      }
+    }
+    return ContextSensitivePEA::getMaskForNode(NH);
+  }
+
   // This implementation of printEquivalenceClasses handles mapping values in
   // the original function to the values in the cloned function so that the
   // diagnostic information will be as clear as possible.
@@ -314,7 +356,11 @@ Value *CSDataRando::getCloneCalledValue(CallSite CS, FuncInfo &CalleeInfo) {
   FunctionType *FT = CS.getFunctionType();
   SmallVector<Type*, 8> Params;
   Params.insert(Params.end(), FT->param_begin(), FT->param_end());
-  Params.insert(Params.end(), CalleeInfo.ArgNodes.size(), MaskTy);
+  if (usesMaskTable(CalleeInfo)) {
+    Params.push_back(MaskTy->getPointerTo());
+  } else {
+    Params.insert(Params.end(), CalleeInfo.ArgNodes.size(), MaskTy);
+  }
   FunctionType *TargetType = FunctionType::get(FT->getReturnType(), Params, FT->isVarArg());
 
   IRBuilder<> Builder(CS.getInstruction());
@@ -424,9 +470,15 @@ bool CSDataRando::processCallSite(CallSite CS, FuncInfo &FI, PointerEquivalenceA
     Args.push_back(CS.getArgOperand(i));
   }
 
+  SmallVector<Value*, 8> Masks;
   for (const DSNode *N : CalleeInfo.ArgNodes) {
-    Value *Mask = P.getMaskForNode(NodeMap[N]);
-    Args.push_back(Mask);
+    Masks.push_back(P.getMaskForNode(NodeMap[N]));
+  }
+  if (usesMaskTable(CalleeInfo)) {
+    Args.push_back(createMaskTable(CS.getInstruction(), Masks));
+  } else {
+    Args.append(Masks.begin(), Masks.end());
+    NumMaskArgs += Masks.size();
   }
 
   // VarArgs go after masks
@@ -453,6 +505,54 @@ bool CSDataRando::processCallSite(CallSite CS, FuncInfo &FI, PointerEquivalenceA
   return true;
 }
 
+bool CSDataRando::usesMaskTable(const FuncInfo &FI) const {
+  return MaskTableThreshold && FI.ArgNodes.size() > MaskTableThreshold;
+}
+
+// Get a pointer to the first element of a constant table holding Masks.
+Constant *CSDataRando::getConstantMaskTable(Module &M, ArrayRef<Constant*> Masks) {
+  ArrayType *TableTy = ArrayType::get(MaskTy, Masks.size());
+  Constant *Init = ConstantArray::get(TableTy, Masks);
+  GlobalVariable *&GV = ConstantMaskTables[Init];
+  if (!GV) {
+    GV = new GlobalVariable(M, TableTy, true, GlobalValue::PrivateLinkage,
+                            Init, "mask_table");
+    GV->setUnnamedAddr(true);
+    NumConstantMaskTables++;
+  }
+  Constant *Zero = ConstantInt::get(Type::getInt32Ty(M.getContext()), 0);
+  Constant *Indices[] = {Zero, Zero};
+  return ConstantExpr::getInBoundsGetElementPtr(TableTy, GV, Indices);
+}
+
+// Build the table of masks for a call to a function taking its masks in a
+// table and return a pointer to its first element. If all masks are constants
+// the table is a constant global shared by all calls passing the same masks,
+// otherwise it is filled on the stack of the caller before the call.
+Value *CSDataRando::createMaskTable(Instruction *Call, ArrayRef<Value*> Masks) {
+  ArrayType *TableTy = ArrayType::get(MaskTy, Masks.size());
+  IRBuilder<> Builder(Call);
+
+  SmallVector<Constant*, 16> Constants;
+  for (Value *Mask : Masks) {
+    if (Constant *C = dyn_cast<Constant>(Mask)) {
+      Constants.push_back(C);
+    }
+  }
+
+  if (Constants.size() == Masks.size()) {
+    return getConstantMaskTable(*Call->getModule(), Constants);
+  }
+
+  BasicBlock &Entry = Call->getParent()->getParent()->getEntryBlock();
+  AllocaInst *Table = new AllocaInst(TableTy, "mask_table", &*Entry.getFirstInsertionPt());
+  for (unsigned i = 0, e = Masks.size(); i != e; ++i) {
+    Builder.CreateStore(Masks[i], Builder.CreateConstInBoundsGEP2_32(TableTy, Table, 0, i));
+    NumMaskTableStores++;
+  }
+  return Builder.CreateConstInBoundsGEP2_32(TableTy, Table, 0, 0);
+}
+
 namespace {
 // Traverse all Instructions in a Function and get the node for that
 // Instruction. This is to make the mask dump more useful. The scalar map for
@@ -493,6 +593,7 @@ bool CSDataRando::runOnModule(Module &M) {
     }
   }
 
+  ConstantMaskTables.clear();
   findGlobalNodes(M);
   findArgNodes(M);
 
@@ -556,6 +657,7 @@ bool CSDataRando::runOnModule(Module &M) {
     if (Clone) {
       // Perform randomization of the cloned function
       CloneFunctionPEA CP(*RNG, M.getContext(), FI, *Graph, &GGPEA);
+      CP.recordAccessAlignments(*Clone, M.getDataLayout());
       DR.instrumentMemoryOperations(*Clone, CP, NULL);
       DR.wrapLibraryFunctions(*Clone, CP, FW);
       replaceWithClones(Clone, FI, CP, Graph);
@@ -571,6 +673,7 @@ bool CSDataRando::runOnModule(Module &M) {
 
     // Perform randomization of the original function
     FunctionPEA FP(*RNG, M.getContext(), FI, *Graph, &GGPEA, !Clone);
+    FP.recordAccessAlignments(*Original, M.getDataLayout());
     DR.instrumentMemoryOperations(*Original, FP, NULL);
     DR.wrapLibraryFunctions(*Original, FP, FW);
     replaceWithClones(Original, FI, FP, Graph);
@@ -592,6 +695,10 @@ bool CSDataRando::runOnModule(Module &M) {
   // Replace remaining uses of original functions with clones.
   replaceOriginalsWithClones();
 
+  if (ShareCloneBodies) {
+    shareCloneBodies();
+  }
+
   if (Out.get()) {
     Out->os() << "*** Equivalence classes for global variables ***\n";
     GGPEA.printEquivalenceClasses(Out->os());
@@ -658,6 +765,70 @@ bool CSDataRando::replaceOriginalsWithClones() {
   return true;
 }
 
+// The original of a cloned function is the clone with every argument mask
+// null: arg nodes get the null mask in the original, and all other nodes are
+// local to the function, so their masks need not agree. Replace the body of
+// each original with a call to its clone passing null masks, and remove
+// originals that are no longer used at all.
+void CSDataRando::shareCloneBodies() {
+  std::vector<Function*> Unused;
+  for (auto i : OldToNewFuncMap) {
+    Function *Original = i.first;
+    Function *Clone = i.second;
+    // Varargs can't be forwarded to the clone.
+    if (!Clone || Original->isVarArg()) {
+      continue;
+    }
+
+    unsigned NumInsts = 0;
+    for (BasicBlock &BB : *Original) {
+      NumInsts += BB.size();
+    }
+
+    SmallVector<Value*, 8> Args;
+    bool CanTailCall = true;
+    for (Argument &A : Original->args()) {
+      Args.push_back(&A);
+      CanTailCall &= !A.hasByValOrInAllocaAttr();
+    }
+    FuncInfo &FI = FunctionInfo[Original];
+    Constant *NullMask = Constant::getNullValue(MaskTy);
+    if (usesMaskTable(FI)) {
+      SmallVector<Constant*, 16> Masks(FI.ArgNodes.size(), NullMask);
+      Args.push_back(getConstantMaskTable(*Original->getParent(), Masks));
+    } else {
+      Args.append(FI.ArgNodes.size(), NullMask);
+    }
+
+    Original->dropAllReferences();
+    BasicBlock *BB = BasicBlock::Create(Original->getContext(), "", Original);
+    IRBuilder<> Builder(BB);
+    CallInst *Call = Builder.CreateCall(Clone, Args);
+    Call->setCallingConv(Clone->getCallingConv());
+    Call->setAttributes(Clone->getAttributes());
+    Call->setTailCall(CanTailCall);
+    if (Original->getReturnType()->isVoidTy()) {
+      Builder.CreateRetVoid();
+    } else {
+      Builder.CreateRet(Call);
+    }
+
+    NumSharedClones++;
+    NumSharedInsts += NumInsts - BB->size();
+    if (Original->hasLocalLinkage() && Original->use_empty()) {
+      Unused.push_back(Original);
+    }
+  }
+
+  for (Function *F : Unused) {
+    NumSharedInsts += F->getEntryBlock().size();
+    NumRemovedOriginals++;
+    FunctionInfo.erase(F);
+    OldToNewFuncMap.erase(F);
+    F->eraseFromParent();
+  }
+}
+
 void CSDataRando::findArgNodes(Module &M) {
   // Create function equivalence classes from the global equivalence classes.
   EquivalenceClasses<const GlobalValue*> &GlobalECs = DSA->getGlobalECs();
@@ -781,7 +952,12 @@ Function *CSDataRando::makeFunctionClone(Function *F) {
   FunctionType *OldFuncTy = F->getFunctionType();
   std::vector<Type*> ArgTys;
   ArgTys.insert(ArgTys.end(), OldFuncTy->param_begin(), OldFuncTy->param_end());
-  ArgTys.insert(ArgTys.end(), FI.ArgNodes.size(), MaskTy);
+  bool MaskTable = usesMaskTable(FI);
+  if (MaskTable) {
+    ArgTys.push_back(MaskTy->getPointerTo());
+  } else {
+    ArgTys.insert(ArgTys.end(), FI.ArgNodes.size(), MaskTy);
+  }
   FunctionType *CloneFuncTy = FunctionType::get(OldFuncTy->getReturnType(), ArgTys, OldFuncTy->isVarArg());
 
   Function *Clone = Function::Create(CloneFuncTy, Function::InternalLinkage, F->getName() + "_CONTEXT_SENSITIVE");
@@ -798,9 +974,17 @@ Function *CSDataRando::makeFunctionClone(Function *F) {
 
   // Set the name of the arg masks and associate them with the nodes they are
   // the masks for.
-  for (unsigned i = 0, e = FI.ArgNodes.size(); i != e; ++i, ++CI) {
-    CI->setName("arg_mask");
-    FI.ArgMaskMap[FI.ArgNodes[i]] = &*CI;
+  if (MaskTable) {
+    CI->setName("mask_table");
+    FI.MaskTable = &*CI;
+    for (unsigned i = 0, e = FI.ArgNodes.size(); i != e; ++i) {
+      FI.MaskTableIndex[FI.ArgNodes[i]] = i;
+    }
+  } else {
+    for (unsigned i = 0, e = FI.ArgNodes.size(); i != e; ++i, ++CI) {
+      CI->setName("arg_mask");
+      FI.ArgMaskMap[FI.ArgNodes[i]] = &*CI;
+    }
   }
 
   SmallVector<ReturnInst*, 8> Returns;
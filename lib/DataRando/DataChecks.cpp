@@ -4,13 +4,26 @@
 
 #include "llvm/Pass.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include "llvm/DataRando/Runtime/CrossChecks.h"
 
 using namespace llvm;
 
@@ -36,12 +49,43 @@ static cl::opt<bool> XCheckLog(
   "log-xchecks", cl::init(false), cl::Hidden,
   cl::desc("Enable data & controlflow crosscheck logging for debugging"));
 
+static cl::opt<bool> BufferXChecks(
+  "xcheck-buffer", cl::init(false), cl::Hidden,
+  cl::desc("Buffer cross-checked values per thread and verify them in "
+           "batches"));
+
+static cl::opt<unsigned> XCheckInterval(
+  "xcheck-interval", cl::init(CROSSCHECK_INTERVAL), cl::Hidden,
+  cl::desc("Number of buffered cross-check values that forces a flush"));
+
+static cl::opt<bool> OptimizeDataChecks(
+  "optimize-data-checks", cl::init(true), cl::Hidden,
+  cl::desc("Remove data cross-checks of values already checked on every path "
+           "and hoist loop-invariant ones"));
+
 STATISTIC(NumCrossChecks, "Number of variant data cross-checks");
+STATISTIC(NumXCheckSyncPoints, "Number of buffered cross-check sync points");
+STATISTIC(NumDataCheckCandidates,
+          "Number of data cross-checks before optimization");
+STATISTIC(NumRedundantDataChecks,
+          "Number of data cross-checks of already checked values removed");
+STATISTIC(NumHoistedDataChecks,
+          "Number of loop-invariant data cross-checks hoisted to preheaders");
+
+// Limit on the number of instructions searched for a store between two loads
+// of the same location.
+static const unsigned ClobberScanLimit = 1024;
 
 class DataChecks : public ModulePass {
 public:
   static char ID; // Pass identification, replacement for typeid
-  DataChecks() : ModulePass(ID), DL(nullptr) {}
+  DataChecks()
+      : ModulePass(ID), DL(nullptr), DT(nullptr), LI(nullptr), AA(nullptr) {
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    initializeDominatorTreeWrapperPassPass(Registry);
+    initializeLoopInfoWrapperPassPass(Registry);
+    initializeAAResultsWrapperPassPass(Registry);
+  }
 
   bool runOnModule(Module &M) override;
 
@@ -56,15 +100,30 @@ private:
 
   void DoControlFlowChecks(Module &M);
 
+  /// Flush the cross-check buffer before calls to external functions.
+  void InsertSyncPoints(Module &M);
 
   void FindConditionsToCheck(Value *Condition, Instruction *U);
 
+  /// Coalesce checks of the same value in ConditionsToCheck.
+  void CoalesceConditionChecks();
+
+  /// Hoist checks of loop-invariant values to loop preheaders and remove
+  /// checks of values that a dominating check already covers.
+  void OptimizeConditionChecks(Function &F);
+
   /// Insert checks of conditionals in ConditionsToCheck. Insertion location is
   /// determined by the Location field in each conditional.
   void InsertConditionChecks(LLVMContext &C);
 
   void CreateCrossCheck(IRBuilder<> &Builder, Value *V);
 
+  /// Append V to the thread-local cross-check buffer, flushing it when
+  /// XCheckInterval values are pending.
+  void CreateBufferedCrossCheck(IRBuilder<> &Builder, Value *V);
+
+  bool isBuffered() const { return BufferXChecks && !XCheckLog; }
+
   const DataLayout *DL;
 
   // External library function that implements the cross checking. Defined in
@@ -72,6 +131,11 @@ private:
   Constant *CheckFn;
   FunctionType *CheckFnTy;
 
+  // Buffered mode: runtime flush function and the thread-local buffer.
+  Constant *FlushFn;
+  GlobalVariable *Buffer;
+  GlobalVariable *BufferPos;
+
   enum CheckLocation {
     Branch,
     Load,
@@ -91,6 +155,21 @@ private:
   // that uses that value
   std::vector<ConditionValue> ConditionsToCheck;
 
+  /// Where the check of a condition value is inserted.
+  static Instruction *getInsertPt(const ConditionValue &Condition);
+
+  /// Return true if a check of Later is redundant given a check of Earlier.
+  bool isCoveredBy(const ConditionValue &Earlier,
+                   const ConditionValue &Later) const;
+
+  /// Hoist the check of Condition out of the loops it is invariant in.
+  bool hoistCheck(ConditionValue &Condition);
+
+  // Analyses of the function being optimized.
+  DominatorTree *DT;
+  LoopInfo *LI;
+  AAResults *AA;
+
   // Comparison instructions that we've already visited. We should avoid
   // cross-checking these when looking for standalone comparison instructions
   // not used in a branch.
@@ -116,10 +195,16 @@ bool DataChecks::runOnModule(Module &M) {
   if (EnableControlFlowXChecks)
     DoControlFlowChecks(M);
 
+  if (Modified && isBuffered())
+    InsertSyncPoints(M);
+
   return Modified;
 }
 
 void DataChecks::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<DominatorTreeWrapperPass>();
+  AU.addRequired<LoopInfoWrapperPass>();
+  AU.addRequired<AAResultsWrapperPass>();
 }
 
 void DataChecks::InitializeCheckFn(Module &M) {
@@ -144,6 +229,28 @@ void DataChecks::InitializeCheckFn(Module &M) {
     CheckFn  = M.getOrInsertFunction("__crosscheck", CheckFnTy);
   }
 
+  if (isBuffered()) {
+    if (XCheckInterval == 0 || XCheckInterval > CROSSCHECK_BUFFER_SIZE)
+      report_fatal_error("-xcheck-interval must be between 1 and the "
+                         "cross-check buffer size");
+
+    Type *Int64Ty = Type::getInt64Ty(C);
+    FlushFn = M.getOrInsertFunction("__crosscheckFlush", Type::getVoidTy(C),
+                                    nullptr);
+    if (!(Buffer = M.getNamedGlobal("__crosscheck_buffer")))
+      Buffer = new GlobalVariable(
+          M, ArrayType::get(Int64Ty, CROSSCHECK_BUFFER_SIZE), false,
+          GlobalValue::ExternalLinkage, nullptr, "__crosscheck_buffer",
+          nullptr, GlobalValue::InitialExecTLSModel);
+    if (!(BufferPos = M.getNamedGlobal("__crosscheck_buffer_pos")))
+      BufferPos = new GlobalVariable(
+          M, Int64Ty, false, GlobalValue::ExternalLinkage, nullptr,
+          "__crosscheck_buffer_pos", nullptr,
+          GlobalValue::InitialExecTLSModel);
+    Buffer->setNoCrossCheck(true);
+    BufferPos->setNoCrossCheck(true);
+  }
+
   // Call the RAVEN cross-check mechanism
 }
 
@@ -185,6 +292,10 @@ void DataChecks::DoConditionChecks(Module &M) {
     if (!ConditionsToCheck.empty()) {
       InitializeCheckFn(M);
 
+      CoalesceConditionChecks();
+      NumDataCheckCandidates += ConditionsToCheck.size();
+      if (OptimizeDataChecks)
+        OptimizeConditionChecks(F);
       InsertConditionChecks(C);
     }
   }
@@ -438,6 +549,8 @@ void DataChecks::CreateCrossCheck(IRBuilder<> &Builder, Value *V) {
       file = Builder.CreateGlobalStringPtr("unknown");
     }
     Builder.CreateCall(CheckFnTy, CheckFn, { caller, file, line, col, V });
+  } else if (isBuffered()) {
+    CreateBufferedCrossCheck(Builder, V);
   } else {
     Builder.CreateCall(CheckFnTy, CheckFn, {V});
   }
@@ -445,7 +558,78 @@ void DataChecks::CreateCrossCheck(IRBuilder<> &Builder, Value *V) {
   NumCrossChecks++;
 }
 
-void DataChecks::InsertConditionChecks(LLVMContext &C) {
+void DataChecks::CreateBufferedCrossCheck(IRBuilder<> &Builder, Value *V) {
+  Type *Int64Ty = Builder.getInt64Ty();
+  Value *Pos = Builder.CreateLoad(BufferPos, "xcheck.pos");
+  Value *Slot = Builder.CreateInBoundsGEP(Buffer, {Builder.getInt64(0), Pos});
+  Builder.CreateStore(Builder.CreateZExtOrTrunc(V, Int64Ty), Slot);
+  Value *Next = Builder.CreateAdd(Pos, Builder.getInt64(1));
+  Builder.CreateStore(Next, BufferPos);
+  Value *Full = Builder.CreateICmpUGE(Next, Builder.getInt64(XCheckInterval));
+
+  // Split off the rarely taken flush and continue after it.
+  Instruction *SplitBefore = &*Builder.GetInsertPoint();
+  MDNode *Weights = MDBuilder(Builder.getContext()).createBranchWeights(1,
+                                                                       1000);
+  TerminatorInst *FlushTerm =
+      SplitBlockAndInsertIfThen(Full, SplitBefore, false, Weights);
+  IRBuilder<> FlushBuilder(FlushTerm);
+  FlushBuilder.CreateCall(FlushFn, {});
+  Builder.SetInsertPoint(SplitBefore);
+}
+
+// Return true if F may return to a caller that is not cross-checked. Such a
+// caller does not flush before its own external calls, so F has to.
+static bool mayReturnToUncheckedCode(const Function &F) {
+  if (!F.hasLocalLinkage() || F.hasAddressTaken())
+    return true;
+  for (const User *U : F.users()) {
+    ImmutableCallSite CS(U);
+    if (!CS ||
+        !CS.getInstruction()->getParent()->getParent()->hasFnAttribute(
+            Attribute::CrossCheck))
+      return true;
+  }
+  return false;
+}
+
+void DataChecks::InsertSyncPoints(Module &M) {
+  for (auto &F : M) {
+    if (!F.hasFnAttribute(Attribute::CrossCheck))
+      continue;
+
+    bool FlushOnReturn = mayReturnToUncheckedCode(F);
+    SmallVector<Instruction *, 16> SyncPoints;
+    for (auto &BB : F) {
+      if (FlushOnReturn && isa<ReturnInst>(BB.getTerminator()))
+        SyncPoints.push_back(BB.getTerminator());
+
+      for (auto &I : BB) {
+        CallSite CS(&I);
+        if (!CS || CS.isInlineAsm())
+          continue;
+        // Indirect calls and calls to functions that are not cross-checked
+        // may reach an external function without flushing first, so they are
+        // sync points as well.
+        Function *Callee =
+            dyn_cast<Function>(CS.getCalledValue()->stripPointerCasts());
+        if (Callee && (Callee->isIntrinsic() ||
+                       Callee->getName().startswith("__crosscheck")))
+          continue;
+        if (!Callee || Callee->isDeclaration() ||
+            !Callee->hasFnAttribute(Attribute::CrossCheck))
+          SyncPoints.push_back(&I);
+      }
+    }
+
+    for (Instruction *I : SyncPoints) {
+      CallInst::Create(FlushFn, {}, "", I);
+      NumXCheckSyncPoints++;
+    }
+  }
+}
+
+void DataChecks::CoalesceConditionChecks() {
   // Eliminate duplicate values. We either insert checks directly after a value
   // is defined, or, when the value is not defined by an instruction, directly
   // before the branch that uses that value as a boolean. We want to coalesce
@@ -454,10 +638,8 @@ void DataChecks::InsertConditionChecks(LLVMContext &C) {
   // an instruction, do not eliminate duplicates, since we will need to insert
   // multiple checks for that value (one before each use by a branch).
   //
-  // The second case could be optimized if we find a common predecessor branch
-  // for all branches that use a value and insert the check there, but... that
-  // sounds complicated and I think that most values have instructions defining
-  // them.
+  // OptimizeConditionChecks removes the checks before branches that are
+  // dominated by another check of the same value.
   if (!CheckAtBranch) {
     std::stable_sort(ConditionsToCheck.begin(), ConditionsToCheck.end(),
               [](const ConditionValue &a, const ConditionValue &b) {
@@ -471,23 +653,215 @@ void DataChecks::InsertConditionChecks(LLVMContext &C) {
                                     }),
                         ConditionsToCheck.end());
   }
+}
 
-  IRBuilder<> Builder(C);
-  for (auto &Condition : ConditionsToCheck) {
-    auto *I = dyn_cast<Instruction>(Condition.V);
-    if (Condition.Location == DataChecks::Load && I) {
-      if (isa<PHINode>(I) || I->isEHPad()) {
-        // Insert at the basic block's first insertion point
-        Builder.SetInsertPoint(I->getParent(), I->getParent()->getFirstInsertionPt());
-      } else {
-        // Insert after the value
-        Builder.SetInsertPoint(I->getNextNode());
+Instruction *DataChecks::getInsertPt(const ConditionValue &Condition) {
+  auto *I = dyn_cast<Instruction>(Condition.V);
+  if (Condition.Location == DataChecks::Load && I) {
+    // Insert at the basic block's first insertion point
+    if (isa<PHINode>(I) || I->isEHPad())
+      return &*I->getParent()->getFirstInsertionPt();
+    // Insert after the value
+    return I->getNextNode();
+  }
+  // Insert before the branch
+  return Condition.U;
+}
+
+/// If V is a simple load, possibly truncated, return the load.
+static LoadInst *getCheckedLoad(Value *V) {
+  if (auto *Trunc = dyn_cast<TruncInst>(V))
+    V = Trunc->getOperand(0);
+  auto *Load = dyn_cast<LoadInst>(V);
+  return Load && Load->isSimple() ? Load : nullptr;
+}
+
+static bool mayClobber(AAResults &AA, const Instruction &I,
+                       const MemoryLocation &Loc) {
+  return AA.getModRefInfo(&I, Loc) & MRI_Mod;
+}
+
+/// Return true if an instruction that may write Loc can execute after From
+/// and before To, where From dominates To.
+static bool isClobberedBetween(AAResults &AA, const Instruction *From,
+                               const Instruction *To,
+                               const MemoryLocation &Loc) {
+  const BasicBlock *FromBB = From->getParent();
+  const BasicBlock *ToBB = To->getParent();
+  unsigned Budget = ClobberScanLimit;
+
+  // The part of To's block before To.
+  BasicBlock::const_iterator Begin =
+      FromBB == ToBB ? std::next(From->getIterator()) : ToBB->begin();
+  for (auto I = Begin; &*I != To; ++I)
+    if (!--Budget || mayClobber(AA, *I, Loc))
+      return true;
+  if (FromBB == ToBB)
+    return false;
+
+  // Every path from From to To leaves From's block and may run any block
+  // between them. Walk back from To's block to From's, which dominates it.
+  SmallVector<const BasicBlock *, 8> Worklist(pred_begin(ToBB),
+                                              pred_end(ToBB));
+  SmallPtrSet<const BasicBlock *, 16> Visited;
+  Visited.insert(FromBB);
+  while (!Worklist.empty()) {
+    const BasicBlock *BB = Worklist.pop_back_val();
+    if (!Visited.insert(BB).second)
+      continue;
+    for (const Instruction &I : *BB)
+      if (!--Budget || mayClobber(AA, I, Loc))
+        return true;
+    Worklist.append(pred_begin(BB), pred_end(BB));
+  }
+
+  for (auto I = std::next(From->getIterator()), E = FromBB->end(); I != E;
+       ++I)
+    if (!--Budget || mayClobber(AA, *I, Loc))
+      return true;
+  return false;
+}
+
+bool DataChecks::isCoveredBy(const ConditionValue &Earlier,
+                             const ConditionValue &Later) const {
+  Instruction *EarlierPt = getInsertPt(Earlier);
+  Instruction *LaterPt = getInsertPt(Later);
+  if (EarlierPt != LaterPt && !DT->dominates(EarlierPt, LaterPt))
+    return false;
+  if (Earlier.V == Later.V)
+    return true;
+
+  // Two loads of the same location with no store in between yield the same
+  // value.
+  LoadInst *EarlierLoad = getCheckedLoad(Earlier.V);
+  LoadInst *LaterLoad = getCheckedLoad(Later.V);
+  if (!EarlierLoad || !LaterLoad || Earlier.V->getType() != Later.V->getType() ||
+      isa<TruncInst>(Earlier.V) != isa<TruncInst>(Later.V) ||
+      EarlierLoad->getType() != LaterLoad->getType() ||
+      !DT->dominates(EarlierLoad, LaterLoad))
+    return false;
+  MemoryLocation Loc = MemoryLocation::get(EarlierLoad);
+  if (EarlierLoad->getPointerOperand()->stripPointerCasts() !=
+          LaterLoad->getPointerOperand()->stripPointerCasts() &&
+      AA->alias(Loc, MemoryLocation::get(LaterLoad)) != MustAlias)
+    return false;
+  return !isClobberedBetween(*AA, EarlierLoad, LaterLoad, Loc);
+}
+
+/// Return true if the block of I runs on every iteration of L, and nothing in
+/// L may keep the first iteration from reaching it.
+static bool isGuaranteedToExecute(DominatorTree &DT, const Instruction *I,
+                                  const Loop *L) {
+  SmallVector<BasicBlock *, 4> Blocks;
+  L->getExitingBlocks(Blocks);
+  if (Blocks.empty())
+    return false;
+  L->getLoopLatches(Blocks);
+  for (BasicBlock *BB : Blocks)
+    if (!DT.dominates(I->getParent(), BB))
+      return false;
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &LI : *BB)
+      if (!isa<DbgInfoIntrinsic>(LI) && !isa<TerminatorInst>(LI) &&
+          !isGuaranteedToTransferExecutionToSuccessor(&LI))
+        return false;
+  return true;
+}
+
+static bool loopMayClobber(AAResults &AA, const Loop *L,
+                           const MemoryLocation &Loc) {
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB)
+      if (mayClobber(AA, I, Loc))
+        return true;
+  return false;
+}
+
+bool DataChecks::hoistCheck(ConditionValue &Condition) {
+  Instruction *InsertPt = getInsertPt(Condition);
+  LoadInst *Load = getCheckedLoad(Condition.V);
+  Loop *Target = nullptr;
+
+  // A value defined outside the loop is checked before the loop instead. A
+  // load that reads the same location on every iteration is checked through
+  // a copy of it in the preheader.
+  for (Loop *L = LI->getLoopFor(InsertPt->getParent()); L;
+       L = L->getParentLoop()) {
+    if (!L->getLoopPreheader() || !isGuaranteedToExecute(*DT, InsertPt, L))
+      break;
+    if (!L->isLoopInvariant(Condition.V) &&
+        (!Load || !L->isLoopInvariant(Load->getPointerOperand()) ||
+         loopMayClobber(*AA, L, MemoryLocation::get(Load))))
+      break;
+    Target = L;
+  }
+  if (!Target)
+    return false;
+
+  Instruction *PreheaderEnd = Target->getLoopPreheader()->getTerminator();
+  if (Target->isLoopInvariant(Condition.V)) {
+    Condition.U = PreheaderEnd;
+    Condition.Location = DataChecks::Branch;
+    return true;
+  }
+
+  Instruction *Copy = Load->clone();
+  Copy->insertBefore(PreheaderEnd);
+  if (Condition.V != Load) {
+    Instruction *Trunc = cast<Instruction>(Condition.V)->clone();
+    Trunc->setOperand(0, Copy);
+    Trunc->insertBefore(PreheaderEnd);
+    Copy = Trunc;
+  }
+  Condition.V = Copy;
+  Condition.U = PreheaderEnd;
+  Condition.Location = DataChecks::Load;
+  return true;
+}
+
+void DataChecks::OptimizeConditionChecks(Function &F) {
+  DT = &getAnalysis<DominatorTreeWrapperPass>(F).getDomTree();
+  LI = &getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+  AA = &getAnalysis<AAResultsWrapperPass>(F).getAAResults();
+
+  for (ConditionValue &Condition : ConditionsToCheck)
+    if (hoistCheck(Condition))
+      ++NumHoistedDataChecks;
+
+  // Drop checks of values that a dominating check already covers.
+  std::vector<ConditionValue> Kept;
+  for (const ConditionValue &Condition : ConditionsToCheck) {
+    bool Redundant = false;
+    for (const ConditionValue &Other : Kept) {
+      if (isCoveredBy(Other, Condition)) {
+        Redundant = true;
+        break;
       }
-    } else {
-      // Insert before the branch
-      Builder.SetInsertPoint(Condition.U);
     }
+    if (Redundant) {
+      ++NumRedundantDataChecks;
+      continue;
+    }
+
+    // A check that dominates already kept checks makes them redundant.
+    Kept.erase(std::remove_if(Kept.begin(), Kept.end(),
+                              [&](const ConditionValue &Other) {
+                                if (!isCoveredBy(Condition, Other))
+                                  return false;
+                                ++NumRedundantDataChecks;
+                                return true;
+                              }),
+               Kept.end());
+    Kept.push_back(Condition);
+  }
+
+  ConditionsToCheck.swap(Kept);
+}
 
+void DataChecks::InsertConditionChecks(LLVMContext &C) {
+  IRBuilder<> Builder(C);
+  for (auto &Condition : ConditionsToCheck) {
+    Builder.SetInsertPoint(getInsertPt(Condition));
     CreateCrossCheck(Builder, Condition.V);
   }
 }
@@ -497,7 +871,11 @@ void DataChecks::DoControlFlowChecks(Module &M) {
     if (F.hasFnAttribute(Attribute::CrossCheck) &&
         F.hasAddressTaken() && !F.isDeclarationForLinker()) {
       IRBuilder<> Builder(M.getContext());
-      Builder.SetInsertPoint(&*F.getEntryBlock().getFirstInsertionPt());
+      // Buffered checks split the block, so keep the entry allocas static.
+      BasicBlock::iterator IP = F.getEntryBlock().getFirstInsertionPt();
+      while (isa<AllocaInst>(IP))
+        ++IP;
+      Builder.SetInsertPoint(&*IP);
       CreateCrossCheck(Builder, Builder.getInt64(F.getGUID()));
     }
   }
@@ -7,6 +7,9 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/InstVisitor.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/DataLayout.h"
@@ -18,10 +21,20 @@
 #include "llvm/RangeValue/RangeValue.h"
 #include "llvm/CrititcalValue/CriticalValue.h"
 
+#include <algorithm>
+
 using namespace llvm;
 
 STATISTIC(NumGlobals, "Number of global variables defined in module");
 STATISTIC(NumUnencyptedGlobals, "Number of global variables defined in module which are not encrypted");
+STATISTIC(NumDirectCalls, "Number of wrappable library calls left unwrapped since all masks are null");
+
+static cl::opt<bool>
+DirectUnmaskedCalls("data-rando-direct-unmasked-calls",
+                    cl::desc("Call library functions directly instead of "
+                             "through their drrt_* wrapper when every mask "
+                             "argument is statically null"),
+                    cl::init(true));
 
 namespace {
 
@@ -32,6 +45,51 @@ bool maskIsNull(const Value *Mask) {
   return false;
 }
 
+// Find the scalar pointer in lane Lane of the vector of pointers Vec, looking
+// through the ways the vectorizers build them. Returns null if it can't be
+// determined. For a vector GEP of a scalar base, the base is returned since it
+// belongs to the same equivalence class.
+Value *getLanePointer(Value *Vec, unsigned Lane) {
+  if (auto *IE = dyn_cast<InsertElementInst>(Vec)) {
+    auto *Idx = dyn_cast<ConstantInt>(IE->getOperand(2));
+    if (!Idx) {
+      return nullptr;
+    }
+    if (Idx->getZExtValue() == Lane) {
+      return IE->getOperand(1);
+    }
+    return getLanePointer(IE->getOperand(0), Lane);
+  }
+  if (auto *SV = dyn_cast<ShuffleVectorInst>(Vec)) {
+    int Elt = SV->getMaskValue(Lane);
+    if (Elt < 0) {
+      return nullptr;
+    }
+    unsigned NumLHS = SV->getOperand(0)->getType()->getVectorNumElements();
+    if ((unsigned)Elt < NumLHS) {
+      return getLanePointer(SV->getOperand(0), Elt);
+    }
+    return getLanePointer(SV->getOperand(1), Elt - NumLHS);
+  }
+  if (auto *GEP = dyn_cast<GetElementPtrInst>(Vec)) {
+    Value *Base = GEP->getPointerOperand();
+    if (Base->getType()->isVectorTy()) {
+      return getLanePointer(Base, Lane);
+    }
+    return Base;
+  }
+  if (auto *Cast = dyn_cast<CastInst>(Vec)) {
+    if (Cast->getSrcTy()->isPtrOrPtrVectorTy()) {
+      return getLanePointer(Cast->getOperand(0), Lane);
+    }
+    return nullptr;
+  }
+  if (auto *C = dyn_cast<Constant>(Vec)) {
+    return C->getAggregateElement(Lane);
+  }
+  return nullptr;
+}
+
 struct DataRandoVisitor : public InstVisitor<DataRandoVisitor> {
 
   ValueMap<Value*, Value*>* decryptedInstructions;
@@ -157,6 +215,107 @@ struct DataRandoVisitor : public InstVisitor<DataRandoVisitor> {
     }
   }
 
+  // Collect the mask of every lane of a gather or scatter. Lanes may point to
+  // different equivalence classes. Returns false if no lane is encrypted. A
+  // lane whose pointer cannot be traced is only masked with the class of the
+  // whole address vector if the analysis knows it; guessing would corrupt
+  // encrypted data, so anything else is a fatal error.
+  bool getLaneMasks(IntrinsicInst &I, Value *Addresses, SmallVectorImpl<Value *> &Masks) {
+    bool Encrypted = false;
+    for (unsigned i = 0, e = Addresses->getType()->getVectorNumElements(); i < e; i++) {
+      Value *Lane = getLanePointer(Addresses, i);
+      if (!Lane) {
+        if (!PEA.getNode(Addresses).getNode()) {
+          report_fatal_error("data-rando: cannot find the object a lane of " +
+                             I.getCalledFunction()->getName() + " in " +
+                             I.getParent()->getParent()->getName() +
+                             " points to, build with the loop and SLP "
+                             "vectorizers disabled");
+        }
+        Lane = Addresses;
+      }
+      Value *Mask = PEA.getMask(Lane);
+      Encrypted |= !maskIsNull(Mask);
+      Masks.push_back(Mask);
+    }
+    return Encrypted;
+  }
+
+  unsigned getAlignmentArg(IntrinsicInst &I, unsigned Arg) {
+    return cast<ConstantInt>(I.getArgOperand(Arg))->getZExtValue();
+  }
+
+  // The masked vector memory intrinsics produced by the loop vectorizer.
+  // Disabled lanes of masked loads and gathers take the unencrypted
+  // pass-through value, so the decrypted result is selected per lane.
+  void visitIntrinsicInst(IntrinsicInst &I) {
+    switch (I.getIntrinsicID()) {
+    case Intrinsic::masked_load:
+      {
+        // (ptr, align, mask, passthru)
+        Value *Mask = PEA.getMask(I.getArgOperand(0));
+        if (maskIsNull(Mask)) {
+          return;
+        }
+        IRBuilder<> builder(&I);
+        Value *myLoad = builder.Insert(I.clone());
+        Value *xorValue = DR.createXor(builder, myLoad, I.getArgOperand(0), Mask, getAlignmentArg(I, 1));
+        Value *Result = builder.CreateSelect(I.getArgOperand(2), xorValue, I.getArgOperand(3));
+        I.replaceAllUsesWith(Result);
+        PEA.replace(&I, Result);
+        I.eraseFromParent();
+        performedReplacement = true;
+      }
+      break;
+    case Intrinsic::masked_store:
+      {
+        // (value, ptr, align, mask)
+        Value *Mask = PEA.getMask(I.getArgOperand(1));
+        if (maskIsNull(Mask)) {
+          return;
+        }
+        IRBuilder<> builder(&I);
+        Value *xorValue = DR.createXor(builder, I.getArgOperand(0), I.getArgOperand(1), Mask, getAlignmentArg(I, 2));
+        I.setArgOperand(0, xorValue);
+        performedReplacement = true;
+      }
+      break;
+    case Intrinsic::masked_gather:
+      {
+        // (ptrs, align, mask, passthru)
+        SmallVector<Value *, 8> Masks;
+        if (!getLaneMasks(I, I.getArgOperand(0), Masks)) {
+          return;
+        }
+        IRBuilder<> builder(&I);
+        Value *myGather = builder.Insert(I.clone());
+        Value *xorValue = DR.createLaneXor(builder, myGather, I.getArgOperand(0), Masks, getAlignmentArg(I, 1));
+        Value *Result = builder.CreateSelect(I.getArgOperand(2), xorValue, I.getArgOperand(3));
+        I.replaceAllUsesWith(Result);
+        PEA.replace(&I, Result);
+        I.eraseFromParent();
+        performedReplacement = true;
+      }
+      break;
+    case Intrinsic::masked_scatter:
+      {
+        // (value, ptrs, align, mask)
+        SmallVector<Value *, 8> Masks;
+        if (!getLaneMasks(I, I.getArgOperand(1), Masks)) {
+          return;
+        }
+        IRBuilder<> builder(&I);
+        Value *xorValue = DR.createLaneXor(builder, I.getArgOperand(0), I.getArgOperand(1), Masks, getAlignmentArg(I, 2));
+        I.setArgOperand(0, xorValue);
+        performedReplacement = true;
+      }
+      break;
+    default:
+      visitCallSite(&I);
+      break;
+    }
+  }
+
   void visitMemSetInst(MemSetInst &I) {
     Value *Mask = PEA.getMask(I.getDest());
     if (!maskIsNull(Mask)) {
@@ -169,7 +328,7 @@ struct DataRandoVisitor : public InstVisitor<DataRandoVisitor> {
       args.push_back(Builder.CreateZExtOrTrunc(I.getValue(), TypeBuilder<int, false>::get(C)));
       args.push_back(Builder.CreateZExtOrTrunc(I.getLength(), TypeBuilder<size_t, false>::get(C)));
       args.insert(args.end(), 2, Mask);
-      Constant *F  = M.getOrInsertFunction("drrt_memset", FT);
+      Constant *F  = M.getOrInsertFunction("drrt_vec_memset", FT);
       Builder.CreateCall(FT, F, args);
       I.eraseFromParent();
       performedReplacement = true;
@@ -180,13 +339,12 @@ struct DataRandoVisitor : public InstVisitor<DataRandoVisitor> {
     Value *SrcMask = PEA.getMask(I.getSource());
     Value *DestMask = PEA.getMask(I.getDest());
     LLVMContext &C = M.getContext();
-    Type *MaskType = TypeBuilder<mask_t, false>::get(C);
-    uint64_t MaskSize = M.getDataLayout().getTypeStoreSize(MaskType);
 
     // The analysis will always place source and destination in the same
     // equivalence class. We need to instrument this instruction if it is not
-    // aligned to the size of the mask.
+    // aligned to the period of the mask.
     assert(SrcMask == DestMask && "Source and destination not in the same class");
+    uint64_t MaskSize = PointerEquivalenceAnalysis::getMaskPeriod(SrcMask);
     if (!maskIsNull(SrcMask) &&
         (I.getAlignment() == 0 || I.getAlignment() % MaskSize)) {
       IRBuilder<> Builder(&I);
@@ -194,7 +352,7 @@ struct DataRandoVisitor : public InstVisitor<DataRandoVisitor> {
       FunctionType *FT = TypeBuilder<void*(void *, const void *, size_t, mask_t, mask_t, mask_t), false>::get(C);
       Type *VoidPtrType = TypeBuilder<void*, false>::get(C);
       Type *SizeType = TypeBuilder<size_t, false>::get(C);
-      Constant *F = M.getOrInsertFunction("drrt_memmove", FT);
+      Constant *F = M.getOrInsertFunction("drrt_vec_memmove", FT);
       args.push_back(Builder.CreateBitCast(I.getDest(), VoidPtrType));
       args.push_back(Builder.CreateBitCast(I.getSource(), VoidPtrType));
       args.push_back(Builder.CreateZExtOrTrunc(I.getLength(), SizeType));
@@ -213,6 +371,10 @@ struct DataRandoVisitor : public InstVisitor<DataRandoVisitor> {
     return performedReplacement;
   }
 
+  void optimize(Function &F) {
+    performedReplacement |= DR.optimizeInstrumentation(F);
+  }
+
 
 private:
   bool performedReplacement;
@@ -244,19 +406,14 @@ struct WrapLibraryFunctionsVisitor : public InstVisitor<WrapLibraryFunctionsVisi
   }
 
   Constant *getWrapperFunction(Function *F) {
-    StringRef Name = Function::getRealLinkageName(F->getName());
-    auto Wrappers = FW.getWrappers();
-    auto I = Wrappers->find(Name);
-    if (I != Wrappers->end()) {
-      FunctionType *FT = getWrapperTy(F->getFunctionType(), FW.isFormatFunction(F));
-      DEBUG(
-          if (FT != I->getValue().Ty) {
-            warnTypeConflict(Name, I->getValue().Ty, FT);
-          });
-      return M.getOrInsertFunction(I->getValue().Name, FT);
-    }
-
-    return nullptr;
+    FunctionType *FT = getWrapperTy(F->getFunctionType(), FW.isFormatFunction(F));
+    DEBUG({
+        FunctionType *Declared = FW.getDeclaredWrapperType(F);
+        if (FT != Declared) {
+          warnTypeConflict(Function::getRealLinkageName(F->getName()), Declared, FT);
+        }
+      });
+    return M.getOrInsertFunction(FW.getWrapperName(F), FT);
   }
 
   void visitCallSite(CallSite CS) {
@@ -270,9 +427,15 @@ struct WrapLibraryFunctionsVisitor : public InstVisitor<WrapLibraryFunctionsVisi
       return;
     }
 
-    if (Constant *W = getWrapperFunction(CalledFun)) {
+    if (FW.hasWrapperFunction(CalledFun)) {
       SmallVector<Value*, 8> Args;
-      collectArguments(Args, CS);
+      if (collectArguments(Args, CS) && DirectUnmaskedCalls) {
+        // Nothing passed to or returned from the call is encrypted, so the
+        // wrapper would only xor with zero. Keep calling the original.
+        ++NumDirectCalls;
+        return;
+      }
+      Constant *W = getWrapperFunction(CalledFun);
       FunctionType *FT = getWrapperTy(CS.getFunctionType(), FW.isFormatFunction(CalledFun));
 
       // We put a cast here just in case the original function was cast
@@ -399,7 +562,9 @@ struct WrapLibraryFunctionsVisitor : public InstVisitor<WrapLibraryFunctionsVisi
     return FunctionType::get(FT->getReturnType(), ParamTys, FT->isVarArg());
   }
 
-  void collectArguments(SmallVectorImpl<Value*> &Args, CallSite CS) {
+  // Collect the arguments for a call to the wrapper of the function called by
+  // CS. Returns true if every mask passed to the wrapper is statically null.
+  bool collectArguments(SmallVectorImpl<Value*> &Args, CallSite CS) {
     Args.clear();
     // NumParams will be the number of regular arguments, not including varargs
     unsigned NumParams = CS.getFunctionType()->getNumParams();
@@ -425,15 +590,19 @@ struct WrapLibraryFunctionsVisitor : public InstVisitor<WrapLibraryFunctionsVisi
 
     // Then masks
     Args.append(Masks.begin(), Masks.end());
+    bool MasksNull = std::all_of(Masks.begin(), Masks.end(), maskIsNull);
 
     // Followed by varargs
     for (unsigned i = NumParams, n = CS.arg_size(); i < n; ++i) {
       Value *A = CS.getArgument(i);
       Args.push_back(A);
       if (FormatFunction) {
-        Args.push_back(PEA.getMask(A));
+        Value *Mask = PEA.getMask(A);
+        MasksNull &= maskIsNull(Mask);
+        Args.push_back(Mask);
       }
     }
+    return MasksNull;
   }
 };
 }
@@ -470,12 +639,15 @@ void DataRando::getAnalysisUsage(AnalysisUsage &AU) const {
 bool DataRandomizer::instrumentMemoryOperations(Module &M, PointerEquivalenceAnalysis &PEA, ValueMap<Value*, Value*>* decryptedInstructions) {
   DataRandoVisitor v(PEA, M, decryptedInstructions);
   v.visit(M);
+  for (Function &F : M)
+    v.optimize(F);
   return v.performedModification();
 }
 
 bool DataRandomizer::instrumentMemoryOperations(Function &F, PointerEquivalenceAnalysis &PEA, ValueMap<Value*, Value*>* decryptedInstructions) {
   DataRandoVisitor v(PEA, *F.getParent(), decryptedInstructions);
   v.visit(F);
+  v.optimize(F);
   return v.performedModification();
 }
 
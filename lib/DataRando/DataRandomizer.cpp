@@ -5,6 +5,8 @@
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/Support/ErrorHandling.h"
 
 using namespace llvm;
 
@@ -50,7 +52,7 @@ Value *DataRandomizer::createAddressAlignment(IRBuilder<> &builder, Value *Addre
     } else {
       // Create a vector of the address repeated
       Value *AddressVector = UndefValue::get(ResultIntType);
-      Value *AddressInt = createCast(builder, Address, AddressIntType);
+      Value *AddressInt = createCast(builder, getAlignmentAddress(builder, Address, MaskSize), AddressIntType);
       for (unsigned i = 0; i < ElementType->getVectorNumElements(); i++) {
         AddressVector = builder.CreateInsertElement(AddressVector, AddressInt, i);
       }
@@ -61,7 +63,7 @@ Value *DataRandomizer::createAddressAlignment(IRBuilder<> &builder, Value *Addre
   } else {
     // We are not pointing at a vector, so we can use the address directly, just
     // cast it to the appropriate type.
-    EffectiveAddress = createCast(builder, Address, ResultIntType);
+    EffectiveAddress = createCast(builder, getAlignmentAddress(builder, Address, MaskSize), ResultIntType);
   }
 
   Value *ShiftByBytes = builder.CreateURem(EffectiveAddress, ConstantInt::get(ResultIntType, MaskSize));
@@ -70,6 +72,35 @@ Value *DataRandomizer::createAddressAlignment(IRBuilder<> &builder, Value *Addre
   return ShiftByBits;
 }
 
+// Only the address modulo the mask size matters for the mask alignment. GEP
+// indices that step over multiples of the mask size don't change it, so
+// replace them with zero. For an array indexed by an induction variable this
+// leaves an address that is invariant in the loop, which allows the mask
+// rotation to be hoisted out of it.
+Value *DataRandomizer::getAlignmentAddress(IRBuilder<> &builder, Value *Address, uint64_t MaskSize) {
+  auto *GEP = dyn_cast<GetElementPtrInst>(Address);
+  if (!GEP || GEP->getType()->isVectorTy())
+    return Address;
+
+  SmallVector<Value *, 4> Indices(GEP->idx_begin(), GEP->idx_end());
+  bool Changed = false;
+  unsigned Idx = 0;
+  for (gep_type_iterator GTI = gep_type_begin(GEP), E = gep_type_end(GEP);
+       GTI != E; ++GTI, ++Idx) {
+    if (isa<Constant>(GTI.getOperand()) || isa<StructType>(*GTI))
+      continue;
+    uint64_t Stride = DL.getTypeAllocSize(GTI.getIndexedType());
+    if (Stride % MaskSize == 0) {
+      Indices[Idx] = Constant::getNullValue(Indices[Idx]->getType());
+      Changed = true;
+    }
+  }
+  if (!Changed)
+    return Address;
+
+  return builder.CreateGEP(GEP->getSourceElementType(), GEP->getPointerOperand(), Indices);
+}
+
 // Emit any code necessary to cast the mask to the desired integer or integer
 // vector type.
 Value *DataRandomizer::getMaskAsType(IRBuilder<> &builder, Type *Ty, Value *Mask) {
@@ -143,7 +174,9 @@ Type *getIntermediateMaskType(Type *ValueIntType, uint64_t MaskSizeInBytes) {
 
 Value *DataRandomizer::getEffectiveMask(IRBuilder<> &builder, Value *Address, Value *Mask, unsigned Alignment) {
   assert(Mask->getType() == MaskTy && "Incorrect mask type");
-  const uint64_t MaskSize = PointerEquivalenceAnalysis::EffectiveMaskSize;
+  // Constant masks may repeat with a shorter period than the effective mask
+  // size, accesses aligned to that period need no rotation.
+  const uint64_t MaskSize = PointerEquivalenceAnalysis::getMaskPeriod(Mask);
   Type *ValueType = Address->getType()->getPointerElementType();
   uint64_t ValueSize = DL.getTypeStoreSize(ValueType);
   Type *ValueIntType = getIntType(ValueType);
@@ -203,6 +236,11 @@ Value *DataRandomizer::createXor(IRBuilder<> &builder, Value *V, Value *Address,
   assert(Address->getType()->getPointerElementType() == V->getType() && "Address doesn't point to the type of V");
   assert(Mask->getType() == MaskTy && "Incorrect mask type");
 
+  // Remember everything emitted here for optimizeInstrumentation().
+  BasicBlock *BB = builder.GetInsertBlock();
+  BasicBlock::iterator InsertPt = builder.GetInsertPoint();
+  Instruction *Prev = InsertPt == BB->begin() ? nullptr : &*std::prev(InsertPt);
+
   Value *RealMask = getEffectiveMask(builder, Address, Mask, Alignment);
 
   // Cast to int
@@ -212,7 +250,90 @@ Value *DataRandomizer::createXor(IRBuilder<> &builder, Value *V, Value *Address,
   Value *xorInst = builder.CreateXor(cast, RealMask);
 
   // Cast back to original type
-  return createCast(builder, xorInst, V->getType());
+  Value *Result = createCast(builder, xorInst, V->getType());
+
+  recordEmitted(BB, Prev, InsertPt);
+  if (auto *XorI = dyn_cast<Instruction>(xorInst))
+    Xors.insert(XorI);
+  if (auto *L = dyn_cast<LoadInst>(V))
+    if (L->getPointerOperand() == Address)
+      DecryptedLoads.push_back(L);
+
+  return Result;
+}
+
+Value *DataRandomizer::createLaneXor(IRBuilder<> &builder, Value *V, Value *Addresses, ArrayRef<Value *> LaneMasks, unsigned Alignment) {
+  VectorType *VecTy = cast<VectorType>(V->getType());
+  unsigned NumElements = VecTy->getNumElements();
+  assert(Addresses->getType()->isVectorTy() &&
+         Addresses->getType()->getVectorNumElements() == NumElements &&
+         "Addresses must have one pointer for every lane of V");
+  assert(LaneMasks.size() == NumElements && "Need a mask for every lane");
+
+  VectorType *ValueIntType = cast<VectorType>(getIntType(VecTy));
+  unsigned MaskBits = DL.getTypeStoreSizeInBits(MaskTy);
+  if (ValueIntType->getScalarSizeInBits() > MaskBits) {
+    report_fatal_error("Data randomization of gathers or scatters with lanes "
+                       "wider than the mask is not supported");
+  }
+  if (Alignment == 0) {
+    Alignment = DL.getABITypeAlignment(VecTy->getElementType());
+  }
+
+  BasicBlock *BB = builder.GetInsertBlock();
+  BasicBlock::iterator InsertPt = builder.GetInsertPoint();
+  Instruction *Prev = InsertPt == BB->begin() ? nullptr : &*std::prev(InsertPt);
+
+  // Build the vector of lane masks. Rotating every lane by its address modulo
+  // the largest mask period is correct for all of them.
+  VectorType *MaskVecTy = VectorType::get(MaskTy, NumElements);
+  uint64_t MaskSize = 1;
+  bool AllConstant = true;
+  for (Value *M : LaneMasks) {
+    assert(M->getType() == MaskTy && "Incorrect mask type");
+    MaskSize = std::max<uint64_t>(MaskSize, PointerEquivalenceAnalysis::getMaskPeriod(M));
+    AllConstant &= isa<Constant>(M);
+  }
+  Value *MaskVec;
+  if (AllConstant) {
+    SmallVector<Constant *, 8> C;
+    for (Value *M : LaneMasks) {
+      C.push_back(cast<Constant>(M));
+    }
+    MaskVec = ConstantVector::get(C);
+  } else {
+    MaskVec = UndefValue::get(MaskVecTy);
+    for (unsigned i = 0; i < NumElements; i++) {
+      MaskVec = builder.CreateInsertElement(MaskVec, LaneMasks[i], i);
+    }
+  }
+
+  if (Alignment % MaskSize || AlwaysEmitMaskAlignment) {
+    Type *AddressIntType = DL.getIntPtrType(Addresses->getType());
+    Value *AddressInt = builder.CreatePtrToInt(Addresses, AddressIntType);
+    Value *ShiftByBytes = builder.CreateURem(AddressInt, ConstantInt::get(AddressIntType, MaskSize));
+    Value *ShiftByBits = builder.CreateMul(ShiftByBytes, ConstantInt::get(AddressIntType, 8));
+    Value *Shift = builder.CreateZExtOrTrunc(ShiftByBits, MaskVecTy);
+    Value *Shr = builder.CreateLShr(MaskVec, Shift);
+    Value *Sub = builder.CreateSub(ConstantInt::get(MaskVecTy, 0), Shift);
+    Value *And = builder.CreateAnd(Sub, ConstantInt::get(MaskVecTy, MaskBits - 1));
+    Value *Shl = builder.CreateShl(MaskVec, And);
+    MaskVec = builder.CreateOr(Shl, Shr);
+  }
+  Value *RealMask = builder.CreateTruncOrBitCast(MaskVec, ValueIntType);
+
+  Value *xorInst = builder.CreateXor(createCast(builder, V, ValueIntType), RealMask);
+  Value *Result = createCast(builder, xorInst, VecTy);
+
+  recordEmitted(BB, Prev, InsertPt);
+  if (auto *XorI = dyn_cast<Instruction>(xorInst))
+    Xors.insert(XorI);
+  return Result;
+}
+
+void DataRandomizer::recordEmitted(BasicBlock *BB, Instruction *Prev, BasicBlock::iterator InsertPt) {
+  for (auto I = Prev ? std::next(Prev->getIterator()) : BB->begin(); I != InsertPt; ++I)
+    Emitted.insert(&*I);
 }
 
 Value *DataRandomizer::createCast(IRBuilder<> &builder, Value *V, Type *T) {
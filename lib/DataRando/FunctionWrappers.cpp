@@ -1,8 +1,8 @@
 //===- FunctionWrappers.cpp - Available wrappers for library functions ----===//
 
 #include "llvm/DataRando/DataRando.h"
-#include "llvm/DataRando/Runtime/Wrapper.h"
 #include "llvm/DataRando/Runtime/DataRandoTypes.h"
+#include "llvm/Support/ErrorHandling.h"
 #include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
@@ -77,17 +77,41 @@ S_TYPEDEF(__sigset_t);
 #endif
 S_TYPEDEF(fd_set);
 
-#define DR_WR(K, V, R, P) Wrappers.insert(std::make_pair(#K, WrapperInfo(#V, TypeBuilder<R P, false>().get(C))));
+#define GET_DRRT_WRAPPER_LOOKUP
+#define GET_DRRT_WRAPPER_TYPES
+#include "llvm/DataRando/Runtime/Wrappers.inc"
 
-void FunctionWrappers::constructMap(LLVMContext &C) {
-  DRRT_WRAPPERS
+static int lookupWrapper(const Function *F) {
+  return lookupWrapper(Function::getRealLinkageName(F->getName()));
 }
 
-#undef DR_WR
+bool FunctionWrappers::hasWrapperFunction(const Function *F) const {
+  return lookupWrapper(F) >= 0;
+}
 
-bool FunctionWrappers::runOnModule(Module &M) {
-  constructMap(M.getContext());
+StringRef FunctionWrappers::getWrapperName(const Function *F) const {
+  int Index = lookupWrapper(F);
+  assert(Index >= 0 && "Function has no wrapper");
+  return WrapperNames[Index];
+}
+
+FunctionType *FunctionWrappers::getDeclaredWrapperType(const Function *F) const {
+  int Index = lookupWrapper(F);
+  assert(Index >= 0 && "Function has no wrapper");
+  return getWrapperType(Index, F->getContext());
+}
 
+bool FunctionWrappers::isFormatFunction(const Value *V) const {
+  if (const Function *F = dyn_cast<Function>(V->stripPointerCasts())) {
+    int Index = lookupWrapper(F);
+    if (Index >= 0 && WrapperFormatArgs[Index] >= 0) {
+      return true;
+    }
+  }
+  return FormatFuncs->isFormatFunction(V);
+}
+
+bool FunctionWrappers::runOnModule(Module &M) {
   CantEncryptTypes.insert(TypeBuilder<FILE*, false>().get(M.getContext()));
 
   MemManagement.insert("malloc");
@@ -1,21 +1,28 @@
 //===- HeapChecks.cpp - Heap Cross-Checks ---------------------------------===//
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstVisitor.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/InitializePasses.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/CommandLine.h"
 
 #include "llvm/DataRando/Passes.h"
+#include "llvm/DataRando/Runtime/CrossChecks.h"
 
 #define DEBUG_TYPE "HeapChecks"
 
@@ -23,20 +30,48 @@ using namespace llvm;
 
 STATISTIC(NumHeapCrossChecks, "Number of variant heap cross-checks");
 STATISTIC(NumHeapFlushes, "Number of variant heap crosscheck points");
+STATISTIC(NumHeapCheckCandidates,
+          "Number of heap cross-checks before optimization");
+STATISTIC(NumRedundantHeapChecks,
+          "Number of must-alias duplicate heap cross-checks removed");
+STATISTIC(NumHoistedHeapChecks,
+          "Number of loop-invariant heap cross-checks hoisted to preheaders");
 
 static cl::opt<bool> HeapCheckHash("hash-heap-checks",
 				   cl::desc("Batch heap-checks using a hash"));
 static cl::opt<bool> HeapCheckDebug("debug-heap-checks",
                                     cl::desc("Enable heap crosscheck debugging"));
+// Off by default: the inline update needs a runtime that defines
+// __crosscheck_hash_state, which deployed cross-check runtimes do not.
+static cl::opt<bool> HeapCheckInlineHash("inline-heap-check-hash",
+                                        cl::init(false),
+                                        cl::desc("Accumulate hashed heap checks "
+                                                 "inline instead of calling "
+                                                 "the runtime (requires a "
+                                                 "runtime that defines "
+                                                 "__crosscheck_hash_state)"));
+static cl::opt<bool> HeapCheckOpt("optimize-heap-checks", cl::init(true),
+                                  cl::desc("Remove redundant heap checks and "
+                                           "hoist loop-invariant ones"));
 
 class HeapChecks : public ModulePass {
 public:
   static char ID; // Pass identification, replacement for typeid
-  HeapChecks() : ModulePass(ID) {}
+  HeapChecks() : ModulePass(ID) {
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    initializeDominatorTreeWrapperPassPass(Registry);
+    initializeLoopInfoWrapperPassPass(Registry);
+    initializeAAResultsWrapperPassPass(Registry);
+  }
 
   bool runOnModule(Module &M) override;
 
   void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+private:
+  void emitInlineHash(IRBuilder<> &Builder, Value *Ptr);
+
+  GlobalVariable *HashState = nullptr;
 };
 
 char HeapChecks::ID = 0;
@@ -50,7 +85,7 @@ struct HeapCheckVisitor : public InstVisitor<HeapCheckVisitor> {
     auto GV = dyn_cast<GlobalVariable>(ptr);
     if (GV && GV->isNoCrossCheck())
       return;
-    toCheck.insert(std::make_pair(&I, ptr));
+    toCheck.push_back(std::make_pair(&I, ptr));
   }
 
   void visitLoadInst(LoadInst &L) {
@@ -70,12 +105,161 @@ struct HeapCheckVisitor : public InstVisitor<HeapCheckVisitor> {
       toFlush.insert(CS.getInstruction());
   }
 
-  DenseSet<std::pair<Instruction *, Value *>> toCheck;
+  // Each load or store is visited once, so a vector keeps the checks in
+  // program order without duplicates.
+  SmallVector<std::pair<Instruction *, Value *>, 32> toCheck;
   DenseSet<Instruction *> toFlush;
 private:
   DenseSet<Function *> *BlackList;
 };
 
+// Limit on the number of kept checks a check is compared with when looking for
+// duplicates of the same object.
+static const unsigned RedundancyScanLimit = 64;
+
+namespace {
+// Plans where heap checks go before they are materialized. A check of Ptr is
+// emitted right before InsertPt; Origin is the access it was derived from and
+// provides the debug location in -debug-heap-checks mode.
+struct HeapCheckPlan {
+  Instruction *InsertPt;
+  Instruction *Origin;
+  Value *Ptr;
+};
+
+class HeapCheckOptimizer {
+public:
+  HeapCheckOptimizer(DominatorTree &DT, LoopInfo &LI, AAResults &AA,
+                     const DenseSet<Instruction *> &FlushPoints)
+    : DT(DT), LI(LI), AA(AA), FlushPoints(FlushPoints) {}
+
+  void run(SmallVectorImpl<HeapCheckPlan> &Checks);
+
+private:
+  bool hasFlushBetween(const Instruction *From, const Instruction *To) const;
+  bool loopHasFlush(const Loop *L) const;
+  bool isGuaranteedToExecute(const Instruction *I, const Loop *L) const;
+  bool isCoveredBy(const HeapCheckPlan &Earlier,
+                   const HeapCheckPlan &Later) const;
+
+  DominatorTree &DT;
+  LoopInfo &LI;
+  AAResults &AA;
+  const DenseSet<Instruction *> &FlushPoints;
+};
+}
+
+/// Return true if a flush point may execute after From and before To. Only
+/// straight-line code within one block is analyzed precisely; across blocks
+/// the function must be free of flush points altogether.
+bool HeapCheckOptimizer::hasFlushBetween(const Instruction *From,
+                                         const Instruction *To) const {
+  if (From == To || FlushPoints.empty())
+    return false;
+  if (From->getParent() != To->getParent())
+    return true;
+  for (auto I = std::next(From->getIterator()); &*I != To; ++I)
+    if (FlushPoints.count(const_cast<Instruction *>(&*I)))
+      return true;
+  return false;
+}
+
+bool HeapCheckOptimizer::loopHasFlush(const Loop *L) const {
+  for (Instruction *I : FlushPoints)
+    if (L->contains(I))
+      return true;
+  return false;
+}
+
+/// Return true if I executes on every iteration of L that reaches an exit,
+/// so a check of I placed in the preheader never checks an object that the
+/// loop would not have accessed.
+bool HeapCheckOptimizer::isGuaranteedToExecute(const Instruction *I,
+                                               const Loop *L) const {
+  SmallVector<BasicBlock *, 4> ExitingBlocks;
+  L->getExitingBlocks(ExitingBlocks);
+  if (ExitingBlocks.empty())
+    return false;
+  for (BasicBlock *Exiting : ExitingBlocks)
+    if (!DT.dominates(I->getParent(), Exiting))
+      return false;
+  return true;
+}
+
+/// Return true if Later is made redundant by Earlier: both check the same
+/// object, Earlier always runs first and no flush point separates them.
+bool HeapCheckOptimizer::isCoveredBy(const HeapCheckPlan &Earlier,
+                                     const HeapCheckPlan &Later) const {
+  if (Earlier.Ptr->stripPointerCasts() != Later.Ptr->stripPointerCasts() &&
+      AA.alias(MemoryLocation(Earlier.Ptr), MemoryLocation(Later.Ptr)) !=
+          MustAlias)
+    return false;
+  if (Earlier.InsertPt != Later.InsertPt &&
+      !DT.dominates(Earlier.InsertPt, Later.InsertPt))
+    return false;
+  return !hasFlushBetween(Earlier.InsertPt, Later.InsertPt);
+}
+
+void HeapCheckOptimizer::run(SmallVectorImpl<HeapCheckPlan> &Checks) {
+  // Hoist checks of loop-invariant pointers as far out as possible.
+  for (HeapCheckPlan &Check : Checks) {
+    Loop *L = LI.getLoopFor(Check.InsertPt->getParent());
+    bool Hoisted = false;
+    while (L) {
+      BasicBlock *Preheader = L->getLoopPreheader();
+      if (!Preheader || !L->isLoopInvariant(Check.Ptr) || loopHasFlush(L) ||
+          !isGuaranteedToExecute(Check.InsertPt, L))
+        break;
+      Check.InsertPt = Preheader->getTerminator();
+      Hoisted = true;
+      L = L->getParentLoop();
+    }
+    if (Hoisted)
+      ++NumHoistedHeapChecks;
+  }
+
+  // Drop checks dominated by a check of the same object. Only the most
+  // recently kept checks are compared, which bounds the alias queries in large
+  // functions.
+  SmallVector<HeapCheckPlan, 32> Kept;
+  for (const HeapCheckPlan &Check : Checks) {
+    auto Recent =
+        Kept.end() - std::min<size_t>(Kept.size(), RedundancyScanLimit);
+    if (std::any_of(Recent, Kept.end(), [&](const HeapCheckPlan &Other) {
+          return isCoveredBy(Other, Check);
+        })) {
+      ++NumRedundantHeapChecks;
+      continue;
+    }
+
+    // A check that dominates already kept checks makes them redundant.
+    Kept.erase(std::remove_if(Recent, Kept.end(),
+                              [&](const HeapCheckPlan &Other) {
+                                if (!isCoveredBy(Check, Other))
+                                  return false;
+                                ++NumRedundantHeapChecks;
+                                return true;
+                              }),
+               Kept.end());
+    Kept.push_back(Check);
+  }
+
+  Checks.swap(Kept);
+}
+
+/// Fold Ptr into the thread-local hash accumulator, mirroring
+/// __crosscheck_hash_update() in Runtime/CrossChecks.h.
+void HeapChecks::emitInlineHash(IRBuilder<> &Builder, Value *Ptr) {
+  Type *Int64Ty = Builder.getInt64Ty();
+  Value *Acc = Builder.CreateLoad(HashState, "hash.acc");
+  Value *V = Builder.CreatePtrToInt(Ptr, Int64Ty);
+  Acc = Builder.CreateXor(Acc, V);
+  Acc = Builder.CreateMul(
+      Acc, ConstantInt::get(Int64Ty, CROSSCHECK_HASH_MULTIPLIER));
+  Acc = Builder.CreateXor(Acc, Builder.CreateLShr(Acc, CROSSCHECK_HASH_SHIFT));
+  Builder.CreateStore(Acc, HashState);
+}
+
 bool HeapChecks::runOnModule(Module &M) {
   LLVMContext &C = M.getContext();
   FunctionType *CheckFnTy, *FlushFnTy, *EnterFnTy;
@@ -112,6 +296,20 @@ bool HeapChecks::runOnModule(Module &M) {
     FlushFn = M.getOrInsertFunction("__crosscheckHash", FlushFnTy);
   }
 
+  // In hashed mode only the flush points need to enter the runtime; every
+  // check just updates the per-thread accumulator that __crosscheckHash()
+  // cross-checks and resets.
+  bool InlineHash = HeapCheckHash && !HeapCheckDebug && HeapCheckInlineHash;
+  if (InlineHash) {
+    HashState = M.getNamedGlobal("__crosscheck_hash_state");
+    if (!HashState)
+      HashState = new GlobalVariable(
+          M, Type::getInt64Ty(C), false, GlobalValue::ExternalLinkage,
+          nullptr, "__crosscheck_hash_state", nullptr,
+          GlobalValue::InitialExecTLSModel);
+    HashState->setNoCrossCheck(true);
+  }
+
   bool modified = false;
 
   DenseSet<Function *> blackList;
@@ -160,11 +358,26 @@ bool HeapChecks::runOnModule(Module &M) {
     HeapCheckVisitor HCV(&blackList);
     HCV.visit(F);
 
-    for (auto &InstValuePair : HCV.toCheck) {
-      Instruction *I = InstValuePair.first;
-      Value *ptr = InstValuePair.second;
-      IRBuilder<> builder(I);
-      builder.SetInsertPoint(I);
+    SmallVector<HeapCheckPlan, 32> Checks;
+    for (auto &InstValuePair : HCV.toCheck)
+      Checks.push_back({InstValuePair.first, InstValuePair.first,
+                        InstValuePair.second});
+    NumHeapCheckCandidates += Checks.size();
+
+    if (HeapCheckOpt && !F.isDeclaration()) {
+      HeapCheckOptimizer HCO(
+          getAnalysis<DominatorTreeWrapperPass>(F).getDomTree(),
+          getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo(),
+          getAnalysis<AAResultsWrapperPass>(F).getAAResults(),
+          HCV.toFlush);
+      HCO.run(Checks);
+    }
+
+    for (auto &Check : Checks) {
+      Instruction *I = Check.Origin;
+      Value *ptr = Check.Ptr;
+      IRBuilder<> builder(Check.InsertPt);
+      builder.SetInsertPoint(Check.InsertPt);
       if (HeapCheckDebug) {
         Value *caller = builder.CreateGlobalStringPtr(F.getName());
 	Value *line, *col, *file;
@@ -182,6 +395,8 @@ bool HeapChecks::runOnModule(Module &M) {
         Value *ptrToByte =
 	  builder.CreateCast(Instruction::CastOps::BitCast, ptr, Type::getInt8PtrTy(M.getContext()));
         builder.CreateCall(CheckFnTy, CheckFn, { caller, file, line, col, ptrToByte });
+      } else if (InlineHash) {
+        emitInlineHash(builder, ptr);
       } else {
         Value *ptrToByte =
 	  builder.CreateCast(Instruction::CastOps::BitCast, ptr, Type::getInt8PtrTy(M.getContext()));
@@ -216,7 +431,7 @@ bool HeapChecks::runOnModule(Module &M) {
       modified = true;
     }
 
-    modified |= (!HCV.toCheck.empty());
+    modified |= (!Checks.empty());
     modified |= (HeapCheckHash & (!HCV.toFlush.empty()));
   }
 
@@ -224,6 +439,9 @@ bool HeapChecks::runOnModule(Module &M) {
 }
 
 void HeapChecks::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<DominatorTreeWrapperPass>();
+  AU.addRequired<LoopInfoWrapperPass>();
+  AU.addRequired<AAResultsWrapperPass>();
   AU.setPreservesAll();
 }
 
@@ -0,0 +1,205 @@
+//===- OptimizeInstrumentation.cpp - Clean up data rando masking ----------===//
+//
+// DataRando runs after the LTO optimization pipeline, so nothing cleans up
+// the code it emits. This removes the most common redundancies in the
+// masking code created by DataRandomizer::createXor:
+//
+// - A load of an address that was stored to earlier in the same block, with
+//   no intervening write, is replaced by the stored (encrypted) value.
+// - xor(xor(V, M), M) pairs, possibly separated by lossless casts and using
+//   separately computed but identical masks, are folded to V. They show up
+//   after forwarding and are not folded by later passes.
+// - Mask computations whose operands are loop invariant are hoisted into the
+//   loop preheader. Together with the alignment address computed by
+//   getAlignmentAddress this covers masks of arrays indexed by an induction
+//   variable with a stride that is a multiple of the mask size.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "DataRando"
+
+#include "llvm/DataRando/DataRandomizer.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+static cl::opt<bool> OptimizeInstrumentation("optimize-data-rando-masking", cl::desc("Remove redundant encryption and decryption and hoist mask computations out of loops"), cl::init(true));
+
+STATISTIC(NumForwardedLoads, "Number of encrypted loads forwarded from stores");
+STATISTIC(NumFoldedXorPairs, "Number of encrypt/decrypt xor pairs folded");
+STATISTIC(NumHoistedMaskInsts, "Number of mask computations hoisted out of loops");
+
+// Limit on the number of instructions searched backwards for a store to
+// forward from.
+static const unsigned ForwardingScanLimit = 64;
+
+namespace {
+
+bool isLosslessCast(const Value *V, const DataLayout &DL) {
+  auto *CI = dyn_cast<CastInst>(V);
+  if (!CI)
+    return false;
+  if (isa<BitCastInst>(CI))
+    return true;
+  if (isa<PtrToIntInst>(CI) || isa<IntToPtrInst>(CI))
+    return DL.getTypeSizeInBits(CI->getSrcTy()) ==
+           DL.getTypeSizeInBits(CI->getDestTy());
+  return false;
+}
+
+}
+
+bool DataRandomizer::isEquivalentMask(const Value *A, const Value *B, unsigned Depth) const {
+  if (A == B)
+    return true;
+  auto *IA = dyn_cast<Instruction>(A);
+  auto *IB = dyn_cast<Instruction>(B);
+  // Mask computations are short, anything deeper is not ours.
+  if (!IA || !IB || Depth > 8)
+    return false;
+  if (!Emitted.count(const_cast<Instruction *>(IA)) ||
+      !Emitted.count(const_cast<Instruction *>(IB)))
+    return false;
+  if (!IA->isSameOperationAs(IB) || IA->mayReadOrWriteMemory())
+    return false;
+  for (unsigned i = 0, e = IA->getNumOperands(); i != e; ++i)
+    if (!isEquivalentMask(IA->getOperand(i), IB->getOperand(i), Depth + 1))
+      return false;
+  return true;
+}
+
+void DataRandomizer::eraseIfDead(Instruction *I) {
+  SmallVector<Instruction *, 8> Worklist;
+  Worklist.push_back(I);
+  while (!Worklist.empty()) {
+    Instruction *Cur = Worklist.pop_back_val();
+    if (!Cur->use_empty() || !Emitted.count(Cur))
+      continue;
+    for (Value *Op : Cur->operands())
+      if (auto *OpI = dyn_cast<Instruction>(Op))
+        Worklist.push_back(OpI);
+    Emitted.erase(Cur);
+    Xors.erase(Cur);
+    Cur->eraseFromParent();
+  }
+}
+
+bool DataRandomizer::forwardStoredValues(Function &F) {
+  bool Changed = false;
+  SmallVector<LoadInst *, 16> Loads;
+  for (LoadInst *L : DecryptedLoads)
+    if (L->getParent()->getParent() == &F)
+      Loads.push_back(L);
+
+  for (LoadInst *L : Loads) {
+    if (!L->isSimple())
+      continue;
+    Value *Ptr = L->getPointerOperand();
+    unsigned Scanned = 0;
+    for (auto I = L->getIterator(), B = L->getParent()->begin();
+         I != B && Scanned < ForwardingScanLimit; ++Scanned) {
+      --I;
+      if (auto *S = dyn_cast<StoreInst>(&*I)) {
+        if (S->isSimple() && S->getPointerOperand() == Ptr &&
+            S->getValueOperand()->getType() == L->getType()) {
+          L->replaceAllUsesWith(S->getValueOperand());
+          L->eraseFromParent();
+          ++NumForwardedLoads;
+          Changed = true;
+        }
+        break;
+      }
+      if (I->mayWriteToMemory())
+        break;
+    }
+  }
+
+  DecryptedLoads.erase(std::remove_if(DecryptedLoads.begin(), DecryptedLoads.end(),
+                                      [&](LoadInst *L) {
+                                        return std::find(Loads.begin(), Loads.end(), L) != Loads.end();
+                                      }),
+                       DecryptedLoads.end());
+  return Changed;
+}
+
+bool DataRandomizer::foldXorPairs(Function &F) {
+  bool Changed = false;
+  SmallVector<Instruction *, 16> Worklist;
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      if (Xors.count(&I))
+        Worklist.push_back(&I);
+
+  for (Instruction *Outer : Worklist) {
+    // Folding an earlier pair may have erased this xor.
+    if (!Xors.count(Outer))
+      continue;
+
+    // Look through casts for the encrypting xor.
+    Value *Inner = Outer->getOperand(0);
+    while (isLosslessCast(Inner, DL))
+      Inner = cast<CastInst>(Inner)->getOperand(0);
+    auto *InnerXor = dyn_cast<Instruction>(Inner);
+    if (!InnerXor || !Xors.count(InnerXor) || InnerXor == Outer)
+      continue;
+
+    Value *Plain = InnerXor->getOperand(0);
+    if (Plain->getType() != Outer->getType() ||
+        !isEquivalentMask(InnerXor->getOperand(1), Outer->getOperand(1)))
+      continue;
+
+    Outer->replaceAllUsesWith(Plain);
+    eraseIfDead(Outer);
+    ++NumFoldedXorPairs;
+    Changed = true;
+  }
+  return Changed;
+}
+
+bool DataRandomizer::hoistMaskComputations(Loop *L) {
+  bool Changed = false;
+  for (Loop *SubLoop : *L)
+    Changed |= hoistMaskComputations(SubLoop);
+
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return Changed;
+
+  // Mask computations are pure arithmetic on the address and mask, so they
+  // can be executed speculatively. Iterate until operands hoisted in one
+  // round have made their users invariant.
+  bool Hoisted;
+  do {
+    Hoisted = false;
+    for (BasicBlock *BB : L->blocks()) {
+      for (auto I = BB->begin(), E = BB->end(); I != E;) {
+        Instruction *Inst = &*I++;
+        if (!Emitted.count(Inst) || Inst->mayHaveSideEffects() ||
+            Inst->mayReadFromMemory() || !L->hasLoopInvariantOperands(Inst))
+          continue;
+        Inst->moveBefore(Preheader->getTerminator());
+        ++NumHoistedMaskInsts;
+        Hoisted = Changed = true;
+      }
+    }
+  } while (Hoisted);
+  return Changed;
+}
+
+bool DataRandomizer::optimizeInstrumentation(Function &F) {
+  if (!OptimizeInstrumentation || F.isDeclaration())
+    return false;
+
+  bool Changed = forwardStoredValues(F);
+  Changed |= foldXorPairs(F);
+
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  for (Loop *L : LI)
+    Changed |= hoistMaskComputations(L);
+  return Changed;
+}
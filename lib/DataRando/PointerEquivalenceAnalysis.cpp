@@ -6,17 +6,23 @@
 #include "llvm/DataRando/PointerEquivalenceAnalysis.h"
 #include "llvm/DataRando/DataRando.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Analysis/AliasSetTracker.h"
+#include "llvm/Analysis/ExecutionCounts.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/RandomNumberGenerator.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/IR/TypeBuilder.h"
 #include "llvm/IR/InstVisitor.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/ModuleSlotTracker.h"
 #include "dsa/DSGraph.h"
 #include "dsa/DSGraphTraits.h"
+#include <algorithm>
+#include <limits>
 
 using namespace llvm;
 
@@ -40,12 +46,19 @@ STATISTIC(NumMasks, "Number of random masks assigned to equivalence classes");
 STATISTIC(NumGlobalECs, "Number of equivalence classes containing global variables");
 STATISTIC(MaxSizeGlobalEC, "Maximum number of globals contained in a single equivalence class");
 STATISTIC(NumNotEncrypted, "Number of equivalence classes which are not encrypted");
+STATISTIC(NumNarrowMasks, "Number of masks narrower than the effective mask size");
+STATISTIC(NumOverBudget, "Number of equivalence classes not encrypted to stay within the overhead budget");
+STATISTIC(NumBudgetNarrowed, "Number of equivalence classes given narrower masks to stay within the overhead budget");
 
 cl::opt<unsigned int> PointerEquivalenceAnalysis::EffectiveMaskSize("data-rando-effective-mask-size", cl::init(8));
 cl::opt<std::string> PointerEquivalenceAnalysis::PrintEquivalenceClassesTo("print-eq-classes-to", cl::desc("Output the equivalence classes to the specified filename"));
 cl::opt<bool> PointerEquivalenceAnalysis::PrintAllocationCounts("print-allocation-counts", cl::desc("Print the number of allocation sites for each equivalence class"), cl::init(false));
 static cl::opt<bool> SafetyAnalysis("safety-analysis", cl::desc("Perform safety analysis before assigning xor masks"), cl::init(true));
+static cl::opt<bool> PerClassMaskSize("data-rando-per-class-mask-size", cl::desc("Give equivalence classes whose accesses all have the same alignment below the effective mask size a mask of that size"), cl::init(false));
 static cl::opt<std::string> PrintUsageCountsTo("print-eq-class-usage-counts", cl::desc("Output the usage counts of each equivalence class to the specified file"));
+static cl::opt<double> OverheadBudget("data-rando-overhead-budget", cl::desc("Estimated run time overhead, as a percentage of executed instructions, that encrypted loads and stores may add. 0 means no limit"), cl::init(0));
+static cl::opt<std::string> PrintBudgetReportTo("print-eq-class-budget-report", cl::desc("Output the estimated dynamic access count, overhead and coverage of each equivalence class to the specified file"));
+static cl::opt<bool> PrintEquivalenceClassesText("print-eq-classes-text", cl::desc("Write -print-eq-classes-to output in the verbose text format instead of JSON lines"), cl::init(false));
 
 void PointerEquivalenceAnalysis::init(RandomNumberGenerator &R, LLVMContext &C) {
   // Effective mask size needs to be a power of 2 equal to or less than
@@ -58,6 +71,115 @@ void PointerEquivalenceAnalysis::init(RandomNumberGenerator &R, LLVMContext &C)
   MaskTy = TypeBuilder<mask_t, false>::get(C);
 }
 
+unsigned PointerEquivalenceAnalysis::getMaskPeriod(const Value *Mask) {
+  const ConstantInt *CI = dyn_cast<ConstantInt>(Mask);
+  if (!CI) {
+    return EffectiveMaskSize;
+  }
+  uint64_t M = CI->getZExtValue();
+  unsigned Period = 1;
+  while (Period < sizeof(mask_t)) {
+    uint64_t Bits = 8 * Period;
+    uint64_t Low = M & ((1ULL << Bits) - 1);
+    uint64_t Repeated = Low;
+    for (unsigned i = Period; i < sizeof(mask_t); i *= 2) {
+      Repeated |= Repeated << (8 * i);
+    }
+    if (Repeated == M) {
+      break;
+    }
+    Period *= 2;
+  }
+  return Period;
+}
+
+// Get the pointer accessed by I, along with the type and alignment of the
+// access. Returns null if I doesn't access memory through a pointer operand.
+static const Value *getAccess(const Instruction &I, const DataLayout &DL, Type *&AccessTy, unsigned &Alignment) {
+  if (const LoadInst *L = dyn_cast<LoadInst>(&I)) {
+    AccessTy = L->getType();
+    Alignment = L->getAlignment();
+    return L->getPointerOperand();
+  } else if (const StoreInst *S = dyn_cast<StoreInst>(&I)) {
+    AccessTy = S->getValueOperand()->getType();
+    Alignment = S->getAlignment();
+    return S->getPointerOperand();
+  } else if (const AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(&I)) {
+    AccessTy = RMW->getValOperand()->getType();
+    Alignment = DL.getTypeStoreSize(AccessTy);
+    return RMW->getPointerOperand();
+  } else if (const AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(&I)) {
+    AccessTy = CX->getCompareOperand()->getType();
+    Alignment = DL.getTypeStoreSize(AccessTy);
+    return CX->getPointerOperand();
+  } else if (const VAArgInst *VA = dyn_cast<VAArgInst>(&I)) {
+    AccessTy = VA->getType();
+    Alignment = 0;
+    return VA->getPointerOperand();
+  } else if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(&I)) {
+    if (II->getIntrinsicID() == Intrinsic::masked_load) {
+      AccessTy = II->getType();
+      Alignment = cast<ConstantInt>(II->getArgOperand(1))->getZExtValue();
+      return II->getArgOperand(0);
+    } else if (II->getIntrinsicID() == Intrinsic::masked_store) {
+      AccessTy = II->getArgOperand(0)->getType();
+      Alignment = cast<ConstantInt>(II->getArgOperand(2))->getZExtValue();
+      return II->getArgOperand(1);
+    }
+  }
+  return nullptr;
+}
+
+unsigned PointerEquivalenceAnalysis::getAlignedSize(Type *AccessTy, unsigned Alignment, const DataLayout &DL) {
+  if (Alignment == 0) {
+    Alignment = DL.getABITypeAlignment(AccessTy);
+  }
+  // The largest power of 2 dividing the alignment, and for vectors the offset
+  // of each element.
+  unsigned Size = Alignment & -Alignment;
+  if (VectorType *VecTy = dyn_cast<VectorType>(AccessTy)) {
+    unsigned ElementSize = DL.getTypeAllocSize(VecTy->getElementType());
+    Size = std::min(Size, ElementSize & -ElementSize);
+  }
+  return std::min(Size, (unsigned)EffectiveMaskSize);
+}
+
+void PointerEquivalenceAnalysis::recordAccessAlignments(const Function &F, const DataLayout &DL) {
+  if (!PerClassMaskSize) {
+    return;
+  }
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      Type *AccessTy;
+      unsigned Alignment;
+      const Value *Ptr = getAccess(I, DL, AccessTy, Alignment);
+      if (!Ptr) {
+        continue;
+      }
+      const DSNode *N = getNode(Ptr).getNode();
+      if (!N) {
+        continue;
+      }
+      // A single narrow access must not shrink the mask of the wider fields
+      // of the class, so only narrow a class whose accesses all agree.
+      unsigned Size = getAlignedSize(AccessTy, Alignment, DL);
+      auto It = MaskSizes.insert(std::make_pair(N, Size));
+      if (!It.second && It.first->second != Size) {
+        It.first->second = EffectiveMaskSize;
+      }
+    }
+  }
+}
+
+Constant *PointerEquivalenceAnalysis::nextMaskForNode(const DSNode *N) {
+  auto I = MaskSizes.find(N);
+  if (I == MaskSizes.end() || I->second >= EffectiveMaskSize) {
+    return nextMask();
+  }
+  NumNarrowMasks++;
+  return nextMask(I->second);
+}
+
 SteensgaardsPEA::SteensgaardsPEA() : ModulePass(ID) {}
 
 void SteensgaardsPEA::warnUnknown(const DSNode *Node) {
@@ -332,11 +454,19 @@ bool SteensgaardsPEA::runOnModule(Module &M) {
     assignMaskRecursively(getNode(&*A), nullMask(), "Environment argument to main");
   }
 
+  for (const Function &F : M) {
+    recordAccessAlignments(F, *DL);
+  }
+
   // Now identify safe equivalence classes
   if (SafetyAnalysis) {
     safetyAnalysis();
   }
 
+  if (OverheadBudget > 0 || !PrintBudgetReportTo.empty()) {
+    applyOverheadBudget(M);
+  }
+
   // After safety analysis has been performed all equivalence classes that will
   // not be encrypted have been found.
   NumNotEncrypted = MaskMap.size();
@@ -392,7 +522,234 @@ void PointerEquivalenceAnalysis::printClass(raw_ostream &S, const DSNode* N, Val
   S << "********************************************************************************\n";
 }
 
+static void printJSONString(raw_ostream &S, StringRef Str) {
+  S << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\') {
+      S << '\\' << C;
+    } else if (C < 0x20) {
+      S << "\\u00" << hexdigit(C >> 4, true) << hexdigit(C & 0xf, true);
+    } else {
+      S << C;
+    }
+  }
+  S << '"';
+}
+
+// Call Visit once for every value that has a class, in an order that only
+// depends on the IR: globals, aliases and functions with their arguments and
+// instructions in module order, then constants in the order of their first
+// use, then values no longer used anywhere in the order of their printed form.
+// Values that are not part of the module are tagged with the function and
+// index of the instruction using them, or with neither.
+void SteensgaardsPEA::visitClassValues(const Module &M, function_ref<void(const Value *, StringRef, const Function *, int)> Visit) {
+  DenseSet<const Value*> Visited;
+  auto visitValue = [&](const Value *V, StringRef Kind, const Function *F, int Index) {
+    auto I = NodeMap.find(V);
+    if (I != NodeMap.end() && I->second.getNode() && Visited.insert(V).second) {
+      Visit(V, Kind, F, Index);
+    }
+  };
+
+  for (const GlobalVariable &GV : M.globals()) {
+    visitValue(&GV, "global", nullptr, -1);
+  }
+  for (const GlobalAlias &GA : M.aliases()) {
+    visitValue(&GA, "alias", nullptr, -1);
+  }
+  for (const Function &F : M) {
+    visitValue(&F, "function", nullptr, -1);
+    for (const Argument &A : F.args()) {
+      visitValue(&A, "argument", &F, A.getArgNo());
+    }
+    int Index = 0;
+    for (const BasicBlock &BB : F) {
+      for (const Instruction &I : BB) {
+        visitValue(&I, "instruction", &F, Index++);
+      }
+    }
+  }
+  // NodeMap is ordered by pointer value, so constants are reached through
+  // their users instead. This keeps their order stable from run to run.
+  DenseSet<const Constant*> Walked;
+  auto visitConstants = [&](const Constant *Root, const Function *F, int Index) {
+    SmallVector<const Constant*, 8> Worklist(1, Root);
+    while (!Worklist.empty()) {
+      const Constant *C = Worklist.pop_back_val();
+      if (isa<GlobalValue>(C) || !Walked.insert(C).second) {
+        continue;
+      }
+      visitValue(C, "other", F, Index);
+      for (const Use &U : C->operands()) {
+        Worklist.push_back(cast<Constant>(U.get()));
+      }
+    }
+  };
+  for (const GlobalVariable &GV : M.globals()) {
+    if (GV.hasInitializer()) {
+      visitConstants(GV.getInitializer(), nullptr, -1);
+    }
+  }
+  for (const GlobalAlias &GA : M.aliases()) {
+    visitConstants(GA.getAliasee(), nullptr, -1);
+  }
+  for (const Function &F : M) {
+    int Index = 0;
+    for (const BasicBlock &BB : F) {
+      for (const Instruction &I : BB) {
+        for (const Use &U : I.operands()) {
+          if (const Constant *C = dyn_cast<Constant>(U.get())) {
+            visitConstants(C, &F, Index);
+          }
+        }
+        ++Index;
+      }
+    }
+  }
+  std::vector<std::pair<std::string, const Value*> > Unused;
+  for (auto I : NodeMap) {
+    if (I.second.getNode() && !Visited.count(I.first)) {
+      std::string Str;
+      raw_string_ostream OS(Str);
+      I.first->printAsOperand(OS, true, &M);
+      Unused.emplace_back(OS.str(), I.first);
+    }
+  }
+  std::stable_sort(Unused.begin(), Unused.end(),
+                   [](const std::pair<std::string, const Value*> &A,
+                      const std::pair<std::string, const Value*> &B) {
+                     return A.first < B.first;
+                   });
+  for (auto &U : Unused) {
+    visitValue(U.second, "other", nullptr, -1);
+  }
+}
+
+unsigned SteensgaardsPEA::getClassID(const DSNode *N) {
+  auto R = ClassIDs.insert(std::make_pair(N, Classes.size()));
+  if (R.second) {
+    Classes.push_back(N);
+  }
+  return R.first->second;
+}
+
+// Number the classes in the order visitClassValues first reaches them. The
+// numbering is done once, so a dump written after the module was transformed
+// uses the same IDs as the budget report written before.
+void SteensgaardsPEA::numberClasses(const Module &M) {
+  if (!Classes.empty()) {
+    return;
+  }
+  visitClassValues(M, [&](const Value *V, StringRef, const Function *, int) {
+    getClassID(NodeMap.lookup(V).getNode());
+  });
+}
+
+// Write the equivalence classes as JSON lines. Name gets one record per class
+// and Name.values one record per value that has a class. Values are numbered
+// in the order of visitClassValues and classes by numberClasses, so the IDs
+// are stable between builds of the same IR. Values are identified by their
+// name, or by their function and index for unnamed instructions, instead of
+// printing them, which is what made the text format slow.
+bool SteensgaardsPEA::dumpEquivalenceClasses(StringRef Name, const Module &M) {
+  std::error_code EC;
+  tool_output_file ClassFile(Name, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Could not open " << Name << ": " << EC.message() << '\n';
+    return false;
+  }
+  std::string ValuesName = (Name + ".values").str();
+  tool_output_file ValueFile(ValuesName, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Could not open " << ValuesName << ": " << EC.message() << '\n';
+    return false;
+  }
+  raw_ostream &VS = ValueFile.os();
+
+  numberClasses(M);
+  std::vector<std::vector<unsigned> > Members(Classes.size());
+  unsigned NextValueID = 0;
+  visitClassValues(M, [&](const Value *V, StringRef Kind, const Function *F, int Index) {
+    unsigned ID = NextValueID++;
+    unsigned Class = getClassID(NodeMap.lookup(V).getNode());
+    Members.resize(Classes.size());
+    Members[Class].push_back(ID);
+
+    VS << "{\"id\":" << ID << ",\"kind\":\"" << Kind << '"';
+    if (F) {
+      VS << ",\"function\":";
+      printJSONString(VS, Function::getRealLinkageName(F->getName()));
+    }
+    if (Index >= 0) {
+      VS << ",\"index\":" << Index;
+    }
+    if (V->hasName()) {
+      VS << ",\"name\":";
+      printJSONString(VS, Function::getRealLinkageName(V->getName()));
+    }
+    if (const Instruction *Inst = dyn_cast<Instruction>(V)) {
+      VS << ",\"opcode\":\"" << Inst->getOpcodeName() << '"';
+    }
+    VS << "}\n";
+  });
+
+  // Classes reached only through points-to edges are appended while looping.
+  raw_ostream &CS = ClassFile.os();
+  for (unsigned ID = 0; ID < Classes.size(); ++ID) {
+    const DSNode *N = Classes[ID];
+    CS << "{\"class\":" << ID << ",\"mask\":";
+    Constant *Mask = MaskMap.lookup(N);
+    if (const ConstantInt *CI = dyn_cast_or_null<ConstantInt>(Mask)) {
+      CS << '"' << format_hex(CI->getZExtValue(), 18) << "\",\"mask_period\":"
+         << getMaskPeriod(CI);
+    } else {
+      CS << "null";
+    }
+    CS << ",\"flags\":" << N->getNodeFlags()
+       << ",\"size\":" << N->getSize()
+       << ",\"allocations\":" << N->numAllocations()
+       << ",\"accesses\":" << AccessCounts.lookup(N);
+
+    CS << ",\"reasons\":[";
+    auto R = MaskReason.find(N);
+    if (R != MaskReason.end()) {
+      bool First = true;
+      for (auto &Str : R->second) {
+        CS << (First ? "" : ",");
+        printJSONString(CS, Str.first());
+        First = false;
+      }
+    }
+
+    CS << "],\"edges\":[";
+    bool First = true;
+    for (auto i = N->edge_begin(), e = N->edge_end(); i != e; i++) {
+      if (const DSNode *Target = i->second.getNode()) {
+        CS << (First ? "" : ",") << '[' << i->first << ',' << getClassID(Target) << ']';
+        First = false;
+      }
+    }
+
+    CS << "],\"members\":[";
+    Members.resize(Classes.size());
+    First = true;
+    for (unsigned V : Members[ID]) {
+      CS << (First ? "" : ",") << V;
+      First = false;
+    }
+    CS << "]}\n";
+  }
+
+  ClassFile.keep();
+  ValueFile.keep();
+  return false;
+}
+
 bool SteensgaardsPEA::printEquivalenceClasses(StringRef Name, const Module &Mdl) {
+  if (!PrintEquivalenceClassesText) {
+    return dumpEquivalenceClasses(Name, Mdl);
+  }
+
   DenseMap<const DSNode*, std::vector<const Value*> > ValueLists;
   for (auto I : NodeMap) {
     ValueLists[I.second.Node].push_back(I.first);
@@ -477,6 +834,170 @@ void SteensgaardsPEA::safetyAnalysis() {
   NumSafeClasses = Nodes.size();
 }
 
+namespace {
+// Dynamic accesses to a class, split by the mask size each access is aligned
+// to: index I counts the accesses aligned to 1 << I bytes.
+struct ClassUsage {
+  size_t StaticCount = 0;
+  double DynamicCount = 0;
+  double AlignedCounts[4] = {0, 0, 0, 0};
+  unsigned MaskSize = 0;
+  double Overhead = 0;
+};
+}
+
+// Instructions added to an access beyond the xor when the mask has to be
+// rotated to the address.
+static const unsigned RotationCost = 4;
+
+// The estimated number of instructions added by encrypting the class with a
+// mask of MaskSize bytes.
+static double getEncryptionCost(const ClassUsage &U, unsigned MaskSize) {
+  double Cost = U.DynamicCount;
+  for (unsigned i = 0; (1u << i) < MaskSize; i++) {
+    Cost += RotationCost * U.AlignedCounts[i];
+  }
+  return Cost;
+}
+
+void SteensgaardsPEA::applyOverheadBudget(Module &M) {
+  DenseMap<const DSNode*, ClassUsage> Usage;
+  // Classes in the order they are first accessed, so the ranking doesn't
+  // depend on pointer values.
+  std::vector<const DSNode*> Accessed;
+  double TotalInstructions = 0;
+  bool HaveProfile = false;
+
+  for (Function &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+
+    HaveProfile |= F.getEntryCount().hasValue();
+    std::vector<double> Counts = estimateBlockExecutionCounts(F);
+    unsigned BI = 0;
+    for (BasicBlock &BB : F) {
+      double Count = Counts[BI++];
+      TotalInstructions += Count * BB.size();
+      for (Instruction &I : BB) {
+        Type *AccessTy;
+        unsigned Alignment;
+        const Value *Ptr = getAccess(I, *DL, AccessTy, Alignment);
+        if (!Ptr) {
+          continue;
+        }
+        const DSNode *N = getNode(Ptr).getNode();
+        if (!N) {
+          continue;
+        }
+        ClassUsage &U = Usage[N];
+        if (U.StaticCount++ == 0) {
+          Accessed.push_back(N);
+        }
+        U.DynamicCount += Count;
+        unsigned Size = getAlignedSize(AccessTy, Alignment, *DL);
+        U.AlignedCounts[Log2_32(Size)] += Count;
+      }
+    }
+  }
+
+  // Rank the classes that can be encrypted from least to most frequently
+  // accessed.
+  std::vector<const DSNode*> Ranked;
+  for (const DSNode *N : Accessed) {
+    if (!MaskMap.count(N)) {
+      Ranked.push_back(N);
+    }
+  }
+  std::stable_sort(Ranked.begin(), Ranked.end(),
+                   [&](const DSNode *A, const DSNode *B) {
+                     return Usage[A].DynamicCount < Usage[B].DynamicCount;
+                   });
+
+  // First cover as many classes as fit in the budget with the cheapest mask,
+  // one byte wide, which never needs rotation. Then spend what is left on
+  // widening the masks of those classes, least accessed first.
+  double Budget = OverheadBudget > 0 ? OverheadBudget / 100 * TotalInstructions
+                                     : std::numeric_limits<double>::infinity();
+  double Used = 0;
+  std::vector<const DSNode*> Encrypted;
+  for (const DSNode *N : Ranked) {
+    ClassUsage &U = Usage[N];
+    double Cost = getEncryptionCost(U, 1);
+    if (Used + Cost > Budget) {
+      assignMask(N, nullMask(), "Over the data randomization overhead budget");
+      NumOverBudget++;
+      continue;
+    }
+    Used += Cost;
+    U.MaskSize = 1;
+    U.Overhead = Cost;
+    Encrypted.push_back(N);
+  }
+  for (const DSNode *N : Encrypted) {
+    ClassUsage &U = Usage[N];
+    for (unsigned Size = getMaskSize(N); Size > 1; Size /= 2) {
+      double Cost = getEncryptionCost(U, Size);
+      if (Used - U.Overhead + Cost <= Budget) {
+        Used += Cost - U.Overhead;
+        U.MaskSize = Size;
+        U.Overhead = Cost;
+        break;
+      }
+    }
+    if (U.MaskSize < getMaskSize(N)) {
+      setMaskSize(N, U.MaskSize);
+      NumBudgetNarrowed++;
+    }
+  }
+
+  if (PrintBudgetReportTo.empty()) {
+    return;
+  }
+  std::error_code EC;
+  raw_fd_ostream S(PrintBudgetReportTo, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "Error opening " << PrintBudgetReportTo << ": " << EC.message() << '\n';
+    return;
+  }
+
+  // Report every accessed class from most to least frequently accessed, by the
+  // IDs it has in the -print-eq-classes-to dump.
+  std::stable_sort(Accessed.begin(), Accessed.end(),
+                   [&](const DSNode *A, const DSNode *B) {
+                     return Usage[A].DynamicCount > Usage[B].DynamicCount;
+                   });
+  size_t StaticTotal = 0, StaticEncrypted = 0;
+  double DynamicTotal = 0, DynamicEncrypted = 0;
+  for (const DSNode *N : Accessed) {
+    StaticTotal += Usage[N].StaticCount;
+    DynamicTotal += Usage[N].DynamicCount;
+  }
+
+  numberClasses(M);
+  S << "Class,Static accesses,Dynamic accesses,Mask size,Estimated overhead %,Cumulative dynamic coverage %\n";
+  for (const DSNode *N : Accessed) {
+    const ClassUsage &U = Usage[N];
+    if (U.MaskSize) {
+      StaticEncrypted += U.StaticCount;
+      DynamicEncrypted += U.DynamicCount;
+    }
+    S << getClassID(N) << ',' << U.StaticCount << ','
+      << format("%.0f", U.DynamicCount) << ',' << U.MaskSize << ','
+      << format("%.4f", percentOf(U.Overhead, TotalInstructions)) << ','
+      << format("%.2f", percentOf(DynamicEncrypted, DynamicTotal)) << '\n';
+  }
+  printExecutionCountSource(S, HaveProfile);
+  S << "# Encrypted classes: " << Encrypted.size() << " of " << Accessed.size() << " accessed\n";
+  S << "# Encrypted accesses: " << format("%.2f", percentOf(StaticEncrypted, StaticTotal)) << "% static, "
+    << format("%.2f", percentOf(DynamicEncrypted, DynamicTotal)) << "% dynamic\n";
+  S << "# Estimated overhead: " << format("%.4f", percentOf(Used, TotalInstructions)) << "% of executed instructions";
+  if (OverheadBudget > 0) {
+    S << " (budget " << format("%.4f", (double)OverheadBudget) << "%)";
+  }
+  S << '\n';
+}
+
 Value *SteensgaardsPEA::getMaskForNode(const NodeHandle &N) {
   if (!N.Node) {
     return nextMask();
@@ -488,7 +1009,7 @@ Value *SteensgaardsPEA::getMaskForNode(const NodeHandle &N) {
 
   auto I = MaskMap.find(N.Node);
   if (I == MaskMap.end()) {
-    Constant *M = nextMask();
+    Constant *M = nextMaskForNode(N.Node);
     assignMask(N, M);
     // update statistics
     NumMasks++;
@@ -0,0 +1,70 @@
+/*===- DataCheckBench.c - Data cross-check throughput ---------------------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* Compares synchronous data cross-checks (one __crosscheck() call per value)
+|* against the buffered lowering emitted by -xcheck-buffer. To measure the
+|* shared-memory transport, run a leader and a follower concurrently:
+|*
+|*   CROSSCHECK_SHM=/xcheck CROSSCHECK_ROLE=leader data-check-bench &
+|*   CROSSCHECK_SHM=/xcheck data-check-bench
+|*
+|*   data-check-bench [checks] [checks-per-sync]
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/DataRando/Runtime/CrossChecks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec TS;
+  clock_gettime(CLOCK_MONOTONIC, &TS);
+  return TS.tv_sec + TS.tv_nsec * 1e-9;
+}
+
+static void report(const char *Name, unsigned long Checks, double Seconds) {
+  printf("%-8s %12.0f checks/s  %8.2f ns/check\n", Name, Checks / Seconds,
+         Seconds * 1e9 / Checks);
+}
+
+/* What the pass emits for each checked value in buffered mode. */
+static inline void bufferedCheck(uint64_t Value) {
+  uint64_t Pos = __crosscheck_buffer_pos;
+  __crosscheck_buffer[Pos] = Value;
+  __crosscheck_buffer_pos = ++Pos;
+  if (__builtin_expect(Pos >= CROSSCHECK_INTERVAL, 0))
+    __crosscheckFlush();
+}
+
+int main(int argc, char **argv) {
+  unsigned long Checks = argc > 1 ? strtoul(argv[1], 0, 0) : 10000000UL;
+  unsigned long PerSync = argc > 2 ? strtoul(argv[2], 0, 0) : 256;
+  unsigned long I;
+  double Start;
+
+  if (!PerSync)
+    PerSync = 1;
+
+  Start = now();
+  for (I = 0; I != Checks; ++I)
+    __crosscheck(I * 7);
+  report("sync", Checks, now() - Start);
+
+  Start = now();
+  for (I = 0; I != Checks; ++I) {
+    bufferedCheck(I * 7);
+    /* An external call, e.g. a system call wrapper. */
+    if (I % PerSync == PerSync - 1)
+      __crosscheckFlush();
+  }
+  __crosscheckFlush();
+  report("buffered", Checks, now() - Start);
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*===- GeneratedWrappers.c - Wrappers generated from Wrappers.td ----------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* Wrappers for library functions that only need their buffer arguments
+|* decrypted before the call or encrypted after it. The bodies are generated
+|* from the Inputs and Outputs of each record in
+|* include/llvm/DataRando/Runtime/Wrappers.td, and decrypt and encrypt through
+|* the vectorized drrt_vec_memmove and drrt_vec_strlen of MaskedStrings.c.
+|*
+|* The generated wrappers are named drrt_gen_* unless their record names the
+|* wrapper, so they never clash with the data randomization runtime.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "llvm/DataRando/Runtime/DataRandoTypes.h"
+
+#include <errno.h>
+#include <grp.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Buffers up to this size are decrypted on the stack. */
+#define DRRT_TEMP_SIZE 256
+
+void *drrt_vec_memmove(void *D, const void *S, size_t N, mask_t MRet,
+                       mask_t MD, mask_t MS);
+size_t drrt_vec_strlen(const char *S, mask_t M);
+
+/* Decrypt the N bytes at P into Stack if they fit, or into a heap buffer.
+   Unencrypted buffers are used in place. */
+static void *decryptTemp(const void *P, size_t N, mask_t M, char *Stack) {
+  if (!P || !M)
+    return (void *)P;
+  void *T = N <= DRRT_TEMP_SIZE ? Stack : malloc(N);
+  if (!T)
+    abort();
+  return drrt_vec_memmove(T, P, N, 0, 0, M);
+}
+
+static void *decryptString(const char *S, mask_t M, char *Stack) {
+  if (!S || !M)
+    return (void *)S;
+  return decryptTemp(S, drrt_vec_strlen(S, M) + 1, M, Stack);
+}
+
+/* Release the temporary T that decryptTemp returned for P. */
+static void freeTemp(const void *T, const void *P, const char *Stack) {
+  if (T != P && T != Stack)
+    free((void *)T);
+}
+
+static void encryptInPlace(void *P, size_t N, mask_t M) {
+  drrt_vec_memmove(P, P, N, 0, M, 0);
+}
+
+/* Encrypt the string written to the N byte buffer at P, which is not
+   terminated if it fills the buffer. */
+static void encryptString(char *P, size_t N, mask_t M) {
+  size_t Length = strnlen(P, N);
+  encryptInPlace(P, Length < N ? Length + 1 : N, M);
+}
+
+#define GET_DRRT_WRAPPER_BODIES
+#include "llvm/DataRando/Runtime/Wrappers.inc"
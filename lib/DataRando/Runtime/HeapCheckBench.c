@@ -0,0 +1,66 @@
+/*===- HeapCheckBench.c - Heap check hashing throughput -------------------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* Compares the throughput of hashed heap checks lowered to a runtime call per
+|* check against the inline accumulation emitted by -inline-heap-check-hash.
+|*
+|*   heap-check-bench [checks] [checks-per-flush]
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/DataRando/Runtime/CrossChecks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec TS;
+  clock_gettime(CLOCK_MONOTONIC, &TS);
+  return TS.tv_sec + TS.tv_nsec * 1e-9;
+}
+
+/* Keep the compiler from folding the object addresses. */
+static char *volatile Objects;
+
+static void report(const char *Name, unsigned long Checks, double Seconds) {
+  printf("%-8s %12.0f checks/s  %6.2f ns/check\n", Name, Checks / Seconds,
+         Seconds * 1e9 / Checks);
+}
+
+int main(int argc, char **argv) {
+  unsigned long Checks = argc > 1 ? strtoul(argv[1], 0, 0) : 100000000UL;
+  unsigned long PerFlush = argc > 2 ? strtoul(argv[2], 0, 0) : 64;
+  unsigned long I;
+  double Start;
+  char *Base;
+
+  if (!PerFlush)
+    PerFlush = 1;
+  Objects = malloc(4096);
+  Base = Objects;
+
+  Start = now();
+  for (I = 0; I != Checks; ++I) {
+    __crosscheckHashObject(Base + (I & 4095));
+    if (I % PerFlush == PerFlush - 1)
+      __crosscheckHash();
+  }
+  report("call", Checks, now() - Start);
+
+  Start = now();
+  for (I = 0; I != Checks; ++I) {
+    __crosscheck_hash_state = __crosscheck_hash_update(
+        __crosscheck_hash_state, (uintptr_t)(Base + (I & 4095)));
+    if (I % PerFlush == PerFlush - 1)
+      __crosscheckHash();
+  }
+  report("inline", Checks, now() - Start);
+
+  free(Base);
+  return 0;
+}
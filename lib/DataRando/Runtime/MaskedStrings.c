@@ -0,0 +1,256 @@
+/*===- MaskedStrings.c - Vectorized string and memory wrappers -----------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* Versions of the hottest drrt_* library wrappers that decrypt 16 bytes at a
+|* time instead of one. The byte at address A of an object with mask M is
+|* encrypted with byte A % 8 of M, so once M is rotated to the first byte of
+|* an access, a single 128-bit pattern decrypts every 16-byte block of it.
+|*
+|* They are named drrt_vec_* so that they never clash with the data
+|* randomization runtime's own drrt_* wrappers; the compiler calls these names
+|* directly. Without SSE2 the wrappers fall back to a byte loop.
+|*
+|* Wrapper masks follow the order the compiler passes them in: the mask of the
+|* returned pointer first, then one mask per pointer argument.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/DataRando/Runtime/DataRandoTypes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Rotate Mask so that its low byte is the one encrypting the byte at P. */
+static inline uint64_t phaseMask(mask_t Mask, const void *P) {
+  unsigned Shift = ((uintptr_t)P & 7) * 8;
+  return Shift ? (Mask >> Shift) | (Mask << (64 - Shift)) : Mask;
+}
+
+/* The mask byte for offset I from the address Phase was rotated to. */
+static inline unsigned char maskByte(uint64_t Phase, size_t I) {
+  return (unsigned char)(Phase >> ((I & 7) * 8));
+}
+
+#ifdef __SSE2__
+#define PAGE_SIZE_MIN 4096
+
+/* Whether a 16-byte read at P could touch the next page. Reads past the end
+   of a string are only safe if they stay on the last page of the string. */
+static inline int crossesPage(const void *P) {
+  return ((uintptr_t)P & (PAGE_SIZE_MIN - 1)) > PAGE_SIZE_MIN - 16;
+}
+
+static inline __m128i loadDecrypted(const void *P, __m128i Mask) {
+  return _mm_xor_si128(_mm_loadu_si128((const __m128i *)P), Mask);
+}
+
+static inline unsigned firstSet(unsigned Bits) {
+  return __builtin_ctz(Bits);
+}
+#endif
+
+size_t drrt_vec_strlen(const char *S, mask_t M) {
+  if (!M)
+    return strlen(S);
+#ifdef __SSE2__
+  /* Aligned blocks never cross a page, so the block holding S is read whole
+     and the bytes before S are ignored. Every aligned block starts at mask
+     byte 0. */
+  const char *Block = (const char *)((uintptr_t)S & ~(uintptr_t)15);
+  __m128i Mask = _mm_set1_epi64x(M);
+  __m128i Zero = _mm_setzero_si128();
+  unsigned Bits = _mm_movemask_epi8(_mm_cmpeq_epi8(
+      _mm_xor_si128(_mm_load_si128((const __m128i *)Block), Mask), Zero));
+  Bits >>= S - Block;
+  if (Bits)
+    return firstSet(Bits);
+  for (Block += 16;; Block += 16) {
+    Bits = _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_xor_si128(_mm_load_si128((const __m128i *)Block), Mask), Zero));
+    if (Bits)
+      return Block - S + firstSet(Bits);
+  }
+#else
+  uint64_t Phase = phaseMask(M, S);
+  size_t I = 0;
+  while ((unsigned char)S[I] != maskByte(Phase, I))
+    ++I;
+  return I;
+#endif
+}
+
+/* strncmp of two encrypted strings, strcmp if N is SIZE_MAX. */
+static int compareStrings(const char *A, const char *B, size_t N,
+                          mask_t MA, mask_t MB) {
+  if (!MA && !MB)
+    return N == SIZE_MAX ? strcmp(A, B) : strncmp(A, B, N);
+  uint64_t PA = phaseMask(MA, A), PB = phaseMask(MB, B);
+  size_t I = 0;
+#ifdef __SSE2__
+  __m128i VA = _mm_set1_epi64x(PA), VB = _mm_set1_epi64x(PB);
+  __m128i Zero = _mm_setzero_si128();
+#endif
+  while (I < N) {
+#ifdef __SSE2__
+    if (N - I >= 16 && !crossesPage(A + I) && !crossesPage(B + I)) {
+      __m128i X = loadDecrypted(A + I, VA);
+      __m128i Y = loadDecrypted(B + I, VB);
+      unsigned Stop = (_mm_movemask_epi8(_mm_cmpeq_epi8(X, Y)) ^ 0xffff) |
+                      _mm_movemask_epi8(_mm_cmpeq_epi8(X, Zero));
+      if (!Stop) {
+        I += 16;
+        continue;
+      }
+      I += firstSet(Stop);
+      return (unsigned char)(A[I] ^ maskByte(PA, I)) -
+             (unsigned char)(B[I] ^ maskByte(PB, I));
+    }
+#endif
+    unsigned char CA = A[I] ^ maskByte(PA, I);
+    unsigned char CB = B[I] ^ maskByte(PB, I);
+    if (CA != CB || !CA)
+      return CA - CB;
+    ++I;
+  }
+  return 0;
+}
+
+int drrt_vec_strcmp(const char *A, const char *B, mask_t MA, mask_t MB) {
+  return compareStrings(A, B, SIZE_MAX, MA, MB);
+}
+
+int drrt_vec_strncmp(const char *A, const char *B, size_t N, mask_t MA,
+                     mask_t MB) {
+  return compareStrings(A, B, N, MA, MB);
+}
+
+int drrt_vec_memcmp(const void *A, const void *B, size_t N, mask_t MA,
+                    mask_t MB) {
+  const unsigned char *CA = A, *CB = B;
+  uint64_t PA = phaseMask(MA, A), PB = phaseMask(MB, B);
+  if (!PA && !PB)
+    return memcmp(A, B, N);
+  size_t I = 0;
+#ifdef __SSE2__
+  __m128i VA = _mm_set1_epi64x(PA), VB = _mm_set1_epi64x(PB);
+  for (; N - I >= 16; I += 16) {
+    unsigned Diff = _mm_movemask_epi8(_mm_cmpeq_epi8(
+        loadDecrypted(CA + I, VA), loadDecrypted(CB + I, VB))) ^ 0xffff;
+    if (Diff) {
+      I += firstSet(Diff);
+      return (unsigned char)(CA[I] ^ maskByte(PA, I)) -
+             (unsigned char)(CB[I] ^ maskByte(PB, I));
+    }
+  }
+#endif
+  for (; I < N; ++I) {
+    unsigned char X = CA[I] ^ maskByte(PA, I);
+    unsigned char Y = CB[I] ^ maskByte(PB, I);
+    if (X != Y)
+      return X - Y;
+  }
+  return 0;
+}
+
+void *drrt_vec_memchr(const void *S, int C, size_t N, mask_t MRet, mask_t MS) {
+  (void)MRet;
+  if (!MS)
+    return memchr(S, C, N);
+  const unsigned char *CS = S;
+  uint64_t Phase = phaseMask(MS, S);
+  size_t I = 0;
+#ifdef __SSE2__
+  __m128i Mask = _mm_set1_epi64x(Phase);
+  __m128i Needle = _mm_set1_epi8((char)C);
+  for (; N - I >= 16; I += 16) {
+    unsigned Found = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(loadDecrypted(CS + I, Mask), Needle));
+    if (Found)
+      return (void *)(CS + I + firstSet(Found));
+  }
+#endif
+  for (; I < N; ++I)
+    if ((unsigned char)(CS[I] ^ maskByte(Phase, I)) == (unsigned char)C)
+      return (void *)(CS + I);
+  return NULL;
+}
+
+void *drrt_vec_memset(void *P, int C, size_t N, mask_t MRet, mask_t MP) {
+  (void)MRet;
+  if (!MP)
+    return memset(P, C, N);
+  unsigned char *CP = P;
+  uint64_t Phase = phaseMask(MP, P);
+  size_t I = 0;
+#ifdef __SSE2__
+  __m128i Value = _mm_xor_si128(_mm_set1_epi8((char)C), _mm_set1_epi64x(Phase));
+  for (; N - I >= 16; I += 16)
+    _mm_storeu_si128((__m128i *)(CP + I), Value);
+#endif
+  for (; I < N; ++I)
+    CP[I] = (unsigned char)C ^ maskByte(Phase, I);
+  return P;
+}
+
+/* Copy N bytes from S to D, re-encrypting every byte from the phase PS of the
+   source to the phase PD of the destination. Handles overlap like memmove. */
+static void moveReencrypted(unsigned char *D, const unsigned char *S, size_t N,
+                            uint64_t PD, uint64_t PS) {
+  uint64_t Phase = PD ^ PS;
+  if (!Phase) {
+    memmove(D, S, N);
+    return;
+  }
+  size_t I;
+  if (D <= S || D >= S + N) {
+    I = 0;
+#ifdef __SSE2__
+    /* Each block is loaded before it is stored, and with D <= S a store never
+       reaches a source byte that is still to be loaded. */
+    __m128i Mask = _mm_set1_epi64x(Phase);
+    for (; N - I >= 16; I += 16)
+      _mm_storeu_si128((__m128i *)(D + I), loadDecrypted(S + I, Mask));
+#endif
+    for (; I < N; ++I)
+      D[I] = S[I] ^ maskByte(Phase, I);
+    return;
+  }
+
+  /* D overlaps the tail of S, copy backwards. Block starts stay congruent to
+     N mod 16, so the mask pattern is rotated to match. */
+  I = N;
+#ifdef __SSE2__
+  __m128i Mask = _mm_set1_epi64x(phaseMask(Phase, (const void *)(N & 7)));
+  for (; I >= 16; I -= 16)
+    _mm_storeu_si128((__m128i *)(D + I - 16), loadDecrypted(S + I - 16, Mask));
+#endif
+  while (I) {
+    --I;
+    D[I] = S[I] ^ maskByte(Phase, I);
+  }
+}
+
+void *drrt_vec_memmove(void *D, const void *S, size_t N, mask_t MRet,
+                       mask_t MD, mask_t MS) {
+  (void)MRet;
+  moveReencrypted(D, S, N, phaseMask(MD, D), phaseMask(MS, S));
+  return D;
+}
+
+char *drrt_vec_strcpy(char *D, const char *S, mask_t MRet, mask_t MD,
+                      mask_t MS) {
+  (void)MRet;
+  size_t N = drrt_vec_strlen(S, MS) + 1;
+  moveReencrypted((unsigned char *)D, (const unsigned char *)S, N,
+                  phaseMask(MD, D), phaseMask(MS, S));
+  return D;
+}
@@ -0,0 +1,116 @@
+/*===- RBuff.c - Shared-memory cross-check transport ----------------------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "RBuff.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define RBUFF_SIZE (1 << 16)
+#define RBUFF_MAGIC 0x7262756666ULL
+
+typedef struct {
+  volatile uint64_t Magic;
+  pthread_mutex_t Lock;
+  pthread_cond_t NotFull;
+  pthread_cond_t NotEmpty;
+  uint64_t Head; /* Next value written by the leader. */
+  uint64_t Tail; /* Next value verified by the follower. */
+  uint64_t Values[RBUFF_SIZE];
+} RBuff;
+
+static RBuff *Ring;
+static int IsLeader;
+
+static void fatal(const char *Msg) {
+  perror(Msg);
+  abort();
+}
+
+static void initRing(void) {
+  pthread_mutexattr_t MA;
+  pthread_condattr_t CA;
+
+  pthread_mutexattr_init(&MA);
+  pthread_mutexattr_setpshared(&MA, PTHREAD_PROCESS_SHARED);
+  pthread_mutex_init(&Ring->Lock, &MA);
+  pthread_condattr_init(&CA);
+  pthread_condattr_setpshared(&CA, PTHREAD_PROCESS_SHARED);
+  pthread_cond_init(&Ring->NotFull, &CA);
+  pthread_cond_init(&Ring->NotEmpty, &CA);
+  Ring->Head = Ring->Tail = 0;
+  __atomic_store_n(&Ring->Magic, RBUFF_MAGIC, __ATOMIC_RELEASE);
+}
+
+int rbuffInit(void) {
+  const char *Name = getenv("CROSSCHECK_SHM");
+  const char *Role = getenv("CROSSCHECK_ROLE");
+  void *Mem;
+  int FD;
+
+  if (!Name)
+    return 0;
+  IsLeader = Role && !strcmp(Role, "leader");
+
+  if (IsLeader) {
+    shm_unlink(Name);
+    FD = shm_open(Name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (FD < 0 || ftruncate(FD, sizeof(RBuff)) < 0)
+      fatal("crosscheck: cannot create CROSSCHECK_SHM");
+  } else {
+    /* The leader may not have started yet. */
+    while ((FD = shm_open(Name, O_RDWR, 0600)) < 0)
+      usleep(1000);
+  }
+
+  Mem = mmap(0, sizeof(RBuff), PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
+  close(FD);
+  if (Mem == MAP_FAILED)
+    fatal("crosscheck: cannot map CROSSCHECK_SHM");
+  Ring = Mem;
+
+  if (IsLeader)
+    initRing();
+  else
+    while (__atomic_load_n(&Ring->Magic, __ATOMIC_ACQUIRE) != RBUFF_MAGIC)
+      usleep(1000);
+  return 1;
+}
+
+void rbuffTransfer(const uint64_t *Values, size_t Count) {
+  size_t I;
+
+  pthread_mutex_lock(&Ring->Lock);
+  for (I = 0; I != Count; ++I) {
+    if (IsLeader) {
+      while (Ring->Head - Ring->Tail == RBUFF_SIZE)
+        pthread_cond_wait(&Ring->NotFull, &Ring->Lock);
+      Ring->Values[Ring->Head++ % RBUFF_SIZE] = Values[I];
+      pthread_cond_signal(&Ring->NotEmpty);
+    } else {
+      uint64_t Expected;
+      while (Ring->Tail == Ring->Head)
+        pthread_cond_wait(&Ring->NotEmpty, &Ring->Lock);
+      Expected = Ring->Values[Ring->Tail % RBUFF_SIZE];
+      if (Expected != Values[I]) {
+        fprintf(stderr, "crosscheck: divergence at value %" PRIu64
+                ": leader %016" PRIx64 ", follower %016" PRIx64 "\n",
+                Ring->Tail, Expected, Values[I]);
+        abort();
+      }
+      ++Ring->Tail;
+      pthread_cond_signal(&Ring->NotFull);
+    }
+  }
+  pthread_mutex_unlock(&Ring->Lock);
+}
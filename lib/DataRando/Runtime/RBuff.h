@@ -0,0 +1,30 @@
+/*===- RBuff.h - Shared-memory cross-check transport ----------------------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* A stand-in for the Raven rbuff ring buffer. Two processes running the same
+|* program attach to the POSIX shared memory object named by CROSSCHECK_SHM.
+|* The one started with CROSSCHECK_ROLE=leader publishes its cross-check
+|* values, the follower compares its own values against them and aborts on
+|* the first mismatch.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#ifndef LLVM_DATARANDO_RUNTIME_RBUFF_H
+#define LLVM_DATARANDO_RUNTIME_RBUFF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Attach to the shared ring buffer if CROSSCHECK_SHM is set. Returns nonzero
+   if values should be passed to rbuffTransfer(). */
+int rbuffInit(void);
+
+/* Publish (leader) or verify (follower) a batch of values. The caller must
+   serialize calls. */
+void rbuffTransfer(const uint64_t *Values, size_t Count);
+
+#endif /* LLVM_DATARANDO_RUNTIME_RBUFF_H */
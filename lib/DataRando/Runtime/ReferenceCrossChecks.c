@@ -0,0 +1,103 @@
+/*===- ReferenceCrossChecks.c - Reference cross-checking runtime ---------===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* A stand-in for the variant monitor runtime. Every cross-checked value is
+|* appended to the file named by CROSSCHECK_LOG, so the logs of two variants
+|* can be compared offline, and, if CROSSCHECK_SHM is set, exchanged with a
+|* second process through the shared-memory ring buffer in RBuff.c. It is used
+|* to validate the instrumentation and to measure its cost on a single
+|* machine; it provides no security.
+|*
+|* Buffered data checks of a thread that exits without reaching a sync point
+|* are not verified.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/DataRando/Runtime/CrossChecks.h"
+#include "RBuff.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+__thread uint64_t __crosscheck_hash_state;
+__thread uint64_t __crosscheck_buffer[CROSSCHECK_BUFFER_SIZE];
+__thread uint64_t __crosscheck_buffer_pos;
+
+static FILE *LogFile;
+static int UseRBuff;
+static pthread_once_t LogOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t LogLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t NumChecks;
+static uint64_t NumHashChecks;
+static uint64_t NumFlushes;
+
+static void printStats(void) {
+  __crosscheckFlush();
+  if (getenv("CROSSCHECK_STATS"))
+    fprintf(stderr, "crosscheck: %" PRIu64 " checks, %" PRIu64
+            " hash checks, %" PRIu64 " flushes\n", NumChecks, NumHashChecks,
+            NumFlushes);
+  if (LogFile)
+    fflush(LogFile);
+}
+
+static void openLog(void) {
+  const char *Path = getenv("CROSSCHECK_LOG");
+  if (Path && !(LogFile = fopen(Path, "w")))
+    perror("crosscheck: cannot open CROSSCHECK_LOG");
+  UseRBuff = rbuffInit();
+  atexit(printStats);
+}
+
+static void record(char Kind, const uint64_t *Values, size_t Count) {
+  size_t I;
+
+  pthread_once(&LogOnce, openLog);
+  pthread_mutex_lock(&LogLock);
+  if (Kind == 'h')
+    NumHashChecks += Count;
+  else
+    NumChecks += Count;
+  if (LogFile)
+    for (I = 0; I != Count; ++I)
+      fprintf(LogFile, "%c %016" PRIx64 "\n", Kind, Values[I]);
+  if (UseRBuff)
+    rbuffTransfer(Values, Count);
+  pthread_mutex_unlock(&LogLock);
+}
+
+/* Synchronous check: the value is verified before the program continues. */
+void __crosscheck(uintptr_t value) {
+  uint64_t Value = value;
+  __crosscheckFlush();
+  record('d', &Value, 1);
+}
+
+void __crosscheckFlush(void) {
+  if (!__crosscheck_buffer_pos)
+    return;
+  record('d', __crosscheck_buffer, __crosscheck_buffer_pos);
+  __crosscheck_buffer_pos = 0;
+  __atomic_fetch_add(&NumFlushes, 1, __ATOMIC_RELAXED);
+}
+
+void __crosscheckObject(void *object) {
+  uint64_t Value = (uintptr_t)object;
+  record('o', &Value, 1);
+}
+
+void __crosscheckHashObject(void *object) {
+  __crosscheck_hash_state =
+      __crosscheck_hash_update(__crosscheck_hash_state, (uintptr_t)object);
+}
+
+void __crosscheckHash(void) {
+  record('h', &__crosscheck_hash_state, 1);
+  __crosscheck_hash_state = 0;
+}
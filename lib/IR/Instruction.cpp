@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Instruction.h"
+#include "LLVMContextImpl.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
@@ -47,6 +48,8 @@ Instruction::~Instruction() {
   assert(!Parent && "Instruction still linked in the program!");
   if (hasMetadataHashEntry())
     clearMetadataHashEntries();
+  if (hasTrapInfo())
+    getContext().pImpl->InstructionTrapInfo.erase(this);
 }
 
 
@@ -54,6 +57,24 @@ void Instruction::setParent(BasicBlock *P) {
   Parent = P;
 }
 
+void Instruction::setTrapInfo(const TrapInfo &Info) {
+  auto &InstructionTrapInfo = getContext().pImpl->InstructionTrapInfo;
+  if (Info.isUnknown()) {
+    if (hasTrapInfo())
+      InstructionTrapInfo.erase(this);
+    setHasTrapInfo(false);
+    return;
+  }
+
+  InstructionTrapInfo[this] = Info;
+  setHasTrapInfo(true);
+}
+
+TrapInfo Instruction::getTrapInfoImpl() const {
+  assert(hasTrapInfo() && "Instruction has no trap information");
+  return getContext().pImpl->InstructionTrapInfo.lookup(this);
+}
+
 const Module *Instruction::getModule() const {
   return getParent()->getModule();
 }
@@ -993,6 +993,9 @@ public:
   /// Collection of per-function metadata used in this context.
   DenseMap<const Function *, MDAttachmentMap> FunctionMetadata;
 
+  /// Collection of per-instruction trap information used in this context.
+  DenseMap<const Instruction *, TrapInfo> InstructionTrapInfo;
+
   /// DiscriminatorTable - This table maps file:line locations to an
   /// integer representing the next DWARF path discriminator to assign to
   /// instructions in different blocks at the same location.
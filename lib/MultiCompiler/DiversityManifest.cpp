@@ -0,0 +1,179 @@
+//===- DiversityManifest.cpp - Record of diversification decisions -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the encoding of the diversity manifest.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/MultiCompiler/DiversityManifest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+
+using namespace llvm;
+
+namespace multicompiler {
+
+cl::opt<bool>
+DiversityManifestEnabled("diversity-manifest",
+                         cl::desc("Record the decisions of the diversifying "
+                                  "transformations in the "
+                                  ".multicompiler_manifest section"),
+                         cl::init(false));
+
+static const char Magic[] = {'M', 'C', 'D', 'M'};
+static const uint32_t Version = 1;
+
+StringRef getDecisionKindName(DecisionKind Kind) {
+  switch (Kind) {
+  case DK_NOPInsertion:   return "nop-insertion";
+  case DK_MOVToLEA:       return "mov-to-lea";
+  case DK_EquivSubst:     return "equiv-subst";
+  case DK_RegisterOrder:  return "register-order";
+  case DK_StackLayout:    return "stack-layout";
+  case DK_GlobalLayout:   return "global-layout";
+  case DK_FunctionLayout: return "function-layout";
+  case DK_Trampolines:    return "trampolines";
+  case DK_NumKinds:       break;
+  }
+  return "unknown";
+}
+
+uint64_t getManifestNameHash(StringRef Name) {
+  return MD5Hash(Name);
+}
+
+DecisionRecord &DiversityManifest::addRecord(DecisionKind Kind,
+                                             StringRef Function) {
+  Records.emplace_back(Kind, Function);
+  return Records.back();
+}
+
+static void writeString(StringRef S, raw_ostream &OS) {
+  encodeULEB128(S.size(), OS);
+  OS << S;
+}
+
+void DiversityManifest::write(raw_ostream &OS) const {
+  SmallString<256> Body;
+  raw_svector_ostream BOS(Body);
+  encodeULEB128(Seed, BOS);
+  writeString(ModuleID, BOS);
+  encodeULEB128(Records.size(), BOS);
+  for (const DecisionRecord &R : Records) {
+    encodeULEB128(R.Kind, BOS);
+    writeString(R.Function, BOS);
+    encodeULEB128(R.Values.size(), BOS);
+    for (uint64_t V : R.Values)
+      encodeULEB128(V, BOS);
+  }
+
+  OS.write(Magic, sizeof(Magic));
+  support::endian::Writer<support::little> W(OS);
+  W.write<uint32_t>(Version);
+  W.write<uint32_t>(Body.size());
+  OS << Body;
+}
+
+namespace {
+// Bounds-checked reader of one encoded manifest.
+class ManifestReader {
+  const uint8_t *P, *End;
+
+public:
+  ManifestReader(StringRef Data)
+      : P(Data.bytes_begin()), End(Data.bytes_end()) {}
+
+  bool atEnd() const { return P == End; }
+
+  bool readULEB(uint64_t &V) {
+    V = 0;
+    for (unsigned Shift = 0; P != End && Shift < 64; Shift += 7) {
+      uint8_t Byte = *P++;
+      V |= uint64_t(Byte & 0x7f) << Shift;
+      if (!(Byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool readString(std::string &S) {
+    uint64_t Size;
+    if (!readULEB(Size) || Size > uint64_t(End - P))
+      return false;
+    S.assign(reinterpret_cast<const char *>(P), Size);
+    P += Size;
+    return true;
+  }
+};
+}
+
+static bool readManifest(StringRef Body, DiversityManifest &M) {
+  ManifestReader R(Body);
+  uint64_t NumRecords;
+  if (!R.readULEB(M.Seed) || !R.readString(M.ModuleID) ||
+      !R.readULEB(NumRecords))
+    return false;
+  // Every record takes at least three bytes.
+  if (NumRecords > Body.size() / 3)
+    return false;
+  M.Records.reserve(NumRecords);
+  for (uint64_t I = 0; I != NumRecords; ++I) {
+    uint64_t Kind, NumValues;
+    std::string Function;
+    if (!R.readULEB(Kind) || Kind >= DK_NumKinds ||
+        !R.readString(Function) || !R.readULEB(NumValues) ||
+        NumValues > Body.size())
+      return false;
+    DecisionRecord &Rec = M.addRecord(DecisionKind(Kind), Function);
+    Rec.Values.resize(NumValues);
+    for (uint64_t &V : Rec.Values)
+      if (!R.readULEB(V))
+        return false;
+  }
+  return R.atEnd();
+}
+
+bool DiversityManifest::read(StringRef Data,
+                             std::vector<DiversityManifest> &Manifests,
+                             std::string &Error) {
+  const size_t HeaderSize = sizeof(Magic) + 8;
+  while (!Data.empty()) {
+    using namespace support;
+    if (Data.size() < HeaderSize ||
+        memcmp(Data.data(), Magic, sizeof(Magic)) != 0) {
+      Error = "not a diversity manifest";
+      return false;
+    }
+    uint32_t V = endian::read<uint32_t, little, unaligned>(Data.data() + 4);
+    uint32_t Size = endian::read<uint32_t, little, unaligned>(Data.data() + 8);
+    if (V != Version) {
+      Error = ("unsupported diversity manifest version " + Twine(V)).str();
+      return false;
+    }
+    if (Size > Data.size() - HeaderSize) {
+      Error = "truncated diversity manifest";
+      return false;
+    }
+    Manifests.emplace_back();
+    if (!readManifest(Data.substr(HeaderSize, Size), Manifests.back())) {
+      Error = "malformed diversity manifest";
+      return false;
+    }
+    Data = Data.drop_front(HeaderSize + Size);
+  }
+  return true;
+}
+
+}
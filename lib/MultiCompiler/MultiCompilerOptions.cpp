@@ -9,11 +9,19 @@
 *===----------------------------------------------------------------------===*/
 
 #include "llvm/MultiCompiler/MultiCompilerOptions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Regex.h"
-#include "llvm/ADT/SmallVector.h"
-#include <fstream>
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+#include <cstring>
+#include <memory>
 #include <string>
+#include <tuple>
+#include <vector>
 
 using namespace llvm;
 
@@ -82,6 +90,11 @@ ReverseGlobals("reverse-globals",
                llvm::cl::desc("Reverse the layout of global variables"),
                llvm::cl::init(false));
 
+llvm::cl::opt<bool>
+InternalCommonPadding("internal-common-padding",
+                      llvm::cl::desc("Pad common globals with internal rather than common padding"),
+                      llvm::cl::init(false), llvm::cl::Hidden);
+
 llvm::cl::opt<int>
 PreRARandomizerRange("pre-RA-randomizer-range",
                         llvm::cl::desc("Pre-RA instruction randomizer probability range; -1 for shuffle"),
@@ -122,6 +135,16 @@ RandomizeFunctionList("randomize-function-list",
                        llvm::cl::desc("Permute the function list"),
                        llvm::cl::init(false));
 
+llvm::cl::opt<bool>
+ShuffleFunctionSections("shuffle-function-sections",
+                        llvm::cl::desc("Emit each function into a .text.shuffle section for the linker to permute"),
+                        llvm::cl::init(false));
+
+llvm::cl::opt<bool>
+LoadTimeFunctionPermutation("load-time-function-permutation",
+                            llvm::cl::desc("Emit the metadata needed to permute local functions at program startup"),
+                            llvm::cl::init(false));
+
 llvm::cl::opt<unsigned int>
 FunctionAlignment("align-functions",
                      llvm::cl::desc("Specify alignment of functions as log2(align)"),
@@ -162,67 +185,208 @@ FunctionOptionsFile("function-options-file",
                        llvm::cl::desc("File to read per-function options from"),
                        llvm::cl::init("function-options.txt"));
 
-// FIXME: read&store this with a LLVM Pass
-typedef StringMap<StringMap<std::string> > FunctionOptionMap;
-static FunctionOptionMap *funcOptMap = NULL;
+namespace {
+// The parsed contents of -function-options-file. Each entry is a function
+// pattern followed by option settings:
+//
+//   main {
+//   nop-insertion-percentage=10
+//   }
+//   parse_* {
+//   shuffle-stack-frames=1
+//   }
+//   /^(read|write)_[a-z]+$/ {
+//   max-stack-pad-size=32
+//   }
+//
+// A pattern is a function name, a glob if it contains any of "*?[", or a
+// regular expression between slashes. Values are parsed when the file is
+// read and kept as the attribute strings to attach.
+class FunctionOptionTable {
+  struct Entry {
+    std::string Pattern;
+    std::unique_ptr<Regex> Matcher;
+    // Attribute name and canonical value of every setting.
+    std::vector<std::pair<std::string, std::string> > Settings;
+  };
+
+  std::vector<Entry> Entries;
+  // Entries for plain function names.
+  StringMap<unsigned> Names;
+  // All glob and regex patterns, so functions that match none of them are
+  // rejected with a single match.
+  std::unique_ptr<Regex> AnyPattern;
+
+  bool parseHeader(StringRef Line, Entry &E, std::string &RE,
+                   std::string &Error);
+  bool parseSetting(StringRef Line, Entry &E, std::string &Error);
+
+public:
+  FunctionOptionTable(StringRef FileName);
+
+  void apply(Function &F) const;
+};
+}
+
+static std::string globToRegex(StringRef Glob) {
+  std::string RE;
+  bool InBracket = false;
+  for (char C : Glob) {
+    if (InBracket) {
+      RE += C;
+      InBracket = C != ']';
+    } else if (C == '*') {
+      RE += ".*";
+    } else if (C == '?') {
+      RE += '.';
+    } else if (C == '[') {
+      RE += C;
+      InBracket = true;
+    } else {
+      if (strchr("()^$|+.{}\\", C))
+        RE += '\\';
+      RE += C;
+    }
+  }
+  return RE;
+}
+
+bool FunctionOptionTable::parseHeader(StringRef Line, Entry &E,
+                                      std::string &RE, std::string &Error) {
+  if (!Line.endswith("{")) {
+    Error = "expected '<pattern> {'";
+    return false;
+  }
+  StringRef Pattern = Line.drop_back().rtrim();
+  if (Pattern.empty()) {
+    Error = "missing function pattern";
+    return false;
+  }
+  E.Pattern = Pattern;
 
+  if (Pattern.size() > 1 && Pattern.startswith("/") && Pattern.endswith("/"))
+    RE = Pattern.slice(1, Pattern.size() - 1);
+  else if (Pattern.find_first_of("*?[") != StringRef::npos)
+    RE = "^" + globToRegex(Pattern) + "$";
+  else
+    return true;
 
-void readFunctionOptions() {
-  if (funcOptMap != NULL)
-    return;
+  E.Matcher.reset(new Regex(RE));
+  return E.Matcher->isValid(Error);
+}
 
-  assert(UseFunctionOptions && "Trying to read function options when disabled");
-  funcOptMap = new FunctionOptionMap();
-  std::ifstream file(FunctionOptionsFile.c_str());
-  if (!file.is_open()) {
-    llvm::errs() << "Error: couldn't open per-function options file\n";
+bool FunctionOptionTable::parseSetting(StringRef Line, Entry &E,
+                                       std::string &Error) {
+  StringRef Name, Value;
+  std::tie(Name, Value) = Line.split('=');
+  Name = Name.trim();
+  Value = Value.trim();
+  if (Name.empty() || Value.empty()) {
+    Error = "expected '<option>=<value>'";
+    return false;
+  }
+  if (!cl::getRegisteredOptions().count(Name)) {
+    Error = ("unknown option '" + Name + "'").str();
+    return false;
+  }
+
+  // Every per-function option is an integer or a boolean.
+  int64_t Val;
+  if (Value == "true")
+    Val = 1;
+  else if (Value == "false")
+    Val = 0;
+  else if (Value.getAsInteger(0, Val)) {
+    Error = ("invalid value '" + Value + "' for " + Name).str();
+    return false;
+  }
+  E.Settings.push_back(
+      std::make_pair(getFunctionOptionAttrName(Name), itostr(Val)));
+  return true;
+}
+
+FunctionOptionTable::FunctionOptionTable(StringRef FileName) {
+  ErrorOr<std::unique_ptr<MemoryBuffer> > BufOrErr =
+      MemoryBuffer::getFile(FileName);
+  if (std::error_code EC = BufOrErr.getError()) {
+    llvm::errs() << "Error: couldn't open per-function options file "
+                 << FileName << ": " << EC.message() << "\n";
     return;
   }
 
-  llvm::Regex funcRE("([_a-zA-Z0-9]+)[ \\t\\n\\f\\r]*{");
-  llvm::Regex optRE("([-a-zA-Z]+)=([0-9]+)");
-  llvm::Regex endRE("}");
-  std::string line;
-  llvm::SmallVector<llvm::StringRef, 4> matches;
-  while (!file.eof()) {
-    getline(file, line);
-    if (funcRE.match(line, &matches)) {
-      std::string funcName = matches[1];
-      for (;;) {
-        if (file.eof()) {
-          llvm::errs() << "Error: function options reached end of file\n";
-          break;
-        }
-        getline(file, line);
-        if (endRE.match(line)) {
-          break;
-        }
-        if (optRE.match(line)) {
-          // FIXME: regex doesn't work correctly
-          size_t eqPos = line.find_first_of('=');
-          std::string optName = line.substr(0, eqPos);
-          std::string optVal  = line.substr(eqPos + 1, line.length() - eqPos - 1);
-          // FIXME: check if option is valid
-          (*funcOptMap)[funcName][optName] = optVal;
-        }
-        // Ignore everything else
+  std::string Patterns;
+  bool InEntry = false;
+  for (line_iterator I(**BufOrErr, /*SkipBlanks=*/true, '#'); !I.is_at_eof();
+       ++I) {
+    StringRef Line = I->trim();
+    std::string Error;
+    if (!InEntry) {
+      Entry E;
+      std::string RE;
+      if (!parseHeader(Line, E, RE, Error)) {
+        llvm::errs() << "Error: " << FileName << ":" << I.line_number()
+                     << ": " << Error << "\n";
+        // Skip the settings of the bad entry.
+        InEntry = Line.endswith("{");
+        Entries.push_back(Entry());
+        continue;
       }
+      if (E.Matcher) {
+        if (!Patterns.empty())
+          Patterns += '|';
+        Patterns += "(" + RE + ")";
+      } else {
+        Names.insert(std::make_pair(E.Pattern, Entries.size()));
+      }
+      Entries.push_back(std::move(E));
+      InEntry = true;
+    } else if (Line == "}") {
+      InEntry = false;
+    } else if (!Entries.back().Pattern.empty() &&
+               !parseSetting(Line, Entries.back(), Error)) {
+      llvm::errs() << "Error: " << FileName << ":" << I.line_number() << ": "
+                   << Error << "\n";
     }
   }
-  file.close();
+  if (InEntry)
+    llvm::errs() << "Error: function options reached end of file\n";
+
+  if (!Patterns.empty())
+    AnyPattern.reset(new Regex(Patterns));
 }
 
-bool findFunctionOption(const Function &Fn, StringRef OptName, StringRef &Val) {
-  readFunctionOptions();
-  FunctionOptionMap::const_iterator FnI = funcOptMap->find(Fn.getName());
-  if (FnI == funcOptMap->end())
-    return false;
-  StringMap<std::string>::const_iterator OptI = FnI->second.find(OptName);
-  if (OptI == FnI->second.end())
-    return false;
+void FunctionOptionTable::apply(Function &F) const {
+  auto Add = [&F](const Entry &E) {
+    for (const auto &Setting : E.Settings)
+      if (!F.hasFnAttribute(Setting.first))
+        F.addFnAttr(Setting.first, Setting.second);
+  };
+
+  // The entry for the exact name comes first, then every matching pattern
+  // in file order. Earlier settings win.
+  StringRef Name = F.getName();
+  auto I = Names.find(Name);
+  if (I != Names.end())
+    Add(Entries[I->second]);
+  if (!AnyPattern || !AnyPattern->match(Name))
+    return;
+  for (const Entry &E : Entries)
+    if (E.Matcher && E.Matcher->match(Name))
+      Add(E);
+}
 
-  Val = OptI->second;
-  return true;
+void applyFunctionOptions(Module &M) {
+  if (!UseFunctionOptions)
+    return;
+
+  static const FunctionOptionTable Table(FunctionOptionsFile);
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Table.apply(F);
+}
+
+std::string getFunctionOptionAttrName(StringRef OptName) {
+  return (Twine(FunctionOptionAttrPrefix) + OptName).str();
 }
 
 }
@@ -0,0 +1,720 @@
+/*===- FunctionPermutation.c - Load-time function permutation runtime -----===*\
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* Permutes the functions of a position-independent executable compiled with
+|* -load-time-function-permutation before any initializer runs. Each module's
+|* record in the multicompiler_fperm section (see
+|* lib/CodeGen/AsmPrinter/FunctionPermutationHandler.cpp) describes the slots
+|* of its .text.fperm section and the pc-relative displacements of its code.
+|* The runtime shuffles the slots of every module, rewrites the displacements,
+|* the dynamically relocated pointers into moved code, the FDE addresses of
+|* .eh_frame and the .eh_frame_hdr search table. Jump tables and LSDAs are
+|* relative to their function and move with it.
+|*
+|* Environment:
+|*   MULTICOMPILER_FPERM_SEED  permute with this seed instead of a random one
+|*   MULTICOMPILER_FPERM_MAP   write the layout to this file, one line per
+|*                             slot: linked address, runtime address minus
+|*                             the load bias, and size, in hex. The
+|*                             fperm-symbolize.py script uses it to map
+|*                             addresses back to the debug info.
+|*
+|* The code segment is writable and executable while the runtime runs, so
+|* systems that enforce W^X for mappings reject it.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <elf.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define FPERM_VERSION 1
+#define FPERM_HEADER_WORDS 7
+
+#define DW_EH_PE_omit 0xff
+#define DW_EH_PE_absptr 0x00
+#define DW_EH_PE_uleb128 0x01
+#define DW_EH_PE_udata2 0x02
+#define DW_EH_PE_udata4 0x03
+#define DW_EH_PE_udata8 0x04
+#define DW_EH_PE_sleb128 0x09
+#define DW_EH_PE_sdata2 0x0a
+#define DW_EH_PE_sdata4 0x0b
+#define DW_EH_PE_sdata8 0x0c
+#define DW_EH_PE_pcrel 0x10
+#define DW_EH_PE_datarel 0x30
+
+#ifndef DT_RELRSZ
+#define DT_RELRSZ 35
+#define DT_RELR 36
+#endif
+
+/* Referenced by every record so that the linker pulls in this file. */
+__attribute__((visibility("hidden"))) const char __multicompiler_fperm_runtime = 0;
+
+extern const uint32_t __start_multicompiler_fperm[] __attribute__((weak));
+extern const uint32_t __stop_multicompiler_fperm[] __attribute__((weak));
+
+typedef struct {
+  uintptr_t Begin;
+  uint32_t Size;
+  uint32_t NumSlots;
+  const uint32_t *OldOffsets;
+  uint32_t *NewOffsets;
+  uint32_t NumFixups;
+  const uint32_t *Fixups;
+  unsigned char *Copy;
+} Region;
+
+typedef struct {
+  uintptr_t Location;
+  int32_t Value;
+} Patch;
+
+static Region *Regions;
+static size_t NumRegions;
+
+/* The executable, as found by dl_iterate_phdr. */
+static uintptr_t Bias;
+static const ElfW(Phdr) *Phdrs;
+static size_t NumPhdrs;
+
+static uint64_t RandomState;
+
+/* The environment passed to the preinit function. environ is not set up yet
+   when it runs. */
+static char **Environment;
+
+static void fatal(const char *Msg) {
+  fprintf(stderr, "fperm: %s\n", Msg);
+  abort();
+}
+
+static void *xmalloc(size_t Size) {
+  void *P = malloc(Size ? Size : 1);
+  if (!P)
+    fatal("out of memory");
+  return P;
+}
+
+static const char *lookupEnv(const char *Name) {
+  size_t Length = strlen(Name);
+  char **E;
+
+  for (E = Environment; E && *E; ++E)
+    if (!strncmp(*E, Name, Length) && (*E)[Length] == '=')
+      return *E + Length + 1;
+  return NULL;
+}
+
+/*===-- Randomness --------------------------------------------------------===*/
+
+static void seedRandom(void) {
+  const char *Seed = lookupEnv("MULTICOMPILER_FPERM_SEED");
+  int Fd;
+
+  if (Seed) {
+    RandomState = strtoull(Seed, NULL, 0);
+    return;
+  }
+#ifdef SYS_getrandom
+  if (syscall(SYS_getrandom, &RandomState, sizeof(RandomState), 0) ==
+      sizeof(RandomState))
+    return;
+#endif
+  Fd = open("/dev/urandom", O_RDONLY);
+  if (Fd >= 0 && read(Fd, &RandomState, sizeof(RandomState)) ==
+                     sizeof(RandomState)) {
+    close(Fd);
+    return;
+  }
+  fatal("no source of randomness");
+}
+
+/* splitmix64 */
+static uint64_t nextRandom(void) {
+  uint64_t Z = (RandomState += 0x9e3779b97f4a7c15ULL);
+  Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  Z = (Z ^ (Z >> 27)) * 0x94d049bb133111ebULL;
+  return Z ^ (Z >> 31);
+}
+
+/*===-- Metadata ----------------------------------------------------------===*/
+
+/* Resolve a 32-bit pc-relative word of the metadata. */
+static uintptr_t resolvePCRel(const uint32_t *Word) {
+  return (uintptr_t)Word + (intptr_t)(int32_t)*Word;
+}
+
+static uint32_t slotEnd(const Region *R, uint32_t I) {
+  return I + 1 == R->NumSlots ? R->Size : R->OldOffsets[I + 1];
+}
+
+/* Parse and validate every record. */
+static void readRecords(void) {
+  const uint32_t *P;
+  size_t N = 0;
+
+  for (P = __start_multicompiler_fperm; P < __stop_multicompiler_fperm;
+       P += FPERM_HEADER_WORDS + P[5] + 2 * P[6]) {
+    if (__stop_multicompiler_fperm - P < FPERM_HEADER_WORDS)
+      fatal("truncated metadata");
+    if (P[0] != FPERM_VERSION)
+      fatal("metadata version mismatch");
+    ++N;
+  }
+  if (P != __stop_multicompiler_fperm)
+    fatal("truncated metadata");
+
+  Regions = xmalloc(N * sizeof(Region));
+  for (P = __start_multicompiler_fperm; P < __stop_multicompiler_fperm;
+       P += FPERM_HEADER_WORDS + P[5] + 2 * P[6]) {
+    Region *R = &Regions[NumRegions++];
+    uint32_t Align = P[1], I;
+
+    R->Begin = resolvePCRel(&P[3]);
+    R->Size = P[4];
+    R->NumSlots = P[5];
+    R->NumFixups = P[6];
+    R->OldOffsets = P + FPERM_HEADER_WORDS;
+    R->Fixups = R->OldOffsets + R->NumSlots;
+    if (Align >= 16 || R->Size & ((1u << Align) - 1) || !R->NumSlots ||
+        R->OldOffsets[0] != 0)
+      fatal("malformed metadata");
+    for (I = 0; I != R->NumSlots; ++I)
+      if (slotEnd(R, I) <= R->OldOffsets[I] ||
+          R->OldOffsets[I] & ((1u << Align) - 1))
+        fatal("malformed metadata");
+    for (I = 0; I != R->NumFixups; ++I)
+      if (R->Fixups[2 * I + 1] < 4 || R->Fixups[2 * I + 1] > 12)
+        fatal("malformed metadata");
+  }
+}
+
+/* Pick a random order for the slots of a region and compute where each slot
+   lands. */
+static void permute(Region *R) {
+  uint32_t *Order = xmalloc(R->NumSlots * sizeof(uint32_t));
+  uint32_t I, Offset = 0;
+
+  for (I = 0; I != R->NumSlots; ++I)
+    Order[I] = I;
+  for (I = R->NumSlots; I > 1; --I) {
+    uint32_t J = nextRandom() % I, T = Order[I - 1];
+    Order[I - 1] = Order[J];
+    Order[J] = T;
+  }
+
+  R->NewOffsets = xmalloc(R->NumSlots * sizeof(uint32_t));
+  for (I = 0; I != R->NumSlots; ++I) {
+    uint32_t Slot = Order[I];
+    R->NewOffsets[Slot] = Offset;
+    Offset += slotEnd(R, Slot) - R->OldOffsets[Slot];
+  }
+  free(Order);
+
+  R->Copy = xmalloc(R->Size);
+  memcpy(R->Copy, (const void *)R->Begin, R->Size);
+}
+
+/* Return the new address of the byte at old address A. */
+static uintptr_t mapAddress(uintptr_t A) {
+  size_t I;
+
+  for (I = 0; I != NumRegions; ++I) {
+    const Region *R = &Regions[I];
+    uint32_t Offset, Lo = 0, Hi = R->NumSlots;
+    if (A - R->Begin >= R->Size)
+      continue;
+    Offset = A - R->Begin;
+    /* Find the last slot starting at or before Offset. */
+    while (Hi - Lo > 1) {
+      uint32_t Mid = Lo + (Hi - Lo) / 2;
+      if (R->OldOffsets[Mid] <= Offset)
+        Lo = Mid;
+      else
+        Hi = Mid;
+    }
+    return R->Begin + R->NewOffsets[Lo] + (Offset - R->OldOffsets[Lo]);
+  }
+  return A;
+}
+
+static int32_t read32(uintptr_t A) {
+  int32_t V;
+  memcpy(&V, (const void *)A, sizeof(V));
+  return V;
+}
+
+static void write32(uintptr_t A, int32_t V) {
+  memcpy((void *)A, &V, sizeof(V));
+}
+
+static int32_t checkedDisplacement(intptr_t D) {
+  if (D != (int32_t)D)
+    fatal("displacement out of range");
+  return (int32_t)D;
+}
+
+/* Compute the new displacement of every fixup from the original code. */
+static Patch *computePatches(size_t *NumPatches) {
+  size_t I, N = 0;
+  Patch *Patches;
+
+  for (I = 0; I != NumRegions; ++I)
+    N += Regions[I].NumFixups;
+  Patches = xmalloc(N * sizeof(Patch));
+
+  N = 0;
+  for (I = 0; I != NumRegions; ++I) {
+    const Region *R = &Regions[I];
+    uint32_t J;
+    for (J = 0; J != R->NumFixups; ++J) {
+      uintptr_t End = resolvePCRel(&R->Fixups[2 * J]);
+      uint32_t Tail = R->Fixups[2 * J + 1];
+      uintptr_t Target = End + read32(End - Tail);
+      /* The end of the last instruction of a slot is the start of the next
+         one, so map the last byte of the instruction instead. */
+      uintptr_t NewEnd = mapAddress(End - 1) + 1;
+      Patches[N].Location = NewEnd - Tail;
+      Patches[N].Value = checkedDisplacement(mapAddress(Target) - NewEnd);
+      ++N;
+    }
+  }
+  *NumPatches = N;
+  return Patches;
+}
+
+/*===-- Dynamic relocations -----------------------------------------------===*/
+
+/* glibc relocates some dynamic entries in place, others stay link-time
+   addresses. */
+static uintptr_t dynamicAddress(ElfW(Addr) A) {
+  return A < Bias ? A + Bias : A;
+}
+
+static void relocatePointer(uintptr_t Location) {
+  uintptr_t V;
+  memcpy(&V, (const void *)Location, sizeof(V));
+  V = mapAddress(V);
+  memcpy((void *)Location, &V, sizeof(V));
+}
+
+static void relocateRela(const ElfW(Rela) *Rela, size_t Size) {
+  const ElfW(Rela) *End = (const ElfW(Rela) *)((const char *)Rela + Size);
+  for (; Rela < End; ++Rela) {
+    unsigned long Type = ELF64_R_TYPE(Rela->r_info);
+    if (Type == R_X86_64_RELATIVE || Type == R_X86_64_IRELATIVE)
+      relocatePointer(Bias + Rela->r_offset);
+  }
+}
+
+static void relocateRelr(const ElfW(Addr) *Relr, size_t Size) {
+  const ElfW(Addr) *End = (const ElfW(Addr) *)((const char *)Relr + Size);
+  uintptr_t Where = 0;
+
+  for (; Relr < End; ++Relr) {
+    ElfW(Addr) Entry = *Relr;
+    unsigned I;
+    if (!(Entry & 1)) {
+      Where = Bias + Entry;
+      relocatePointer(Where);
+      Where += sizeof(ElfW(Addr));
+      continue;
+    }
+    for (I = 0; (Entry >>= 1) != 0; ++I)
+      if (Entry & 1)
+        relocatePointer(Where + I * sizeof(ElfW(Addr)));
+    Where += (8 * sizeof(ElfW(Addr)) - 1) * sizeof(ElfW(Addr));
+  }
+}
+
+static void relocateDynamic(const ElfW(Dyn) *Dyn) {
+  uintptr_t Rela = 0, JmpRel = 0, Relr = 0;
+  size_t RelaSize = 0, JmpRelSize = 0, RelrSize = 0;
+
+  for (; Dyn->d_tag != DT_NULL; ++Dyn) {
+    switch (Dyn->d_tag) {
+    case DT_RELA: Rela = dynamicAddress(Dyn->d_un.d_ptr); break;
+    case DT_RELASZ: RelaSize = Dyn->d_un.d_val; break;
+    case DT_JMPREL: JmpRel = dynamicAddress(Dyn->d_un.d_ptr); break;
+    case DT_PLTRELSZ: JmpRelSize = Dyn->d_un.d_val; break;
+    case DT_RELR: Relr = dynamicAddress(Dyn->d_un.d_ptr); break;
+    case DT_RELRSZ: RelrSize = Dyn->d_un.d_val; break;
+    }
+  }
+  if (Rela)
+    relocateRela((const ElfW(Rela) *)Rela, RelaSize);
+  if (JmpRel)
+    relocateRela((const ElfW(Rela) *)JmpRel, JmpRelSize);
+  if (Relr)
+    relocateRelr((const ElfW(Addr) *)Relr, RelrSize);
+}
+
+/*===-- Exception handling tables -----------------------------------------===*/
+
+static uint64_t readULEB128(const unsigned char **P) {
+  uint64_t V = 0;
+  unsigned Shift = 0;
+  unsigned char Byte;
+  do {
+    Byte = *(*P)++;
+    V |= (uint64_t)(Byte & 0x7f) << Shift;
+    Shift += 7;
+  } while (Byte & 0x80);
+  return V;
+}
+
+static int64_t readSLEB128(const unsigned char **P) {
+  int64_t V = 0;
+  unsigned Shift = 0;
+  unsigned char Byte;
+  do {
+    Byte = *(*P)++;
+    V |= (int64_t)(Byte & 0x7f) << Shift;
+    Shift += 7;
+  } while (Byte & 0x80);
+  if (Shift < 64 && (Byte & 0x40))
+    V |= -((int64_t)1 << Shift);
+  return V;
+}
+
+/* Read an encoded pointer. Returns the size of its fixed-size field, or 0. */
+static unsigned readEncoded(const unsigned char **P, unsigned char Enc,
+                            uintptr_t DataRel, uintptr_t *Result) {
+  const unsigned char *Start = *P;
+  uintptr_t V;
+  unsigned Size = 0;
+
+  switch (Enc & 0x0f) {
+  case DW_EH_PE_absptr:
+  case DW_EH_PE_udata8:
+  case DW_EH_PE_sdata8: {
+    uint64_t U;
+    memcpy(&U, Start, 8);
+    V = U;
+    Size = 8;
+    break;
+  }
+  case DW_EH_PE_udata4: {
+    uint32_t U;
+    memcpy(&U, Start, 4);
+    V = U;
+    Size = 4;
+    break;
+  }
+  case DW_EH_PE_sdata4: {
+    int32_t S;
+    memcpy(&S, Start, 4);
+    V = (intptr_t)S;
+    Size = 4;
+    break;
+  }
+  case DW_EH_PE_udata2: {
+    uint16_t U;
+    memcpy(&U, Start, 2);
+    V = U;
+    Size = 2;
+    break;
+  }
+  case DW_EH_PE_sdata2: {
+    int16_t S;
+    memcpy(&S, Start, 2);
+    V = (intptr_t)S;
+    Size = 2;
+    break;
+  }
+  case DW_EH_PE_uleb128:
+    V = readULEB128(P);
+    break;
+  case DW_EH_PE_sleb128:
+    V = readSLEB128(P);
+    break;
+  default:
+    fatal("unsupported pointer encoding in .eh_frame");
+  }
+  *P += Size;
+
+  switch (Enc & 0x70) {
+  case 0:
+    break;
+  case DW_EH_PE_pcrel:
+    V += (uintptr_t)Start;
+    break;
+  case DW_EH_PE_datarel:
+    V += DataRel;
+    break;
+  default:
+    fatal("unsupported pointer encoding in .eh_frame");
+  }
+  *Result = V;
+  return Size;
+}
+
+/* Return the FDE pointer encoding of a CIE, or DW_EH_PE_omit. */
+static unsigned char fdeEncoding(const unsigned char *CIE) {
+  const unsigned char *P = CIE + 4;
+  const char *Aug;
+  unsigned char Version;
+  uintptr_t Ignored;
+
+  if (*(const uint32_t *)CIE == 0xffffffff)
+    P += 8;
+  P += 4; /* CIE id */
+  Version = *P++;
+  Aug = (const char *)P;
+  P += strlen(Aug) + 1;
+  if (Aug[0] != 'z')
+    return DW_EH_PE_absptr;
+  readULEB128(&P); /* code alignment */
+  readSLEB128(&P); /* data alignment */
+  if (Version == 1)
+    ++P;
+  else
+    readULEB128(&P);
+  readULEB128(&P); /* augmentation length */
+  for (++Aug; *Aug; ++Aug) {
+    switch (*Aug) {
+    case 'R':
+      return *P;
+    case 'L':
+      ++P;
+      break;
+    case 'P': {
+      unsigned char Enc = *P++;
+      readEncoded(&P, Enc & 0x7f, 0, &Ignored);
+      break;
+    }
+    case 'S':
+    case 'B':
+      break;
+    default:
+      return DW_EH_PE_omit;
+    }
+  }
+  return DW_EH_PE_absptr;
+}
+
+/* Point the FDEs of moved functions at their new location. Absolute FDE
+   addresses are dynamically relocated and already handled. */
+static void relocateEHFrame(const unsigned char *P) {
+  for (;;) {
+    uint64_t Length = *(const uint32_t *)P;
+    const unsigned char *Id = P + 4;
+    uint32_t CIEOffset;
+
+    if (Length == 0)
+      return;
+    if (Length == 0xffffffff) {
+      memcpy(&Length, P + 4, 8);
+      Id = P + 12;
+    }
+    CIEOffset = *(const uint32_t *)Id;
+    if (CIEOffset != 0) {
+      unsigned char Enc = fdeEncoding(Id - CIEOffset);
+      if (Enc != DW_EH_PE_omit && (Enc & 0x70) == DW_EH_PE_pcrel) {
+        const unsigned char *Field = Id + 4;
+        uintptr_t Old, New;
+        unsigned Size = readEncoded(&Field, Enc, 0, &Old);
+        Field = Id + 4;
+        New = mapAddress(Old);
+        if (New != Old && Size == 4)
+          write32((uintptr_t)Field,
+                  checkedDisplacement(New - (uintptr_t)Field));
+        else if (New != Old && Size == 8)
+          memcpy((void *)Field, &(uint64_t){New - (uintptr_t)Field}, 8);
+        else if (New != Old)
+          fatal("unsupported FDE address encoding");
+      }
+    }
+    P = Id + Length;
+  }
+}
+
+static int compareTableEntries(const void *A, const void *B) {
+  int32_t X = *(const int32_t *)A, Y = *(const int32_t *)B;
+  return X < Y ? -1 : X > Y;
+}
+
+static void relocateEHFrameHdr(uintptr_t Hdr) {
+  const unsigned char *P = (const unsigned char *)Hdr;
+  unsigned char FrameEnc, CountEnc, TableEnc;
+  uintptr_t Frame, Count, I;
+  int32_t *Table;
+
+  if (P[0] != 1)
+    fatal("unsupported .eh_frame_hdr version");
+  FrameEnc = P[1];
+  CountEnc = P[2];
+  TableEnc = P[3];
+  P += 4;
+  if (FrameEnc == DW_EH_PE_omit)
+    return;
+  readEncoded(&P, FrameEnc, Hdr, &Frame);
+  relocateEHFrame((const unsigned char *)Frame);
+
+  if (CountEnc == DW_EH_PE_omit || TableEnc == DW_EH_PE_omit)
+    return;
+  readEncoded(&P, CountEnc, Hdr, &Count);
+  if (TableEnc != (DW_EH_PE_datarel | DW_EH_PE_sdata4))
+    fatal("unsupported .eh_frame_hdr table encoding");
+  Table = (int32_t *)P;
+  for (I = 0; I != Count; ++I)
+    Table[2 * I] = checkedDisplacement(mapAddress(Hdr + Table[2 * I]) - Hdr);
+  qsort(Table, Count, 2 * sizeof(int32_t), compareTableEntries);
+}
+
+/*===-- Memory protection -------------------------------------------------===*/
+
+static int findExecutable(struct dl_phdr_info *Info, size_t Size, void *Data) {
+  uintptr_t Addr = (uintptr_t)Data;
+  size_t I;
+  (void)Size;
+
+  for (I = 0; I != Info->dlpi_phnum; ++I) {
+    const ElfW(Phdr) *Ph = &Info->dlpi_phdr[I];
+    uintptr_t Start = Info->dlpi_addr + Ph->p_vaddr;
+    if (Ph->p_type == PT_LOAD && Addr - Start < Ph->p_memsz) {
+      Bias = Info->dlpi_addr;
+      Phdrs = Info->dlpi_phdr;
+      NumPhdrs = Info->dlpi_phnum;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int isPositionIndependent(void) {
+  size_t I;
+  for (I = 0; I != NumPhdrs; ++I)
+    if (Phdrs[I].p_type == PT_LOAD && Phdrs[I].p_offset == 0)
+      return ((const ElfW(Ehdr) *)(Bias + Phdrs[I].p_vaddr))->e_type == ET_DYN;
+  return 0;
+}
+
+static int segmentProtection(const ElfW(Phdr) *Ph) {
+  return (Ph->p_flags & PF_R ? PROT_READ : 0) |
+         (Ph->p_flags & PF_W ? PROT_WRITE : 0) |
+         (Ph->p_flags & PF_X ? PROT_EXEC : 0);
+}
+
+/* Make every segment writable, or restore the protection set up by the
+   dynamic loader. RELRO boundaries are rounded down as the loader does. */
+static void protectSegments(int Writable) {
+  uintptr_t PageMask = ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1);
+  size_t I;
+
+  for (I = 0; I != NumPhdrs; ++I) {
+    const ElfW(Phdr) *Ph = &Phdrs[I];
+    uintptr_t Start = (Bias + Ph->p_vaddr) & PageMask, End;
+    int Prot;
+    if (Ph->p_type == PT_LOAD && !(Ph->p_flags & PF_W)) {
+      End = (Bias + Ph->p_vaddr + Ph->p_memsz + ~PageMask) & PageMask;
+      Prot = segmentProtection(Ph) | (Writable ? PROT_WRITE : 0);
+    } else if (Ph->p_type == PT_GNU_RELRO) {
+      End = (Bias + Ph->p_vaddr + Ph->p_memsz) & PageMask;
+      Prot = PROT_READ | (Writable ? PROT_WRITE : 0);
+    } else {
+      continue;
+    }
+    if (End > Start && mprotect((void *)Start, End - Start, Prot))
+      fatal("cannot change memory protection");
+  }
+}
+
+/*===-- Driver ------------------------------------------------------------===*/
+
+static void writeMap(void) {
+  const char *Path = lookupEnv("MULTICOMPILER_FPERM_MAP");
+  FILE *F;
+  size_t I;
+
+  if (!Path)
+    return;
+  if (!(F = fopen(Path, "w"))) {
+    perror("fperm: cannot open MULTICOMPILER_FPERM_MAP");
+    return;
+  }
+  for (I = 0; I != NumRegions; ++I) {
+    const Region *R = &Regions[I];
+    uint32_t J;
+    for (J = 0; J != R->NumSlots; ++J)
+      fprintf(F, "%" PRIxPTR " %" PRIxPTR " %" PRIx32 "\n",
+              R->Begin + R->OldOffsets[J] - Bias,
+              R->Begin + R->NewOffsets[J] - Bias,
+              slotEnd(R, J) - R->OldOffsets[J]);
+  }
+  fclose(F);
+}
+
+static void permuteFunctions(int Argc, char **Argv, char **Envp) {
+  Patch *Patches;
+  size_t NumPatches, I;
+
+  (void)Argc;
+  (void)Argv;
+  Environment = Envp;
+  if (!__start_multicompiler_fperm ||
+      &__start_multicompiler_fperm[0] == &__stop_multicompiler_fperm[0])
+    return;
+  if (!dl_iterate_phdr(findExecutable, (void *)__start_multicompiler_fperm))
+    fatal("cannot find the executable");
+  if (!isPositionIndependent()) {
+    fprintf(stderr, "fperm: not a position-independent executable, functions "
+                    "are not permuted\n");
+    return;
+  }
+
+  readRecords();
+  seedRandom();
+  for (I = 0; I != NumRegions; ++I)
+    permute(&Regions[I]);
+  Patches = computePatches(&NumPatches);
+
+  protectSegments(1);
+  for (I = 0; I != NumRegions; ++I) {
+    const Region *R = &Regions[I];
+    uint32_t J;
+    for (J = 0; J != R->NumSlots; ++J)
+      memcpy((void *)(R->Begin + R->NewOffsets[J]),
+             R->Copy + R->OldOffsets[J], slotEnd(R, J) - R->OldOffsets[J]);
+  }
+  for (I = 0; I != NumPatches; ++I)
+    write32(Patches[I].Location, Patches[I].Value);
+  for (I = 0; I != NumPhdrs; ++I) {
+    if (Phdrs[I].p_type == PT_DYNAMIC)
+      relocateDynamic((const ElfW(Dyn) *)(Bias + Phdrs[I].p_vaddr));
+    else if (Phdrs[I].p_type == PT_GNU_EH_FRAME)
+      relocateEHFrameHdr(Bias + Phdrs[I].p_vaddr);
+  }
+  protectSegments(0);
+
+  writeMap();
+  free(Patches);
+  for (I = 0; I != NumRegions; ++I) {
+    free(Regions[I].NewOffsets);
+    free(Regions[I].Copy);
+  }
+  free(Regions);
+  Regions = NULL;
+  NumRegions = 0;
+}
+
+/* Runs before the initializers, some of which may have been permuted. */
+__attribute__((section(".preinit_array"), used))
+static void (*const PermuteFunctions)(int, char **, char **) =
+    permuteFunctions;
@@ -86,6 +86,10 @@ RandomNumberGenerator::~RandomNumberGenerator() {
   }
 }
 
+uint64_t RandomNumberGenerator::getCommandLineSeed() {
+  return CommandLineSeed;
+}
+
 #if HAVE_OPENSSL
 
 RandomNumberGenerator::RandomNumberGenerator(StringRef Salt) {
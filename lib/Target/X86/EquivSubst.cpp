@@ -13,17 +13,21 @@
 
 #define DEBUG_TYPE "equiv-subst"
 #include "X86.h"
+#include "X86Diversity.h"
 #include "X86InstrBuilder.h"
 #include "X86InstrInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/IR/Module.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
 #include "llvm/MultiCompiler/MultiCompilerOptions.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/RandomNumberGenerator.h"
 #include "llvm/Target/TargetInstrInfo.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 
 using namespace llvm;
@@ -37,8 +41,10 @@ namespace {
 class EquivInsnFilter {
 public:
   virtual bool check(MachineBasicBlock &BB, const MachineInstr &MI) const = 0;
-  virtual void subst(MachineBasicBlock &BB, const TargetInstrInfo *TII,
-                     MachineBasicBlock::iterator I) const = 0;
+  // Substitute the instruction at I and return its replacement.
+  virtual MachineInstr *subst(MachineBasicBlock &BB,
+                              const TargetInstrInfo *TII,
+                              MachineBasicBlock::iterator I) const = 0;
 };
 
 class OpcodeRevFilter : public EquivInsnFilter {
@@ -51,10 +57,12 @@ public:
     return opc == Opc1 || opc == Opc2;
   }
 
-  virtual void subst(MachineBasicBlock &BB, const TargetInstrInfo *TII,
-                     MachineBasicBlock::iterator I) const {
+  virtual MachineInstr *subst(MachineBasicBlock &BB,
+                              const TargetInstrInfo *TII,
+                              MachineBasicBlock::iterator I) const {
     int newOpc = (I->getOpcode() == Opc1) ? Opc2 : Opc1;
     I->setDesc(TII->get(newOpc));
+    return &*I;
   }
 };
 
@@ -70,12 +78,15 @@ public:
            MI.getOpcode() == Opc1;
   }
 
-  virtual void subst(MachineBasicBlock &BB, const TargetInstrInfo *TII,
-                     MachineBasicBlock::iterator I) const {
-    addRegOffset(BuildMI(BB, I, I->getDebugLoc(),
-                         TII->get(Opc2), I->getOperand(0).getReg()),
-                 I->getOperand(1).getReg(), false, 0);
+  virtual MachineInstr *subst(MachineBasicBlock &BB,
+                              const TargetInstrInfo *TII,
+                              MachineBasicBlock::iterator I) const {
+    MachineInstr *NewMI =
+        addRegOffset(BuildMI(BB, I, I->getDebugLoc(),
+                             TII->get(Opc2), I->getOperand(0).getReg()),
+                     I->getOperand(1).getReg(), false, 0);
     I->eraseFromParent();
+    return NewMI;
   }
 };
 
@@ -88,14 +99,17 @@ public:
     return MI.getNumOperands() >= 1 && MI.getOpcode() == Opc1;
   }
 
-  virtual void subst(MachineBasicBlock &BB, const TargetInstrInfo *TII,
-                     MachineBasicBlock::iterator I) const {
+  virtual MachineInstr *subst(MachineBasicBlock &BB,
+                              const TargetInstrInfo *TII,
+                              MachineBasicBlock::iterator I) const {
     unsigned reg32 = getX86SubSuperRegister(I->getOperand(0).getReg(),
                                             MVT::i32);
-    BuildMI(BB, I, I->getDebugLoc(), TII->get(Opc2), reg32)
-      .addReg(reg32, RegState::Kill)
-      .addReg(reg32, RegState::Kill);
+    MachineInstr *NewMI =
+        BuildMI(BB, I, I->getDebugLoc(), TII->get(Opc2), reg32)
+          .addReg(reg32, RegState::Kill)
+          .addReg(reg32, RegState::Kill);
     I->eraseFromParent();
+    return NewMI;
   }
 };
 
@@ -189,37 +203,52 @@ bool EquivSubstPass::runOnMachineFunction(MachineFunction &Fn) {
   if (!RNG)
     RNG.reset(Fn.getFunction()->getParent()->createRNG(this));
 
+  unsigned int Percentage =
+      Fn.getFunctionOption(multicompiler::EquivSubstPercentage);
+  multicompiler::DecisionRecord *Record = nullptr;
+  if (multicompiler::DiversityManifest *Manifest =
+          Fn.getMMI().getDiversityManifest())
+    Record = &Manifest->addRecord(multicompiler::DK_EquivSubst, Fn.getName());
+
   bool Changed = false;
-  std::vector<const EquivInsnFilter*> Candidates;
+  unsigned Site = 0;
   for (MachineFunction::iterator BB = Fn.begin(), E = Fn.end(); BB != E; ++BB)
-    for (MachineBasicBlock::iterator I = BB->begin(); I != BB->end(); ) {
-      ++PreEquivSubstInstructionCount;
-      Candidates.clear();
-      for (size_t i = 0; i < array_lengthof(Filters); i++)
-        if (Filters[i]->check(*BB, *I))
-         Candidates.push_back(Filters[i]);
-      if (Candidates.empty()) {
-        ++I;
-        continue;
-      }
-
-      unsigned int Roll = RNG->Random(100);
-      ++EquivSubstCandidates;
-      if (Roll >= multicompiler::EquivSubstPercentage) {
-        ++I;
-        continue;
-      }
-
-      unsigned int Pick = RNG->Random(Candidates.size());
-      MachineBasicBlock::iterator J = I;
-      ++I;
-      Candidates[Pick]->subst(*BB, TII, J);
-      Changed = true;
-      ++EquivSubstituted;
-    }
+    for (MachineBasicBlock::iterator I = BB->begin(); I != BB->end(); ++I)
+      Changed |= X86Diversity::substituteEquivalent(*BB, I, TII, *RNG,
+                                                    Percentage, Record, Site++);
   return Changed;
 }
 
+bool X86Diversity::substituteEquivalent(MachineBasicBlock &MBB,
+                                        MachineBasicBlock::iterator &I,
+                                        const TargetInstrInfo *TII,
+                                        RandomNumberGenerator &RNG,
+                                        unsigned Percentage,
+                                        multicompiler::DecisionRecord *Record,
+                                        unsigned Site) {
+  ++PreEquivSubstInstructionCount;
+  SmallVector<const EquivInsnFilter *, 4> Candidates;
+  for (size_t i = 0; i < array_lengthof(Filters); i++)
+    if (Filters[i]->check(MBB, *I))
+      Candidates.push_back(Filters[i]);
+  if (Candidates.empty())
+    return false;
+
+  unsigned int Roll = RNG.Random(100);
+  ++EquivSubstCandidates;
+  if (Roll >= Percentage)
+    return false;
+
+  unsigned int Pick = RNG.Random(Candidates.size());
+  I = Candidates[Pick]->subst(MBB, TII, I);
+  ++EquivSubstituted;
+  if (Record) {
+    Record->Values.push_back(Site);
+    Record->Values.push_back(I->getOpcode());
+  }
+  return true;
+}
+
 FunctionPass *llvm::createEquivSubstPass() {
   return new EquivSubstPass();
 }
@@ -13,12 +13,15 @@
 
 #define DEBUG_TYPE "mov-to-lea"
 #include "X86.h"
+#include "X86Diversity.h"
 #include "X86InstrBuilder.h"
 #include "X86InstrInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/IR/Module.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
 #include "llvm/MultiCompiler/MultiCompilerOptions.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/RandomNumberGenerator.h"
@@ -67,45 +70,60 @@ bool MOVToLEAPass::runOnMachineFunction(MachineFunction &Fn) {
      if(!RNG)
        RNG.reset(Fn.getFunction()->getParent()->createRNG(this));
 
+  unsigned int Percentage =
+      Fn.getFunctionOption(multicompiler::MOVToLEAPercentage);
+  multicompiler::DecisionRecord *Record = nullptr;
+  if (multicompiler::DiversityManifest *Manifest =
+          Fn.getMMI().getDiversityManifest())
+    Record = &Manifest->addRecord(multicompiler::DK_MOVToLEA, Fn.getName());
+
   bool Changed = false;
+  unsigned Site = 0;
   for (MachineFunction::iterator BB = Fn.begin(), E = Fn.end(); BB != E; ++BB)
-    for (MachineBasicBlock::iterator I = BB->begin(); I != BB->end(); ) {
-      ++PreMOVtoLEAInstructionCount;
-      if (I->getNumOperands() != 2 ||
-          !I->getOperand(0).isReg() || !I->getOperand(1).isReg()) {
-        ++I;
-        continue;
-      }
-
-      unsigned leaOpc;
-      if (I->getOpcode() == X86::MOV32rr) {
-        leaOpc = X86::LEA32r;
-      } else if (I->getOpcode() == X86::MOV64rr) {
-        leaOpc = X86::LEA64r;
-      } else {
-        ++I;
-        continue;
-      }
-
-      unsigned int Roll = RNG->Random(100);
-      ++MOVCandidates;
-      if (Roll >= multicompiler::MOVToLEAPercentage) {
-        ++I;
-        continue;
-      }
-
-      ++ReplacedMOV;
-      MachineBasicBlock::iterator J = I;
-      ++I;
-      addRegOffset(BuildMI(*BB, J, J->getDebugLoc(),
-                           TII->get(leaOpc), J->getOperand(0).getReg()),
-                   J->getOperand(1).getReg(), false, 0);
-      J->eraseFromParent();
-      Changed = true;
-    }
+    for (MachineBasicBlock::iterator I = BB->begin(); I != BB->end(); ++I)
+      Changed |= X86Diversity::substituteMOVToLEA(*BB, I, TII, *RNG,
+                                                  Percentage, Record, Site++);
   return Changed;
 }
 
+bool X86Diversity::substituteMOVToLEA(MachineBasicBlock &MBB,
+                                      MachineBasicBlock::iterator &I,
+                                      const TargetInstrInfo *TII,
+                                      RandomNumberGenerator &RNG,
+                                      unsigned Percentage,
+                                      multicompiler::DecisionRecord *Record,
+                                      unsigned Site) {
+  ++PreMOVtoLEAInstructionCount;
+  if (I->getNumOperands() != 2 ||
+      !I->getOperand(0).isReg() || !I->getOperand(1).isReg())
+    return false;
+
+  unsigned leaOpc;
+  if (I->getOpcode() == X86::MOV32rr) {
+    leaOpc = X86::LEA32r;
+  } else if (I->getOpcode() == X86::MOV64rr) {
+    leaOpc = X86::LEA64r;
+  } else {
+    return false;
+  }
+
+  unsigned int Roll = RNG.Random(100);
+  ++MOVCandidates;
+  if (Roll >= Percentage)
+    return false;
+
+  ++ReplacedMOV;
+  if (Record)
+    Record->Values.push_back(Site);
+  MachineInstr *LEA =
+      addRegOffset(BuildMI(MBB, I, I->getDebugLoc(),
+                           TII->get(leaOpc), I->getOperand(0).getReg()),
+                   I->getOperand(1).getReg(), false, 0);
+  I->eraseFromParent();
+  I = LEA;
+  return true;
+}
+
 FunctionPass *llvm::createMOVToLEAPass() {
   return new MOVToLEAPass();
 }
@@ -13,6 +13,7 @@
 
 #define DEBUG_TYPE "nop-insertion"
 #include "X86.h"
+#include "X86Diversity.h"
 #include "X86InstrBuilder.h"
 #include "X86InstrInfo.h"
 #include "llvm/ADT/Statistic.h"
@@ -22,6 +23,7 @@
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Module.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
 #include "llvm/MultiCompiler/MultiCompilerOptions.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
@@ -73,7 +75,6 @@ class NOPInsertionPass : public MachineFunctionPass {
   // RNG instance for this pass
   std::unique_ptr<RandomNumberGenerator> RNG;
 
-  void IncrementCounters(int const code);
 public:
   NOPInsertionPass(bool is64Bit_) :
       MachineFunctionPass(ID), is64Bit(is64Bit_) {
@@ -114,7 +115,7 @@ static const unsigned nopRegs[MAX_NOPS][2] = {
     { X86::EDI, X86::RDI },
 };
 
-void NOPInsertionPass::IncrementCounters(int const code) {
+static void IncrementCounters(int const code) {
   ++InsertedInstructions;
   switch(code) {
   case NOP:      ++NumNOPInstructions; break;
@@ -143,107 +144,131 @@ bool NOPInsertionPass::runOnMachineFunction(MachineFunction &Fn) {
     if(!RNG)
       RNG.reset(Fn.getFunction()->getParent()->createRNG(this));
 
+  multicompiler::DecisionRecord *Record = nullptr;
+  if (multicompiler::DiversityManifest *Manifest =
+          Fn.getMMI().getDiversityManifest())
+    Record = &Manifest->addRecord(multicompiler::DK_NOPInsertion,
+                                  Fn.getName());
+
   PreNOPFunctionCount++;
   unsigned int NOPsInserted = 0;
-  int FnProb = multicompiler::getFunctionOption(
-      NOPInsertionPercentage, *Fn.getFunction());
+  unsigned Site = 0;
+  int FnProb = Fn.getFunctionOption(NOPInsertionPercentage);
   for (MachineFunction::iterator BB = Fn.begin(), E = Fn.end(); BB != E; ++BB) {
     PreNOPBasicBlockCount++;
     PreNOPInstructionCount += BB->size();
-    int BBProb = FnProb;
-    if (BB->getBasicBlock()) {
-      BBProb = BB->getBasicBlock()->getNOPInsertionPercentage();
-      if (BBProb == multicompiler::NOPInsertionUnknown)
-        BBProb = FnProb;
-    }
+    int BBProb = X86Diversity::getNOPInsertionPercentage(*BB, FnProb);
     //printf("BB(%p):%d\n", &*BB, BBProb);
-    if (BBProb <= 0)
+    if (BBProb <= 0) {
+      Site += BB->size();
       continue;
+    }
 
-    for (MachineBasicBlock::iterator I = BB->begin(); I != BB->end(); ) {
-      MachineBasicBlock::iterator J = std::next(I);
-      if (I->isPseudo()) {
-        I = J;
-        continue;
-      }
-      unsigned int NumNOPs = MaxNOPsPerInstruction;
-      if (NOPsInserted < EarlyNOPThreshold)
-        NumNOPs = RNG->Random(EarlyNOPMaxCount);
-      for (unsigned int i = 0; i < NumNOPs; i++) {
-        int Roll = RNG->Random(100);
-        if (Roll >= BBProb)
-          continue;
-
-        int NOPCode = RNG->Random(MAX_NOPS);
-
-        // TODO(ahomescu): figure out if we need to preserve kill information
-        MachineInstr *NewMI = NULL;
-        unsigned reg = nopRegs[NOPCode][!!is64Bit];
-        switch (NOPCode) {
-        case NOP:
-          NewMI = BuildMI(*BB, I, I->getDebugLoc(), TII->get(X86::NOOP));
-          NOPsInserted++;
-          break;
+    for (MachineBasicBlock::iterator I = BB->begin(); I != BB->end(); ++I)
+      X86Diversity::insertNOPs(*BB, I, TII, *RNG, BBProb, is64Bit,
+                               NOPsInserted, Record, Site++);
+  }
+  return true;
+}
+
+int X86Diversity::getNOPInsertionPercentage(const MachineBasicBlock &MBB,
+                                            int FnPercentage) {
+  if (!MBB.getBasicBlock())
+    return FnPercentage;
+  int BBProb = MBB.getBasicBlock()->getNOPInsertionPercentage();
+  if (BBProb == multicompiler::NOPInsertionUnknown)
+    return FnPercentage;
+  return BBProb;
+}
+
+void X86Diversity::insertNOPs(MachineBasicBlock &MBB,
+                              MachineBasicBlock::iterator I,
+                              const TargetInstrInfo *TII,
+                              RandomNumberGenerator &RNG, int Percentage,
+                              bool is64Bit, unsigned &NOPsInserted,
+                              multicompiler::DecisionRecord *Record,
+                              unsigned Site) {
+  if (I->isPseudo())
+    return;
+
+  unsigned int NumNOPs = MaxNOPsPerInstruction;
+  if (NOPsInserted < EarlyNOPThreshold)
+    NumNOPs = RNG.Random(EarlyNOPMaxCount);
+  for (unsigned int i = 0; i < NumNOPs; i++) {
+    int Roll = RNG.Random(100);
+    if (Roll >= Percentage)
+      continue;
+
+    int NOPCode = RNG.Random(MAX_NOPS);
+
+    // TODO(ahomescu): figure out if we need to preserve kill information
+    MachineInstr *NewMI = NULL;
+    unsigned reg = nopRegs[NOPCode][!!is64Bit];
+    switch (NOPCode) {
+    case NOP:
+      NewMI = BuildMI(MBB, I, I->getDebugLoc(), TII->get(X86::NOOP));
+      NOPsInserted++;
+      break;
 /*
-        case NOP2:
-          NewMI = BuildMI(*BB, I, I->getDebugLoc(), TII->get(X86::NOOP2));
-          break;
-
-        case NOP3:
-          NewMI = addDirectMem(BuildMI(*BB, I, I->getDebugLoc(),
-                                       TII->get(X86::NOOP3)), X86::RAX);
-          break;
-
-        case NOP4:
-          NewMI = addRegOffset(
-            BuildMI(*BB, I, I->getDebugLoc(), TII->get(X86::NOOP3)),
-            X86::RAX, false, 0
-            );
-          break;
-       
-        case NOP5:
-          NewMI = addRegReg(
-            BuildMI(*BB, I, I->getDebugLoc(), TII->get(X86::NOOP5)),
-            X86::RAX, false, X86::RAX, false		    
-            );
-          break;
-                                        
-        case NOP6:
-          NewMI = addRegReg(
-            BuildMI(*BB, I, I->getDebugLoc(), TII->get(X86::NOOP6)),
-            X86::RAX, false, X86::RAX, false		    
-            );
-          break;
+    case NOP2:
+      NewMI = BuildMI(MBB, I, I->getDebugLoc(), TII->get(X86::NOOP2));
+      break;
+
+    case NOP3:
+      NewMI = addDirectMem(BuildMI(MBB, I, I->getDebugLoc(),
+                                   TII->get(X86::NOOP3)), X86::RAX);
+      break;
+
+    case NOP4:
+      NewMI = addRegOffset(
+        BuildMI(MBB, I, I->getDebugLoc(), TII->get(X86::NOOP3)),
+        X86::RAX, false, 0
+        );
+      break;
+   
+    case NOP5:
+      NewMI = addRegReg(
+        BuildMI(MBB, I, I->getDebugLoc(), TII->get(X86::NOOP5)),
+        X86::RAX, false, X86::RAX, false		    
+        );
+      break;
+                                    
+    case NOP6:
+      NewMI = addRegReg(
+        BuildMI(MBB, I, I->getDebugLoc(), TII->get(X86::NOOP6)),
+        X86::RAX, false, X86::RAX, false		    
+        );
+      break;
 */
-        case MOV_EBP:
-        case MOV_ESP: {
-          unsigned opc = is64Bit ? X86::MOV64rr : X86::MOV32rr;
-          NewMI = BuildMI(*BB, I, I->getDebugLoc(), TII->get(opc), reg)
-            .addReg(reg);
-          NOPsInserted++;
-          break;
-        }
-
-        case LEA_ESI:
-        case LEA_EDI: {
-          unsigned opc = is64Bit ? X86::LEA64r : X86::LEA32r;
-          NewMI = addRegOffset(BuildMI(*BB, I, I->getDebugLoc(),
-                                       TII->get(opc), reg),
-                               reg, false, 0);
-          NOPsInserted++;
-          break;
-        }
-        }
-
-        if (NewMI != NULL) {
-          IncrementCounters(NOPCode);
-          NewMI->setFlag(MachineInstr::InsertedNOP);
-        }
+    case MOV_EBP:
+    case MOV_ESP: {
+      unsigned opc = is64Bit ? X86::MOV64rr : X86::MOV32rr;
+      NewMI = BuildMI(MBB, I, I->getDebugLoc(), TII->get(opc), reg)
+        .addReg(reg);
+      NOPsInserted++;
+      break;
+    }
+
+    case LEA_ESI:
+    case LEA_EDI: {
+      unsigned opc = is64Bit ? X86::LEA64r : X86::LEA32r;
+      NewMI = addRegOffset(BuildMI(MBB, I, I->getDebugLoc(),
+                                   TII->get(opc), reg),
+                           reg, false, 0);
+      NOPsInserted++;
+      break;
+    }
+    }
+
+    if (NewMI != NULL) {
+      IncrementCounters(NOPCode);
+      NewMI->setFlag(MachineInstr::InsertedNOP);
+      if (Record) {
+        Record->Values.push_back(Site);
+        Record->Values.push_back(NOPCode);
       }
-      I = J;
     }
   }
-  return true;
 }
 
 FunctionPass *llvm::createNOPInsertionPass(bool is64Bit) {
@@ -57,6 +57,11 @@ FunctionPass *createEquivSubstPass();
 /// instructions.
 FunctionPass *createNOPInsertionPass(bool is64Bit);
 
+/// createX86CheapDiversityPass - This pass applies MOVToLEA, EquivSubst and,
+/// if NOPInsertion is set, NOP insertion in a single walk with one random
+/// stream per module. Used by the cheap diversity pipeline.
+FunctionPass *createX86CheapDiversityPass(bool Is64Bit, bool NOPInsertion);
+
 /// Return a pass that pads short functions with NOOPs.
 /// This will prevent a stall when returning on the Atom.
 FunctionPass *createX86PadShortFunctions();
@@ -0,0 +1,123 @@
+//===- X86CheapDiversity.cpp - Single-pass machine code diversity ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the pass the cheap diversity pipeline runs instead of
+// MOVToLEA, EquivSubst and NOPInsertion. It applies the three transformations
+// in the same order during one walk over each function and draws from one
+// random stream for the whole module, so diversified -O0 builds pay for a
+// single extra walk over the code.
+//
+//===----------------------------------------------------------------------===//
+
+#include "X86.h"
+#include "X86Diversity.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
+#include "llvm/MultiCompiler/MultiCompilerOptions.h"
+#include "llvm/Support/RandomNumberGenerator.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/Target/TargetSubtargetInfo.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "x86-cheap-diversity"
+
+STATISTIC(NumCheapFunctions, "Number of functions diversified in one walk");
+
+namespace {
+class X86CheapDiversity : public MachineFunctionPass {
+  static char ID;
+
+  bool Is64Bit;
+  bool NOPInsertion;
+
+  // One random stream for every function of the module.
+  std::unique_ptr<RandomNumberGenerator> RNG;
+
+public:
+  X86CheapDiversity(bool Is64Bit, bool NOPInsertion)
+      : MachineFunctionPass(ID), Is64Bit(Is64Bit),
+        NOPInsertion(NOPInsertion) {}
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+
+  const char *getPassName() const override {
+    return "X86 cheap diversity pass";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+};
+}
+
+char X86CheapDiversity::ID = 0;
+
+bool X86CheapDiversity::runOnMachineFunction(MachineFunction &MF) {
+  unsigned MOVToLEA = MF.getFunctionOption(multicompiler::MOVToLEAPercentage);
+  unsigned EquivSubst =
+      MF.getFunctionOption(multicompiler::EquivSubstPercentage);
+  int FnNOPs = MF.getFunctionOption(multicompiler::NOPInsertionPercentage);
+  if (!MOVToLEA && !EquivSubst && !NOPInsertion)
+    return false;
+
+  if (!RNG)
+    RNG.reset(MF.getFunction()->getParent()->createRNG(this));
+
+  // Add all records before taking their addresses.
+  multicompiler::DecisionRecord *MOVRecord = nullptr, *EquivRecord = nullptr,
+                                *NOPRecord = nullptr;
+  if (multicompiler::DiversityManifest *Manifest =
+          MF.getMMI().getDiversityManifest()) {
+    size_t First = Manifest->Records.size();
+    Manifest->addRecord(multicompiler::DK_MOVToLEA, MF.getName());
+    Manifest->addRecord(multicompiler::DK_EquivSubst, MF.getName());
+    Manifest->addRecord(multicompiler::DK_NOPInsertion, MF.getName());
+    MOVRecord = &Manifest->Records[First];
+    EquivRecord = &Manifest->Records[First + 1];
+    NOPRecord = &Manifest->Records[First + 2];
+  }
+
+  ++NumCheapFunctions;
+  const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+  bool Changed = false;
+  unsigned NOPsInserted = 0;
+  unsigned Site = 0;
+  for (MachineBasicBlock &MBB : MF) {
+    int NOPs = NOPInsertion
+                   ? X86Diversity::getNOPInsertionPercentage(MBB, FnNOPs)
+                   : 0;
+    // NOPs go before the substituted instruction, so they are never visited
+    // and MOVToLEA cannot rewrite the MOV NOPs.
+    for (MachineBasicBlock::iterator I = MBB.begin(), E = MBB.end(); I != E;
+         ++I, ++Site) {
+      if (MOVToLEA)
+        Changed |= X86Diversity::substituteMOVToLEA(MBB, I, TII, *RNG, MOVToLEA,
+                                                    MOVRecord, Site);
+      if (EquivSubst)
+        Changed |= X86Diversity::substituteEquivalent(
+            MBB, I, TII, *RNG, EquivSubst, EquivRecord, Site);
+      if (NOPs > 0) {
+        X86Diversity::insertNOPs(MBB, I, TII, *RNG, NOPs, Is64Bit,
+                                 NOPsInserted, NOPRecord, Site);
+        Changed = true;
+      }
+    }
+  }
+  return Changed;
+}
+
+FunctionPass *llvm::createX86CheapDiversityPass(bool Is64Bit,
+                                                bool NOPInsertion) {
+  return new X86CheapDiversity(Is64Bit, NOPInsertion);
+}
@@ -0,0 +1,69 @@
+//===-- X86Diversity.h - Per-instruction diversifying steps -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the per-instruction steps of the MOVToLEA, EquivSubst
+// and NOPInsertion passes, so that the cheap diversity pass can apply all of
+// them in a single walk over each function.
+//
+// Each step appends its decisions to Record, if given, for the instruction
+// with index Site in the function.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_X86_X86DIVERSITY_H
+#define LLVM_LIB_TARGET_X86_X86DIVERSITY_H
+
+#include "llvm/CodeGen/MachineBasicBlock.h"
+
+namespace multicompiler {
+struct DecisionRecord;
+}
+
+namespace llvm {
+class RandomNumberGenerator;
+class TargetInstrInfo;
+
+namespace X86Diversity {
+
+/// Replace the register MOV at I by an equivalent LEA with the given
+/// probability. On return I points to the instruction that replaced it.
+/// Returns true if the instruction was replaced.
+bool substituteMOVToLEA(MachineBasicBlock &MBB, MachineBasicBlock::iterator &I,
+                        const TargetInstrInfo *TII, RandomNumberGenerator &RNG,
+                        unsigned Percentage,
+                        multicompiler::DecisionRecord *Record = nullptr,
+                        unsigned Site = 0);
+
+/// Replace the instruction at I by an equivalent instruction with the given
+/// probability. On return I points to the instruction that replaced it.
+/// Returns true if the instruction was replaced.
+bool substituteEquivalent(MachineBasicBlock &MBB,
+                          MachineBasicBlock::iterator &I,
+                          const TargetInstrInfo *TII,
+                          RandomNumberGenerator &RNG, unsigned Percentage,
+                          multicompiler::DecisionRecord *Record = nullptr,
+                          unsigned Site = 0);
+
+/// Return the NOP insertion percentage of MBB, whose function uses
+/// FnPercentage.
+int getNOPInsertionPercentage(const MachineBasicBlock &MBB, int FnPercentage);
+
+/// Insert random NOPs before the instruction at I, each with the given
+/// probability. NOPsInserted is the number of NOPs inserted so far in the
+/// function and is updated.
+void insertNOPs(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+                const TargetInstrInfo *TII, RandomNumberGenerator &RNG,
+                int Percentage, bool Is64Bit, unsigned &NOPsInserted,
+                multicompiler::DecisionRecord *Record = nullptr,
+                unsigned Site = 0);
+
+} // end namespace X86Diversity
+} // end namespace llvm
+
+#endif
@@ -4612,6 +4612,38 @@ bool X86InstrInfo::getMemOpBaseRegImmOfs(MachineInstr *MemOp, unsigned &BaseReg,
           X86::NoRegister);
 }
 
+unsigned X86InstrInfo::getPCRelDisplacementTail(const MachineInstr *MI) const {
+  switch (MI->getOpcode()) {
+  case X86::CALL64pcrel32:
+  case X86::TAILJMPd64:
+    // Direct tail calls are lowered to JMP_4 when functions are permuted.
+    return MI->getOperand(0).isImm() ? 0 : 4;
+  }
+
+  const MCInstrDesc &Desc = MI->getDesc();
+  int MemRefBegin = X86II::getMemoryOperandNo(Desc.TSFlags, MI->getOpcode());
+  if (MemRefBegin < 0)
+    return 0;
+  MemRefBegin += X86II::getOperandBias(Desc);
+  if (MI->getOperand(MemRefBegin + X86::AddrBaseReg).getReg() != X86::RIP)
+    return 0;
+
+  const MachineOperand &DispMO = MI->getOperand(MemRefBegin + X86::AddrDisp);
+  if (DispMO.isImm())
+    return 0;
+  // The linker may rewrite thread-local accesses into other instructions.
+  switch (DispMO.getTargetFlags()) {
+  case X86II::MO_TLSGD:
+  case X86II::MO_TLSLD:
+  case X86II::MO_GOTTPOFF:
+    return 0;
+  }
+
+  // The displacement is followed by the immediate, if any.
+  return 4 + (X86II::hasImm(Desc.TSFlags) ? X86II::getSizeOfImm(Desc.TSFlags)
+                                          : 0);
+}
+
 static unsigned getStoreRegOpcode(unsigned SrcReg,
                                   const TargetRegisterClass *RC,
                                   bool isStackAligned,
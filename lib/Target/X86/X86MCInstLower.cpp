@@ -20,6 +20,7 @@
 #include "Utils/X86ShuffleDecode.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/CodeGen/FunctionPermutation.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineConstantPool.h"
 #include "llvm/CodeGen/MachineOperand.h"
@@ -440,7 +441,7 @@ X86MCInstLower::LowerMachineOperand(const MachineInstr *MI,
 
 void X86MCInstLower::Lower(const MachineInstr *MI, MCInst &OutMI) const {
   OutMI.setOpcode(MI->getOpcode());
-  OutMI.setTrapInfo(MI->getTrapInfo());
+  OutMI.setTrapInfo(AsmPrinter.getUniquedTrapInfo(MI->getTrapInfo()));
 
   for (const MachineOperand &MO : MI->operands())
     if (auto MaybeMCOp = LowerMachineOperand(MI, MO))
@@ -560,8 +561,12 @@ ReSimplify:
     switch (OutMI.getOpcode()) {
     default: llvm_unreachable("Invalid opcode");
     case X86::TAILJMPr: Opcode = X86::JMP32r; break;
-    case X86::TAILJMPd:
-    case X86::TAILJMPd64: Opcode = X86::JMP_1; break;
+    case X86::TAILJMPd: Opcode = X86::JMP_1; break;
+    case X86::TAILJMPd64:
+      // The displacements recorded for load-time function permutation are
+      // 32 bits wide, so keep the assembler from relaxing the jump.
+      Opcode = isLoadTimePermutationEnabled(TM) ? X86::JMP_4 : X86::JMP_1;
+      break;
     }
 
     MCOperand Saved = OutMI.getOperand(0);
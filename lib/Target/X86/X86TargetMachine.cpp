@@ -288,6 +288,11 @@ void X86PassConfig::addPreEmitPass() {
 
   addPass(createX86FixupVCalls());
 
+  if (useCheapDiversity()) {
+    addPass(createX86CheapDiversityPass(Is64Bit, TM->Options.NOPInsertion));
+    return;
+  }
+
   // NOTE: these must be added in exactly this order
   // as they interfere with each other
   // MOVToLEA might change the MOVs inserted as NOPs
@@ -0,0 +1,24 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O0 -nop-insertion -debug-pass=Structure -o /dev/null 2>&1 | FileCheck %s --check-prefix=CHEAP
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O2 -nop-insertion -cheap-diversity -debug-pass=Structure -o /dev/null 2>&1 | FileCheck %s --check-prefix=CHEAP
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O1 -nop-insertion -debug-pass=Structure -o /dev/null 2>&1 | FileCheck %s --check-prefix=FULL
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O2 -nop-insertion -debug-pass=Structure -o /dev/null 2>&1 | FileCheck %s --check-prefix=FULL
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O0 -nop-insertion -cheap-diversity=false -debug-pass=Structure -o /dev/null 2>&1 | FileCheck %s --check-prefix=FULL
+
+; At -O0 the machine code diversity passes run as one pass. -O1 keeps the
+; separate passes so that existing seeds give the same code.
+
+; CHEAP-NOT: MOV to LEA transformation pass
+; CHEAP-NOT: Equivalent instruction substitution pass
+; CHEAP: X86 cheap diversity pass
+; CHEAP-NOT: NOP insertion pass
+
+; FULL-NOT: X86 cheap diversity pass
+; FULL: MOV to LEA transformation pass
+; FULL-NEXT: Equivalent instruction substitution pass
+; FULL-NEXT: NOP insertion pass
+; FULL-NOT: X86 cheap diversity pass
+
+define i32 @f(i32 %a, i32 %b) {
+  %c = add i32 %a, %b
+  ret i32 %c
+}
@@ -0,0 +1,25 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -nop-insertion -diversity-overhead-budget=1.5 -diversity-plan-report=%t -o /dev/null
+; RUN: FileCheck %s < %t
+
+; The hot function executes 2000000 instructions and every percent of NOP
+; insertion adds 20000 of them, so a 1.5% budget allows a setting of 1. The
+; cold function never runs and keeps the global setting.
+
+; CHECK: Function,Entry count,Executed instructions,nop-insertion-percentage,mov-to-lea-percentage,equiv-subst-percentage,stack-to-heap-percentage,Estimated overhead %
+; CHECK-NEXT: hot,1000000,2000000,1,,,,1.0000
+; CHECK-NEXT: cold,0,0,50,,,,0.0000
+; CHECK: # Execution counts from profile data
+; CHECK: # Estimated overhead: 1.0000% of executed instructions (budget 1.5000%)
+
+define i32 @hot(i32 %x) !prof !0 {
+  %y = add i32 %x, 1
+  ret i32 %y
+}
+
+define i32 @cold(i32 %x) !prof !1 {
+  %y = mul i32 %x, 3
+  ret i32 %y
+}
+
+!0 = !{!"function_entry_count", i64 1000000}
+!1 = !{!"function_entry_count", i64 0}
@@ -0,0 +1,25 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -use-function-options -function-options-file=%S/Inputs/function-options.txt -print-after=function-options -o /dev/null 2>&1 | FileCheck %s
+
+; CHECK: define void @glob_one() #[[ONE:[0-9]+]] {
+; CHECK: define void @glob_kept() #[[KEPT:[0-9]+]] {
+; CHECK: define void @re_two() #[[TWO:[0-9]+]] {
+; CHECK: define void @other() {
+; CHECK-DAG: attributes #[[ONE]] = { "multicompiler-max-stack-pad-size"="32" "multicompiler-nop-insertion-percentage"="30" }
+; CHECK-DAG: attributes #[[KEPT]] = { "multicompiler-max-stack-pad-size"="32" "multicompiler-nop-insertion-percentage"="5" }
+; CHECK-DAG: attributes #[[TWO]] = { "multicompiler-shuffle-stack-frames"="1" }
+
+define void @glob_one() {
+  ret void
+}
+
+define void @glob_kept() "multicompiler-nop-insertion-percentage"="5" {
+  ret void
+}
+
+define void @re_two() {
+  ret void
+}
+
+define void @other() {
+  ret void
+}
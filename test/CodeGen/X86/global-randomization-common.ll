@@ -0,0 +1,18 @@
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu -random-seed=1 -shuffle-globals -global-min-count=2 < %s | FileCheck %s
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu -random-seed=1 -shuffle-globals -global-min-count=2 -internal-common-padding < %s | FileCheck %s --check-prefix=INTERNAL
+
+; Common globals are padded with common symbols for the linker to allocate,
+; unless the gold plugin has defined the common globals of the module.
+
+@c = common global i32 0, align 4
+@d = global i32 1, align 4
+
+; The padding of @d is "[padding]" and the padding of @c is "[padding].1".
+; CHECK-DAG: .comm c,4,4
+; CHECK-DAG: .local "[padding]"
+; CHECK-DAG: .comm "[padding].1",{{[0-9]+}},1
+; CHECK-NOT: .local "[padding].1"
+
+; INTERNAL-DAG: .comm c,4,4
+; INTERNAL-DAG: .local "[padding]"
+; INTERNAL-DAG: .local "[padding].1"
@@ -0,0 +1,36 @@
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu -O2 -pointer-protection < %s | FileCheck %s
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu -O2 < %s | FileCheck %s --check-prefix=NOPROT
+
+; The value profile of each site travels with the call as VP metadata, so the
+; hot site is promoted even though it is the second indirect call in IR order.
+; The values are the MD5 hashes of the PGO names of @hot and @cold.
+
+declare void @hot(i32)
+declare void @cold(i32)
+
+; CHECK-LABEL: caller:
+; The cold site stays an indirect call through the trampoline.
+; CHECK:       callq *
+; Only the guard uses the trampoline address of @hot.
+; CHECK:       movl $llvm.trampoline_table, %e[[T:[a-z]+]]
+; CHECK:       cmpq %r[[T]],
+; CHECK-NEXT:  jne [[FALLBACK:.LBB[0-9_]+]]
+; CHECK:       callq hot
+; CHECK:       [[FALLBACK]]:
+; CHECK-NOT:   callq cold
+; CHECK:       callq *
+; CHECK:       .Lfunc_end0:
+
+; Without pointer protection the pass does not run.
+; NOPROT-LABEL: caller:
+; NOPROT-NOT:   callq hot
+; NOPROT:       .Lfunc_end0:
+define void @caller(void (i32)* %a, void (i32)* %b) {
+entry:
+  call void %a(i32 1), !prof !1
+  call void %b(i32 2), !prof !0
+  ret void
+}
+
+!0 = !{!"VP", i32 0, i64 10000, i64 10177652421713147431, i64 9000, i64 11668175513417606517, i64 500}
+!1 = !{!"VP", i32 0, i64 40, i64 11668175513417606517, i64 30, i64 10177652421713147431, i64 10}
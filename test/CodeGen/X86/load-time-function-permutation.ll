@@ -0,0 +1,84 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -relocation-model=pic -load-time-function-permutation | FileCheck %s
+
+; Local functions go to .text.fperm, each in an aligned slot with its jump
+; table. The metadata lists the slots and the pc-relative references.
+
+@g = internal global i32 0
+
+; CHECK: .section .text.fperm,"ax",@progbits
+; CHECK-NEXT: .align 16, 0x90
+; CHECK-NEXT: .type store,@function
+; CHECK-NEXT: store:
+; CHECK: movl $5, g(%rip)
+; CHECK-NEXT: [[STORE:.Ltmp[0-9]+]]:
+define internal void @store() {
+  store i32 5, i32* @g
+  ret void
+}
+
+; CHECK: .align 16, 0x90
+; CHECK-NEXT: .type sw,@function
+; CHECK-NEXT: sw:
+; CHECK: leaq .LJTI1_0(%rip), %{{[a-z]+}}
+; CHECK-NEXT: [[JT:.Ltmp[0-9]+]]:
+; CHECK-NOT: .section
+; CHECK: .LJTI1_0:
+define internal i32 @sw(i32 %x) {
+entry:
+  switch i32 %x, label %d [
+    i32 0, label %a
+    i32 1, label %b
+    i32 2, label %c
+    i32 3, label %e
+  ]
+a:
+  ret i32 7
+b:
+  ret i32 11
+c:
+  ret i32 13
+e:
+  ret i32 17
+d:
+  ret i32 0
+}
+
+; CHECK: .text
+; CHECK: main:
+; CHECK: callq store
+; CHECK-NEXT: [[CALL:.Ltmp[0-9]+]]:
+; CHECK: jmp sw
+; CHECK-NEXT: [[JMP:.Ltmp[0-9]+]]:
+define i32 @main() {
+  call void @store()
+  %r = tail call i32 @sw(i32 2)
+  ret i32 %r
+}
+
+; CHECK: .align 16, 0x90
+; CHECK-NEXT: [[END:.Ltmp[0-9]+]]:
+; CHECK: .section multicompiler_fperm,"a",@progbits
+; CHECK-NEXT: .align 4
+; CHECK-NEXT: .long 1
+; CHECK-NEXT: .long 4
+; CHECK-NEXT: [[HERE:.Ltmp[0-9]+]]:
+; CHECK-NEXT: .long __multicompiler_fperm_runtime-[[HERE]]
+; CHECK-NEXT: [[HERE:.Ltmp[0-9]+]]:
+; CHECK-NEXT: .long store-[[HERE]]
+; CHECK-NEXT: .long [[END]]-store
+; CHECK-NEXT: .long 2
+; CHECK-NEXT: .long 4
+; CHECK-NEXT: .long store-store
+; CHECK-NEXT: .long sw-store
+; CHECK-NEXT: [[HERE:.Ltmp[0-9]+]]:
+; CHECK-NEXT: .long [[STORE]]-[[HERE]]
+; CHECK-NEXT: .long 8
+; CHECK-NEXT: [[HERE:.Ltmp[0-9]+]]:
+; CHECK-NEXT: .long [[JT]]-[[HERE]]
+; CHECK-NEXT: .long 4
+; CHECK-NEXT: [[HERE:.Ltmp[0-9]+]]:
+; CHECK-NEXT: .long [[CALL]]-[[HERE]]
+; CHECK-NEXT: .long 4
+; CHECK-NEXT: [[HERE:.Ltmp[0-9]+]]:
+; CHECK-NEXT: .long [[JMP]]-[[HERE]]
+; CHECK-NEXT: .long 4
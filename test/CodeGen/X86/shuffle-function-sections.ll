@@ -0,0 +1,25 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -shuffle-function-sections | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -shuffle-function-sections -unique-section-names=false | FileCheck %s --check-prefix=NOUNIQUE
+
+; Every function gets its own .text.shuffle section for the gold plugin to
+; permute.
+
+; CHECK: .section .text.shuffle.f,"ax",@progbits
+; CHECK: f:
+; CHECK: .section .text.shuffle.g,"axG",@progbits,g,comdat
+; CHECK: g:
+
+; NOUNIQUE: .section .text.shuffle,"ax",@progbits,unique
+; NOUNIQUE: f:
+; NOUNIQUE: .section .text.shuffle,"axG",@progbits,g,comdat
+; NOUNIQUE: g:
+
+$g = comdat any
+
+define void @f() {
+  ret void
+}
+
+define linkonce_odr void @g() comdat {
+  ret void
+}
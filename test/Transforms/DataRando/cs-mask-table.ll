@@ -0,0 +1,49 @@
+; RUN: opt -S %loaddatarando -cs-data-rando -cs-data-rando-mask-table-threshold=1 < %s | FileCheck %s
+
+; Clones needing more than one mask take them in a table. Calls passing only
+; constant masks point at a private constant table, other calls fill a table
+; in the entry block of the caller, and the clone loads each mask from the
+; table in its entry block.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK: [[TABLE:@mask_table[.0-9]*]] = private unnamed_addr constant [2 x i64] [i64 {{-?[0-9]+}}, i64 {{-?[0-9]+}}]
+
+; The masks @mid passes on are its own, so it fills a table on its stack.
+; CHECK-LABEL: define internal void @mid_CONTEXT_SENSITIVE(i32* %p, i64* %q, i64* %mask_table)
+; CHECK-DAG: [[LOCAL:%mask_table[0-9]+]] = alloca [2 x i64]
+; CHECK-DAG: getelementptr inbounds i64, i64* %mask_table, i32 0
+; CHECK-DAG: getelementptr inbounds i64, i64* %mask_table, i32 1
+; CHECK: store i64 %arg_mask{{[0-9]*}}, i64* {{%[^ ]+}}
+; CHECK-NEXT: store i64 %arg_mask{{[0-9]*}}, i64* {{%[^ ]+}}
+; CHECK-NEXT: [[PTR:%[^ ]+]] = getelementptr inbounds [2 x i64], [2 x i64]* [[LOCAL]], i32 0, i32 0
+; CHECK-NEXT: call void @leaf_CONTEXT_SENSITIVE(i32* %p, i64* %q, i64* [[PTR]])
+define void @mid(i32* %p, i64* %q) {
+  call void @leaf(i32* %p, i64* %q)
+  ret void
+}
+
+; The clone loads each mask once, in its entry block, before using it.
+; CHECK-LABEL: define internal void @leaf_CONTEXT_SENSITIVE(i32* %p, i64* %q, i64* %mask_table)
+; CHECK-NEXT: [[A:%[^ ]+]] = getelementptr inbounds i64, i64* %mask_table, i32 {{[01]}}
+; CHECK-NEXT: %arg_mask{{[0-9]*}} = load i64, i64* [[A]]
+; CHECK-NEXT: [[B:%[^ ]+]] = getelementptr inbounds i64, i64* %mask_table, i32 {{[01]}}
+; CHECK-NEXT: %arg_mask{{[0-9]*}} = load i64, i64* [[B]]
+; CHECK-NOT: load i64, i64* %mask_table
+; CHECK: ret void
+define internal void @leaf(i32* %p, i64* %q) {
+  store i32 1, i32* %p
+  store i64 2, i64* %q
+  ret void
+}
+
+; Calls from code that isn't cloned pass constant masks.
+; CHECK-LABEL: define void @top()
+; CHECK: call void @mid_CONTEXT_SENSITIVE(i32* %a, i64* %b, i64* getelementptr inbounds ([2 x i64], [2 x i64]* [[TABLE]], i32 0, i32 0))
+define void @top() {
+  %a = alloca i32
+  %b = alloca i64
+  call void @mid(i32* %a, i64* %b)
+  ret void
+}
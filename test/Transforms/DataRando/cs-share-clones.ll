@@ -0,0 +1,61 @@
+; RUN: opt -S %loaddatarando -cs-data-rando < %s | FileCheck %s
+; RUN: opt -S %loaddatarando -cs-data-rando -cs-data-rando-mask-table-threshold=1 < %s | FileCheck %s --check-prefix=TABLE
+; RUN: opt -S %loaddatarando -cs-data-rando -cs-data-rando-share-clones=false < %s | FileCheck %s --check-prefix=NOSHARE
+
+; The original of a cloned function is replaced by a call to its clone with
+; every argument mask null, passed either as separate arguments or in a
+; constant table. Local originals left without uses are deleted, and vararg
+; originals keep their own body.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; TABLE: @mask_table = private unnamed_addr constant [2 x i64] zeroinitializer
+
+; CHECK-LABEL: define i32 @one(i32* %p)
+; CHECK-NEXT: [[R:%[0-9]+]] = tail call i32 @one_CONTEXT_SENSITIVE(i32* %p, i64 0)
+; CHECK-NEXT: ret i32 [[R]]
+; NOSHARE-LABEL: define i32 @one(i32* %p)
+; NOSHARE: load i32, i32* %p
+define i32 @one(i32* %p) {
+  %v = load i32, i32* %p
+  ret i32 %v
+}
+
+; CHECK-LABEL: define void @two(i32* %p, i64* %q)
+; CHECK-NEXT: tail call void @two_CONTEXT_SENSITIVE(i32* %p, i64* %q, i64 0, i64 0)
+; CHECK-NEXT: ret void
+; TABLE-LABEL: define void @two(i32* %p, i64* %q)
+; TABLE-NEXT: tail call void @two_CONTEXT_SENSITIVE(i32* %p, i64* %q, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @mask_table, i32 0, i32 0))
+; TABLE-NEXT: ret void
+define void @two(i32* %p, i64* %q) {
+  store i32 1, i32* %p
+  store i64 2, i64* %q
+  ret void
+}
+
+; Once calls to @helper have been redirected to its clone, the original has no
+; uses left and is removed.
+; CHECK-NOT: define internal void @helper(
+; CHECK-LABEL: define void @caller(i32* %p)
+; CHECK-NEXT: tail call void @caller_CONTEXT_SENSITIVE(i32* %p, i64 0)
+; NOSHARE-LABEL: define internal void @helper(i32* %p)
+define internal void @helper(i32* %p) {
+  store i32 0, i32* %p
+  ret void
+}
+
+define void @caller(i32* %p) {
+  call void @helper(i32* %p)
+  ret void
+}
+
+; CHECK-LABEL: define i32 @va(i32* %p, ...)
+; CHECK-NOT: call
+; CHECK: load i32, i32* %p
+; CHECK-NOT: call
+; CHECK: ret i32
+define i32 @va(i32* %p, ...) {
+  %v = load i32, i32* %p
+  ret i32 %v
+}
@@ -0,0 +1,89 @@
+; RUN: opt -S %loaddatarando -datachecks -xcheck-data < %s | FileCheck %s
+; RUN: opt -S %loaddatarando -datachecks -xcheck-data -optimize-data-checks=false < %s | FileCheck %s --check-prefix=NOOPT
+
+; A flag tested in the loop header and again in the body is checked once,
+; before the loop.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@flag = global i32 0
+@count = global i32 0
+@other = global i32 0
+
+; CHECK-LABEL: @loop(
+; CHECK: entry:
+; CHECK-NEXT: [[COPY:%.*]] = load i32, i32* @flag
+; CHECK-NEXT: [[EXT:%.*]] = zext i32 [[COPY]] to i64
+; CHECK-NEXT: call void @__crosscheck(i64 [[EXT]])
+; CHECK-NEXT: br label %header
+; CHECK-NOT: call void @__crosscheck
+; CHECK: ret void
+
+; NOOPT-LABEL: @loop(
+; NOOPT: call void @__crosscheck
+; NOOPT: call void @__crosscheck
+; NOOPT: ret void
+define void @loop(i32 %n) crosscheck {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %next, %latch ]
+  %f1 = load i32, i32* @flag
+  %c1 = icmp eq i32 %f1, 0
+  br i1 %c1, label %exit, label %body
+
+body:
+  %f2 = load i32, i32* @flag
+  %c2 = icmp sgt i32 %f2, 7
+  br i1 %c2, label %latch, label %inc
+
+inc:
+  store i32 %i, i32* @other
+  br label %latch
+
+latch:
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %header
+
+exit:
+  ret void
+}
+
+; The second load is checked again after a store that may change it.
+
+; CHECK-LABEL: @clobber(
+; CHECK: %a = load i32, i32* %p
+; CHECK-NEXT: zext
+; CHECK-NEXT: call void @__crosscheck
+; CHECK: %b = load i32, i32* %p
+; CHECK-NOT: call void @__crosscheck
+; CHECK: store i32 1, i32* %q
+; CHECK: %c = load i32, i32* %p
+; CHECK-NEXT: zext
+; CHECK-NEXT: call void @__crosscheck
+; CHECK-NOT: call void @__crosscheck
+; CHECK: ret i32
+define i32 @clobber(i32* %p, i32* %q) crosscheck {
+entry:
+  %a = load i32, i32* %p
+  %ca = icmp eq i32 %a, 0
+  br i1 %ca, label %then, label %join
+
+then:
+  %b = load i32, i32* %p
+  %cb = icmp slt i32 %b, 3
+  br i1 %cb, label %join, label %store
+
+store:
+  store i32 1, i32* %q
+  br label %join
+
+join:
+  %c = load i32, i32* %p
+  %cc = icmp ugt i32 %c, 9
+  %r = zext i1 %cc to i32
+  ret i32 %r
+}
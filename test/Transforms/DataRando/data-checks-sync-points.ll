@@ -0,0 +1,59 @@
+; RUN: opt -S %loaddatarando -datachecks -xcheck-data -xcheck-buffer < %s | FileCheck %s
+
+; With buffered checks, pending values are flushed before every call that may
+; reach code outside the module without flushing first: external functions,
+; indirect calls and functions that are not cross-checked. Cross-checked
+; functions that may return to unchecked code flush before returning.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@flag = global i32 0
+
+declare void @external()
+
+; @checked is only called from cross-checked code, so it returns without
+; flushing.
+; CHECK-LABEL: define internal void @checked()
+; CHECK-NEXT: ret void
+define internal void @checked() crosscheck {
+  ret void
+}
+
+; CHECK-LABEL: define void @unchecked()
+; CHECK-NEXT: ret void
+define void @unchecked() {
+  ret void
+}
+
+; The flush in the entry block is the one taken when the buffer is full, so
+; start matching at the calls.
+; CHECK-LABEL: define void @calls(
+; CHECK-LABEL: {{^}}then:
+; CHECK-NEXT: call void @__crosscheckFlush()
+; CHECK-NEXT: call void @external()
+; CHECK-NEXT: call void @checked()
+; CHECK-NEXT: call void @__crosscheckFlush()
+; CHECK-NEXT: call void @unchecked()
+; CHECK-NEXT: call void @__crosscheckFlush()
+; CHECK-NEXT: call void %fp()
+; CHECK-NEXT: br label %exit
+; CHECK-LABEL: {{^}}exit:
+; CHECK-NEXT: call void @__crosscheckFlush()
+; CHECK-NEXT: ret void
+define void @calls(void ()* %fp) crosscheck {
+entry:
+  %f = load i32, i32* @flag
+  %c = icmp eq i32 %f, 0
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @external()
+  call void @checked()
+  call void @unchecked()
+  call void %fp()
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,38 @@
+; RUN: opt -disable-output %loaddatarando -data-rando -print-eq-classes-to=%t.a < %s
+; RUN: opt -disable-output %loaddatarando -data-rando -print-eq-classes-to=%t.b < %s
+; RUN: diff %t.a %t.b
+; RUN: diff %t.a.values %t.b.values
+; RUN: cat %t.a.values %t.a | FileCheck %s
+; RUN: %python %S/../../../utils/eq-class-query.py %t.a --name p --summary | FileCheck %s --check-prefix=QUERY
+
+; -print-eq-classes-to writes one JSON line per class, and one per value to
+; the .values file. Values are numbered in module order, followed by the
+; constants the analysis knows about in the order of their first use, so two
+; runs give the same dump.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@arr = internal global [2 x i32] zeroinitializer
+
+; CHECK: {"id":0,"kind":"global","name":"arr"}
+; CHECK-NOT: "kind":"other"
+; CHECK: {"id":{{[0-9]+}},"kind":"argument","function":"f","index":0,"name":"p"}
+; CHECK-NOT: "kind":"other"
+; CHECK: {"id":{{[0-9]+}},"kind":"instruction","function":"f","index":{{[0-9]+}},"name":"q","opcode":"getelementptr"}
+; CHECK-NEXT: {"id":[[CE:[0-9]+]],"kind":"other","function":"f","index":0}
+
+; @arr is only accessed through constant addresses, so its class is safe.
+; CHECK: {"class":0,"mask":"0x0000000000000000","mask_period":1,{{.*}}"reasons":["Safe equivalence class"],"edges":[],"members":[0,[[CE]]]}
+; CHECK: {"class":{{[0-9]+}},"mask":"0x{{[0-9a-f]+}}",{{.*}}"accesses":1,
+
+; QUERY: {{[0-9]+}}: argument in f %p #0 -> class [[P:[0-9]+]]
+; QUERY-NEXT: class [[P]]: mask 0x{{[0-9a-f]+}}, 2 members
+
+define i32 @f(i32* %p) {
+entry:
+  %v = load i32, i32* getelementptr inbounds ([2 x i32], [2 x i32]* @arr, i64 0, i64 1)
+  %q = getelementptr inbounds i32, i32* %p, i64 1
+  store i32 %v, i32* %q
+  ret i32 %v
+}
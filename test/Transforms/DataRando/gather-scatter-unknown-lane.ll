@@ -0,0 +1,16 @@
+; RUN: not opt -S %loaddatarando -data-rando < %s 2>&1 | FileCheck %s
+
+; The lanes of an address vector passed in as an argument cannot be traced to
+; their objects, so no mask can be chosen for them.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK: data-rando: cannot find the object a lane of llvm.masked.gather.v2i64 in opaque_lanes points to
+define <2 x i64> @opaque_lanes(<2 x i64*> %ptrs) {
+entry:
+  %g = call <2 x i64> @llvm.masked.gather.v2i64(<2 x i64*> %ptrs, i32 8, <2 x i1> <i1 true, i1 true>, <2 x i64> undef)
+  ret <2 x i64> %g
+}
+
+declare <2 x i64> @llvm.masked.gather.v2i64(<2 x i64*>, i32, <2 x i1>, <2 x i64>)
@@ -0,0 +1,51 @@
+; RUN: opt -S %loaddatarando -data-rando < %s | FileCheck %s
+
+; Gathers and scatters mask every lane with the mask of the object it points
+; to, rotated by the lane's own address when the access is not mask aligned.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; Indexed loads from one array, as emitted by the loop vectorizer.
+; CHECK-LABEL: @indexed_gather(
+; CHECK: [[G:%[^ ]+]] = call <4 x i32> @llvm.masked.gather.v4i32(<4 x i32*> %ptrs, i32 4, <4 x i1> %m, <4 x i32> undef)
+; CHECK-NEXT: [[D:%[^ ]+]] = xor <4 x i32> [[G]], <i32 [[M:-?[0-9]+]], i32 [[M]], i32 [[M]], i32 [[M]]>
+; CHECK-NEXT: select <4 x i1> %m, <4 x i32> [[D]], <4 x i32> undef
+define <4 x i32> @indexed_gather(i32* %base, <4 x i64> %idx, <4 x i1> %m) {
+entry:
+  %ptrs = getelementptr i32, i32* %base, <4 x i64> %idx
+  %g = call <4 x i32> @llvm.masked.gather.v4i32(<4 x i32*> %ptrs, i32 4, <4 x i1> %m, <4 x i32> undef)
+  ret <4 x i32> %g
+}
+
+; Lanes built from separate pointers each get the mask of their own object.
+; CHECK-LABEL: @lane_pointers(
+; CHECK: [[G:%[^ ]+]] = call <2 x i64> @llvm.masked.gather.v2i64(
+; CHECK-NEXT: xor <2 x i64> [[G]], <i64 {{-?[0-9]+}}, i64 {{-?[0-9]+}}>
+define <2 x i64> @lane_pointers(i64* %a, i64* %b) {
+entry:
+  %v0 = insertelement <2 x i64*> undef, i64* %a, i32 0
+  %v1 = insertelement <2 x i64*> %v0, i64* %b, i32 1
+  %g = call <2 x i64> @llvm.masked.gather.v2i64(<2 x i64*> %v1, i32 8, <2 x i1> <i1 true, i1 true>, <2 x i64> undef)
+  ret <2 x i64> %g
+}
+
+; Byte aligned lanes whose accesses may straddle the mask are rotated per lane.
+; CHECK-LABEL: @unaligned_scatter(
+; CHECK: [[A:%[^ ]+]] = ptrtoint <4 x i16*> %ptrs to <4 x i64>
+; CHECK-NEXT: [[R:%[^ ]+]] = urem <4 x i64> [[A]], <i64 8, i64 8, i64 8, i64 8>
+; CHECK: lshr <4 x i64>
+; CHECK: shl <4 x i64>
+; CHECK: [[T:%[^ ]+]] = trunc <4 x i64> %{{.*}} to <4 x i16>
+; CHECK-NEXT: [[E:%[^ ]+]] = xor <4 x i16> %v, [[T]]
+; CHECK-NEXT: call void @llvm.masked.scatter.v4i16(<4 x i16> [[E]], <4 x i16*> %ptrs, i32 1, <4 x i1> %m)
+define void @unaligned_scatter(i16* %base, <4 x i64> %idx, <4 x i16> %v, <4 x i1> %m) {
+entry:
+  %ptrs = getelementptr i16, i16* %base, <4 x i64> %idx
+  call void @llvm.masked.scatter.v4i16(<4 x i16> %v, <4 x i16*> %ptrs, i32 1, <4 x i1> %m)
+  ret void
+}
+
+declare <4 x i32> @llvm.masked.gather.v4i32(<4 x i32*>, i32, <4 x i1>, <4 x i32>)
+declare <2 x i64> @llvm.masked.gather.v2i64(<2 x i64*>, i32, <2 x i1>, <2 x i64>)
+declare void @llvm.masked.scatter.v4i16(<4 x i16>, <4 x i16*>, i32, <4 x i1>)
@@ -0,0 +1,39 @@
+; RUN: opt -S %loaddatarando -heapchecks -hash-heap-checks -inline-heap-check-hash < %s | FileCheck %s
+; RUN: opt -S %loaddatarando -heapchecks -hash-heap-checks < %s | FileCheck %s --check-prefix=CALL
+
+; With -inline-heap-check-hash, hashed heap checks fold the pointer into the
+; thread-local accumulator inline instead of calling the runtime. Flush points
+; still call __crosscheckHash().
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK: @__crosscheck_hash_state = external thread_local(initialexec) nocrosscheck global i64
+
+declare void @free(i8*)
+
+; CHECK-LABEL: define i32 @f(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: [[ACC:%[^ ]+]] = load i64, i64* @__crosscheck_hash_state
+; CHECK-NEXT: [[P:%[0-9]+]] = ptrtoint i32* %p to i64
+; CHECK-NEXT: [[X:%[0-9]+]] = xor i64 [[ACC]], [[P]]
+; CHECK-NEXT: [[M:%[0-9]+]] = mul i64 [[X]], -7046029254386353131
+; CHECK-NEXT: [[S:%[0-9]+]] = lshr i64 [[M]], 32
+; CHECK-NEXT: [[H:%[0-9]+]] = xor i64 [[M]], [[S]]
+; CHECK-NEXT: store i64 [[H]], i64* @__crosscheck_hash_state
+; CHECK-NEXT: %v = load i32, i32* %p
+; CHECK-NEXT: call void @__crosscheckHash()
+; CHECK-NEXT: call void @free(i8* %q)
+; CHECK-NOT: call void @__crosscheckHashObject
+
+; CALL-NOT: @__crosscheck_hash_state
+; CALL-LABEL: define i32 @f(
+; CALL: call void @__crosscheckHashObject(i8*
+; CALL-NEXT: %v = load i32, i32* %p
+; CALL-NEXT: call void @__crosscheckHash()
+define i32 @f(i32* %p, i8* %q) crosscheck {
+entry:
+  %v = load i32, i32* %p
+  call void @free(i8* %q)
+  ret i32 %v
+}
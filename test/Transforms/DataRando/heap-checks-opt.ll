@@ -0,0 +1,88 @@
+; RUN: opt -S %loaddatarando -heapchecks < %s | FileCheck %s
+; RUN: opt -S %loaddatarando -heapchecks -optimize-heap-checks=false < %s | FileCheck %s --check-prefix=NOOPT
+
+; Heap checks of loop-invariant pointers are hoisted into the preheader, and
+; a check of an object already checked on every path is dropped unless a
+; flush point, such as a call to free, separates the two.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @free(i8*)
+
+; CHECK-LABEL: define void @hoist(
+; CHECK: entry:
+; CHECK-NEXT: [[P:%[0-9]+]] = bitcast i32* %p to i8*
+; CHECK-NEXT: call void @__crosscheckObject(i8* [[P]])
+; CHECK-NEXT: br label %loop
+; CHECK: loop:
+; CHECK-NOT: call void @__crosscheckObject
+; CHECK: ret void
+; NOOPT-LABEL: define void @hoist(
+; NOOPT: loop:
+; NOOPT: call void @__crosscheckObject
+; NOOPT-NEXT: load i32, i32* %p
+define void @hoist(i32* %p, i32 %n) crosscheck {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, i32* %p
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: define i32 @duplicate(
+; CHECK: call void @__crosscheckObject
+; CHECK-NOT: call void @__crosscheckObject
+; CHECK: ret i32
+; NOOPT-LABEL: define i32 @duplicate(
+; NOOPT: call void @__crosscheckObject
+; NOOPT: call void @__crosscheckObject
+; NOOPT: call void @__crosscheckObject
+define i32 @duplicate(i32* %p) crosscheck {
+  %a = load i32, i32* %p
+  %q = getelementptr i32, i32* %p, i64 0
+  store i32 1, i32* %q
+  %b = load i32, i32* %p
+  ret i32 %b
+}
+
+; CHECK-LABEL: define i32 @across_free(
+; CHECK: call void @__crosscheckObject
+; CHECK-NEXT: load i32, i32* %p
+; CHECK-NEXT: call void @free
+; CHECK: call void @__crosscheckObject
+; CHECK-NEXT: load i32, i32* %p
+define i32 @across_free(i32* %p, i8* %q) crosscheck {
+  %a = load i32, i32* %p
+  call void @free(i8* %q)
+  %b = load i32, i32* %p
+  ret i32 %b
+}
+
+; A loop that may flush keeps its check inside.
+; CHECK-LABEL: define void @loop_free(
+; CHECK: loop:
+; CHECK: call void @__crosscheckObject
+; CHECK-NEXT: load i32, i32* %p
+define void @loop_free(i32* %p, i8* %q, i32 %n) crosscheck {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, i32* %p
+  call void @free(i8* %q)
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
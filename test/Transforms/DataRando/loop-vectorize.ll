@@ -0,0 +1,37 @@
+; RUN: opt -S %loaddatarando -data-rando < %s | FileCheck %s
+
+; Wide loads and stores as emitted by the loop vectorizer. The accesses are
+; aligned to the lane size, so the masks need no rotation.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK-LABEL: @add_one(
+define void @add_one(i32* noalias %dst, i32* noalias %src) {
+entry:
+  br label %vector.body
+
+; CHECK: vector.body:
+; CHECK: [[L:%[^ ]+]] = load <4 x i32>, <4 x i32>* %{{.*}}, align 4
+; CHECK-NEXT: [[D:%[^ ]+]] = xor <4 x i32> [[L]], <i32 [[M:-?[0-9]+]], i32 [[M]], i32 [[M]], i32 [[M]]>
+; CHECK: [[A:%[^ ]+]] = add <4 x i32> [[D]], <i32 1, i32 1, i32 1, i32 1>
+; CHECK-NEXT: [[E:%[^ ]+]] = xor <4 x i32> [[A]], <i32 [[N:-?[0-9]+]], i32 [[N]], i32 [[N]], i32 [[N]]>
+; CHECK-NEXT: store <4 x i32> [[E]], <4 x i32>* %{{.*}}, align 4
+; CHECK-NOT: urem
+; CHECK: ret void
+vector.body:
+  %index = phi i64 [ 0, %entry ], [ %index.next, %vector.body ]
+  %0 = getelementptr inbounds i32, i32* %src, i64 %index
+  %1 = bitcast i32* %0 to <4 x i32>*
+  %wide.load = load <4 x i32>, <4 x i32>* %1, align 4
+  %2 = add <4 x i32> %wide.load, <i32 1, i32 1, i32 1, i32 1>
+  %3 = getelementptr inbounds i32, i32* %dst, i64 %index
+  %4 = bitcast i32* %3 to <4 x i32>*
+  store <4 x i32> %2, <4 x i32>* %4, align 4
+  %index.next = add i64 %index, 4
+  %5 = icmp eq i64 %index.next, 1024
+  br i1 %5, label %exit, label %vector.body
+
+exit:
+  ret void
+}
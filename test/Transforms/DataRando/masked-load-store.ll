@@ -0,0 +1,23 @@
+; RUN: opt -S %loaddatarando -data-rando < %s | FileCheck %s
+
+; Masked loads and stores emitted by the loop vectorizer for predicated loops.
+; Disabled lanes of a masked load keep the unencrypted pass-through value.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK-LABEL: @predicated_copy(
+; CHECK: [[L:%[^ ]+]] = call <4 x i32> @llvm.masked.load.v4i32(<4 x i32>* %src, i32 4, <4 x i1> %m, <4 x i32> %pass)
+; CHECK-NEXT: [[D:%[^ ]+]] = xor <4 x i32> [[L]], <i32 {{-?[0-9]+}}, i32 {{-?[0-9]+}}, i32 {{-?[0-9]+}}, i32 {{-?[0-9]+}}>
+; CHECK-NEXT: [[S:%[^ ]+]] = select <4 x i1> %m, <4 x i32> [[D]], <4 x i32> %pass
+; CHECK: [[E:%[^ ]+]] = xor <4 x i32> [[S]], <i32 {{-?[0-9]+}}, i32 {{-?[0-9]+}}, i32 {{-?[0-9]+}}, i32 {{-?[0-9]+}}>
+; CHECK-NEXT: call void @llvm.masked.store.v4i32(<4 x i32> [[E]], <4 x i32>* %dst, i32 4, <4 x i1> %m)
+define void @predicated_copy(<4 x i32>* noalias %dst, <4 x i32>* noalias %src, <4 x i1> %m, <4 x i32> %pass) {
+entry:
+  %v = call <4 x i32> @llvm.masked.load.v4i32(<4 x i32>* %src, i32 4, <4 x i1> %m, <4 x i32> %pass)
+  call void @llvm.masked.store.v4i32(<4 x i32> %v, <4 x i32>* %dst, i32 4, <4 x i1> %m)
+  ret void
+}
+
+declare <4 x i32> @llvm.masked.load.v4i32(<4 x i32>*, i32, <4 x i1>, <4 x i32>)
+declare void @llvm.masked.store.v4i32(<4 x i32>, <4 x i32>*, i32, <4 x i1>)
@@ -0,0 +1,88 @@
+; RUN: opt -S %loaddatarando -data-rando < %s | FileCheck %s
+; RUN: opt -S %loaddatarando -data-rando -optimize-data-rando-masking=false < %s | FileCheck %s --check-prefix=NOOPT
+
+; Cleanup of the masking code: stored values are forwarded to later loads of
+; the same address, encrypt/decrypt xor pairs with the same mask are folded,
+; and mask rotations of loop-invariant addresses are hoisted out of loops.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; The load is replaced by the encrypted stored value, whose decryption then
+; folds away.
+; CHECK-LABEL: @forward(
+; CHECK: [[E:%[^ ]+]] = xor i64 %v, [[M:-?[0-9]+]]
+; CHECK-NEXT: store i64 [[E]], i64* %p, align 8
+; CHECK-NOT: load
+; CHECK: ret i64 %v
+; NOOPT-LABEL: @forward(
+; NOOPT: store i64
+; NOOPT: load i64, i64* %p, align 8
+define i64 @forward(i64* %p, i64 %v) {
+entry:
+  store i64 %v, i64* %p, align 8
+  %l = load i64, i64* %p, align 8
+  ret i64 %l
+}
+
+; Copying within one object decrypts and re-encrypts with the same mask.
+; CHECK-LABEL: @copy(
+; CHECK: [[L:%[^ ]+]] = load i64, i64* %p, align 8
+; CHECK-NOT: xor
+; CHECK: store i64 [[L]], i64* %q, align 8
+; NOOPT-LABEL: @copy(
+; NOOPT: xor i64
+; NOOPT: xor i64
+; NOOPT: store i64
+define void @copy(i64* %p) {
+entry:
+  %v = load i64, i64* %p, align 8
+  %q = getelementptr i64, i64* %p, i64 1
+  store i64 %v, i64* %q, align 8
+  ret void
+}
+
+; A store in between may alias, so the load stays.
+; CHECK-LABEL: @blocked(
+; CHECK: store i64 %{{.*}}, i64* %p, align 8
+; CHECK: store i64 %{{.*}}, i64* %r, align 8
+; CHECK: load i64, i64* %p, align 8
+; CHECK: ret i64
+define i64 @blocked(i64* %p, i64* %r, i64 %v) {
+entry:
+  store i64 %v, i64* %p, align 8
+  store i64 0, i64* %r, align 8
+  %l = load i64, i64* %p, align 8
+  ret i64 %l
+}
+
+; The misaligned accesses need their mask rotated. Every element is 8 bytes,
+; so the rotation only depends on %p and is computed once before the loop.
+; CHECK-LABEL: @hoist(
+; CHECK: entry:
+; CHECK: urem i64 %{{.*}}, 8
+; CHECK: br label %loop
+; CHECK: loop:
+; CHECK-NOT: urem
+; CHECK: load i64, i64* %g, align 1
+; CHECK: ret i64
+; NOOPT-LABEL: @hoist(
+; NOOPT: loop:
+; NOOPT: urem i64 %{{.*}}, 8
+define i64 @hoist(i64* %p, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %loop ]
+  %g = getelementptr i64, i64* %p, i64 %i
+  %v = load i64, i64* %g, align 1
+  %s.next = add i64 %s, %v
+  %i.next = add i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i64 %s.next
+}
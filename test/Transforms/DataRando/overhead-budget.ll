@@ -0,0 +1,42 @@
+; RUN: opt -S %loaddatarando -data-rando -safety-analysis=false -data-rando-overhead-budget=2 -print-eq-class-budget-report=%t.csv -print-eq-classes-to=%t.json < %s | FileCheck %s --check-prefix=IR
+; RUN: cat %t.csv %t.json | FileCheck %s
+
+; The loop makes %h the most frequently accessed class. Encrypting it would
+; cost more than 2% of the executed instructions, so it is left unencrypted,
+; while %c fits with a mask narrowed to the alignment of its access. The report
+; names the classes by their number in the dump.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; IR-LABEL: define i32 @f(
+; IR: load i32, i32* %c, align 4
+; IR-NEXT: xor i32
+; IR: load i32, i32* %h, align 4
+; IR-NOT: xor
+; IR: ret i32
+
+; CHECK: Class,Static accesses,Dynamic accesses,Mask size,Estimated overhead %,Cumulative dynamic coverage %
+; CHECK-NEXT: [[HOT:[0-9]+]],1,{{[0-9]+}},0,0.0000,0.00
+; CHECK-NEXT: [[COLD:[0-9]+]],1,1,4,{{[0-9.]+}},100.00
+; CHECK: # Encrypted classes: 1 of 2 accessed
+; CHECK-DAG: {"class":[[HOT]],"mask":"0x0000000000000000","mask_period":1,{{.*}}"reasons":["Over the data randomization overhead budget"]
+; CHECK-DAG: {"class":[[COLD]],"mask":"0x{{[0-9a-f]+}}","mask_period":4,
+
+define i32 @f(i32* %h, i32* %c, i32 %n) {
+entry:
+  %init = load i32, i32* %c, align 4
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ %init, %entry ], [ %s.next, %loop ]
+  %v = load i32, i32* %h, align 4
+  %s.next = add i32 %s, %v
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
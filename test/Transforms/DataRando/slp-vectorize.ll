@@ -0,0 +1,45 @@
+; RUN: opt -S %loaddatarando -data-rando < %s | FileCheck %s
+
+; Adjacent scalar accesses combined by the SLP vectorizer.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+%struct.pair = type { double, double }
+
+; Floating point lanes are masked as integers.
+; CHECK-LABEL: @scale_pair(
+; CHECK: [[L:%[^ ]+]] = load <2 x double>, <2 x double>* %{{.*}}, align 8
+; CHECK-NEXT: [[I:%[^ ]+]] = bitcast <2 x double> [[L]] to <2 x i64>
+; CHECK-NEXT: [[D:%[^ ]+]] = xor <2 x i64> [[I]], <i64 [[M:-?[0-9]+]], i64 [[M]]>
+; CHECK-NEXT: bitcast <2 x i64> [[D]] to <2 x double>
+; CHECK: fmul <2 x double>
+; CHECK: xor <2 x i64> %{{.*}}, <i64 [[N:-?[0-9]+]], i64 [[N]]>
+; CHECK: store <2 x double>
+define void @scale_pair(%struct.pair* noalias %dst, %struct.pair* noalias %src) {
+entry:
+  %s0 = getelementptr inbounds %struct.pair, %struct.pair* %src, i64 0, i32 0
+  %d0 = getelementptr inbounds %struct.pair, %struct.pair* %dst, i64 0, i32 0
+  %sv = bitcast double* %s0 to <2 x double>*
+  %v = load <2 x double>, <2 x double>* %sv, align 8
+  %m = fmul <2 x double> %v, <double 2.0, double 2.0>
+  %dv = bitcast double* %d0 to <2 x double>*
+  store <2 x double> %m, <2 x double>* %dv, align 8
+  ret void
+}
+
+; A copy within one equivalence class doesn't need to decrypt and re-encrypt.
+; CHECK-LABEL: @shift_pairs(
+; CHECK: [[L:%[^ ]+]] = load <2 x i64>, <2 x i64>* %{{.*}}, align 8
+; CHECK-NOT: xor
+; CHECK: store <2 x i64> [[L]], <2 x i64>* %{{.*}}, align 8
+; CHECK: ret void
+define void @shift_pairs(i64* %a) {
+entry:
+  %s = getelementptr inbounds i64, i64* %a, i64 2
+  %sv = bitcast i64* %s to <2 x i64>*
+  %v = load <2 x i64>, <2 x i64>* %sv, align 8
+  %dv = bitcast i64* %a to <2 x i64>*
+  store <2 x i64> %v, <2 x i64>* %dv, align 8
+  ret void
+}
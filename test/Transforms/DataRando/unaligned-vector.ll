@@ -0,0 +1,39 @@
+; RUN: opt -S %loaddatarando -data-rando -data-rando-per-class-mask-size < %s | FileCheck %s
+; RUN: opt -S %loaddatarando -data-rando < %s | FileCheck %s --check-prefix=ROTATE
+
+; A vector whose lanes straddle mask boundaries. With per-class mask sizes the
+; class, whose only access is byte aligned, gets a repeated 1 byte mask and no
+; rotation is needed. Otherwise every lane is rotated by its own offset.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK-LABEL: @load_unaligned(
+; CHECK-NOT: urem
+; CHECK: xor <4 x i16>
+; CHECK: ret <4 x i16>
+
+; ROTATE-LABEL: @load_unaligned(
+; ROTATE: [[L:%[^ ]+]] = load <4 x i16>, <4 x i16>* %p, align 1
+; ROTATE: add <4 x i64> %{{.*}}, <i64 0, i64 2, i64 4, i64 6>
+; ROTATE: urem <4 x i64> %{{.*}}, <i64 8, i64 8, i64 8, i64 8>
+; ROTATE: [[T:%[^ ]+]] = trunc <4 x i64> %{{.*}} to <4 x i16>
+; ROTATE-NEXT: xor <4 x i16> [[L]], [[T]]
+define <4 x i16> @load_unaligned(<4 x i16>* %p) {
+entry:
+  %v = load <4 x i16>, <4 x i16>* %p, align 1
+  ret <4 x i16> %v
+}
+
+; A class with both byte and 8 byte accesses keeps the full mask even with
+; per-class mask sizes, so the byte access is rotated.
+; CHECK-LABEL: @mixed(
+; CHECK: urem i{{[0-9]+}} %{{.*}}, 8
+define i8 @mixed(i64* %p) {
+entry:
+  store i64 1, i64* %p, align 8
+  %b = bitcast i64* %p to i8*
+  %q = getelementptr i8, i8* %b, i64 3
+  %c = load i8, i8* %q, align 1
+  ret i8 %c
+}
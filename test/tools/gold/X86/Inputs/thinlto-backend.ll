@@ -0,0 +1,8 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @g(i32 %x) {
+entry:
+  %y = mul i32 %x, 3
+  ret i32 %y
+}
@@ -27,3 +27,18 @@
 
 ; Mixed ELF and IR. We keep ours as common so the linker will finish the merge.
 ; MIXED: @a = common global i8 0, align 8
+
+; RUN: llvm-as %p/Inputs/common.ll -o %t2.o
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=emit-llvm --plugin-opt=-shuffle-globals \
+; RUN:    %t1.o %t2.o -o %t3.o
+; RUN: llvm-dis %t3.o -o - | FileCheck --check-prefix=SHUFFLE %s
+
+; With -shuffle-globals, a common symbol only the IR uses becomes a plain
+; zero-initialized definition, so that it is shuffled with the other globals.
+; SHUFFLE: @a = internal global i16 0, align 8
+
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=emit-llvm --plugin-opt=-shuffle-globals \
+; RUN:    -shared %t1.o %t2.o -o %t3.o
+; RUN: llvm-dis %t3.o -o - | FileCheck %s
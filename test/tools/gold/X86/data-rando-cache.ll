@@ -0,0 +1,70 @@
+; RUN: llvm-as %s -o %t.o
+; RUN: rm -rf %t.cache
+
+; Reference link without the cache.
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=data-rando --plugin-opt=save-temps \
+; RUN:    -shared %t.o -o %t.ref
+
+; The first link with the cache fills it, the second reuses the entry. Both
+; must produce exactly the same code as the reference.
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=data-rando --plugin-opt=save-temps \
+; RUN:    --plugin-opt=data-rando-cache-dir=%t.cache \
+; RUN:    -shared %t.o -o %t.cold
+; RUN: ls %t.cache | count 1
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=data-rando --plugin-opt=save-temps \
+; RUN:    --plugin-opt=data-rando-cache-dir=%t.cache \
+; RUN:    -shared %t.o -o %t.warm
+; RUN: ls %t.cache | count 1
+; RUN: cmp %t.ref.o %t.cold.o
+; RUN: cmp %t.ref.o %t.warm.o
+
+; A corrupt entry is discarded and rebuilt instead of failing the link.
+; RUN: for f in %t.cache/*; do echo garbage > $f; done
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=data-rando --plugin-opt=save-temps \
+; RUN:    --plugin-opt=data-rando-cache-dir=%t.cache \
+; RUN:    -shared %t.o -o %t.rebuilt 2>&1 | FileCheck %s --check-prefix=CORRUPT
+; RUN: ls %t.cache | count 1
+; RUN: cmp %t.ref.o %t.rebuilt.o
+; CORRUPT: Ignoring invalid data randomization cache entry
+
+; Different options give a different entry.
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=data-rando --plugin-opt=save-temps \
+; RUN:    --plugin-opt=data-rando-cache-dir=%t.cache \
+; RUN:    --plugin-opt=-data-rando-effective-mask-size=4 \
+; RUN:    -shared %t.o -o %t.narrow
+; RUN: ls %t.cache | count 2
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define internal void @fill(i32* %p, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+  %q = getelementptr i32, i32* %p, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, i32* %q
+  %next = add i64 %i, 1
+  %done = icmp eq i64 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define i32 @f(i64 %n, i64 %j) {
+entry:
+  %buf = alloca [16 x i32]
+  %p = getelementptr [16 x i32], [16 x i32]* %buf, i64 0, i64 0
+  call void @fill(i32* %p, i64 %n)
+  %q = getelementptr i32, i32* %p, i64 %j
+  %v = load i32, i32* %q
+  ret i32 %v
+}
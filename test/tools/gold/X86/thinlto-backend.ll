@@ -0,0 +1,46 @@
+; RUN: llvm-as -function-summary %s -o %t.o
+; RUN: llvm-as -function-summary %p/Inputs/thinlto-backend.ll -o %t2.o
+
+; Each module is compiled into its own object, and the combined index is
+; saved along with them.
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=thinlto --plugin-opt=jobs=2 \
+; RUN:    --plugin-opt=save-temps \
+; RUN:    -shared %t.o %t2.o -o %t3
+; RUN: llvm-nm %t3.o1 | FileCheck %s --check-prefix=NM1
+; RUN: llvm-nm %t3.o2 | FileCheck %s --check-prefix=NM2
+; RUN: llvm-dis %t3.1.opt.bc -o - | FileCheck %s --check-prefix=OPT1
+; RUN: llvm-bcanalyzer -dump %t3.thinlto.bc | FileCheck %s --check-prefix=COMBINED
+; RUN: llvm-nm %t3 | FileCheck %s --check-prefix=NM
+
+; NM1: T f
+; NM1-NOT: T g
+; NM2: T g
+
+; g was imported from the other module and inlined.
+; OPT1: define i32 @f(i32 %x)
+; OPT1-NOT: call
+; OPT1: ret i32
+
+; COMBINED: <MODULE_STRTAB_BLOCK
+
+; NM: T f
+; NM: T g
+
+; Data randomization needs the whole program.
+; RUN: not %gold -plugin %llvmshlibdir/LLVMgold.so -m elf_x86_64 \
+; RUN:    --plugin-opt=thinlto --plugin-opt=data-rando \
+; RUN:    -shared %t.o %t2.o -o %t4 2>&1 | FileCheck %s --check-prefix=DATARANDO
+; DATARANDO: data-rando and heap-checks need the whole program and cannot be used with thinlto
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @g(i32)
+
+define i32 @f(i32 %x) {
+entry:
+  %y = call i32 @g(i32 %x)
+  %z = add i32 %y, 1
+  ret i32 %z
+}
@@ -0,0 +1,43 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -filetype=obj -diversity-manifest -nop-insertion -nop-insertion-percentage=50 -random-seed=1 -o %t1.o
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -filetype=obj -diversity-manifest -nop-insertion -nop-insertion-percentage=50 -random-seed=1 -o %t1b.o
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -filetype=obj -diversity-manifest -nop-insertion -nop-insertion-percentage=50 -random-seed=2 -o %t2.o
+; RUN: llvm-diversity-diff -dump %t1.o | FileCheck %s --check-prefix=DUMP
+; RUN: llvm-diversity-diff -v %t1.o %t1b.o | FileCheck %s --check-prefix=SAME
+; RUN: llvm-diversity-diff %t1.o %t2.o | FileCheck %s --check-prefix=DIFF
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -filetype=obj -nop-insertion -o %t3.o
+; RUN: not llvm-diversity-diff -dump %t3.o 2>&1 | FileCheck %s --check-prefix=NONE
+
+; DUMP: module <stdin> seed 1
+; DUMP: nop-insertion f:
+; DUMP: nop-insertion g:
+; DUMP: function-layout: [[F:[0-9]+]] [[G:[0-9]+]]
+
+; SAME: a: <stdin> (seed 1)
+; SAME: b: <stdin> (seed 1)
+; SAME: nop-insertion
+; SAME-SAME: 100.00%
+; SAME: functions with identical decisions: 2 of 2
+; SAME-NEXT: f
+; SAME-NEXT: g
+
+; DIFF: a: <stdin> (seed 1)
+; DIFF: b: <stdin> (seed 2)
+; DIFF: function-layout 1 1 2 2 100.00%
+; DIFF: functions with identical decisions: {{[0-9]}} of 2
+
+; NONE: no .multicompiler_manifest section
+
+define i32 @f(i32 %a, i32 %b) {
+  %c = add i32 %a, %b
+  %d = mul i32 %c, %a
+  %e = sub i32 %d, %b
+  %g = xor i32 %e, %c
+  ret i32 %g
+}
+
+define i32 @g(i32 %a) {
+  %b = call i32 @f(i32 %a, i32 %a)
+  %c = shl i32 %b, 3
+  %d = or i32 %c, %a
+  ret i32 %d
+}
@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Config/config.h" // plugin-api.h requires HAVE_STDINT_H
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
@@ -30,16 +31,21 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Linker/IRMover.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/FunctionIndexObjectFile.h"
 #include "llvm/Object/IRObjectFile.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Utils/GlobalStatus.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
@@ -47,9 +53,11 @@
 #include "llvm/DataRando/DataRando.h"
 #include "llvm/DataRando/Passes.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include <dlfcn.h>
 #include <list>
 #include <plugin-api.h>
 #include <system_error>
+#include <thread>
 #include <vector>
 
 #include "llvm/MultiCompiler/MultiCompilerOptions.h"
@@ -112,11 +120,18 @@ static ld_plugin_get_symbols get_symbols = nullptr;
 static ld_plugin_add_input_file add_input_file = nullptr;
 static ld_plugin_set_extra_library_path set_extra_library_path = nullptr;
 static ld_plugin_get_view get_view = nullptr;
+static ld_plugin_get_input_section_count get_input_section_count = nullptr;
+static ld_plugin_get_input_section_name get_input_section_name = nullptr;
+static ld_plugin_update_section_order update_section_order = nullptr;
+static ld_plugin_allow_section_ordering allow_section_ordering = nullptr;
 static Reloc::Model RelocationModel = Reloc::Default;
 static std::string output_name = "";
 static std::list<claimed_file> Modules;
 static StringMap<ResolutionInfo> ResInfo;
 static std::vector<std::string> Cleanup;
+// Sections of the native objects of the link that are permuted by
+// shuffle-function-sections, in the order gold read them.
+static std::vector<ld_plugin_section> ShuffledSections;
 static llvm::TargetOptions TargetOpts;
 
 namespace options {
@@ -129,7 +144,10 @@ namespace options {
   static bool generate_api_file = false;
   static OutputType TheOutputType = OT_NORMAL;
   static unsigned OptLevel = 2;
-  static unsigned Parallelism = 1;
+  // Number of code generation threads, or of ThinLTO backend threads. 0 means
+  // the option was not given: code generation then uses a single thread and
+  // ThinLTO one thread per core.
+  static unsigned Parallelism = 0;
 #ifdef NDEBUG
   static bool DisableVerify = true;
 #else
@@ -139,14 +157,24 @@ namespace options {
   static std::string extra_library_path;
   static std::string triple;
   static std::string mcpu;
-  // When the thinlto plugin option is specified, only read the function
-  // the information from intermediate files and write a combined
-  // global index for the ThinLTO backends.
+  // When the thinlto plugin option is specified, read the function summaries
+  // from the intermediate files into a combined index and optimize and
+  // generate code for each module separately, importing functions from the
+  // other modules as the index suggests.
   static bool thinlto = false;
+  // With thinlto-index-only, only write the combined index for external
+  // ThinLTO backends and stop.
+  static bool thinlto_index_only = false;
   static bool DataRando = false;
   static bool HeapChecks = false;
   static bool DataRandoContextSensitive = false;
+  // Directory holding data randomized modules from earlier links, named by a
+  // hash of the optimized module they were produced from.
+  static std::string data_rando_cache_dir;
   static bool DisableVectorization = false;
+  // Permute the .text.shuffle sections emitted by -shuffle-function-sections
+  // across all objects of the link.
+  static bool shuffle_function_sections = false;
   // Additional options to pass into the code generator.
   // Note: This array will contain all plugin options which are not claimed
   // as plugin exclusive to pass to the code generator.
@@ -178,6 +206,8 @@ namespace options {
       TheOutputType = OT_DISABLE;
     } else if (opt == "thinlto") {
       thinlto = true;
+    } else if (opt == "thinlto-index-only") {
+      thinlto_index_only = true;
     } else if (opt.size() == 2 && opt[0] == 'O') {
       if (opt[1] < '0' || opt[1] > '3')
         message(LDPL_FATAL, "Optimization level must be between 0 and 3");
@@ -189,12 +219,16 @@ namespace options {
       DisableVerify = true;
     } else if (opt == "data-rando") {
       DataRando = true;
+    } else if (opt.startswith("data-rando-cache-dir=")) {
+      data_rando_cache_dir = opt.substr(strlen("data-rando-cache-dir="));
     } else if (opt == "context-sensitive") {
       DataRandoContextSensitive = true;
     } else if (opt == "heap-checks") {
       HeapChecks = true;
     } else if (opt == "disable-vectorization") {
       DisableVectorization = true;
+    } else if (opt == "shuffle-function-sections") {
+      shuffle_function_sections = true;
     } else {
       // Save this option to pass to the code generator.
       // ParseCommandLineOptions() expects argv[0] to be program name. Lazily
@@ -298,6 +332,18 @@ ld_plugin_status onload(ld_plugin_tv *tv) {
       case LDPT_GET_VIEW:
         get_view = tv->tv_u.tv_get_view;
         break;
+      case LDPT_GET_INPUT_SECTION_COUNT:
+        get_input_section_count = tv->tv_u.tv_get_input_section_count;
+        break;
+      case LDPT_GET_INPUT_SECTION_NAME:
+        get_input_section_name = tv->tv_u.tv_get_input_section_name;
+        break;
+      case LDPT_UPDATE_SECTION_ORDER:
+        update_section_order = tv->tv_u.tv_update_section_order;
+        break;
+      case LDPT_ALLOW_SECTION_ORDERING:
+        allow_section_ordering = tv->tv_u.tv_allow_section_ordering;
+        break;
       case LDPT_MESSAGE:
         message = tv->tv_u.tv_message;
         break;
@@ -326,6 +372,13 @@ ld_plugin_status onload(ld_plugin_tv *tv) {
     message(LDPL_ERROR, "relesase_input_file not passed to LLVMgold.");
     return LDPS_ERR;
   }
+  if (options::shuffle_function_sections &&
+      (!get_input_section_count || !get_input_section_name ||
+       !update_section_order || !allow_section_ordering)) {
+    message(LDPL_ERROR, "shuffle-function-sections needs a version of gold "
+                        "that supports section ordering.");
+    return LDPS_ERR;
+  }
 
   return LDPS_OK;
 }
@@ -344,19 +397,25 @@ static bool shouldSkip(uint32_t Symflags) {
   return false;
 }
 
-static void diagnosticHandler(const DiagnosticInfo &DI) {
+/// Print DI into ErrStorage. Return false if DI should be ignored.
+static bool printDiagnostic(const DiagnosticInfo &DI, std::string &ErrStorage) {
   if (const auto *BDI = dyn_cast<BitcodeDiagnosticInfo>(&DI)) {
     std::error_code EC = BDI->getError();
     if (EC == BitcodeError::InvalidBitcodeSignature)
-      return;
+      return false;
   }
 
+  raw_string_ostream OS(ErrStorage);
+  DiagnosticPrinterRawOStream DP(OS);
+  DI.print(DP);
+  OS.flush();
+  return true;
+}
+
+static void diagnosticHandler(const DiagnosticInfo &DI) {
   std::string ErrStorage;
-  {
-    raw_string_ostream OS(ErrStorage);
-    DiagnosticPrinterRawOStream DP(OS);
-    DI.print(DP);
-  }
+  if (!printDiagnostic(DI, ErrStorage))
+    return;
   ld_plugin_level Level;
   switch (DI.getSeverity()) {
   case DS_Error:
@@ -391,11 +450,56 @@ getMinVisibility(GlobalValue::VisibilityTypes A,
   return B;
 }
 
+/// Record the .text.shuffle sections of a native object for
+/// shuffle-function-sections. Gold only lets plugins look at the sections of
+/// an object while it is being claimed.
+static void collectShuffledSections(const ld_plugin_input_file *file) {
+  static bool OrderingAllowed = false;
+  if (!OrderingAllowed) {
+    // Tell gold to defer the layout of the input sections until their order
+    // is known.
+    allow_section_ordering();
+    OrderingAllowed = true;
+  }
+
+  unsigned Count;
+  // This fails for files that are not ELF objects, such as bitcode.
+  if (get_input_section_count(file->handle, &Count) != LDPS_OK)
+    return;
+  for (unsigned I = 0; I != Count; ++I) {
+    ld_plugin_section Section = {file->handle, I};
+    char *Name;
+    if (get_input_section_name(Section, &Name) != LDPS_OK)
+      continue;
+    StringRef SectionName(Name);
+    if (SectionName == ".text.shuffle" ||
+        SectionName.startswith(".text.shuffle."))
+      ShuffledSections.push_back(Section);
+    free(Name);
+  }
+}
+
+/// Randomly permute the sections recorded by collectShuffledSections. The
+/// permutation is derived from -random-seed and the name of the output.
+static void shuffleSections() {
+  if (ShuffledSections.empty())
+    return;
+  RandomNumberGenerator RNG(
+      ("shuffle-function-sections" + sys::path::filename(output_name)).str());
+  RNG.shuffle(ShuffledSections.data(), ShuffledSections.size());
+  if (update_section_order(ShuffledSections.data(), ShuffledSections.size()) !=
+      LDPS_OK)
+    message(LDPL_FATAL, "Unable to update the section order");
+}
+
 /// Called by gold to see whether this file is one that our plugin can handle.
 /// We'll try to open it and register all the symbols with add_symbol if
 /// possible.
 static ld_plugin_status claim_file_hook(const ld_plugin_input_file *file,
                                         int *claimed) {
+  if (options::shuffle_function_sections)
+    collectShuffledSections(file);
+
   LLVMContext Context;
   MemoryBufferRef BufferRef;
   std::unique_ptr<MemoryBuffer> Buffer;
@@ -447,9 +551,10 @@ static ld_plugin_status claim_file_hook(const ld_plugin_input_file *file,
 
   cf.handle = file->handle;
 
-  // If we are doing ThinLTO compilation, don't need to process the symbols.
-  // Later we simply build a combined index file after all files are claimed.
-  if (options::thinlto)
+  // If we are only writing the ThinLTO index, don't need to process the
+  // symbols. Later we simply build a combined index file after all files are
+  // claimed.
+  if (options::thinlto_index_only)
     return LDPS_OK;
 
   for (auto &Sym : Obj->symbols()) {
@@ -546,6 +651,24 @@ static void internalize(GlobalValue &GV) {
     GV.setLinkage(GlobalValue::InternalLinkage);
 }
 
+/// Turn the common symbols that only the IR of the link uses into
+/// zero-initialized definitions. Gold allocates common symbols after all the
+/// input sections, where -shuffle-globals cannot move them. Once internalized,
+/// the definitions are emitted into .bss in the order in which
+/// GlobalRandomization permutes the merged module, interleaved with its other
+/// zero-initialized internal globals. Common symbols that native objects can
+/// see are left for gold to merge, since a native object may declare a larger
+/// one. The padding GlobalRandomization adds for them is made internal too.
+static void defineCommonSymbols(Module &M, const StringSet<> &Internalize) {
+  for (GlobalVariable &GV : M.globals()) {
+    if (!GV.hasCommonLinkage() || GV.isThreadLocal() ||
+        !Internalize.count(GV.getName()))
+      continue;
+    GV.setLinkage(GlobalValue::ExternalLinkage);
+  }
+  multicompiler::InternalCommonPadding = true;
+}
+
 static const char *getResolutionName(ld_plugin_symbol_resolution R) {
   switch (R) {
   case LDPR_UNKNOWN:
@@ -579,18 +702,32 @@ static void freeSymName(ld_plugin_symbol &Sym) {
   Sym.comdat_key = nullptr;
 }
 
-static std::unique_ptr<FunctionInfoIndex>
-getFunctionIndexForFile(claimed_file &F, ld_plugin_input_file &Info) {
-
-  if (get_symbols(F.handle, F.syms.size(), &F.syms[0]) != LDPS_OK)
+/// Get the resolutions of the symbols of F from gold and a view of its
+/// contents.
+static const void *getSymbolsAndView(claimed_file &F) {
+  if (get_symbols(F.handle, F.syms.size(), F.syms.data()) != LDPS_OK)
     message(LDPL_FATAL, "Failed to get symbol information");
 
   const void *View;
   if (get_view(F.handle, &View) != LDPS_OK)
     message(LDPL_FATAL, "Failed to get a view of file");
+  return View;
+}
 
+/// The path identifying the module in Info in the combined ThinLTO index.
+/// Gold passes the members of an archive with the name of the archive, so
+/// their offset is added to tell them apart.
+static std::string getModulePath(const ld_plugin_input_file &Info) {
+  if (!Info.offset)
+    return Info.name;
+  return (Twine(Info.name) + "(" + Twine(Info.offset) + ")").str();
+}
+
+static std::unique_ptr<FunctionInfoIndex>
+getFunctionIndexForFile(const void *View, ld_plugin_input_file &Info,
+                        StringRef ModulePath) {
   MemoryBufferRef BufferRef(StringRef((const char *)View, Info.filesize),
-                            Info.name);
+                            ModulePath);
 
   // Don't bother trying to build an index if there is no summary information
   // in this bitcode file.
@@ -611,18 +748,10 @@ getFunctionIndexForFile(claimed_file &F, ld_plugin_input_file &Info) {
 }
 
 static std::unique_ptr<Module>
-getModuleForFile(LLVMContext &Context, claimed_file &F,
+getModuleForFile(LLVMContext &Context, claimed_file &F, const void *View,
                  ld_plugin_input_file &Info, raw_fd_ostream *ApiFile,
                  StringSet<> &Internalize, StringSet<> &Maybe,
                  std::vector<GlobalValue *> &Keep) {
-
-  if (get_symbols(F.handle, F.syms.size(), F.syms.data()) != LDPS_OK)
-    message(LDPL_FATAL, "Failed to get symbol information");
-
-  const void *View;
-  if (get_view(F.handle, &View) != LDPS_OK)
-    message(LDPL_FATAL, "Failed to get a view of file");
-
   MemoryBufferRef BufferRef(StringRef((const char *)View, Info.filesize),
                             Info.name);
   ErrorOr<std::unique_ptr<object::IRObjectFile>> ObjOrErr =
@@ -749,24 +878,146 @@ getModuleForFile(LLVMContext &Context, claimed_file &F,
   return Obj.takeModule();
 }
 
-static void runLTOPasses(Module &M, TargetMachine &TM) {
-  M.setDataLayout(TM.createDataLayout());
+static void addDataRandoPasses(legacy::PassManagerBase &passes) {
+  if (options::DataRandoContextSensitive) {
+    passes.add(new CSDataRando());
+  } else {
+    passes.add(new DataRando());
+  }
+}
+
+// Identify the build of the plugin: its version and the size and modification
+// time of the plugin itself, so that entries written by another build of the
+// passes are not reused after an upgrade or rebuild.
+static void hashPluginBuild(MD5 &Hasher) {
+  Hasher.update(LLVM_VERSION_STRING);
+  Hasher.update(StringRef("", 1));
+  Dl_info Info;
+  sys::fs::file_status Status;
+  if (!dladdr(reinterpret_cast<void *>(&onload), &Info) || !Info.dli_fname ||
+      sys::fs::status(Info.dli_fname, Status)) {
+    message(LDPL_WARNING, "Could not identify the plugin build, data "
+                          "randomization cache entries may be stale after an "
+                          "upgrade");
+    return;
+  }
+  Hasher.update(utostr(Status.getSize()));
+  Hasher.update(StringRef("", 1));
+  sys::TimeValue MTime = Status.getLastModificationTime();
+  Hasher.update(utostr(MTime.toEpochTime()) + "." +
+                utostr(MTime.nanoseconds()));
+  Hasher.update(StringRef("", 1));
+}
+
+// Hash everything that affects the result of data randomization: the build of
+// the plugin, the optimized module and the options passed to the passes.
+static std::string getDataRandoCacheKey(Module &M) {
+  SmallVector<char, 0> Buffer;
+  {
+    raw_svector_ostream OS(Buffer);
+    WriteBitcodeToFile(&M, OS, /* ShouldPreserveUseListOrder */ true);
+  }
+  MD5 Hasher;
+  hashPluginBuild(Hasher);
+  Hasher.update(StringRef(Buffer.data(), Buffer.size()));
+  for (const char *Opt : options::extra) {
+    Hasher.update(Opt);
+    Hasher.update(StringRef("", 1));
+  }
+  Hasher.update(options::DataRandoContextSensitive ? "context-sensitive"
+                                                   : "context-insensitive");
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+// Run data randomization on M, or replace M with the result of an earlier link
+// of the same optimized module. Pointer analysis dominates the link time of
+// large programs, so relinks with unchanged inputs skip it.
+static void runDataRandoWithCache(std::unique_ptr<Module> &M,
+                                  TargetMachine &TM) {
+  SmallString<128> EntryPath(options::data_rando_cache_dir);
+  sys::path::append(EntryPath, getDataRandoCacheKey(*M) + ".bc");
+
+  // An entry that cannot be read or parsed is a miss: it is removed and
+  // rewritten below.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Cached =
+      MemoryBuffer::getFile(EntryPath);
+  if (Cached) {
+    ErrorOr<std::unique_ptr<Module>> CachedModule =
+        parseBitcodeFile((*Cached)->getMemBufferRef(), M->getContext());
+    if (CachedModule) {
+      // The module ID seeds the random number generators of later passes.
+      (*CachedModule)->setModuleIdentifier(M->getModuleIdentifier());
+      M = std::move(*CachedModule);
+      return;
+    }
+    message(LDPL_WARNING, "Ignoring invalid data randomization cache entry "
+                          "%s: %s",
+            EntryPath.c_str(), CachedModule.getError().message().c_str());
+    sys::fs::remove(EntryPath);
+  } else if (Cached.getError() != std::errc::no_such_file_or_directory) {
+    message(LDPL_WARNING, "Ignoring unreadable data randomization cache entry "
+                          "%s: %s",
+            EntryPath.c_str(), Cached.getError().message().c_str());
+    sys::fs::remove(EntryPath);
+  }
 
   legacy::PassManager passes;
   passes.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+  addDataRandoPasses(passes);
+  passes.run(*M);
+
+  // Write the entry under a temporary name and rename it into place, so that
+  // concurrent links never read a partially written entry.
+  std::error_code EC =
+      sys::fs::create_directories(options::data_rando_cache_dir);
+  int FD;
+  SmallString<128> TempPath;
+  if (!EC)
+    EC = sys::fs::createUniqueFile(EntryPath + ".%%%%%%.tmp", FD, TempPath);
+  if (EC) {
+    message(LDPL_WARNING, "Could not write data randomization cache entry %s: %s",
+            EntryPath.c_str(), EC.message().c_str());
+    return;
+  }
+  {
+    raw_fd_ostream OS(FD, true);
+    WriteBitcodeToFile(M.get(), OS, /* ShouldPreserveUseListOrder */ true);
+  }
+  EC = sys::fs::rename(TempPath, EntryPath);
+  if (EC) {
+    sys::fs::remove(TempPath);
+    message(LDPL_WARNING, "Could not write data randomization cache entry %s: %s",
+            EntryPath.c_str(), EC.message().c_str());
+  }
+}
 
-  PassManagerBuilder PMB;
+static void initPassManagerBuilder(PassManagerBuilder &PMB,
+                                   TargetMachine &TM) {
   PMB.LibraryInfo = new TargetLibraryInfoImpl(Triple(TM.getTargetTriple()));
   PMB.Inliner = createFunctionInliningPass();
+  PMB.LoopVectorize = !options::DisableVectorization;
+  PMB.SLPVectorize = !options::DisableVectorization;
+  PMB.OptLevel = options::OptLevel;
+}
+
+static void runLTOPasses(std::unique_ptr<Module> &M, TargetMachine &TM) {
+  M->setDataLayout(TM.createDataLayout());
+
+  legacy::PassManager passes;
+  passes.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+
+  PassManagerBuilder PMB;
+  initPassManagerBuilder(PMB, TM);
   // Unconditionally verify input since it is not verified before this
   // point and has unknown origin.
   PMB.VerifyInput = true;
   PMB.VerifyOutput = !options::DisableVerify;
-  PMB.LoopVectorize = !options::DisableVectorization;
-  PMB.SLPVectorize = !options::DisableVectorization;
-  PMB.OptLevel = options::OptLevel;
 
-  Module *mergedModule = &M;
+  Module *mergedModule = M.get();
 
   std::unique_ptr<RandomNumberGenerator> RNG(mergedModule->createRNG());
 
@@ -785,29 +1036,46 @@ static void runLTOPasses(Module &M, TargetMachine &TM) {
     // they depend on.
     LoopInfoWrapperPass();
   }
-  if (options::DataRando) {
-    if (options::DataRandoContextSensitive) {
-      passes.add(new CSDataRando());
-    } else {
-      passes.add(new DataRando());
+  if (options::DataRando && !options::data_rando_cache_dir.empty()) {
+    // Data randomization runs separately so that the optimized module it starts
+    // from can be looked up in the cache.
+    passes.run(*M);
+    runDataRandoWithCache(M, TM);
+    if (options::HeapChecks) {
+      legacy::PassManager HeapChecksPasses;
+      HeapChecksPasses.add(
+          new TargetLibraryInfoWrapperPass(Triple(TM.getTargetTriple())));
+      HeapChecksPasses.add(
+          createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+      HeapChecksPasses.add(createHeapChecksPass());
+      HeapChecksPasses.run(*M);
     }
+    return;
+  }
+  if (options::DataRando) {
+    addDataRandoPasses(passes);
   }
   if (options::HeapChecks) {
     passes.add(createHeapChecksPass());
   }
-  passes.run(M);
+  passes.run(*M);
 }
 
-static void saveBCFile(StringRef Path, Module &M) {
+static std::error_code writeBCFile(StringRef Path, Module &M) {
   std::error_code EC;
   raw_fd_ostream OS(Path, EC, sys::fs::OpenFlags::F_None);
-  if (EC)
+  if (!EC)
+    WriteBitcodeToFile(&M, OS, /* ShouldPreserveUseListOrder */ false);
+  return EC;
+}
+
+static void saveBCFile(StringRef Path, Module &M) {
+  if (writeBCFile(Path, M))
     message(LDPL_FATAL, "Failed to write the output file.");
-  WriteBitcodeToFile(&M, OS, /* ShouldPreserveUseListOrder */ false);
 }
 
-static void codegen(std::unique_ptr<Module> M) {
-  const std::string &TripleStr = M->getTargetTriple();
+static std::unique_ptr<TargetMachine> createTargetMachine(const Module &M) {
+  const std::string &TripleStr = M.getTargetTriple();
   Triple TheTriple(TripleStr);
 
   std::string ErrMsg;
@@ -815,9 +1083,6 @@ static void codegen(std::unique_ptr<Module> M) {
   if (!TheTarget)
     message(LDPL_FATAL, "Target not found: %s", ErrMsg.c_str());
 
-  if (unsigned NumOpts = options::extra.size())
-    cl::ParseCommandLineOptions(NumOpts, &options::extra[0]);
-
   SubtargetFeatures Features;
   Features.getDefaultSubtargetFeatures(TheTriple);
   for (const std::string &A : MAttrs)
@@ -839,52 +1104,72 @@ static void codegen(std::unique_ptr<Module> M) {
     CGOptLevel = CodeGenOpt::Aggressive;
     break;
   }
-  std::unique_ptr<TargetMachine> TM(TheTarget->createTargetMachine(
+  return std::unique_ptr<TargetMachine>(TheTarget->createTargetMachine(
       TripleStr, options::mcpu, Features.getString(), Options, RelocationModel,
       CodeModel::Default, CGOptLevel));
+}
 
-  runLTOPasses(*M, *TM);
-
-  if (options::TheOutputType == options::OT_SAVE_TEMPS)
-    saveBCFile(output_name + ".opt.bc", *M);
-
+/// The name of the object file to generate code into, or an empty string if a
+/// temporary file should be used.
+static SmallString<128> getOutputFilename() {
   SmallString<128> Filename;
   if (!options::obj_path.empty())
     Filename = options::obj_path;
   else if (options::TheOutputType == options::OT_SAVE_TEMPS)
     Filename = output_name + ".o";
+  return Filename;
+}
+
+/// Open Filename for writing, or a new temporary file if TempOutFile is set,
+/// in which case Filename is set to its name.
+static int openOutputFile(SmallString<128> &Filename, bool TempOutFile) {
+  int FD;
+  if (TempOutFile) {
+    std::error_code EC =
+        sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
+    if (EC)
+      message(LDPL_FATAL, "Could not create temporary file: %s",
+              EC.message().c_str());
+  } else {
+    std::error_code EC =
+        sys::fs::openFileForWrite(Filename, FD, sys::fs::F_None);
+    if (EC)
+      message(LDPL_FATAL, "Could not open file: %s", EC.message().c_str());
+  }
+  return FD;
+}
+
+static void codegen(std::unique_ptr<Module> M) {
+  std::unique_ptr<TargetMachine> TM = createTargetMachine(*M);
+
+  runLTOPasses(M, *TM);
 
-  std::vector<SmallString<128>> Filenames(options::Parallelism);
+  if (options::TheOutputType == options::OT_SAVE_TEMPS)
+    saveBCFile(output_name + ".opt.bc", *M);
+
+  SmallString<128> Filename = getOutputFilename();
+  unsigned Parallelism = options::Parallelism ? options::Parallelism : 1;
+  std::vector<SmallString<128>> Filenames(Parallelism);
   bool TempOutFile = Filename.empty();
   {
     // Open a file descriptor for each backend thread. This is done in a block
     // so that the output file descriptors are closed before gold opens them.
     std::list<llvm::raw_fd_ostream> OSs;
-    std::vector<llvm::raw_pwrite_stream *> OSPtrs(options::Parallelism);
-    for (unsigned I = 0; I != options::Parallelism; ++I) {
-      int FD;
-      if (TempOutFile) {
-        std::error_code EC =
-            sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filenames[I]);
-        if (EC)
-          message(LDPL_FATAL, "Could not create temporary file: %s",
-                  EC.message().c_str());
-      } else {
+    std::vector<llvm::raw_pwrite_stream *> OSPtrs(Parallelism);
+    for (unsigned I = 0; I != Parallelism; ++I) {
+      if (!TempOutFile) {
         Filenames[I] = Filename;
-        if (options::Parallelism != 1)
+        if (Parallelism != 1)
           Filenames[I] += utostr(I);
-        std::error_code EC =
-            sys::fs::openFileForWrite(Filenames[I], FD, sys::fs::F_None);
-        if (EC)
-          message(LDPL_FATAL, "Could not open file: %s", EC.message().c_str());
       }
-      OSs.emplace_back(FD, true);
+      OSs.emplace_back(openOutputFile(Filenames[I], TempOutFile), true);
       OSPtrs[I] = &OSs.back();
     }
 
     // Run backend threads.
-    splitCodeGen(std::move(M), OSPtrs, options::mcpu, Features.getString(),
-                 Options, RelocationModel, CodeModel::Default, CGOptLevel);
+    splitCodeGen(std::move(M), OSPtrs, options::mcpu,
+                 TM->getTargetFeatureString(), TM->Options, RelocationModel,
+                 CodeModel::Default, TM->getOptLevel());
   }
 
   for (auto &Filename : Filenames) {
@@ -897,6 +1182,281 @@ static void codegen(std::unique_ptr<Module> M) {
   }
 }
 
+namespace {
+/// A module optimized and compiled by its own ThinLTO backend thread.
+struct ThinLTOModule {
+  // Each backend has its own context, since contexts are not thread safe.
+  std::unique_ptr<LLVMContext> Context;
+  std::unique_ptr<Module> M;
+  // The ID of the module in the combined index.
+  uint64_t ModuleId;
+  SmallString<128> Filename;
+  bool TempOutFile;
+  int FD;
+  // The diagnostics of the backend. gold's callbacks are not thread safe, so
+  // the main thread reports them once all backends have finished.
+  std::vector<std::pair<ld_plugin_level, std::string>> Diagnostics;
+};
+}
+
+static void recordThinLTODiagnostic(ThinLTOModule &TLM, ld_plugin_level Level,
+                                    const Twine &Msg) {
+  TLM.Diagnostics.emplace_back(Level, Msg.str());
+}
+
+static void thinLTODiagnosticHandler(const DiagnosticInfo &DI,
+                                     void *Context) {
+  std::string ErrStorage;
+  if (!printDiagnostic(DI, ErrStorage))
+    return;
+  ld_plugin_level Level;
+  switch (DI.getSeverity()) {
+  case DS_Error:
+    Level = LDPL_ERROR;
+    break;
+  case DS_Warning:
+    Level = LDPL_WARNING;
+    break;
+  case DS_Note:
+  case DS_Remark:
+    Level = LDPL_INFO;
+    break;
+  }
+  recordThinLTODiagnostic(*static_cast<ThinLTOModule *>(Context), Level,
+                          "LLVM gold plugin: " + ErrStorage);
+}
+
+/// Lazily load the module at ModulePath in the combined index, so that
+/// functions can be imported from it. Views holds the bitcode of each module,
+/// which the main thread has already read in full, so this only fails if the
+/// backend runs out of resources. The error is then recorded for TLM and an
+/// empty module is returned.
+static std::unique_ptr<Module>
+loadModuleForImport(ThinLTOModule &TLM, const StringMap<StringRef> &Views,
+                    StringRef ModulePath) {
+  auto I = Views.find(ModulePath);
+  assert(I != Views.end() && "Module in the index was not claimed");
+
+  // The importer links in the metadata after importing all functions.
+  LLVMContext &Context = *TLM.Context;
+  ErrorOr<std::unique_ptr<Module>> MOrErr = getLazyBitcodeModule(
+      MemoryBuffer::getMemBuffer(MemoryBufferRef(I->second, ModulePath), false),
+      Context, /* ShouldLazyLoadMetadata */ true);
+  if (std::error_code EC = MOrErr.getError()) {
+    recordThinLTODiagnostic(TLM, LDPL_ERROR,
+                            "Could not read bitcode from file " + ModulePath +
+                                ": " + EC.message());
+    return llvm::make_unique<Module>(ModulePath, Context);
+  }
+  return std::move(*MOrErr);
+}
+
+static void runThinLTOPasses(Module &M, TargetMachine &TM) {
+  M.setDataLayout(TM.createDataLayout());
+
+  legacy::PassManager passes;
+  passes.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+  passes.add(createVerifierPass());
+
+  PassManagerBuilder PMB;
+  initPassManagerBuilder(PMB, TM);
+
+  if (multicompiler::RandomizeFunctionList) {
+    std::unique_ptr<RandomNumberGenerator> RNG(M.createRNG());
+    RNG->shuffle<Function>(M.getFunctionList());
+  }
+
+  PMB.populateModulePassManager(passes);
+  if (!options::DisableVerify)
+    passes.add(createVerifierPass());
+  passes.run(M);
+}
+
+/// Import functions into the module of TLM from the other modules of the
+/// link, optimize it and generate code for it. This runs on a backend thread,
+/// so it must not call back into gold: errors are recorded in TLM instead.
+static void runThinLTOBackend(ThinLTOModule &TLM,
+                              const FunctionInfoIndex &CombinedIndex,
+                              const StringMap<StringRef> &Views) {
+  // The stream owns the output file descriptor, so it is closed even if the
+  // backend fails.
+  raw_fd_ostream OS(TLM.FD, true);
+  Module &M = *TLM.M;
+  std::unique_ptr<TargetMachine> TM = createTargetMachine(M);
+
+  // Promote the locals that other modules may import references to.
+  if (renameModuleForThinLTO(M, &CombinedIndex)) {
+    recordThinLTODiagnostic(TLM, LDPL_ERROR,
+                            "Failed to rename module " +
+                                M.getModuleIdentifier() + " for ThinLTO");
+    return;
+  }
+
+  FunctionImporter Importer(CombinedIndex, [&](StringRef ModulePath) {
+    return loadModuleForImport(TLM, Views, ModulePath);
+  });
+  Importer.importFunctions(M);
+
+  // The diversifying passes salt their random number generators with the file
+  // name of the module identifier, which inputs in different directories or
+  // archives can share. Name each module after its ID in the combined index,
+  // like the merged module of a full LTO link is named ld-temp.o, so that every
+  // backend derives its own seeds from -random-seed.
+  M.setModuleIdentifier(("ld-temp." + Twine(TLM.ModuleId) + ".o").str());
+
+  runThinLTOPasses(M, *TM);
+
+  if (options::TheOutputType == options::OT_SAVE_TEMPS) {
+    std::string Path = output_name + "." + utostr(TLM.ModuleId) + ".opt.bc";
+    if (std::error_code EC = writeBCFile(Path, M))
+      recordThinLTODiagnostic(TLM, LDPL_ERROR, "Failed to write " + Path +
+                                                   ": " + EC.message());
+  }
+
+  {
+    legacy::PassManager CodeGenPasses;
+    if (TM->addPassesToEmitFile(CodeGenPasses, OS,
+                                TargetMachine::CGFT_ObjectFile)) {
+      recordThinLTODiagnostic(TLM, LDPL_ERROR, "Failed to setup codegen");
+      return;
+    }
+    CodeGenPasses.run(M);
+  }
+
+  TLM.M.reset();
+  TLM.Context.reset();
+}
+
+/// Optimize and generate code for each module on its own backend thread,
+/// importing functions from the other modules as suggested by the combined
+/// function index. Unlike a full LTO link, the time spent grows with the
+/// size of the largest module rather than of the whole program.
+static void thinLTOBackends(raw_fd_ostream *ApiFile) {
+  if (options::DataRando || options::HeapChecks)
+    message(LDPL_FATAL,
+            "data-rando and heap-checks need the whole program and cannot be "
+            "used with thinlto");
+  if (options::TheOutputType == options::OT_BC_ONLY)
+    message(LDPL_FATAL, "emit-llvm cannot be used with thinlto");
+
+  std::string DefaultTriple = sys::getDefaultTargetTriple();
+
+  // Everything that calls back into gold, or depends on the order of the
+  // modules, is done here: reading the symbol resolutions, resolving common
+  // symbols across modules and building the combined index. The input files
+  // stay open so that their views can be read by the backends.
+  std::list<PluginInputFile> InputFiles;
+  StringMap<StringRef> Views;
+  FunctionInfoIndex CombinedIndex;
+  std::list<ThinLTOModule> Tasks;
+  uint64_t NextModuleId = 0;
+  for (claimed_file &F : Modules) {
+    InputFiles.emplace_back(F.handle);
+    ld_plugin_input_file &Info = InputFiles.back().file();
+    const void *View = getSymbolsAndView(F);
+    std::string ModulePath = getModulePath(Info);
+    ErrorOr<MemoryBufferRef> BCOrErr =
+        object::IRObjectFile::findBitcodeInMemBuffer(MemoryBufferRef(
+            StringRef((const char *)View, Info.filesize), ModulePath));
+    if (std::error_code EC = BCOrErr.getError())
+      message(LDPL_FATAL, "Could not read bitcode from file : %s",
+              EC.message().c_str());
+    Views[ModulePath] = BCOrErr->getBuffer();
+
+    Tasks.emplace_back();
+    ThinLTOModule &TLM = Tasks.back();
+    TLM.ModuleId = ++NextModuleId;
+
+    // Modules without a function summary are still compiled, but nothing is
+    // imported from them.
+    if (std::unique_ptr<FunctionInfoIndex> Index =
+            getFunctionIndexForFile(View, Info, ModulePath))
+      CombinedIndex.mergeFrom(std::move(Index), TLM.ModuleId);
+
+    TLM.Context.reset(new LLVMContext);
+    TLM.Context->setDiagnosticHandler(diagnosticHandlerForContext, nullptr,
+                                      true);
+
+    // Symbols only used by IR are not internalized, since the other modules
+    // may still import references to them.
+    StringSet<> Internalize;
+    StringSet<> Maybe;
+    std::vector<GlobalValue *> Keep;
+    std::unique_ptr<Module> M = getModuleForFile(
+        *TLM.Context, F, View, Info, ApiFile, Internalize, Maybe, Keep);
+    if (!options::triple.empty())
+      M->setTargetTriple(options::triple.c_str());
+    else if (M->getTargetTriple().empty())
+      M->setTargetTriple(DefaultTriple);
+
+    // Drop the definitions that were resolved to other modules by moving only
+    // the kept values into a module named as in the combined index.
+    TLM.M.reset(new Module(ModulePath, *TLM.Context));
+    IRMover L(*TLM.M);
+    if (L.move(*M, Keep, [](GlobalValue &, IRMover::ValueAdder) {}))
+      message(LDPL_FATAL, "Failed to link module");
+
+    // From here on the context is only used by the backend thread, which
+    // records its diagnostics for the main thread to report.
+    TLM.Context->setDiagnosticHandler(thinLTODiagnosticHandler, &TLM, true);
+  }
+
+  if (options::TheOutputType == options::OT_DISABLE)
+    return;
+
+  if (options::TheOutputType == options::OT_SAVE_TEMPS) {
+    std::error_code EC;
+    raw_fd_ostream OS(output_name + ".thinlto.bc", EC,
+                      sys::fs::OpenFlags::F_None);
+    if (EC)
+      message(LDPL_FATAL, "Unable to open %s.thinlto.bc for writing: %s",
+              output_name.data(), EC.message().c_str());
+    WriteFunctionSummaryToFile(CombinedIndex, OS);
+  }
+
+  SmallString<128> Filename = getOutputFilename();
+  for (ThinLTOModule &TLM : Tasks) {
+    TLM.TempOutFile = Filename.empty();
+    if (!TLM.TempOutFile) {
+      TLM.Filename = Filename;
+      TLM.Filename += utostr(TLM.ModuleId);
+    }
+    TLM.FD = openOutputFile(TLM.Filename, TLM.TempOutFile);
+  }
+
+  {
+    // The pool waits for all backends to finish when it is destroyed.
+    unsigned Jobs = options::Parallelism
+                        ? options::Parallelism
+                        : std::max(std::thread::hardware_concurrency(), 1u);
+    ThreadPool Backends(Jobs);
+    for (ThinLTOModule &TLM : Tasks)
+      Backends.async(runThinLTOBackend, std::ref(TLM), std::cref(CombinedIndex),
+                     std::cref(Views));
+  }
+
+  // Report the diagnostics of the backends in module order, and fail the link
+  // only once all of them have been printed.
+  bool Failed = false;
+  for (ThinLTOModule &TLM : Tasks) {
+    for (const auto &Diagnostic : TLM.Diagnostics) {
+      message(Diagnostic.first, "%s", Diagnostic.second.c_str());
+      Failed |= Diagnostic.first == LDPL_ERROR;
+    }
+  }
+  if (Failed)
+    message(LDPL_FATAL, "ThinLTO backend failed");
+
+  for (ThinLTOModule &TLM : Tasks) {
+    if (add_input_file(TLM.Filename.c_str()) != LDPS_OK)
+      message(LDPL_FATAL,
+              "Unable to add .o file to the link. File left behind in: %s",
+              TLM.Filename.c_str());
+    if (TLM.TempOutFile)
+      Cleanup.push_back(TLM.Filename.c_str());
+  }
+}
+
 /// gold informs us that all symbols have been read. At this point, we use
 /// get_symbols to see if any of our definitions have been overridden by a
 /// native object file. Then, perform optimization and codegen.
@@ -904,17 +1464,18 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
   if (Modules.empty())
     return LDPS_OK;
 
-  // If we are doing ThinLTO compilation, simply build the combined
+  // If we are only writing the ThinLTO index, simply build the combined
   // function index/summary and emit it. We don't need to parse the modules
   // and link them in this case.
-  if (options::thinlto) {
+  if (options::thinlto_index_only) {
     FunctionInfoIndex CombinedIndex;
     uint64_t NextModuleId = 0;
     for (claimed_file &F : Modules) {
       PluginInputFile InputFile(F.handle);
 
-      std::unique_ptr<FunctionInfoIndex> Index =
-          getFunctionIndexForFile(F, InputFile.file());
+      std::unique_ptr<FunctionInfoIndex> Index = getFunctionIndexForFile(
+          getSymbolsAndView(F), InputFile.file(),
+          getModulePath(InputFile.file()));
 
       // Skip files without a function summary.
       if (Index)
@@ -934,6 +1495,14 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
     exit(0);
   }
 
+  if (options::thinlto) {
+    thinLTOBackends(ApiFile);
+    if (!options::extra_library_path.empty() &&
+        set_extra_library_path(options::extra_library_path.c_str()) != LDPS_OK)
+      message(LDPL_FATAL, "Unable to set the extra library path.");
+    return LDPS_OK;
+  }
+
   LLVMContext Context;
   Context.setDiagnosticHandler(diagnosticHandlerForContext, nullptr, true);
 
@@ -947,8 +1516,9 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
   for (claimed_file &F : Modules) {
     PluginInputFile InputFile(F.handle);
     std::vector<GlobalValue *> Keep;
-    std::unique_ptr<Module> M = getModuleForFile(
-        Context, F, InputFile.file(), ApiFile, Internalize, Maybe, Keep);
+    std::unique_ptr<Module> M =
+        getModuleForFile(Context, F, getSymbolsAndView(F), InputFile.file(),
+                         ApiFile, Internalize, Maybe, Keep);
     if (!options::triple.empty())
       M->setTargetTriple(options::triple.c_str());
     else if (M->getTargetTriple().empty())
@@ -958,6 +1528,9 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
       message(LDPL_FATAL, "Failed to link module");
   }
 
+  if (multicompiler::ShuffleGlobals || multicompiler::ReverseGlobals)
+    defineCommonSymbols(*Combined, Internalize);
+
   for (const auto &Name : Internalize) {
     GlobalValue *GV = Combined->getNamedValue(Name.first());
     if (GV)
@@ -997,6 +1570,16 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
 }
 
 static ld_plugin_status all_symbols_read_hook(void) {
+  if (unsigned NumOpts = options::extra.size())
+    cl::ParseCommandLineOptions(NumOpts, &options::extra[0]);
+
+  // The objects generated below from bitcode are added to the link after
+  // this, so only the separately compiled objects are reordered. Functions
+  // from a full LTO link are already shuffled in IR by
+  // -randomize-function-list.
+  if (options::shuffle_function_sections)
+    shuffleSections();
+
   ld_plugin_status Ret;
   if (!options::generate_api_file) {
     Ret = allSymbolsReadHook(nullptr);
@@ -0,0 +1,291 @@
+//===-- llvm-diversity-diff.cpp - Compare diversity manifests -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program compares the diversity manifests of two variants of a program
+// and reports, for every kind of decision, how many decisions the variants
+// share. The inputs are objects or executables built with -diversity-manifest,
+// or raw manifests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/MultiCompiler/DiversityManifest.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace multicompiler;
+
+static cl::list<std::string> InputFilenames(cl::Positional,
+                                            cl::desc("<variant a> <variant b>"),
+                                            cl::OneOrMore);
+
+static cl::opt<bool> Dump("dump",
+                          cl::desc("Print the manifests of the inputs instead "
+                                   "of comparing them"));
+
+static cl::opt<bool> Verbose("v",
+                             cl::desc("List the functions whose decisions are "
+                                      "identical in both variants"));
+
+namespace {
+struct Variant {
+  std::unique_ptr<MemoryBuffer> Buffer;
+  std::vector<DiversityManifest> Manifests;
+  // Every record, keyed by module, kind, function and occurrence.
+  StringMap<const DecisionRecord *> Index;
+};
+
+struct KindStats {
+  uint64_t Records, Identical, Shared, Total;
+  KindStats() : Records(0), Identical(0), Shared(0), Total(0) {}
+};
+
+struct FunctionStats {
+  bool InBoth, Identical;
+  FunctionStats() : InBoth(true), Identical(true) {}
+};
+
+typedef std::vector<uint64_t> Decision;
+}
+
+static void reportError(StringRef File, const Twine &Message) {
+  errs() << "llvm-diversity-diff: " << File << ": " << Message << '\n';
+  exit(1);
+}
+
+static void loadVariant(StringRef File, Variant &V) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFileOrSTDIN(File);
+  if (std::error_code EC = BufferOrErr.getError())
+    reportError(File, EC.message());
+  V.Buffer = std::move(*BufferOrErr);
+
+  StringRef Data = V.Buffer->getBuffer();
+  std::unique_ptr<object::ObjectFile> Obj;
+  if (!Data.startswith("MCDM")) {
+    ErrorOr<std::unique_ptr<object::ObjectFile>> ObjOrErr =
+        object::ObjectFile::createObjectFile(V.Buffer->getMemBufferRef());
+    if (std::error_code EC = ObjOrErr.getError())
+      reportError(File, EC.message());
+    Obj = std::move(*ObjOrErr);
+    Data = StringRef();
+    bool Found = false;
+    for (const object::SectionRef &Sec : Obj->sections()) {
+      StringRef Name;
+      if (Sec.getName(Name) || Name != DiversityManifestSection)
+        continue;
+      if (std::error_code EC = Sec.getContents(Data))
+        reportError(File, EC.message());
+      Found = true;
+      break;
+    }
+    if (!Found)
+      reportError(File, Twine("no ") + DiversityManifestSection + " section");
+  }
+
+  std::string Error;
+  if (!DiversityManifest::read(Data, V.Manifests, Error))
+    reportError(File, Error);
+
+  for (const DiversityManifest &M : V.Manifests) {
+    for (const DecisionRecord &R : M.Records) {
+      std::string Key = M.ModuleID + '\0' + char('0' + R.Kind) + '\0' +
+                        R.Function + '\0';
+      for (unsigned Occurrence = 0;; ++Occurrence) {
+        std::string K = Key + std::to_string(Occurrence);
+        if (V.Index.insert(std::make_pair(K, &R)).second)
+          break;
+      }
+    }
+  }
+}
+
+// Return the number of values that make up one decision of Kind.
+static unsigned getDecisionWidth(DecisionKind Kind) {
+  switch (Kind) {
+  case DK_NOPInsertion:
+  case DK_EquivSubst:
+  case DK_RegisterOrder:
+    return 2;
+  default:
+    return 1;
+  }
+}
+
+static std::vector<Decision> getDecisions(const DecisionRecord *R) {
+  std::vector<Decision> Decisions;
+  if (!R)
+    return Decisions;
+  unsigned Width = getDecisionWidth(R->Kind);
+  for (size_t I = 0; I + Width <= R->Values.size(); I += Width)
+    Decisions.emplace_back(R->Values.begin() + I,
+                           R->Values.begin() + I + Width);
+  return Decisions;
+}
+
+// Compare the records of the two variants for the same key, either of which
+// may be missing. Layouts share the decisions at the same position; sets of
+// choices share the decisions both variants made.
+static void compareRecords(DecisionKind Kind, const DecisionRecord *A,
+                           const DecisionRecord *B, KindStats &KS,
+                           FunctionStats &FS) {
+  ++KS.Records;
+  std::vector<Decision> DA = getDecisions(A), DB = getDecisions(B);
+  uint64_t Shared = 0, Total;
+  if (isLayoutDecision(Kind)) {
+    for (size_t I = 0, E = std::min(DA.size(), DB.size()); I != E; ++I)
+      if (DA[I] == DB[I])
+        ++Shared;
+    Total = std::max(DA.size(), DB.size());
+  } else {
+    std::sort(DA.begin(), DA.end());
+    std::sort(DB.begin(), DB.end());
+    std::vector<Decision> Common;
+    std::set_intersection(DA.begin(), DA.end(), DB.begin(), DB.end(),
+                          std::back_inserter(Common));
+    Shared = Common.size();
+    Total = DA.size() + DB.size() - Shared;
+  }
+  KS.Shared += Shared;
+  KS.Total += Total;
+
+  bool Identical = A && B && A->Values == B->Values;
+  if (Identical)
+    ++KS.Identical;
+  if (!A || !B)
+    FS.InBoth = false;
+  FS.Identical &= Identical;
+}
+
+static void printPercent(uint64_t Part, uint64_t Whole) {
+  if (!Whole)
+    outs() << "      -";
+  else
+    outs() << format("%6.2f%%", 100.0 * Part / Whole);
+}
+
+static void printSeeds(StringRef Name, const Variant &V) {
+  outs() << Name << ':';
+  for (const DiversityManifest &M : V.Manifests)
+    outs() << ' ' << M.ModuleID << " (seed " << M.Seed << ')';
+  outs() << '\n';
+}
+
+static void dumpVariant(const Variant &V) {
+  for (const DiversityManifest &M : V.Manifests) {
+    outs() << "module " << M.ModuleID << " seed " << M.Seed << '\n';
+    for (const DecisionRecord &R : M.Records) {
+      outs() << "  " << getDecisionKindName(R.Kind);
+      if (!R.Function.empty())
+        outs() << ' ' << R.Function;
+      outs() << ':';
+      for (uint64_t Value : R.Values)
+        outs() << ' ' << Value;
+      outs() << '\n';
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+
+  cl::ParseCommandLineOptions(argc, argv, "diversity manifest comparator\n");
+
+  if (Dump) {
+    for (const std::string &File : InputFilenames) {
+      Variant V;
+      loadVariant(File, V);
+      dumpVariant(V);
+    }
+    return 0;
+  }
+
+  if (InputFilenames.size() != 2) {
+    errs() << "llvm-diversity-diff: expected two variants\n";
+    return 1;
+  }
+
+  Variant A, B;
+  loadVariant(InputFilenames[0], A);
+  loadVariant(InputFilenames[1], B);
+
+  KindStats Kinds[DK_NumKinds];
+  std::map<std::string, FunctionStats> Functions;
+  auto Compare = [&](const std::string &ModuleID, const DecisionRecord &R,
+                     const DecisionRecord *RA, const DecisionRecord *RB) {
+    FunctionStats Ignored;
+    FunctionStats &FS =
+        R.Function.empty() ? Ignored
+                           : Functions[ModuleID + '\0' + R.Function];
+    compareRecords(R.Kind, RA, RB, Kinds[R.Kind], FS);
+  };
+
+  for (const auto &Entry : A.Index) {
+    const DecisionRecord *RA = Entry.getValue();
+    const DecisionRecord *RB = B.Index.lookup(Entry.getKey());
+    Compare(Entry.getKey().split('\0').first, *RA, RA, RB);
+  }
+  for (const auto &Entry : B.Index) {
+    if (A.Index.count(Entry.getKey()))
+      continue;
+    const DecisionRecord *RB = Entry.getValue();
+    Compare(Entry.getKey().split('\0').first, *RB, nullptr, RB);
+  }
+
+  printSeeds("a", A);
+  printSeeds("b", B);
+  outs() << left_justify("kind", 16) << right_justify("records", 9)
+         << right_justify("identical", 11) << right_justify("shared", 13)
+         << right_justify("decisions", 13) << '\n';
+  uint64_t Shared = 0, Total = 0;
+  for (unsigned K = 0; K != DK_NumKinds; ++K) {
+    const KindStats &S = Kinds[K];
+    if (!S.Records)
+      continue;
+    outs() << left_justify(getDecisionKindName(DecisionKind(K)), 16)
+           << format_decimal(S.Records, 9) << format_decimal(S.Identical, 11)
+           << format_decimal(S.Shared, 13) << format_decimal(S.Total, 13)
+           << ' ';
+    printPercent(S.Shared, S.Total);
+    outs() << '\n';
+    Shared += S.Shared;
+    Total += S.Total;
+  }
+  outs() << left_justify("total", 36) << format_decimal(Shared, 13)
+         << format_decimal(Total, 13) << ' ';
+  printPercent(Shared, Total);
+  outs() << '\n';
+
+  unsigned NumIdentical = 0;
+  for (const auto &F : Functions)
+    if (F.second.InBoth && F.second.Identical)
+      ++NumIdentical;
+  outs() << "functions with identical decisions: " << NumIdentical << " of "
+         << Functions.size() << '\n';
+  if (Verbose)
+    for (const auto &F : Functions)
+      if (F.second.InBoth && F.second.Identical)
+        outs() << "  " << StringRef(F.first).split('\0').second << '\n';
+  return 0;
+}
@@ -0,0 +1,170 @@
+//===- unittests/DataRando/MaskedStringsTest.cpp --------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Smoke tests for the vectorized drrt_vec_* wrappers of DataRandoStrings_rt.
+// Each wrapper is run on encrypted, misaligned buffers and checked against
+// libc on the plain contents.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DataRando/Runtime/DataRandoTypes.h"
+#include "gtest/gtest.h"
+#include <cstring>
+
+extern "C" {
+size_t drrt_vec_strlen(const char *S, mask_t M);
+int drrt_vec_strcmp(const char *A, const char *B, mask_t MA, mask_t MB);
+int drrt_vec_strncmp(const char *A, const char *B, size_t N, mask_t MA,
+                     mask_t MB);
+int drrt_vec_memcmp(const void *A, const void *B, size_t N, mask_t MA,
+                    mask_t MB);
+void *drrt_vec_memchr(const void *S, int C, size_t N, mask_t MRet, mask_t MS);
+void *drrt_vec_memset(void *P, int C, size_t N, mask_t MRet, mask_t MP);
+void *drrt_vec_memmove(void *D, const void *S, size_t N, mask_t MRet,
+                       mask_t MD, mask_t MS);
+char *drrt_vec_strcpy(char *D, const char *S, mask_t MRet, mask_t MD,
+                      mask_t MS);
+}
+
+namespace {
+
+const mask_t MaskA = 0x0123456789abcdefULL;
+const mask_t MaskB = 0xf0e1d2c3b4a59687ULL;
+
+// The byte at address P of an object with mask M is encrypted with byte P % 8
+// of M, so encryption and decryption are the same operation.
+void crypt(void *P, size_t N, mask_t M) {
+  unsigned char *C = static_cast<unsigned char *>(P);
+  for (size_t I = 0; I != N; ++I)
+    C[I] ^= (unsigned char)(M >> (((uintptr_t)(C + I) & 7) * 8));
+}
+
+// Buffers large enough for the 16-byte blocks of the wrappers to run, at
+// every offset within a block.
+struct Buffers {
+  alignas(16) char A[128];
+  alignas(16) char B[128];
+};
+
+void fill(char *P, size_t N, unsigned Seed) {
+  for (size_t I = 0; I != N; ++I)
+    P[I] = 'a' + (I * 7 + Seed) % 26;
+}
+
+TEST(MaskedStringsTest, strlen) {
+  for (mask_t M : {mask_t(0), MaskA}) {
+    for (unsigned Off = 0; Off != 16; ++Off) {
+      for (size_t Len = 0; Len != 70; ++Len) {
+        Buffers Buf;
+        char *S = Buf.A + Off;
+        fill(S, Len, Off);
+        S[Len] = '\0';
+        crypt(S, Len + 1, M);
+        EXPECT_EQ(Len, drrt_vec_strlen(S, M)) << "offset " << Off;
+      }
+    }
+  }
+}
+
+TEST(MaskedStringsTest, compare) {
+  for (unsigned Off = 0; Off != 16; ++Off) {
+    for (size_t Len = 1; Len != 50; ++Len) {
+      for (int Delta : {-1, 0, 1}) {
+        Buffers Buf;
+        char *A = Buf.A + Off, *B = Buf.B + (Off * 3) % 16;
+        fill(A, Len, 0);
+        fill(B, Len, 0);
+        A[Len] = B[Len] = '\0';
+        B[Len - 1] += Delta;
+        int Str = strcmp(A, B), StrN = strncmp(A, B, Len - 1),
+            Mem = memcmp(A, B, Len);
+        crypt(A, Len + 1, MaskA);
+        crypt(B, Len + 1, MaskB);
+        EXPECT_EQ(Str > 0, drrt_vec_strcmp(A, B, MaskA, MaskB) > 0);
+        EXPECT_EQ(Str < 0, drrt_vec_strcmp(A, B, MaskA, MaskB) < 0);
+        EXPECT_EQ(StrN == 0,
+                  drrt_vec_strncmp(A, B, Len - 1, MaskA, MaskB) == 0);
+        EXPECT_EQ(Mem > 0, drrt_vec_memcmp(A, B, Len, MaskA, MaskB) > 0);
+        EXPECT_EQ(Mem < 0, drrt_vec_memcmp(A, B, Len, MaskA, MaskB) < 0);
+      }
+    }
+  }
+}
+
+TEST(MaskedStringsTest, memchr) {
+  for (unsigned Off = 0; Off != 16; ++Off) {
+    Buffers Buf;
+    char *S = Buf.A + Off;
+    fill(S, 100, 0);
+    void *Expected = memchr(S, 'q', 100);
+    crypt(S, 100, MaskA);
+    EXPECT_EQ(Expected, drrt_vec_memchr(S, 'q', 100, 0, MaskA));
+    EXPECT_EQ(nullptr, drrt_vec_memchr(S, '#', 100, 0, MaskA));
+  }
+}
+
+TEST(MaskedStringsTest, memset) {
+  for (unsigned Off = 0; Off != 16; ++Off) {
+    for (size_t Len = 0; Len != 70; ++Len) {
+      Buffers Buf;
+      char *P = Buf.A + Off;
+      EXPECT_EQ(P, drrt_vec_memset(P, 'x', Len, 0, MaskA));
+      crypt(P, Len, MaskA);
+      for (size_t I = 0; I != Len; ++I)
+        ASSERT_EQ('x', P[I]) << "offset " << Off << " byte " << I;
+    }
+  }
+}
+
+TEST(MaskedStringsTest, memmove) {
+  // Distinct buffers, then overlapping moves in both directions.
+  for (unsigned Off = 0; Off != 16; ++Off) {
+    for (size_t Len = 0; Len != 70; ++Len) {
+      Buffers Buf;
+      char Expected[128];
+      char *S = Buf.A + Off, *D = Buf.B + (Off * 5) % 16;
+      fill(S, Len, Off);
+      memcpy(Expected, S, Len);
+      crypt(S, Len, MaskA);
+      EXPECT_EQ(D, drrt_vec_memmove(D, S, Len, 0, MaskB, MaskA));
+      crypt(D, Len, MaskB);
+      ASSERT_EQ(0, memcmp(Expected, D, Len)) << "offset " << Off;
+    }
+  }
+  for (int Shift : {-9, -1, 1, 9}) {
+    for (size_t Len = 0; Len != 70; ++Len) {
+      Buffers Buf;
+      char Plain[128];
+      fill(Buf.A, sizeof(Buf.A), 0);
+      memcpy(Plain, Buf.A, sizeof(Plain));
+      memmove(Plain + 20 + Shift, Plain + 20, Len);
+      crypt(Buf.A, sizeof(Buf.A), MaskA);
+      drrt_vec_memmove(Buf.A + 20 + Shift, Buf.A + 20, Len, 0, MaskA, MaskA);
+      crypt(Buf.A, sizeof(Buf.A), MaskA);
+      ASSERT_EQ(0, memcmp(Plain, Buf.A, sizeof(Plain))) << "shift " << Shift;
+    }
+  }
+}
+
+TEST(MaskedStringsTest, strcpy) {
+  for (unsigned Off = 0; Off != 16; ++Off) {
+    Buffers Buf;
+    char *S = Buf.A + Off, *D = Buf.B + (Off * 7) % 16;
+    fill(S, 40, Off);
+    S[40] = '\0';
+    char Expected[41];
+    memcpy(Expected, S, 41);
+    crypt(S, 41, MaskA);
+    EXPECT_EQ(D, drrt_vec_strcpy(D, S, 0, MaskB, MaskA));
+    crypt(D, 41, MaskB);
+    EXPECT_STREQ(Expected, D);
+  }
+}
+
+} // end anonymous namespace
@@ -0,0 +1,41 @@
+/*===- unittests/DataRando/RuntimeStub.c ----------------------------------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* Stand-in for the data randomization runtime, which defines its own wrappers
+|* under the drrt_ names. Each returns a value the real function never does.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/DataRando/Runtime/DataRandoTypes.h"
+
+#include <stddef.h>
+
+size_t drrt_strlen(const char *S, mask_t M) {
+  (void)S;
+  (void)M;
+  return (size_t)-1;
+}
+
+void *drrt_memmove(void *D, const void *S, size_t N, mask_t MRet, mask_t MD,
+                   mask_t MS) {
+  (void)D;
+  (void)S;
+  (void)N;
+  (void)MRet;
+  (void)MD;
+  (void)MS;
+  return NULL;
+}
+
+int drrt_access(const char *P, int Mode, mask_t M) {
+  (void)P;
+  (void)Mode;
+  (void)M;
+  return -2;
+}
@@ -0,0 +1,48 @@
+//===- unittests/DataRando/WrapperLinkTest.cpp ----------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// DataRandoStrings_rt is linked together with RuntimeStub.c, which defines
+// wrappers under the runtime's names. The link only succeeds if the two share
+// no symbols, and calls to the names the compiler uses must reach
+// DataRandoStrings_rt.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DataRando/Runtime/DataRandoTypes.h"
+#include "gtest/gtest.h"
+#include <unistd.h>
+
+extern "C" {
+size_t drrt_strlen(const char *S, mask_t M);
+void *drrt_memmove(void *D, const void *S, size_t N, mask_t MRet, mask_t MD,
+                   mask_t MS);
+int drrt_access(const char *P, int Mode, mask_t M);
+
+size_t drrt_vec_strlen(const char *S, mask_t M);
+void *drrt_vec_memmove(void *D, const void *S, size_t N, mask_t MRet,
+                       mask_t MD, mask_t MS);
+int drrt_gen_access(const char *P, int Mode, mask_t M);
+}
+
+namespace {
+
+TEST(WrapperLinkTest, vectorized) {
+  char D[4];
+  EXPECT_EQ(3u, drrt_vec_strlen("abc", 0));
+  EXPECT_EQ(D, drrt_vec_memmove(D, "abc", 4, 0, 0, 0));
+  EXPECT_EQ((size_t)-1, drrt_strlen("abc", 0));
+  EXPECT_EQ(nullptr, drrt_memmove(D, "abc", 4, 0, 0, 0));
+}
+
+TEST(WrapperLinkTest, generated) {
+  EXPECT_EQ(0, drrt_gen_access("/", F_OK, 0));
+  EXPECT_EQ(-2, drrt_access("/", F_OK, 0));
+}
+
+}
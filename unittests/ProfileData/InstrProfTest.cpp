@@ -7,6 +7,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/ProfileData/InstrProfWriter.h"
 #include "llvm/Support/Compression.h"
@@ -169,6 +173,50 @@ TEST_F(InstrProfTest, get_icall_data_read_write) {
   ASSERT_EQ(StringRef((const char *)VD[2].Value, 7), StringRef("callee1"));
 }
 
+TEST_F(InstrProfTest, annotate_value_site) {
+  InstrProfRecord Record("caller", 0x1234, {1, 2});
+  Record.reserveSites(IPVK_IndirectCallTarget, 2);
+  // No value profile data at the first site.
+  Record.addValueData(IPVK_IndirectCallTarget, 0, nullptr, 0, nullptr);
+  InstrProfValueData VD1[] = {{1000, 1}, {2000, 4}, {3000, 2}, {4000, 3}};
+  Record.addValueData(IPVK_IndirectCallTarget, 1, VD1, 4, nullptr);
+
+  LLVMContext Ctx;
+  std::unique_ptr<Module> M(new Module("annotate", Ctx));
+  FunctionType *FTy = FunctionType::get(Type::getVoidTy(Ctx), false);
+  Function *F = Function::Create(FTy, Function::ExternalLinkage, "caller",
+                                 M.get());
+  BasicBlock *BB = BasicBlock::Create(Ctx, "", F);
+  IRBuilder<> Builder(BB);
+  Instruction *Inst = Builder.CreateCondBr(Builder.getTrue(), BB, BB);
+
+  InstrProfValueData ValueData[5];
+  uint32_t N;
+  uint64_t T;
+  annotateValueSite(*M, *Inst, Record, IPVK_IndirectCallTarget, 0);
+  ASSERT_FALSE(getValueProfDataFromInst(*Inst, IPVK_IndirectCallTarget, 5,
+                                        ValueData, N, T));
+
+  // Only the three hottest values are kept, but the total counts them all.
+  annotateValueSite(*M, *Inst, Record, IPVK_IndirectCallTarget, 1);
+  ASSERT_TRUE(getValueProfDataFromInst(*Inst, IPVK_IndirectCallTarget, 5,
+                                       ValueData, N, T));
+  ASSERT_EQ(3U, N);
+  ASSERT_EQ(10U, T);
+  ASSERT_EQ(2000U, ValueData[0].Value);
+  ASSERT_EQ(4U, ValueData[0].Count);
+  ASSERT_EQ(4000U, ValueData[1].Value);
+  ASSERT_EQ(3U, ValueData[1].Count);
+  ASSERT_EQ(3000U, ValueData[2].Value);
+  ASSERT_EQ(2U, ValueData[2].Count);
+
+  // MaxNumValueData limits the values returned.
+  ASSERT_TRUE(getValueProfDataFromInst(*Inst, IPVK_IndirectCallTarget, 1,
+                                       ValueData, N, T));
+  ASSERT_EQ(1U, N);
+  ASSERT_EQ(10U, T);
+}
+
 TEST_F(InstrProfTest, get_icall_data_read_write_with_weight) {
   InstrProfRecord Record1("caller", 0x1234, {1, 2});
   InstrProfRecord Record2("callee1", 0x1235, {3, 4});
@@ -0,0 +1,342 @@
+//===- DataRandoWrappersEmitter.cpp - Generate data rando wrapper tables --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tablegen backend emits the table of library functions wrapped by data
+// randomization: a lookup of wrappers by library function name, the types of
+// the wrappers, and the bodies of the wrappers that only decrypt or encrypt
+// buffers around the call. It also emits the DRRT_WRAPPERS X-macro used by the
+// runtime, which is checked in as Wrappers.def so that the runtime header can
+// be used outside of an LLVM build tree.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/TableGen/Error.h"
+#include "llvm/TableGen/Record.h"
+#include "llvm/TableGen/StringMatcher.h"
+#include "llvm/TableGen/TableGenBackend.h"
+#include <string>
+#include <vector>
+using namespace llvm;
+
+namespace {
+
+struct WrapperParam {
+  std::string Type;
+  // Index among the mask_t parameters, or -1.
+  int MaskIndex;
+};
+
+struct DataRandoWrapper {
+  Record *TheDef;
+  std::string Function;
+  std::string Name;
+  std::string Ret;
+  std::vector<WrapperParam> Params;
+  unsigned NumMasks;
+  bool IsVarArg;
+  int FormatArg;
+  std::vector<Record*> Inputs;
+  std::vector<Record*> Outputs;
+
+  explicit DataRandoWrapper(Record *R);
+
+  bool hasBody() const { return !Inputs.empty() || !Outputs.empty(); }
+
+  std::string getParamList() const;
+};
+
+class DataRandoWrappersEmitter {
+  std::vector<DataRandoWrapper> Wrappers;
+
+public:
+  explicit DataRandoWrappersEmitter(RecordKeeper &Records);
+
+  void run(raw_ostream &OS);
+  void runList(raw_ostream &OS);
+
+private:
+  void emitXMacro(raw_ostream &OS);
+  void emitLookup(raw_ostream &OS);
+  void emitTypes(raw_ostream &OS);
+  void emitBodies(raw_ostream &OS);
+  void emitBody(const DataRandoWrapper &W, raw_ostream &OS);
+};
+
+} // End anonymous namespace.
+
+static bool isPointerType(StringRef Type) {
+  return Type.find('*') != StringRef::npos || Type.endswith("[]");
+}
+
+DataRandoWrapper::DataRandoWrapper(Record *R)
+    : TheDef(R), Function(R->getName()), NumMasks(0), IsVarArg(false) {
+  Ret = R->getValueAsString("Ret");
+  FormatArg = R->getValueAsInt("FormatArg");
+  Inputs = R->getValueAsListOfDefs("Inputs");
+  Outputs = R->getValueAsListOfDefs("Outputs");
+  Name = R->getValueAsString("WrapperName");
+  if (Name.empty())
+    Name = (hasBody() ? "drrt_gen_" : "drrt_") + Function;
+
+  std::vector<std::string> Types = R->getValueAsListOfStrings("Params");
+  for (unsigned i = 0, e = Types.size(); i != e; ++i) {
+    if (Types[i] == "...") {
+      if (i + 1 != e)
+        PrintFatalError(R->getLoc(), "'...' must be the last parameter");
+      IsVarArg = true;
+      break;
+    }
+    WrapperParam P;
+    P.Type = Types[i];
+    P.MaskIndex = Types[i] == "mask_t" ? NumMasks++ : -1;
+    Params.push_back(P);
+  }
+
+  if (FormatArg >= 0 &&
+      (!IsVarArg || FormatArg >= (int)Params.size() ||
+       !isPointerType(Params[FormatArg].Type)))
+    PrintFatalError(R->getLoc(), "FormatArg must name the format string "
+                                 "parameter of a variadic function");
+
+  if (!hasBody())
+    return;
+
+  // A generated body handles every encrypted object itself, so check that each
+  // mask is used by exactly one buffer and that buffers are pointers with
+  // integer lengths.
+  if (IsVarArg)
+    PrintFatalError(R->getLoc(), "Cannot generate the body of a variadic "
+                                 "wrapper");
+  if (isPointerType(Ret))
+    PrintFatalError(R->getLoc(), "Cannot generate the body of a wrapper "
+                                 "returning a pointer");
+  std::vector<bool> MaskUsed(NumMasks);
+  auto checkBuffer = [&](Record *B) {
+    int Arg = B->getValueAsInt("Arg");
+    int Mask = B->getValueAsInt("Mask");
+    int Length = B->getValueAsInt("Length");
+    if (Arg < 0 || Arg >= (int)Params.size() ||
+        !isPointerType(Params[Arg].Type))
+      PrintFatalError(R->getLoc(), "Buffer argument " + itostr(Arg) +
+                                       " is not a pointer parameter");
+    if (Mask < 0 || Mask >= (int)NumMasks || MaskUsed[Mask])
+      PrintFatalError(R->getLoc(), "Mask " + itostr(Mask) +
+                                       " is out of range or used twice");
+    MaskUsed[Mask] = true;
+    if (Length >= (int)Params.size() ||
+        (Length >= 0 && (isPointerType(Params[Length].Type) ||
+                         Params[Length].MaskIndex >= 0)))
+      PrintFatalError(R->getLoc(), "Length " + itostr(Length) +
+                                       " is not an integer parameter");
+  };
+  for (Record *In : Inputs)
+    checkBuffer(In);
+  for (Record *Out : Outputs) {
+    checkBuffer(Out);
+    std::string Extent = Out->getValueAsString("Extent");
+    if (Extent != "result" && Extent != "string")
+      PrintFatalError(R->getLoc(), "Unknown output extent '" + Extent + "'");
+    if (Out->getValueAsInt("Length") < 0)
+      PrintFatalError(R->getLoc(), "Outputs need a Length parameter");
+    if (Extent == "result" && Ret == "void")
+      PrintFatalError(R->getLoc(), "A 'result' extent needs a return value");
+  }
+  for (unsigned i = 0; i != NumMasks; ++i)
+    if (!MaskUsed[i])
+      PrintFatalError(R->getLoc(), "Mask " + itostr(i) +
+                                       " is not used by any buffer");
+}
+
+std::string DataRandoWrapper::getParamList() const {
+  std::string List;
+  for (const WrapperParam &P : Params) {
+    if (!List.empty())
+      List += ", ";
+    List += P.Type;
+  }
+  if (IsVarArg)
+    List += List.empty() ? "..." : ", ...";
+  return List;
+}
+
+DataRandoWrappersEmitter::DataRandoWrappersEmitter(RecordKeeper &Records) {
+  for (Record *R : Records.getAllDerivedDefinitions("Wrapper"))
+    Wrappers.push_back(DataRandoWrapper(R));
+}
+
+void DataRandoWrappersEmitter::emitXMacro(raw_ostream &OS) {
+  OS << "#define DRRT_WRAPPERS \\\n";
+  for (const DataRandoWrapper &W : Wrappers) {
+    std::string Params = W.getParamList();
+    OS << "  DR_WR(" << W.Function << ", " << W.Name << ", " << W.Ret << ", ("
+       << (Params.empty() ? "void" : Params) << ")) \\\n";
+  }
+  OS << "\n";
+}
+
+void DataRandoWrappersEmitter::emitLookup(raw_ostream &OS) {
+  OS << "#ifdef GET_DRRT_WRAPPER_LOOKUP\n";
+  OS << "#undef GET_DRRT_WRAPPER_LOOKUP\n";
+
+  OS << "static const char *const WrapperNames[] = {\n";
+  for (const DataRandoWrapper &W : Wrappers)
+    OS << "  \"" << W.Name << "\",\n";
+  OS << "};\n\n";
+
+  OS << "static const int WrapperFormatArgs[] = {\n";
+  for (const DataRandoWrapper &W : Wrappers)
+    OS << "  " << W.FormatArg << ", // " << W.Function << "\n";
+  OS << "};\n\n";
+
+  std::vector<StringMatcher::StringPair> Matches;
+  for (unsigned i = 0, e = Wrappers.size(); i != e; ++i)
+    Matches.push_back(StringMatcher::StringPair(Wrappers[i].Function,
+                                                "return " + utostr(i) + ";"));
+  OS << "// Index of the wrapper for the library function Name, or -1.\n";
+  OS << "static int lookupWrapper(StringRef Name) {\n";
+  StringMatcher("Name", Matches, OS).Emit();
+  OS << "  return -1;\n";
+  OS << "}\n";
+  OS << "#endif // GET_DRRT_WRAPPER_LOOKUP\n\n";
+}
+
+void DataRandoWrappersEmitter::emitTypes(raw_ostream &OS) {
+  OS << "#ifdef GET_DRRT_WRAPPER_TYPES\n";
+  OS << "#undef GET_DRRT_WRAPPER_TYPES\n";
+  OS << "// The type the runtime declares the wrapper with the given index with.\n";
+  OS << "static FunctionType *getWrapperType(int Index, LLVMContext &C) {\n";
+  OS << "  switch (Index) {\n";
+  OS << "  default: llvm_unreachable(\"Invalid wrapper index\");\n";
+  for (unsigned i = 0, e = Wrappers.size(); i != e; ++i)
+    OS << "  case " << i << ": return TypeBuilder<" << Wrappers[i].Ret << "("
+       << Wrappers[i].getParamList() << "), false>::get(C);\n";
+  OS << "  }\n";
+  OS << "}\n";
+  OS << "#endif // GET_DRRT_WRAPPER_TYPES\n\n";
+}
+
+// The generated body of a wrapper decrypts each input into a temporary, calls
+// the library function, frees the temporaries and encrypts the outputs in
+// place. If every mask is null the library function is called directly.
+void DataRandoWrappersEmitter::emitBody(const DataRandoWrapper &W,
+                                        raw_ostream &OS) {
+  auto arg = [](unsigned i) { return "a" + utostr(i); };
+  auto mask = [](unsigned i) { return "m" + utostr(i); };
+
+  // Declare Name with the C type Type.
+  auto declare = [](StringRef Type, StringRef Name) {
+    return Type.str() + (Type.endswith("*") ? "" : " ") + Name.str();
+  };
+
+  OS << declare(W.Ret, W.Name) << "(";
+  std::vector<std::string> CallArgs;
+  for (unsigned i = 0, e = W.Params.size(); i != e; ++i) {
+    const WrapperParam &P = W.Params[i];
+    std::string Name = P.MaskIndex >= 0 ? mask(P.MaskIndex) : arg(i);
+    OS << (i ? ", " : "") << declare(P.Type, Name);
+    if (P.MaskIndex < 0)
+      CallArgs.push_back(Name);
+  }
+  OS << ") {\n";
+
+  bool HasResult = W.Ret != "void";
+  auto getCall = [&]() {
+    return W.Function + "(" + join(CallArgs.begin(), CallArgs.end(), ", ") +
+           ")";
+  };
+
+  OS << "  if (";
+  for (unsigned i = 0; i != W.NumMasks; ++i)
+    OS << (i ? " && " : "") << "!" << mask(i);
+  OS << ") {\n";
+  if (HasResult) {
+    OS << "    return " << getCall() << ";\n";
+  } else {
+    OS << "    " << getCall() << ";\n";
+    OS << "    return;\n";
+  }
+  OS << "  }\n";
+
+  for (Record *In : W.Inputs) {
+    unsigned Arg = In->getValueAsInt("Arg");
+    int Length = In->getValueAsInt("Length");
+    std::string Temp = "t" + utostr(Arg);
+    OS << "  char " << Temp << "_stack[DRRT_TEMP_SIZE];\n";
+    OS << "  " << declare(W.Params[Arg].Type, Temp) << " = ";
+    if (Length < 0)
+      OS << "decryptString(" << arg(Arg) << ", "
+         << mask(In->getValueAsInt("Mask")) << ", " << Temp << "_stack);\n";
+    else
+      OS << "decryptTemp(" << arg(Arg) << ", " << arg(Length) << ", "
+         << mask(In->getValueAsInt("Mask")) << ", " << Temp << "_stack);\n";
+    CallArgs[Arg] = Temp;
+  }
+  if (HasResult)
+    OS << "  " << declare(W.Ret, "r") << " = " << getCall() << ";\n";
+  else
+    OS << "  " << getCall() << ";\n";
+  OS << "  int e = errno;\n";
+  for (Record *In : W.Inputs) {
+    std::string Temp = "t" + utostr(In->getValueAsInt("Arg"));
+    OS << "  freeTemp(" << Temp << ", " << arg(In->getValueAsInt("Arg")) << ", "
+       << Temp << "_stack);\n";
+  }
+  for (Record *Out : W.Outputs) {
+    std::string Buf = arg(Out->getValueAsInt("Arg"));
+    std::string Mask = mask(Out->getValueAsInt("Mask"));
+    std::string Length = arg(Out->getValueAsInt("Length"));
+    if (Out->getValueAsString("Extent") == "result")
+      OS << "  if (r > 0)\n"
+         << "    encryptInPlace(" << Buf << ", r, " << Mask << ");\n";
+    else if (HasResult)
+      OS << "  if (r >= 0)\n"
+         << "    encryptString(" << Buf << ", " << Length << ", " << Mask
+         << ");\n";
+    else
+      OS << "  encryptString(" << Buf << ", " << Length << ", " << Mask
+         << ");\n";
+  }
+  OS << "  errno = e;\n";
+  OS << "  return" << (HasResult ? " r" : "") << ";\n";
+  OS << "}\n\n";
+}
+
+void DataRandoWrappersEmitter::emitBodies(raw_ostream &OS) {
+  OS << "#ifdef GET_DRRT_WRAPPER_BODIES\n";
+  OS << "#undef GET_DRRT_WRAPPER_BODIES\n";
+  for (const DataRandoWrapper &W : Wrappers)
+    if (W.hasBody())
+      emitBody(W, OS);
+  OS << "#endif // GET_DRRT_WRAPPER_BODIES\n\n";
+}
+
+void DataRandoWrappersEmitter::run(raw_ostream &OS) {
+  emitSourceFileHeader("Data randomization library wrappers", OS);
+  emitLookup(OS);
+  emitTypes(OS);
+  emitBodies(OS);
+}
+
+void DataRandoWrappersEmitter::runList(raw_ostream &OS) {
+  emitSourceFileHeader("Data randomization library wrapper list", OS);
+  emitXMacro(OS);
+}
+
+namespace llvm {
+
+void EmitDataRandoWrappers(RecordKeeper &RK, raw_ostream &OS) {
+  DataRandoWrappersEmitter(RK).run(OS);
+}
+
+void EmitDataRandoWrapperList(RecordKeeper &RK, raw_ostream &OS) {
+  DataRandoWrappersEmitter(RK).runList(OS);
+}
+
+} // End llvm namespace.
@@ -43,7 +43,9 @@ enum ActionType {
   PrintSets,
   GenOptParserDefs,
   GenCTags,
-  GenAttributes
+  GenAttributes,
+  GenDataRandoWrappers,
+  GenDataRandoWrapperList
 };
 
 namespace {
@@ -89,6 +91,12 @@ namespace {
                                "Generate ctags-compatible index"),
                     clEnumValN(GenAttributes, "gen-attrs",
                                "Generate attributes"),
+                    clEnumValN(GenDataRandoWrappers, "gen-data-rando-wrappers",
+                               "Generate data randomization wrapper tables"),
+                    clEnumValN(GenDataRandoWrapperList,
+                               "gen-data-rando-wrapper-list",
+                               "Generate the data randomization wrapper "
+                               "X-macro"),
                     clEnumValEnd));
 
   cl::opt<std::string>
@@ -172,6 +180,12 @@ bool LLVMTableGenMain(raw_ostream &OS, RecordKeeper &Records) {
   case GenAttributes:
     EmitAttributes(Records, OS);
     break;
+  case GenDataRandoWrappers:
+    EmitDataRandoWrappers(Records, OS);
+    break;
+  case GenDataRandoWrapperList:
+    EmitDataRandoWrapperList(Records, OS);
+    break;
   }
 
   return false;
@@ -79,6 +79,8 @@ void EmitMapTable(RecordKeeper &RK, raw_ostream &OS);
 void EmitOptParser(RecordKeeper &RK, raw_ostream &OS);
 void EmitCTags(RecordKeeper &RK, raw_ostream &OS);
 void EmitAttributes(RecordKeeper &RK, raw_ostream &OS);
+void EmitDataRandoWrappers(RecordKeeper &RK, raw_ostream &OS);
+void EmitDataRandoWrapperList(RecordKeeper &RK, raw_ostream &OS);
 
 } // End llvm namespace
 
@@ -0,0 +1,398 @@
+#!/usr/bin/env python
+"""Measure the overhead of the multicompiler diversity options.
+
+Builds every kernel in kernels/ once without diversity and then with each
+diversity configuration over several random seeds. Each build is run a few
+times. The output is JSON lines, one "build" record per kernel, configuration
+and seed and one "summary" record per kernel and configuration. A summary
+holds the mean, standard deviation, minimum and maximum across seeds of the
+run time, text size and compile time deltas, in percent of the matching
+baseline. LTO configurations are compared against an LTO baseline, and their
+code generation flags are passed to the gold plugin instead of the compiler.
+
+A build whose executable sections are identical to its baseline was not
+diversified. Its record has "text_diversified": false and it is left out of
+the summary, which counts such builds as "undiversified".
+
+Every diversified binary must print the same output as its baseline,
+otherwise its build record has "output_ok": false.
+
+Binaries linked against the reference cross-checking runtime report the number
+of cross-checks they ran as "dynamic_checks". Compare the data-checks and
+data-checks-noopt configurations to see how many checks -optimize-data-checks
+saves.
+
+Examples:
+  diversity-bench.py --cc /path/to/build/bin/clang -o results.jsonl
+  diversity-bench.py --cc clang --configs nop-insertion,mov-to-lea \\
+      --kernels matmul,http --seeds 5 --runs 5 --combine pairs
+  diversity-bench.py --list
+"""
+
+from __future__ import print_function
+
+import argparse
+import itertools
+import json
+import hashlib
+import math
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+KERNEL_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          'kernels')
+
+
+def mllvm(*opts):
+  flags = []
+  for opt in opts:
+    flags += ['-mllvm', opt]
+  return flags
+
+
+def plugin(*opts):
+  return ['-Wl,--plugin-opt,' + opt for opt in opts]
+
+
+# Each configuration gives compiler flags, linker flags and whether it needs
+# LTO. Code generation runs in the gold plugin for LTO builds, so lto_flags()
+# passes the -mllvm and -Xclang flags of those builds to the plugin instead.
+CONFIGS = {
+    'nop-insertion': {
+        'cflags': ['-Xclang', '-nop-insertion'] +
+                  mllvm('-nop-insertion-percentage=30')},
+    'mov-to-lea': {'cflags': mllvm('-mov-to-lea-percentage=30')},
+    'equiv-subst': {'cflags': mllvm('-equiv-subst-percentage=30')},
+    'randomize-registers': {'cflags': mllvm('-randomize-machine-registers')},
+    'sched-randomize': {'cflags': mllvm('-sched-randomize')},
+    'shuffle-stack-frames': {'cflags': mllvm('-shuffle-stack-frames')},
+    'stack-padding': {'cflags': mllvm('-max-stack-pad-size=64')},
+    'stack-to-heap': {
+        'cflags': mllvm('-stack-to-heap-promotion',
+                        '-stack-to-heap-percentage=30')},
+    'shuffle-globals': {
+        'lto': True,
+        'ldflags': plugin('-shuffle-globals')},
+    'pointer-protection': {
+        'lto': True,
+        'cflags': ['-fcode-pointer-protection'],
+        'ldflags': plugin('-pointer-protection', '-call-pointer-protection',
+                          '-cookie-protection')},
+    'data-rando': {
+        'lto': True,
+        'cflags': ['-fdata-rando'],
+        'ldflags': ['-fdata-rando']},
+    'data-checks': {
+        'cflags': ['-fsanitize=crosscheck'] + mllvm('-xcheck-data'),
+        'ldflags': ['-fsanitize=crosscheck']},
+    'data-checks-noopt': {
+        'cflags': ['-fsanitize=crosscheck'] +
+                  mllvm('-xcheck-data', '-optimize-data-checks=false'),
+        'ldflags': ['-fsanitize=crosscheck']},
+}
+
+# Combinations of configurations measured by default.
+COMBINATIONS = {
+    'code': ['nop-insertion', 'mov-to-lea', 'equiv-subst',
+             'randomize-registers', 'sched-randomize'],
+    'stack': ['shuffle-stack-frames', 'stack-padding', 'stack-to-heap'],
+    'all-non-lto': ['nop-insertion', 'mov-to-lea', 'equiv-subst',
+                    'randomize-registers', 'sched-randomize',
+                    'shuffle-stack-frames', 'stack-padding', 'stack-to-heap'],
+    'all-lto': ['nop-insertion', 'mov-to-lea', 'equiv-subst',
+                'randomize-registers', 'sched-randomize',
+                'shuffle-stack-frames', 'stack-padding', 'shuffle-globals',
+                'pointer-protection'],
+}
+
+
+# -Xclang code generation flags and the gold plugin options that set them.
+XCLANG_PLUGIN_OPTS = {
+    '-nop-insertion': '-nop-insertion',
+}
+
+
+def lto_flags(cflags):
+  """Split cflags into the flags left for the compiler and the gold plugin
+  options that replace the code generation flags among them."""
+  compile_flags = []
+  link_flags = []
+  flags = iter(cflags)
+  for flag in flags:
+    if flag == '-mllvm':
+      link_flags += plugin(next(flags))
+    elif flag == '-Xclang':
+      arg = next(flags)
+      if arg in XCLANG_PLUGIN_OPTS:
+        link_flags += plugin(XCLANG_PLUGIN_OPTS[arg])
+      else:
+        compile_flags += [flag, arg]
+    else:
+      compile_flags.append(flag)
+  return compile_flags, link_flags
+
+
+def combine(names):
+  """Merge the flags of several configurations."""
+  merged = {'cflags': [], 'ldflags': [], 'lto': False}
+  for name in names:
+    config = CONFIGS[name]
+    merged['cflags'] += config.get('cflags', [])
+    merged['ldflags'] += config.get('ldflags', [])
+    merged['lto'] |= config.get('lto', False)
+  return merged
+
+
+def kernels():
+  return sorted(f for f in os.listdir(KERNEL_DIR)
+                if f.endswith('.c') or f.endswith('.cpp'))
+
+
+def text_sections(path):
+  """Total size and SHA-1 of the executable sections of an ELF64 file."""
+  with open(path, 'rb') as f:
+    data = f.read()
+  if data[:4] != b'\x7fELF' or data[4:5] != b'\x02':
+    return None, None
+  endian = '<' if data[5:6] == b'\x01' else '>'
+  shoff, = struct.unpack_from(endian + 'Q', data, 0x28)
+  shentsize, shnum = struct.unpack_from(endian + 'HH', data, 0x3a)
+  size = 0
+  digest = hashlib.sha1()
+  for i in range(shnum):
+    header = shoff + i * shentsize
+    flags, = struct.unpack_from(endian + 'Q', data, header + 8)
+    sh_offset, sh_size = struct.unpack_from(endian + 'QQ', data, header + 24)
+    if flags & 0x4:  # SHF_EXECINSTR
+      size += sh_size
+      digest.update(data[sh_offset:sh_offset + sh_size])
+  return size, digest.hexdigest()
+
+
+def build(args, kernel, config, seed, out):
+  src = os.path.join(KERNEL_DIR, kernel)
+  cc = args.cxx if kernel.endswith('.cpp') else args.cc
+  cmd = [cc, '-O2'] + args.cflags
+  cflags = config['cflags']
+  ldflags = config['ldflags']
+  if config['lto']:
+    cmd += ['-flto', '-fuse-ld=gold']
+    cflags, codegen_flags = lto_flags(cflags)
+    ldflags = codegen_flags + ldflags
+  cmd += cflags
+  if seed is not None:
+    cmd += ['-frandom-seed=%d' % seed]
+    if config['lto']:
+      cmd += plugin('-random-seed=%d' % seed)
+  cmd += [src, '-o', out] + ldflags + args.ldflags + ['-lm']
+
+  start = time.time()
+  proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT)
+  log = proc.communicate()[0]
+  elapsed = time.time() - start
+  if proc.returncode:
+    return None, '%s\n%s' % (' '.join(cmd), log.decode('utf-8', 'replace'))
+  return elapsed, None
+
+
+def run(path, runs):
+  """Return the run times, the output and the number of cross-checks run."""
+  times = []
+  output = None
+  checks = None
+  env = dict(os.environ, CROSSCHECK_STATS='1')
+  for _ in range(runs):
+    start = time.time()
+    proc = subprocess.Popen([path], stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, env=env)
+    output, errors = proc.communicate()
+    times.append(time.time() - start)
+    if proc.returncode:
+      raise subprocess.CalledProcessError(proc.returncode, path)
+    m = re.search(br'crosscheck: (\d+) checks, (\d+) hash checks', errors)
+    if m:
+      checks = int(m.group(1)) + int(m.group(2))
+  return times, output, checks
+
+
+def median(values):
+  values = sorted(values)
+  mid = len(values) // 2
+  if len(values) % 2:
+    return values[mid]
+  return (values[mid - 1] + values[mid]) / 2
+
+
+def stats(values):
+  if not values:
+    return None
+  mean = sum(values) / len(values)
+  var = sum((v - mean) ** 2 for v in values) / max(len(values) - 1, 1)
+  return {'mean': mean, 'stdev': math.sqrt(var), 'min': min(values),
+          'max': max(values)}
+
+
+def delta(value, base):
+  return 100.0 * (value - base) / base if base else 0.0
+
+
+def measure(args, work, kernel, name, config, seed):
+  """Build and run one binary and return its build record."""
+  exe = os.path.join(work, '%s.%s.%s' % (kernel, name,
+                                         'base' if seed is None else seed))
+  record = {'type': 'build', 'kernel': kernel, 'config': name, 'seed': seed}
+  compile_s, error = build(args, kernel, config, seed, exe)
+  if error:
+    record['error'] = error
+    return record, None
+  try:
+    times, output, checks = run(exe, args.runs)
+  except (subprocess.CalledProcessError, OSError) as e:
+    record['error'] = str(e)
+    return record, None
+  text_bytes, text_sha1 = text_sections(exe)
+  record.update({'compile_s': compile_s, 'text_bytes': text_bytes,
+                 'text_sha1': text_sha1,
+                 'runtime_s': median(times), 'runtimes_s': times,
+                 'dynamic_checks': checks})
+  return record, output
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--cc', default='clang', help='C compiler')
+  parser.add_argument('--cxx', help='C++ compiler (default: CC with ++)')
+  parser.add_argument('--cflags', default='',
+                      help='extra flags for every compile')
+  parser.add_argument('--ldflags', default='',
+                      help='extra flags for every link')
+  parser.add_argument('--kernels', help='comma-separated kernels to run')
+  parser.add_argument('--configs',
+                      help='comma-separated configurations to run')
+  parser.add_argument('--combine', choices=['none', 'default', 'pairs'],
+                      default='default',
+                      help='also measure the default combinations, or every '
+                           'pair of the selected configurations')
+  parser.add_argument('--no-lto', action='store_true',
+                      help='skip configurations that need LTO')
+  parser.add_argument('--seeds', type=int, default=3,
+                      help='number of random seeds per configuration')
+  parser.add_argument('--runs', type=int, default=3,
+                      help='number of runs per binary')
+  parser.add_argument('--keep', metavar='DIR',
+                      help='build in DIR and keep the binaries')
+  parser.add_argument('-o', '--output', help='output file (default: stdout)')
+  parser.add_argument('--list', action='store_true',
+                      help='list the kernels and configurations')
+  args = parser.parse_args()
+
+  if args.list:
+    print('kernels: ' + ' '.join(kernels()))
+    for name in sorted(CONFIGS):
+      print('%s%s' % (name, ' (LTO)' if CONFIGS[name].get('lto') else ''))
+    for name in sorted(COMBINATIONS):
+      print('%s = %s' % (name, '+'.join(COMBINATIONS[name])))
+    return 0
+
+  if not args.cxx:
+    args.cxx = args.cc + '++'
+  args.cflags = args.cflags.split()
+  args.ldflags = args.ldflags.split()
+
+  selected_kernels = kernels()
+  if args.kernels:
+    wanted = args.kernels.split(',')
+    selected_kernels = [k for k in selected_kernels
+                        if os.path.splitext(k)[0] in wanted or k in wanted]
+  names = sorted(CONFIGS)
+  if args.configs:
+    names = args.configs.split(',')
+    for name in names:
+      if name not in CONFIGS:
+        parser.error('unknown configuration %s' % name)
+
+  configs = [(name, combine([name])) for name in names]
+  if args.combine == 'default':
+    for name in sorted(COMBINATIONS):
+      if set(COMBINATIONS[name]) <= set(names) or not args.configs:
+        configs.append((name, combine(COMBINATIONS[name])))
+  elif args.combine == 'pairs':
+    for a, b in itertools.combinations(names, 2):
+      configs.append(('%s+%s' % (a, b), combine([a, b])))
+  if args.no_lto:
+    configs = [(n, c) for n, c in configs if not c['lto']]
+
+  out = open(args.output, 'w') if args.output else sys.stdout
+  work = args.keep or tempfile.mkdtemp(prefix='diversity-bench-')
+  if not os.path.isdir(work):
+    os.makedirs(work)
+
+  def emit(record):
+    out.write(json.dumps(record, sort_keys=True) + '\n')
+    out.flush()
+
+  try:
+    for kernel in selected_kernels:
+      baselines = {}
+      for lto in sorted(set(c['lto'] for _, c in configs)):
+        name = 'baseline-lto' if lto else 'baseline'
+        config = combine([])
+        config['lto'] = lto
+        record, output = measure(args, work, kernel, name, config, None)
+        emit(record)
+        if output is not None:
+          baselines[lto] = (name, record, output)
+
+      for name, config in configs:
+        if config['lto'] not in baselines:
+          continue
+        base_name, base, base_output = baselines[config['lto']]
+        deltas = {'runtime': [], 'text': [], 'compile': []}
+        checks = []
+        undiversified = 0
+        for seed in range(1, args.seeds + 1):
+          record, output = measure(args, work, kernel, name, config, seed)
+          if output is not None:
+            record['output_ok'] = output == base_output
+            record['text_diversified'] = (record['text_sha1'] is None or
+                                          record['text_sha1'] !=
+                                          base['text_sha1'])
+            if not record['text_diversified']:
+              undiversified += 1
+              emit(record)
+              continue
+            deltas['runtime'].append(delta(record['runtime_s'],
+                                           base['runtime_s']))
+            deltas['compile'].append(delta(record['compile_s'],
+                                           base['compile_s']))
+            if record['dynamic_checks'] is not None:
+              checks.append(record['dynamic_checks'])
+            if record['text_bytes'] and base['text_bytes']:
+              deltas['text'].append(delta(record['text_bytes'],
+                                          base['text_bytes']))
+          emit(record)
+        emit({'type': 'summary', 'kernel': kernel, 'config': name,
+              'baseline': base_name, 'seeds': len(deltas['runtime']),
+              'undiversified': undiversified,
+              'runtime_delta_pct': stats(deltas['runtime']),
+              'text_delta_pct': stats(deltas['text']),
+              'compile_delta_pct': stats(deltas['compile']),
+              'dynamic_checks': stats(checks)})
+  finally:
+    if not args.keep:
+      shutil.rmtree(work, ignore_errors=True)
+    if args.output:
+      out.close()
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
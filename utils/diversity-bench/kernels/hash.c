@@ -0,0 +1,68 @@
+/* CRC-32 and FNV-1a over a buffer, plus an open-addressing hash table. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BUF_SIZE (1 << 20)
+#define TABLE_SIZE (1 << 16)
+
+static uint32_t crc_table[256];
+static uint32_t keys[TABLE_SIZE];
+static uint32_t values[TABLE_SIZE];
+
+static void crc_init(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++)
+      c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    crc_table[i] = c;
+  }
+}
+
+static uint32_t crc32(const unsigned char *p, size_t n) {
+  uint32_t c = 0xffffffffu;
+  for (size_t i = 0; i < n; i++)
+    c = crc_table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffffu;
+}
+
+static uint32_t fnv1a(const unsigned char *p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+static void insert(uint32_t key, uint32_t value) {
+  uint32_t slot = key * 2654435761u & (TABLE_SIZE - 1);
+  while (keys[slot] && keys[slot] != key)
+    slot = (slot + 1) & (TABLE_SIZE - 1);
+  keys[slot] = key;
+  values[slot] += value;
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 40;
+  unsigned char *buf = malloc(BUF_SIZE);
+  uint32_t seed = 7, sum = 0;
+
+  crc_init();
+  for (int it = 0; it < iterations; it++) {
+    for (size_t i = 0; i < BUF_SIZE; i++) {
+      seed = seed * 1103515245u + 12345u;
+      buf[i] = seed >> 24;
+    }
+    sum ^= crc32(buf, BUF_SIZE);
+    for (size_t i = 0; i + 16 <= BUF_SIZE; i += 16)
+      if (i % (TABLE_SIZE / 4) < TABLE_SIZE / 8)
+        /* At most TABLE_SIZE / 4 distinct keys, so the table never fills. */
+        insert(fnv1a(buf + i, 16) % (TABLE_SIZE / 4) + 1, (uint32_t)i);
+  }
+  for (size_t i = 0; i < TABLE_SIZE; i++)
+    sum += keys[i] ^ values[i];
+
+  printf("%u\n", sum);
+  free(buf);
+  return 0;
+}
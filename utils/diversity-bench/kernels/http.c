@@ -0,0 +1,234 @@
+/* HTTP-style request processing: parse generated requests, route them through
+ * a handler table and render responses. Everything happens in one process so
+ * the run time does not depend on the network. */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_HEADERS 16
+#define REQUESTS 20000
+
+struct header {
+  char name[32];
+  char value[128];
+};
+
+struct request {
+  char method[8];
+  char path[256];
+  char query[256];
+  struct header headers[MAX_HEADERS];
+  int num_headers;
+  const char *body;
+  size_t body_len;
+};
+
+struct response {
+  int status;
+  char body[2048];
+  size_t len;
+};
+
+typedef void (*handler_fn)(const struct request *, struct response *);
+
+static const char *find_header(const struct request *req, const char *name) {
+  for (int i = 0; i < req->num_headers; i++)
+    if (strcasecmp(req->headers[i].name, name) == 0)
+      return req->headers[i].value;
+  return NULL;
+}
+
+static size_t url_decode(const char *in, char *out, size_t size) {
+  size_t n = 0;
+  for (; *in && n + 1 < size; in++) {
+    if (*in == '%' && isxdigit((unsigned char)in[1]) &&
+        isxdigit((unsigned char)in[2])) {
+      char hex[3] = {in[1], in[2], 0};
+      out[n++] = (char)strtol(hex, NULL, 16);
+      in += 2;
+    } else {
+      out[n++] = *in == '+' ? ' ' : *in;
+    }
+  }
+  out[n] = 0;
+  return n;
+}
+
+static int query_param(const struct request *req, const char *key, char *out,
+                       size_t size) {
+  char buf[256];
+  strncpy(buf, req->query, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = 0;
+  for (char *save, *tok = strtok_r(buf, "&", &save); tok;
+       tok = strtok_r(NULL, "&", &save)) {
+    char *eq = strchr(tok, '=');
+    if (!eq)
+      continue;
+    *eq = 0;
+    if (strcmp(tok, key) == 0) {
+      url_decode(eq + 1, out, size);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void handle_index(const struct request *req, struct response *res) {
+  const char *agent = find_header(req, "User-Agent");
+  res->status = 200;
+  res->len = snprintf(res->body, sizeof(res->body),
+                      "<html><body><h1>Welcome</h1><p>%s</p></body></html>",
+                      agent ? agent : "unknown");
+}
+
+static void handle_search(const struct request *req, struct response *res) {
+  char term[128];
+  if (!query_param(req, "q", term, sizeof(term))) {
+    res->status = 400;
+    res->len = snprintf(res->body, sizeof(res->body), "missing q");
+    return;
+  }
+  res->status = 200;
+  res->len = snprintf(res->body, sizeof(res->body), "<ul>");
+  for (int i = 0; i < 10 && res->len < sizeof(res->body) - 128; i++)
+    res->len += snprintf(res->body + res->len, sizeof(res->body) - res->len,
+                         "<li>%s result %d</li>", term, i);
+  res->len += snprintf(res->body + res->len, sizeof(res->body) - res->len,
+                       "</ul>");
+}
+
+static void handle_upload(const struct request *req, struct response *res) {
+  static const char b64[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t n = 0;
+  for (size_t i = 0; i + 2 < req->body_len && n + 4 < sizeof(res->body);
+       i += 3) {
+    unsigned v = (unsigned char)req->body[i] << 16 |
+                 (unsigned char)req->body[i + 1] << 8 |
+                 (unsigned char)req->body[i + 2];
+    res->body[n++] = b64[v >> 18 & 63];
+    res->body[n++] = b64[v >> 12 & 63];
+    res->body[n++] = b64[v >> 6 & 63];
+    res->body[n++] = b64[v & 63];
+  }
+  res->status = 201;
+  res->len = n;
+}
+
+static void handle_not_found(const struct request *req, struct response *res) {
+  res->status = 404;
+  res->len = snprintf(res->body, sizeof(res->body), "%s not found", req->path);
+}
+
+static const struct route {
+  const char *method;
+  const char *path;
+  handler_fn handler;
+} routes[] = {
+    {"GET", "/", handle_index},
+    {"GET", "/search", handle_search},
+    {"POST", "/upload", handle_upload},
+};
+
+static int parse_request(const char *p, struct request *req) {
+  const char *end = strstr(p, "\r\n");
+  char line[512];
+  if (!end || (size_t)(end - p) >= sizeof(line))
+    return 0;
+  memcpy(line, p, end - p);
+  line[end - p] = 0;
+
+  char target[256];
+  if (sscanf(line, "%7s %255s", req->method, target) != 2)
+    return 0;
+  char *q = strchr(target, '?');
+  if (q) {
+    *q = 0;
+    snprintf(req->query, sizeof(req->query), "%s", q + 1);
+  } else {
+    req->query[0] = 0;
+  }
+  snprintf(req->path, sizeof(req->path), "%s", target);
+
+  req->num_headers = 0;
+  for (p = end + 2; strncmp(p, "\r\n", 2) != 0; p = end + 2) {
+    end = strstr(p, "\r\n");
+    const char *colon = memchr(p, ':', end - p);
+    if (!end || !colon)
+      return 0;
+    if (req->num_headers < MAX_HEADERS) {
+      struct header *h = &req->headers[req->num_headers++];
+      snprintf(h->name, sizeof(h->name), "%.*s", (int)(colon - p), p);
+      colon++;
+      while (*colon == ' ')
+        colon++;
+      snprintf(h->value, sizeof(h->value), "%.*s", (int)(end - colon), colon);
+    }
+  }
+  req->body = p + 2;
+  const char *len = find_header(req, "Content-Length");
+  req->body_len = len ? strtoul(len, NULL, 10) : 0;
+  return 1;
+}
+
+static size_t make_request(char *buf, size_t size, unsigned r) {
+  static const char *agents[] = {"curl/7.58", "Mozilla/5.0 (X11; Linux)",
+                                 "bench/1.0"};
+  char body[300];
+  size_t body_len = 0;
+  switch (r % 4) {
+  case 0:
+    return snprintf(buf, size,
+                    "GET / HTTP/1.1\r\nHost: example.com\r\nUser-Agent: %s\r\n"
+                    "Accept: */*\r\n\r\n",
+                    agents[r % 3]);
+  case 1:
+    return snprintf(buf, size,
+                    "GET /search?q=term%%20%u&page=%u HTTP/1.1\r\n"
+                    "Host: example.com\r\nCookie: session=%08x\r\n\r\n",
+                    r % 1000, r % 7, r * 2654435761u);
+  case 2:
+    for (; body_len < 64 + r % 200; body_len++)
+      body[body_len] = 'a' + (r + body_len) % 26;
+    return snprintf(buf, size,
+                    "POST /upload HTTP/1.1\r\nHost: example.com\r\n"
+                    "Content-Length: %zu\r\n\r\n%.*s",
+                    body_len, (int)body_len, body);
+  default:
+    return snprintf(buf, size, "GET /missing/%u HTTP/1.1\r\nHost: x\r\n\r\n",
+                    r);
+  }
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 15;
+  unsigned long long sum = 0;
+  unsigned seed = 9;
+
+  for (int it = 0; it < iterations; it++) {
+    for (int i = 0; i < REQUESTS; i++) {
+      char raw[1024];
+      struct request req;
+      struct response res;
+      seed = seed * 1103515245u + 12345u;
+      make_request(raw, sizeof(raw), seed >> 8);
+      if (!parse_request(raw, &req)) {
+        sum += 1;
+        continue;
+      }
+      handler_fn handler = handle_not_found;
+      for (size_t r = 0; r < sizeof(routes) / sizeof(*routes); r++)
+        if (strcmp(routes[r].method, req.method) == 0 &&
+            strcmp(routes[r].path, req.path) == 0)
+          handler = routes[r].handler;
+      handler(&req, &res);
+      sum += res.status;
+      for (size_t k = 0; k < res.len; k++)
+        sum = sum * 31 + (unsigned char)res.body[k];
+    }
+  }
+  printf("%llu\n", sum);
+  return 0;
+}
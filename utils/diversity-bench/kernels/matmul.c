@@ -0,0 +1,46 @@
+/* Blocked double-precision matrix multiplication. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 192
+#define BLOCK 32
+
+static double A[N][N], B[N][N], C[N][N];
+
+static void init(unsigned seed) {
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++) {
+      seed = seed * 1103515245u + 12345u;
+      A[i][j] = (seed >> 16) % 100 / 10.0;
+      seed = seed * 1103515245u + 12345u;
+      B[i][j] = (seed >> 16) % 100 / 10.0;
+    }
+}
+
+static void multiply(void) {
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      C[i][j] = 0;
+  for (int ii = 0; ii < N; ii += BLOCK)
+    for (int kk = 0; kk < N; kk += BLOCK)
+      for (int jj = 0; jj < N; jj += BLOCK)
+        for (int i = ii; i < ii + BLOCK; i++)
+          for (int k = kk; k < kk + BLOCK; k++) {
+            double a = A[i][k];
+            for (int j = jj; j < jj + BLOCK; j++)
+              C[i][j] += a * B[k][j];
+          }
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 20;
+  double sum = 0;
+  for (int it = 0; it < iterations; it++) {
+    init(it);
+    multiply();
+    sum += C[it % N][(it * 7) % N];
+  }
+  printf("%.3f\n", sum);
+  return 0;
+}
@@ -0,0 +1,66 @@
+/* N-body simulation with a struct-of-arrays layout. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BODIES 512
+
+struct system {
+  double x[BODIES], y[BODIES], z[BODIES];
+  double vx[BODIES], vy[BODIES], vz[BODIES];
+  double mass[BODIES];
+};
+
+static struct system sys;
+
+static void advance(double dt) {
+  for (int i = 0; i < BODIES; i++) {
+    double ax = 0, ay = 0, az = 0;
+    for (int j = 0; j < BODIES; j++) {
+      double dx = sys.x[j] - sys.x[i];
+      double dy = sys.y[j] - sys.y[i];
+      double dz = sys.z[j] - sys.z[i];
+      double d2 = dx * dx + dy * dy + dz * dz + 0.01;
+      double inv = sys.mass[j] / (d2 * sqrt(d2));
+      ax += dx * inv;
+      ay += dy * inv;
+      az += dz * inv;
+    }
+    sys.vx[i] += ax * dt;
+    sys.vy[i] += ay * dt;
+    sys.vz[i] += az * dt;
+  }
+  for (int i = 0; i < BODIES; i++) {
+    sys.x[i] += sys.vx[i] * dt;
+    sys.y[i] += sys.vy[i] * dt;
+    sys.z[i] += sys.vz[i] * dt;
+  }
+}
+
+static double energy(void) {
+  double e = 0;
+  for (int i = 0; i < BODIES; i++)
+    e += 0.5 * sys.mass[i] *
+         (sys.vx[i] * sys.vx[i] + sys.vy[i] * sys.vy[i] +
+          sys.vz[i] * sys.vz[i]);
+  return e;
+}
+
+int main(int argc, char **argv) {
+  int steps = argc > 1 ? atoi(argv[1]) : 60;
+  unsigned seed = 3;
+  for (int i = 0; i < BODIES; i++) {
+    seed = seed * 1103515245u + 12345u;
+    sys.x[i] = (seed >> 16) % 1000 / 100.0;
+    seed = seed * 1103515245u + 12345u;
+    sys.y[i] = (seed >> 16) % 1000 / 100.0;
+    seed = seed * 1103515245u + 12345u;
+    sys.z[i] = (seed >> 16) % 1000 / 100.0;
+    sys.mass[i] = 1.0 + i % 7;
+  }
+  for (int s = 0; s < steps; s++)
+    advance(0.001);
+  printf("%.6f\n", energy());
+  return 0;
+}
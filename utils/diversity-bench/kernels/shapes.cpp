@@ -0,0 +1,68 @@
+// Virtual dispatch, std::map and std::string heavy C++ kernel.
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+struct Shape {
+  virtual ~Shape() {}
+  virtual double area() const = 0;
+  virtual std::string kind() const = 0;
+};
+
+struct Circle : Shape {
+  double R;
+  explicit Circle(double R) : R(R) {}
+  double area() const override { return 3.14159265358979 * R * R; }
+  std::string kind() const override { return "circle"; }
+};
+
+struct Rect : Shape {
+  double W, H;
+  Rect(double W, double H) : W(W), H(H) {}
+  double area() const override { return W * H; }
+  std::string kind() const override { return "rect"; }
+};
+
+struct Triangle : Shape {
+  double B, H;
+  Triangle(double B, double H) : B(B), H(H) {}
+  double area() const override { return 0.5 * B * H; }
+  std::string kind() const override { return "triangle"; }
+};
+} // end anonymous namespace
+
+int main(int argc, char **argv) {
+  int Iterations = argc > 1 ? std::atoi(argv[1]) : 30;
+  unsigned Seed = 5;
+  double Total = 0;
+  std::map<std::string, double> ByKind;
+
+  for (int It = 0; It < Iterations; It++) {
+    std::vector<std::unique_ptr<Shape>> Shapes;
+    for (int I = 0; I < 20000; I++) {
+      Seed = Seed * 1103515245u + 12345u;
+      double A = (Seed >> 16) % 100 / 10.0 + 0.1;
+      switch ((Seed >> 8) % 3) {
+      case 0: Shapes.emplace_back(new Circle(A)); break;
+      case 1: Shapes.emplace_back(new Rect(A, A + 1)); break;
+      default: Shapes.emplace_back(new Triangle(A, A * 2)); break;
+      }
+    }
+    for (const auto &S : Shapes) {
+      double Area = S->area();
+      ByKind[S->kind() + "-" + std::to_string(It % 4)] += Area;
+      Total += Area;
+    }
+  }
+
+  double Check = 0;
+  for (const auto &Entry : ByKind)
+    Check += Entry.second * Entry.first.size();
+  std::printf("%.3f %.3f\n", Total, Check);
+  return 0;
+}
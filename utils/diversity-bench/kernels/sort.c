@@ -0,0 +1,76 @@
+/* Sort integers and records with qsort and a hand-written merge sort, both
+ * through comparison function pointers. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N 200000
+
+struct record {
+  unsigned key;
+  char name[12];
+};
+
+static int cmp_uint(const void *a, const void *b) {
+  unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+  return x < y ? -1 : x > y;
+}
+
+static int cmp_record(const void *a, const void *b) {
+  const struct record *x = a, *y = b;
+  int c = strcmp(x->name, y->name);
+  return c ? c : cmp_uint(&x->key, &y->key);
+}
+
+static void merge_sort(unsigned *v, unsigned *tmp, size_t n,
+                       int (*cmp)(const void *, const void *)) {
+  if (n < 2)
+    return;
+  size_t half = n / 2;
+  merge_sort(v, tmp, half, cmp);
+  merge_sort(v + half, tmp, n - half, cmp);
+  size_t i = 0, j = half, k = 0;
+  while (i < half && j < n)
+    tmp[k++] = cmp(&v[i], &v[j]) <= 0 ? v[i++] : v[j++];
+  while (i < half)
+    tmp[k++] = v[i++];
+  while (j < n)
+    tmp[k++] = v[j++];
+  memcpy(v, tmp, n * sizeof(*v));
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 8;
+  unsigned *v = malloc(N * sizeof(*v));
+  unsigned *tmp = malloc(N * sizeof(*tmp));
+  struct record *r = malloc(N / 4 * sizeof(*r));
+  unsigned long long sum = 0;
+  unsigned seed = 1;
+
+  for (int it = 0; it < iterations; it++) {
+    for (size_t i = 0; i < N; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      v[i] = seed;
+    }
+    if (it & 1)
+      qsort(v, N, sizeof(*v), cmp_uint);
+    else
+      merge_sort(v, tmp, N, cmp_uint);
+    sum += v[it * 997 % N];
+
+    for (size_t i = 0; i < N / 4; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      r[i].key = seed;
+      snprintf(r[i].name, sizeof(r[i].name), "n%u", (seed >> 8) % 5000);
+    }
+    qsort(r, N / 4, sizeof(*r), cmp_record);
+    sum += r[it * 31 % (N / 4)].key;
+  }
+
+  printf("%llu\n", sum);
+  free(v);
+  free(tmp);
+  free(r);
+  return 0;
+}
@@ -0,0 +1,84 @@
+/* Tokenize generated text and count words with a Boyer-Moore-Horspool search
+ * and a small trie. Exercises stack buffers and byte-wise loops. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXT_SIZE (1 << 20)
+#define MAX_NODES 65536
+
+static const char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon",
+                              "zeta", "eta", "theta", "iota", "kappa"};
+
+static int trie[MAX_NODES][27];
+static int counts[MAX_NODES];
+static int nodes = 1;
+
+static size_t horspool(const char *text, size_t n, const char *pat) {
+  size_t m = strlen(pat), skip[256], found = 0;
+  for (int i = 0; i < 256; i++)
+    skip[i] = m;
+  for (size_t i = 0; i + 1 < m; i++)
+    skip[(unsigned char)pat[i]] = m - 1 - i;
+  for (size_t i = 0; i + m <= n; i += skip[(unsigned char)text[i + m - 1]])
+    if (memcmp(text + i, pat, m) == 0)
+      found++;
+  return found;
+}
+
+static void add_word(const char *w, size_t n) {
+  int node = 0;
+  for (size_t i = 0; i < n; i++) {
+    int c = w[i] - 'a';
+    if (c < 0 || c >= 26)
+      c = 26;
+    if (!trie[node][c]) {
+      if (nodes == MAX_NODES)
+        return;
+      trie[node][c] = nodes++;
+    }
+    node = trie[node][c];
+  }
+  counts[node]++;
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 10;
+  char *text = malloc(TEXT_SIZE + 1);
+  unsigned seed = 11;
+  size_t len = 0, found = 0;
+
+  while (len + 16 < TEXT_SIZE) {
+    seed = seed * 1103515245u + 12345u;
+    const char *w = words[(seed >> 16) % 10];
+    char word[16];
+    size_t n = strlen(w);
+    memcpy(word, w, n);
+    if ((seed >> 8) % 3 == 0)
+      word[n++] = 'a' + (seed >> 20) % 26;
+    memcpy(text + len, word, n);
+    len += n;
+    text[len++] = ' ';
+  }
+  text[len] = 0;
+
+  for (int it = 0; it < iterations; it++) {
+    for (size_t i = 0; i < sizeof(words) / sizeof(*words); i++)
+      found += horspool(text, len, words[i]);
+    size_t start = 0;
+    for (size_t i = 0; i <= len; i++)
+      if (text[i] == ' ' || text[i] == 0) {
+        if (i > start)
+          add_word(text + start, i - start);
+        start = i + 1;
+      }
+  }
+
+  long sum = found;
+  for (int i = 0; i < nodes; i++)
+    sum += (long)counts[i] * (i % 13);
+  printf("%ld %d\n", sum, nodes);
+  free(text);
+  return 0;
+}
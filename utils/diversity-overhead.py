@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+"""Compare the expected overhead of a diversity plan with the measured one.
+
+Reads the report written by -diversity-plan-report, runs the baseline and the
+diversified build of the same program several times, and prints the overhead
+the planner expected next to the measured wall clock overhead.
+
+Example:
+  diversity-overhead.py plan.csv --baseline './base input' \\
+      --diversified './diversified input' --runs 10
+"""
+
+from __future__ import print_function
+
+import argparse
+import re
+import subprocess
+import sys
+import time
+
+
+def expected_overhead(path):
+  budget = None
+  expected = None
+  with open(path) as f:
+    for line in f:
+      m = re.match(r'# Estimated overhead: ([0-9.]+)% .*\(budget ([0-9.]+)%\)',
+                   line)
+      if m:
+        expected = float(m.group(1))
+        budget = float(m.group(2))
+  if expected is None:
+    raise ValueError('%s has no estimated overhead line' % path)
+  return expected, budget
+
+
+def median_time(cmd, runs):
+  times = []
+  for _ in range(runs):
+    start = time.time()
+    subprocess.check_call(cmd, shell=True)
+    times.append(time.time() - start)
+  times.sort()
+  return times[len(times) // 2]
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('report', help='file written by -diversity-plan-report')
+  parser.add_argument('--baseline', required=True,
+                      help='command running the undiversified program')
+  parser.add_argument('--diversified', required=True,
+                      help='command running the diversified program')
+  parser.add_argument('--runs', type=int, default=5,
+                      help='number of runs of each command')
+  args = parser.parse_args()
+
+  expected, budget = expected_overhead(args.report)
+  base = median_time(args.baseline, args.runs)
+  div = median_time(args.diversified, args.runs)
+  measured = 100 * (div - base) / base if base > 0 else 0.0
+
+  print('budget:   %.4f%%' % budget)
+  print('expected: %.4f%%' % expected)
+  print('measured: %.4f%% (median of %d runs, %.3fs -> %.3fs)' %
+        (measured, args.runs, base, div))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
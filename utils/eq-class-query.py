@@ -0,0 +1,131 @@
+#!/usr/bin/env python
+"""Look up values in an equivalence class dump.
+
+Reads the JSON lines written by -print-eq-classes-to (the class file and the
+.values file next to it) and prints the class of every matching value: its
+mask, why it got that mask, which classes it points to, and its members.
+
+Examples:
+  eq-class-query.py classes.jsonl --name buf
+  eq-class-query.py classes.jsonl --function main --index 12
+  eq-class-query.py classes.jsonl --class 42
+  eq-class-query.py classes.jsonl --unencrypted --summary
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import sys
+
+
+def load_lines(path):
+  with open(path) as f:
+    for line in f:
+      if line.strip():
+        yield json.loads(line)
+
+
+def describe_value(value):
+  desc = value['kind']
+  if 'function' in value:
+    desc += ' in ' + value['function']
+  if 'name' in value:
+    sigil = '@' if value['kind'] in ('function', 'global', 'alias') else '%'
+    desc += ' ' + sigil + value['name']
+  if 'index' in value:
+    desc += ' #%d' % value['index']
+  if 'opcode' in value:
+    desc += ' (%s)' % value['opcode']
+  return desc
+
+
+def print_class(cls, values, max_members):
+  mask = cls['mask'] if cls['mask'] is not None else 'unassigned'
+  print('class %d: mask %s' % (cls['class'], mask), end='')
+  if 'mask_period' in cls:
+    print(', period %d' % cls['mask_period'], end='')
+  print(', %d accesses, %d allocations' % (cls['accesses'],
+                                            cls['allocations']))
+  for reason in cls['reasons']:
+    print('  reason: ' + reason)
+  for offset, target in cls['edges']:
+    print('  offset %d points to class %d' % (offset, target))
+  members = cls['members']
+  print('  %d members' % len(members))
+  for vid in members[:max_members]:
+    print('    %d: %s' % (vid, describe_value(values[vid])))
+  if len(members) > max_members:
+    print('    ...')
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('dump', help='class file written by -print-eq-classes-to')
+  parser.add_argument('--name', help='name of the value to look up')
+  parser.add_argument('--function', help='function containing the value')
+  parser.add_argument('--index', type=int,
+                      help='instruction or argument index within --function')
+  parser.add_argument('--class', dest='cls', type=int,
+                      help='print the class with this ID')
+  parser.add_argument('--unencrypted', action='store_true',
+                      help='print every class with a null mask')
+  parser.add_argument('--summary', action='store_true',
+                      help='only print one line per class')
+  parser.add_argument('--max-members', type=int, default=20,
+                      help='number of members to print per class')
+  args = parser.parse_args()
+
+  values = {}
+  class_of = {}
+  for value in load_lines(args.dump + '.values'):
+    values[value['id']] = value
+  classes = {}
+  for cls in load_lines(args.dump):
+    classes[cls['class']] = cls
+    for vid in cls['members']:
+      class_of[vid] = cls['class']
+
+  selected = []
+  if args.cls is not None:
+    selected.append(args.cls)
+  if args.unencrypted:
+    selected.extend(c for c, cls in sorted(classes.items())
+                    if cls['mask'] == '0x0000000000000000')
+  if args.name is not None or args.function is not None:
+    for vid, value in sorted(values.items()):
+      if args.name is not None and value.get('name') != args.name:
+        continue
+      if args.function is not None and \
+          value.get('function', value.get('name')) != args.function:
+        continue
+      if args.index is not None and value.get('index') != args.index:
+        continue
+      print('%d: %s -> class %d' % (vid, describe_value(value),
+                                    class_of[vid]))
+      selected.append(class_of[vid])
+
+  if not selected:
+    print('no matching values or classes', file=sys.stderr)
+    return 1
+
+  seen = set()
+  for c in selected:
+    if c in seen:
+      continue
+    seen.add(c)
+    if c not in classes:
+      print('no class %d' % c, file=sys.stderr)
+      continue
+    if args.summary:
+      cls = classes[c]
+      print('class %d: mask %s, %d members' % (c, cls['mask'],
+                                               len(cls['members'])))
+    else:
+      print_class(classes[c], values, args.max_members)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
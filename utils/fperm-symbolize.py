@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+"""Symbolize addresses of a process whose functions were permuted at load time.
+
+Reads the layout written by the FunctionPermutation runtime to the file named
+by MULTICOMPILER_FPERM_MAP, maps each address from the permuted layout back to
+the linked layout the debug info describes, and, with --obj, passes it to
+llvm-symbolizer. Addresses are offsets from the load bias of the executable,
+in hex, given on the command line or one per line on stdin.
+
+Example:
+  MULTICOMPILER_FPERM_MAP=layout.txt ./program
+  fperm-symbolize.py layout.txt --obj ./program 0x1234 0x5678
+"""
+
+from __future__ import print_function
+
+import argparse
+import bisect
+import subprocess
+import sys
+
+
+def read_layout(path):
+  """Return the slots sorted by runtime address as (new, old, size) tuples."""
+  slots = []
+  with open(path) as f:
+    for line in f:
+      fields = line.split()
+      if len(fields) != 3:
+        continue
+      old, new, size = (int(field, 16) for field in fields)
+      slots.append((new, old, size))
+  slots.sort()
+  return slots
+
+
+def unpermute(slots, starts, address):
+  i = bisect.bisect_right(starts, address) - 1
+  if i >= 0:
+    new, old, size = slots[i]
+    if address < new + size:
+      return old + address - new
+  return address
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('layout', help='file written by the runtime')
+  parser.add_argument('addresses', nargs='*', help='addresses to map')
+  parser.add_argument('--obj', help='symbolize against this executable')
+  parser.add_argument('--symbolizer', default='llvm-symbolizer',
+                      help='llvm-symbolizer to run (default: %(default)s)')
+  args = parser.parse_args()
+
+  slots = read_layout(args.layout)
+  starts = [slot[0] for slot in slots]
+  addresses = args.addresses or [line.strip() for line in sys.stdin]
+  mapped = ['0x%x' % unpermute(slots, starts, int(a, 16))
+            for a in addresses if a]
+
+  if not args.obj:
+    for original, address in zip(addresses, mapped):
+      print('%s %s' % (original, address))
+    return 0
+
+  proc = subprocess.Popen([args.symbolizer, '-obj=' + args.obj] + mapped)
+  return proc.wait()
+
+
+if __name__ == '__main__':
+  sys.exit(main())